@@ -21,14 +21,51 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
 #include "internal.h"
 #include "net_http.h"
 #include "net_uri.h"
 #include "ctx_impl.h"
+#include "calendar_cache.h"
 #include "pkitruststore.h"
 
 KSI_IMPLEMENT_LIST(GlobalCleanupFn, NULL);
 
+/* Serializes the global init and cleanup functions of the contexts created in different threads. */
+#ifdef _WIN32
+static INIT_ONCE globalLockOnce = INIT_ONCE_STATIC_INIT;
+static CRITICAL_SECTION globalLock;
+
+static BOOL CALLBACK globalLock_init(PINIT_ONCE once, PVOID param, PVOID *context) {
+	InitializeCriticalSection(&globalLock);
+	return TRUE;
+}
+
+static void globalLock_acquire(void) {
+	InitOnceExecuteOnce(&globalLockOnce, globalLock_init, NULL, NULL);
+	EnterCriticalSection(&globalLock);
+}
+
+static void globalLock_release(void) {
+	LeaveCriticalSection(&globalLock);
+}
+#else
+static pthread_mutex_t globalLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void globalLock_acquire(void) {
+	pthread_mutex_lock(&globalLock);
+}
+
+static void globalLock_release(void) {
+	pthread_mutex_unlock(&globalLock);
+}
+#endif
+
 #ifdef COMMIT_ID
 #  define KSI_VERSION_STRING "libksi " VERSION "-" COMMIT_ID
 #else
@@ -155,8 +192,11 @@ int KSI_CTX_new(KSI_CTX **context) {
 	ctx->publicationCertEmail = NULL;
 	ctx->loggerCB = NULL;
 	ctx->requestHeaderCB = NULL;
+	ctx->requestPhaseCB = NULL;
+	ctx->requestPhaseCtx = NULL;
 	ctx->loggerCtx = NULL;
 	ctx->requestCounter = 0;
+	ctx->calendarCache = NULL;
 	KSI_ERR_clearErrors(ctx);
 
 	/* Create global cleanup list as the first thing. */
@@ -218,11 +258,18 @@ int KSI_CTX_registerGlobals(KSI_CTX *ctx, int (*initFn)(void), void (*cleanupFn)
 
 	/* Only run the init function if the cleanup function is not found. */
 	if (pos == NULL) {
+		globalLock_acquire();
 		res = initFn();
+		globalLock_release();
 		if (res != KSI_OK) goto cleanup;
 
 		res = KSI_List_append(ctx->cleanupFnList, (void *)cleanupFn);
-		if (res != KSI_OK) goto cleanup;
+		if (res != KSI_OK) {
+			globalLock_acquire();
+			cleanupFn();
+			globalLock_release();
+			goto cleanup;
+		}
 	}
 
 	res = KSI_OK;
@@ -251,7 +298,9 @@ static void globalCleanup(KSI_CTX *ctx) {
 			break;
 		}
 
+		globalLock_acquire();
 		fn();
+		globalLock_release();
 	}
 }
 
@@ -273,6 +322,8 @@ void KSI_CTX_free(KSI_CTX *ctx) {
 		KSI_PublicationsFile_free(ctx->publicationsFile);
 		KSI_free(ctx->publicationCertEmail);
 
+		KSI_CalendarCache_free(ctx->calendarCache);
+
 		KSI_free(ctx);
 	}
 }
@@ -400,6 +451,8 @@ int KSI_receivePublicationsFile(KSI_CTX *ctx, KSI_PublicationsFile **pubFile) {
 			goto cleanup;
 		}
 
+		KSI_RequestHandle_setPhaseTime(handle, KSI_NET_PHASE_PARSE_DONE, 0);
+
 		ctx->publicationsFile = tmp;
 		tmp = NULL;
 
@@ -463,6 +516,59 @@ cleanup:
 	return res;
 }
 
+int KSI_verifySignatures(KSI_CTX *ctx, KSI_Signature * const *sigs, size_t count, int *results) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || (sigs == NULL && count > 0)) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_Signature_verifyMany(sigs, count, ctx, NULL, results);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx,res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_verifySignaturesWithPublicationString(KSI_CTX *ctx, KSI_Signature * const *sigs, size_t count, const char *pubString, int *results) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_PublicationData *pubData = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || (sigs == NULL && count > 0) || pubString == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_PublicationData_fromBase32(ctx, pubString, &pubData);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx,res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_Signature_verifyMany(sigs, count, ctx, pubData, results);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx,res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_PublicationData_free(pubData);
+
+	return res;
+}
+
 int KSI_createSignature(KSI_CTX *ctx, KSI_DataHash *dataHash, KSI_Signature **sig) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_Signature *tmp = NULL;
@@ -931,6 +1037,24 @@ cleanup:
 	return res;
 }
 
+int KSI_CTX_setRequestPhaseCallback(KSI_CTX *ctx, KSI_RequestPhaseCallback cb, void *phaseCtx) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (ctx == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	ctx->requestPhaseCB = cb;
+	ctx->requestPhaseCtx = phaseCtx;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_CTX_setLoggerCallback(KSI_CTX *ctx, KSI_LoggerCallback cb, void *logCtx) {
 	int res = KSI_UNKNOWN_ERROR;
 	if (ctx == NULL) {
@@ -978,3 +1102,35 @@ cleanup:
 	return res;
 }
 CTX_VALUEP_GETTER(publicationCertEmail, PublicationCertEmail, const char)
+
+int KSI_CTX_setCalendarCacheSize(KSI_CTX *ctx, size_t maxEntries) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CalendarCache *tmp = NULL;
+
+	if (ctx == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (maxEntries > 0) {
+		res = KSI_CalendarCache_new(ctx, maxEntries, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	KSI_CalendarCache_free(ctx->calendarCache);
+	ctx->calendarCache = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_CalendarCache_free(tmp);
+
+	return res;
+}
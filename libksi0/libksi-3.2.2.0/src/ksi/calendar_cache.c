@@ -0,0 +1,267 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include <string.h>
+
+#include "internal.h"
+#include "calendar_cache.h"
+#include "hashchain.h"
+
+typedef struct CalendarCacheEntry_st CalendarCacheEntry;
+
+struct CalendarCacheEntry_st {
+	KSI_uint64_t aggrTime;
+	KSI_uint64_t pubTime;
+	KSI_CalendarHashChain *chain;
+
+	/* Next entry in the same bucket. */
+	CalendarCacheEntry *bucketNext;
+
+	/* Neighbours in the recently used list. */
+	CalendarCacheEntry *prev;
+	CalendarCacheEntry *next;
+};
+
+struct KSI_CalendarCache_st {
+	KSI_CTX *ctx;
+
+	size_t maxEntries;
+	size_t count;
+
+	CalendarCacheEntry **buckets;
+	size_t bucketCount;
+
+	/* Most recently used entry. */
+	CalendarCacheEntry *first;
+	/* Least recently used entry. */
+	CalendarCacheEntry *last;
+};
+
+static size_t bucketOf(const KSI_CalendarCache *cache, KSI_uint64_t aggrTime) {
+	/* All chains of the same aggregation time share the bucket. */
+	return (size_t)((aggrTime * 0x9E3779B97F4A7C15ull) >> 32) % cache->bucketCount;
+}
+
+static void CalendarCache_unlink(KSI_CalendarCache *cache, CalendarCacheEntry *entry) {
+	if (entry->prev != NULL) entry->prev->next = entry->next;
+	else cache->first = entry->next;
+	if (entry->next != NULL) entry->next->prev = entry->prev;
+	else cache->last = entry->prev;
+	entry->prev = entry->next = NULL;
+}
+
+static void CalendarCache_pushFront(KSI_CalendarCache *cache, CalendarCacheEntry *entry) {
+	entry->prev = NULL;
+	entry->next = cache->first;
+	if (cache->first != NULL) cache->first->prev = entry;
+	else cache->last = entry;
+	cache->first = entry;
+}
+
+static void CalendarCache_remove(KSI_CalendarCache *cache, CalendarCacheEntry *entry) {
+	CalendarCacheEntry **p = &cache->buckets[bucketOf(cache, entry->aggrTime)];
+
+	while (*p != NULL && *p != entry) p = &(*p)->bucketNext;
+	if (*p != NULL) *p = entry->bucketNext;
+
+	CalendarCache_unlink(cache, entry);
+
+	KSI_CalendarHashChain_free(entry->chain);
+	KSI_free(entry);
+	cache->count--;
+}
+
+int KSI_CalendarCache_new(KSI_CTX *ctx, size_t maxEntries, KSI_CalendarCache **cache) {
+	int res;
+	KSI_CalendarCache *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (ctx == NULL || maxEntries == 0 || cache == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_CalendarCache);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->ctx = ctx;
+	tmp->maxEntries = maxEntries;
+	tmp->count = 0;
+	tmp->bucketCount = maxEntries;
+	tmp->first = NULL;
+	tmp->last = NULL;
+
+	tmp->buckets = KSI_calloc(tmp->bucketCount, sizeof(CalendarCacheEntry *));
+	if (tmp->buckets == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	*cache = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_CalendarCache_free(tmp);
+
+	return res;
+}
+
+void KSI_CalendarCache_free(KSI_CalendarCache *cache) {
+	if (cache != NULL) {
+		CalendarCacheEntry *entry = cache->first;
+
+		while (entry != NULL) {
+			CalendarCacheEntry *next = entry->next;
+			KSI_CalendarHashChain_free(entry->chain);
+			KSI_free(entry);
+			entry = next;
+		}
+
+		KSI_free(cache->buckets);
+		KSI_free(cache);
+	}
+}
+
+int KSI_CalendarCache_get(KSI_CalendarCache *cache, const KSI_Integer *aggrTime, const KSI_Integer *pubTime, KSI_CalendarHashChain **chain) {
+	int res;
+	CalendarCacheEntry *entry = NULL;
+	KSI_uint64_t aggr;
+
+	if (aggrTime == NULL || chain == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	*chain = NULL;
+
+	if (cache == NULL) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	aggr = KSI_Integer_getUInt64(aggrTime);
+
+	for (entry = cache->buckets[bucketOf(cache, aggr)]; entry != NULL; entry = entry->bucketNext) {
+		if (entry->aggrTime == aggr && (pubTime == NULL || entry->pubTime == KSI_Integer_getUInt64(pubTime))) break;
+	}
+
+	if (entry == NULL) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = KSI_CalendarHashChain_clone(entry->chain, chain);
+	if (res != KSI_OK) {
+		KSI_pushError(cache->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	CalendarCache_unlink(cache, entry);
+	CalendarCache_pushFront(cache, entry);
+
+	KSI_LOG_debug(cache->ctx, "Calendar hash chain found in cache.");
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_CalendarCache_put(KSI_CalendarCache *cache, const KSI_Integer *aggrTime, const KSI_CalendarHashChain *chain) {
+	int res;
+	CalendarCacheEntry *entry = NULL;
+	CalendarCacheEntry *tmp = NULL;
+	KSI_Integer *pubTime = NULL;
+	KSI_uint64_t aggr;
+	KSI_uint64_t pub;
+	size_t bucket;
+
+	if (aggrTime == NULL || chain == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (cache == NULL) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = KSI_CalendarHashChain_getPublicationTime(chain, &pubTime);
+	if (res != KSI_OK || pubTime == NULL) {
+		KSI_pushError(cache->ctx, res = KSI_INVALID_FORMAT, "Calendar hash chain has no publication time.");
+		goto cleanup;
+	}
+
+	aggr = KSI_Integer_getUInt64(aggrTime);
+	pub = KSI_Integer_getUInt64(pubTime);
+	bucket = bucketOf(cache, aggr);
+
+	/* The chain for the same key never changes. */
+	for (entry = cache->buckets[bucket]; entry != NULL; entry = entry->bucketNext) {
+		if (entry->aggrTime == aggr && entry->pubTime == pub) {
+			res = KSI_OK;
+			goto cleanup;
+		}
+	}
+
+	tmp = KSI_new(CalendarCacheEntry);
+	if (tmp == NULL) {
+		KSI_pushError(cache->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->aggrTime = aggr;
+	tmp->pubTime = pub;
+	tmp->chain = NULL;
+	tmp->prev = NULL;
+	tmp->next = NULL;
+
+	res = KSI_CalendarHashChain_clone(chain, &tmp->chain);
+	if (res != KSI_OK) {
+		KSI_pushError(cache->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (cache->count >= cache->maxEntries) {
+		CalendarCache_remove(cache, cache->last);
+	}
+
+	tmp->bucketNext = cache->buckets[bucket];
+	cache->buckets[bucket] = tmp;
+	CalendarCache_pushFront(cache, tmp);
+	cache->count++;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (tmp != NULL) KSI_CalendarHashChain_free(tmp->chain);
+	KSI_free(tmp);
+
+	return res;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef CALENDAR_CACHE_H_
+#define CALENDAR_CACHE_H_
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * Bounded cache of validated calendar hash chains, keyed by the aggregation time
+	 * and the publication time of the chain. The least recently used chain is evicted
+	 * when the cache is full.
+	 */
+	typedef struct KSI_CalendarCache_st KSI_CalendarCache;
+
+	/**
+	 * Creates a new cache.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	maxEntries	Maximum number of chains held, must be greater than 0.
+	 * \param[out]	cache		Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_CalendarCache_new(KSI_CTX *ctx, size_t maxEntries, KSI_CalendarCache **cache);
+
+	/**
+	 * Cleanup method for the cache.
+	 * \param[in]	cache		Cache to be freed.
+	 */
+	void KSI_CalendarCache_free(KSI_CalendarCache *cache);
+
+	/**
+	 * Looks up a calendar hash chain. On a cache miss the output is set to \c NULL.
+	 * \param[in]	cache		The cache, may be \c NULL.
+	 * \param[in]	aggrTime	Aggregation time of the chain.
+	 * \param[in]	pubTime		Publication time of the chain, \c NULL matches any publication time.
+	 * \param[out]	chain		Pointer to the receiving pointer, the caller owns the returned copy.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_CalendarCache_get(KSI_CalendarCache *cache, const KSI_Integer *aggrTime, const KSI_Integer *pubTime, KSI_CalendarHashChain **chain);
+
+	/**
+	 * Stores a copy of a validated calendar hash chain. The chain is keyed by
+	 * its publication time.
+	 * \param[in]	cache		The cache, may be \c NULL.
+	 * \param[in]	aggrTime	Aggregation time the chain was requested for.
+	 * \param[in]	chain		Calendar hash chain.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_CalendarCache_put(KSI_CalendarCache *cache, const KSI_Integer *aggrTime, const KSI_CalendarHashChain *chain);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CALENDAR_CACHE_H_ */
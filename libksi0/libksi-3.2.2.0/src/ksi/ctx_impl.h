@@ -72,8 +72,15 @@ extern "C" {
 		/** User defined function to be called on the request pdu header before sending it. */
 		KSI_RequestHeaderCallback requestHeaderCB;
 
+		/** User defined function to be called every time a request completes a phase. */
+		KSI_RequestPhaseCallback requestPhaseCB;
+		void *requestPhaseCtx;
+
 		/** Counter for the requests sent by this context. */
 		KSI_uint64_t requestCounter;
+
+		/** Cache of the calendar hash chains received from the extender, NULL if disabled. */
+		struct KSI_CalendarCache_st *calendarCache;
 	};
 
 #ifdef __cplusplus
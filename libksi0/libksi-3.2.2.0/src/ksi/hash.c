@@ -72,7 +72,7 @@ static struct KSI_hashAlgorithmInfo_st {
  */
 
 void KSI_DataHash_free(KSI_DataHash *hash) {
-	if (hash != NULL && --hash->refCount == 0) {
+	if (hash != NULL && KSI_REFCOUNT_DEC(hash->refCount) == 0) {
 		KSI_free(hash);
 	}
 }
@@ -314,7 +314,7 @@ int KSI_DataHash_clone(KSI_DataHash *from, KSI_DataHash **to) {
 	}
 	KSI_ERR_clearErrors(from->ctx);
 
-	from->refCount++;
+	KSI_REFCOUNT_INC(from->refCount);
 	*to = from;
 
 	res = KSI_OK;
@@ -29,6 +29,7 @@
 #include "hash_impl.h"
 
 KSI_IMPORT_TLV_TEMPLATE(KSI_HashChainLink)
+KSI_IMPORT_TLV_TEMPLATE(KSI_CalendarHashChain)
 
 struct KSI_HashChainLink_st {
 	KSI_CTX *ctx;
@@ -418,6 +419,33 @@ cleanup:
 	return res;
 }
 
+int KSI_CalendarHashChain_clone(const KSI_CalendarHashChain *t, KSI_CalendarHashChain **clone) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CalendarHashChain *tmp = NULL;
+
+	if (t == NULL || clone == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = KSI_CalendarHashChain_new(t->ctx, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvTemplate_deepCopy(t->ctx, t, KSI_TLV_TEMPLATE(KSI_CalendarHashChain), tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	*clone = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_CalendarHashChain_free(tmp);
+
+	return res;
+}
+
 int KSI_CalendarHashChain_aggregate(KSI_CalendarHashChain *chain, KSI_DataHash **hsh) {
 	int res = KSI_UNKNOWN_ERROR;
 
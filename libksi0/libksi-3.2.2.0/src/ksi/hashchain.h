@@ -171,6 +171,7 @@ extern "C" {
 	 */
 	void KSI_CalendarHashChain_free(KSI_CalendarHashChain *t);
 	int KSI_CalendarHashChain_new(KSI_CTX *ctx, KSI_CalendarHashChain **t);
+	int KSI_CalendarHashChain_clone(const KSI_CalendarHashChain *t, KSI_CalendarHashChain **clone);
 	int KSI_CalendarHashChain_aggregate(KSI_CalendarHashChain *chain, KSI_DataHash **hsh);
 	int KSI_CalendarHashChain_calculateAggregationTime(KSI_CalendarHashChain *chain, time_t *aggrTime);
 	int KSI_CalendarHashChain_getPublicationTime(const KSI_CalendarHashChain *t, KSI_Integer **publicationTime);
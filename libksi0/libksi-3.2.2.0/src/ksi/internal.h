@@ -33,6 +33,7 @@
 #define KSI_IMPL_CURL			1
 #define KSI_IMPL_WININET		2
 #define KSI_IMPL_WINHTTP		3
+#define KSI_IMPL_NATIVE			6
  /**
   * Crypto implementations.
   */
@@ -89,6 +90,21 @@
 /** Dummy macro for indicating that the programmer knows and did not forget to free up some pointer. */
 #define KSI_nofree(ptr) (ptr) = NULL
 
+/* Reference counter of the objects that may be shared between threads. The macros update the
+ * counter atomically and evaluate to the new value. */
+typedef long KSI_RefCount;
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#  define KSI_REFCOUNT_INC(cnt) _InterlockedIncrement(&(cnt))
+#  define KSI_REFCOUNT_DEC(cnt) _InterlockedDecrement(&(cnt))
+#elif defined(__GNUC__)
+#  define KSI_REFCOUNT_INC(cnt) __sync_add_and_fetch(&(cnt), 1)
+#  define KSI_REFCOUNT_DEC(cnt) __sync_sub_and_fetch(&(cnt), 1)
+#else
+#  define KSI_REFCOUNT_INC(cnt) (++(cnt))
+#  define KSI_REFCOUNT_DEC(cnt) (--(cnt))
+#endif
+
 #define KSI_IMPLEMENT_GET_CTX(type)							\
 KSI_CTX *type##_getCtx(const type *o) {			 			\
 	return o != NULL ? o->ctx : NULL;						\
@@ -273,4 +289,25 @@ struct KSI_ERR_st {
 	KSI_CTX *ctx;
 };
 
+/**
+ * Encodes the value as a big-endian integer of \c len (at most 8) bytes.
+ */
+void KSI_putUInt(unsigned char *buf, KSI_uint64_t val, unsigned len);
+
+/**
+ * Decodes a big-endian integer of \c len (at most 8) bytes.
+ */
+KSI_uint64_t KSI_getUInt(const unsigned char *buf, unsigned len);
+
+/**
+ * Writes the value to the file as a big-endian integer of \c len (at most 8) bytes.
+ */
+int KSI_writeUInt(FILE *f, KSI_uint64_t val, unsigned len);
+
+/**
+ * Reads a big-endian integer of \c len (at most 8) bytes. At the end of the data
+ * \c *readCount is less than \c len and \c *val is not changed.
+ */
+int KSI_RDR_readUInt(KSI_RDR *rdr, unsigned len, KSI_uint64_t *val, size_t *readCount);
+
 #endif
@@ -27,6 +27,11 @@
 
 #ifndef _WIN32
 #  include "sys/socket.h"
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#  include <unistd.h>
 #  define socket_error errno
 #  define socketTimedOut EWOULDBLOCK
 #else
@@ -36,10 +41,17 @@
 #  include <ws2tcpip.h>
 #endif
 
+/* Size of the read-ahead buffer of the socket reader, large enough for a whole TLV16 PDU. */
+#define KSI_IO_SOCKET_BUFFER_SIZE (0xffff + 4)
+
+/* Initial size of the buffer of a file read to the end, large enough for a whole TLV16 PDU. */
+#define KSI_IO_FILE_BUFFER_SIZE (0xffff + 4)
+
 typedef enum {
 	KSI_IO_FILE,
 	KSI_IO_MEM,
-	KSI_IO_SOCKET
+	KSI_IO_SOCKET,
+	KSI_IO_MMAP
 } KSI_IO_Type;
 
 struct KSI_RDR_st {
@@ -54,7 +66,7 @@ struct KSI_RDR_st {
 		/* KSI_IO_FILE type input. */
 		FILE *file;
 
-		/* KSI_IO_MEM type input */
+		/* KSI_IO_MEM and KSI_IO_MMAP type input. */
 		struct {
 			unsigned char *buffer;
 			size_t buffer_length;
@@ -62,7 +74,18 @@ struct KSI_RDR_st {
 			/* Does the memory belong to this reader? */
 			int ownCopy;
 		} mem;
-		int socketfd;
+
+		/* KSI_IO_SOCKET type input. */
+		struct {
+			int fd;
+
+			/* Read-ahead buffer, allocated on the first read. */
+			unsigned char *buffer;
+			size_t buffer_size;
+			/* The unread data is buffer[start..end). */
+			size_t start;
+			size_t end;
+		} sock;
 	} data;
 
 	/* Offset of stream. */
@@ -160,6 +183,8 @@ static int createReader_fromMem(KSI_CTX *ctx, unsigned char *buffer, const size_
 
 	reader->data.mem.buffer_length = buffer_length;
 
+	reader->data.mem.ownCopy = 0;
+
 	*rdr = reader;
 	reader = NULL;
 
@@ -194,6 +219,197 @@ cleanup:
 	return res;
 }
 
+/* Reads the stream to the end into a buffer owned by the reader, for the files that can not
+ * be mapped. The size hint is the expected size of the file, 0 if not known. */
+static int readFile(KSI_CTX *ctx, FILE *f, size_t sizeHint, KSI_RDR *rdr) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *raw = NULL;
+	size_t raw_size = 0;
+	size_t raw_len = 0;
+
+	rdr->ioType = KSI_IO_MEM;
+
+	/* One byte more than the hint, so the end of the file is seen without growing the buffer. */
+	raw_size = (sizeHint > 0 && sizeHint < (size_t)-1) ? sizeHint + 1 : KSI_IO_FILE_BUFFER_SIZE;
+
+	while (!feof(f)) {
+		if (raw == NULL || raw_len == raw_size) {
+			size_t size = raw == NULL ? raw_size : 2 * raw_size;
+			unsigned char *tmp = NULL;
+
+			if (size < raw_size) {
+				KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to read file: file too large.");
+				goto cleanup;
+			}
+
+			tmp = KSI_malloc(size);
+			if (tmp == NULL) {
+				KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+				goto cleanup;
+			}
+
+			if (raw_len > 0) memcpy(tmp, raw, raw_len);
+			KSI_free(raw);
+			raw = tmp;
+			raw_size = size;
+		}
+
+		raw_len += fread(raw + raw_len, 1, raw_size - raw_len, f);
+		if (ferror(f)) {
+			KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to read file.");
+			goto cleanup;
+		}
+	}
+
+	rdr->data.mem.buffer = raw;
+	rdr->data.mem.buffer_length = raw_len;
+	rdr->data.mem.ownCopy = 1;
+	raw = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(raw);
+
+	return res;
+}
+
+#ifndef _WIN32
+static int mapFile(KSI_CTX *ctx, const char *fileName, KSI_RDR *rdr) {
+	int res = KSI_UNKNOWN_ERROR;
+	int fd = -1;
+	FILE *f = NULL;
+	struct stat st;
+	void *map = NULL;
+
+	fd = open(fileName, O_RDONLY);
+	if (fd < 0) {
+		KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to open file.");
+		goto cleanup;
+	}
+
+	if (fstat(fd, &st) != 0) {
+		KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to read file.");
+		goto cleanup;
+	}
+
+	/* Pipes, FIFOs and character devices are read to the end instead. */
+	if (!S_ISREG(st.st_mode)) {
+		f = fdopen(fd, "rb");
+		if (f == NULL) {
+			KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to open file.");
+			goto cleanup;
+		}
+		fd = -1;
+
+		res = readFile(ctx, f, 0, rdr);
+		goto cleanup;
+	}
+
+	if ((unsigned long long)st.st_size > (size_t)-1) {
+		KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to map file: file too large.");
+		goto cleanup;
+	}
+
+	/* An empty file can not be mapped, it is read as an empty buffer instead. */
+	if (st.st_size > 0) {
+		map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to map file.");
+			goto cleanup;
+		}
+
+		/* The files are parsed front to back once, let the kernel read ahead aggressively. */
+#ifdef MADV_SEQUENTIAL
+		madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+#ifdef MADV_WILLNEED
+		madvise(map, (size_t)st.st_size, MADV_WILLNEED);
+#endif
+	}
+
+	rdr->data.mem.buffer = map;
+	rdr->data.mem.buffer_length = (size_t)st.st_size;
+	rdr->data.mem.ownCopy = 1;
+
+	res = KSI_OK;
+
+cleanup:
+
+	/* The mapping stays valid after closing the descriptor. */
+	if (f != NULL) fclose(f);
+	if (fd >= 0) close(fd);
+
+	return res;
+}
+#else
+static int mapFile(KSI_CTX *ctx, const char *fileName, KSI_RDR *rdr) {
+	int res = KSI_UNKNOWN_ERROR;
+	FILE *f = NULL;
+	long raw_size;
+
+	/* Without mmap the file is read into a buffer owned by the reader. */
+	f = fopen(fileName, "rb");
+	if (f == NULL) {
+		KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to open file.");
+		goto cleanup;
+	}
+
+	/* The size is only known for the files that can be seeked. */
+	if (fseek(f, 0, SEEK_END) != 0 || (raw_size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+		raw_size = 0;
+		clearerr(f);
+	}
+
+	res = readFile(ctx, f, (size_t)raw_size, rdr);
+
+cleanup:
+
+	if (f != NULL) fclose(f);
+
+	return res;
+}
+#endif
+
+int KSI_RDR_fromFile(KSI_CTX *ctx, const char *fileName, KSI_RDR **rdr) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_RDR *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || fileName == NULL || rdr == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	tmp = newReader(ctx, KSI_IO_MMAP);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->data.mem.buffer = NULL;
+	tmp->data.mem.buffer_length = 0;
+	tmp->data.mem.ownCopy = 0;
+
+	res = mapFile(ctx, fileName, tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*rdr = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_RDR_close(tmp);
+
+	return res;
+}
+
 int KSI_RDR_fromSocket(KSI_CTX *ctx, int socketfd, KSI_RDR **rdr) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_RDR *tmp = NULL;
@@ -210,7 +426,11 @@ int KSI_RDR_fromSocket(KSI_CTX *ctx, int socketfd, KSI_RDR **rdr) {
 		goto cleanup;
 	}
 
-	tmp->data.socketfd = socketfd;
+	tmp->data.sock.fd = socketfd;
+	tmp->data.sock.buffer = NULL;
+	tmp->data.sock.buffer_size = 0;
+	tmp->data.sock.start = 0;
+	tmp->data.sock.end = 0;
 
 	*rdr = tmp;
 	tmp = NULL;
@@ -226,9 +446,15 @@ cleanup:
 
 
 int KSI_RDR_isEOF(KSI_RDR *rdr) {
+	/* The end of the socket may have been read ahead of the buffered data. */
+	if (rdr->ioType == KSI_IO_SOCKET && rdr->data.sock.start < rdr->data.sock.end) return 0;
 	return rdr->eof;
 }
 
+int KSI_RDR_isBuffered(KSI_RDR *rdr) {
+	return rdr != NULL && rdr->ioType == KSI_IO_SOCKET && rdr->data.sock.start < rdr->data.sock.end;
+}
+
 static int readFromFile(KSI_RDR *rdr, unsigned char *buffer, const size_t size, size_t *readCount) {
 	int res = KSI_UNKNOWN_ERROR;
 	size_t count;
@@ -297,11 +523,70 @@ cleanup:
 	return res;
 }
 
+/**
+ * Receives more data into the read-ahead buffer with a single call, making room for at
+ * least \c need unread bytes first. Sets the end of stream flag, when the peer has closed
+ * the connection.
+ */
+static int fillSocketBuffer(KSI_RDR *rdr, size_t need) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t unread = rdr->data.sock.end - rdr->data.sock.start;
+	unsigned char *tmp = NULL;
+	size_t room;
+	int c;
+
+	if (need < KSI_IO_SOCKET_BUFFER_SIZE) need = KSI_IO_SOCKET_BUFFER_SIZE;
+
+	if (rdr->data.sock.buffer_size < need) {
+		tmp = KSI_malloc(need);
+		if (tmp == NULL) {
+			KSI_pushError(rdr->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+
+		if (unread > 0) memcpy(tmp, rdr->data.sock.buffer + rdr->data.sock.start, unread);
+
+		KSI_free(rdr->data.sock.buffer);
+		rdr->data.sock.buffer = tmp;
+		rdr->data.sock.buffer_size = need;
+		rdr->data.sock.start = 0;
+		rdr->data.sock.end = unread;
+		tmp = NULL;
+	} else if (rdr->data.sock.start > 0 && rdr->data.sock.buffer_size - rdr->data.sock.start < need) {
+		/* Move the unread data to the beginning of the buffer. */
+		memmove(rdr->data.sock.buffer, rdr->data.sock.buffer + rdr->data.sock.start, unread);
+		rdr->data.sock.start = 0;
+		rdr->data.sock.end = unread;
+	}
+
+	room = rdr->data.sock.buffer_size - rdr->data.sock.end;
+	if (room > INT_MAX) room = INT_MAX;
+
+	c = recv(rdr->data.sock.fd, (char *)rdr->data.sock.buffer + rdr->data.sock.end, (int)room, 0);
+	if (c < 0) {
+		if (socket_error == socketTimedOut) {
+			KSI_pushError(rdr->ctx, res = KSI_NETWORK_RECIEVE_TIMEOUT, "Unable to read from socket."); // TODO! Add errno
+		} else {
+			KSI_pushError(rdr->ctx, res = KSI_IO_ERROR, "Unable to read from socket."); // TODO! Add errno
+		}
+		goto cleanup;
+	}
+
+	rdr->data.sock.end += c;
+	rdr->eof = (c == 0);
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+
+	return res;
+}
+
 static int readFromSocket(KSI_RDR *rdr, unsigned char *buffer, const size_t size, size_t *readCount) {
 	int res = KSI_UNKNOWN_ERROR;
 	size_t count = 0;
-	unsigned char *bp = buffer;
-	size_t bp_len = size;
 
 	if (rdr == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -315,33 +600,57 @@ static int readFromSocket(KSI_RDR *rdr, unsigned char *buffer, const size_t size
 		goto cleanup;
 	}
 
-	if(bp_len > INT_MAX){
-		KSI_pushError(rdr->ctx, res = KSI_INVALID_ARGUMENT, "Unable to read more than MAX_INT from the socket.");
-		goto cleanup;
-	}
+	while (count < size) {
+		size_t chunk = rdr->data.sock.end - rdr->data.sock.start;
 
-	while (!rdr->eof && bp_len > 0) {
-		int c = recv(rdr->data.socketfd, bp, bp_len, 0);
+		if (chunk == 0) {
+			if (rdr->eof) break;
 
-		if (c < 0) {
-			if (socket_error == socketTimedOut) {
-				KSI_pushError(rdr->ctx, res = KSI_NETWORK_RECIEVE_TIMEOUT, "Unable to read from socket."); // TODO! Add errno
-			} else {
-				KSI_pushError(rdr->ctx, res = KSI_IO_ERROR, "Unable to read from socket."); // TODO! Add errno
-			}
-			goto cleanup;
+			res = fillSocketBuffer(rdr, 0);
+			if (res != KSI_OK) goto cleanup;
+			continue;
 		}
 
-		bp_len -= c;
-		bp += c;
+		if (chunk > size - count) chunk = size - count;
 
-		rdr->eof = (c == 0);
-		count += c;
+		memcpy(buffer + count, rdr->data.sock.buffer + rdr->data.sock.start, chunk);
+		rdr->data.sock.start += chunk;
+		count += chunk;
 	}
+
 	/* Update metadata */
 	rdr->offset += count;
 
-	if (readCount != NULL) *readCount = count;
+	*readCount = count;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Returns a pointer to the next \c len bytes in the read-ahead buffer, receiving until as
+ * many are buffered or the peer closes the connection.
+ */
+static int readPtrFromSocket(KSI_RDR *rdr, unsigned char **ptr, const size_t len, size_t *readCount) {
+	int res = KSI_UNKNOWN_ERROR;
+	size_t count;
+
+	while (rdr->data.sock.end - rdr->data.sock.start < len && !rdr->eof) {
+		res = fillSocketBuffer(rdr, len);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	count = rdr->data.sock.end - rdr->data.sock.start;
+	if (count > len) count = len;
+
+	*ptr = count > 0 ? rdr->data.sock.buffer + rdr->data.sock.start : NULL;
+	*readCount = count;
+
+	rdr->data.sock.start += count;
+	rdr->offset += count;
 
 	res = KSI_OK;
 
@@ -370,6 +679,7 @@ int KSI_RDR_read_ex(KSI_RDR *rdr, unsigned char *buffer, const size_t bufferLeng
 			res = readFromFile(rdr, buffer, bufferLength, readCount);
 			break;
 		case KSI_IO_MEM:
+		case KSI_IO_MMAP:
 			res = readFromMem(rdr, buffer, bufferLength, readCount);
 			break;
 		case KSI_IO_SOCKET:
@@ -412,6 +722,7 @@ int KSI_RDR_read_ptr(KSI_RDR *rdr, unsigned char **ptr, const size_t len, size_t
 		case KSI_IO_FILE:
 			break;
 		case KSI_IO_MEM:
+		case KSI_IO_MMAP:
 			if (rdr->offset < rdr->data.mem.buffer_length) {
 				p = rdr->data.mem.buffer + rdr->offset;
 				count = len;
@@ -429,6 +740,13 @@ int KSI_RDR_read_ptr(KSI_RDR *rdr, unsigned char **ptr, const size_t len, size_t
 				*readCount = 0;
 			}
 			break;
+		case KSI_IO_SOCKET:
+			res = readPtrFromSocket(rdr, ptr, len, readCount);
+			if (res != KSI_OK) {
+				KSI_pushError(rdr->ctx, res, NULL);
+				goto cleanup;
+			}
+			break;
 		default:
 			KSI_pushError(rdr->ctx, res = KSI_UNKNOWN_ERROR, "Unsupported KSI IO TYPE");
 			goto cleanup;
@@ -454,9 +772,18 @@ void KSI_RDR_close(KSI_RDR *rdr)  {
 			rdr->data.file = NULL;
 			break;
 		case KSI_IO_MEM:
+			if (rdr->data.mem.ownCopy) KSI_free(rdr->data.mem.buffer);
+			rdr->data.mem.buffer = NULL;
+			break;
+		case KSI_IO_MMAP:
+#ifndef _WIN32
+			if (rdr->data.mem.buffer != NULL) munmap(rdr->data.mem.buffer, rdr->data.mem.buffer_length);
+#endif
 			rdr->data.mem.buffer = NULL;
 			break;
 		case KSI_IO_SOCKET:
+			KSI_free(rdr->data.sock.buffer);
+			rdr->data.sock.buffer = NULL;
 			break;
 		default:
 			KSI_LOG_warn(ctx, "Unsupported KSI IO-type - possible MEMORY LEAK");
@@ -493,4 +820,43 @@ cleanup:
 
 }
 
+void KSI_putUInt(unsigned char *buf, KSI_uint64_t val, unsigned len) {
+	unsigned i;
+
+	for (i = 0; i < len; i++) {
+		buf[i] = (unsigned char)(val >> ((len - i - 1) * 8));
+	}
+}
+
+KSI_uint64_t KSI_getUInt(const unsigned char *buf, unsigned len) {
+	KSI_uint64_t val = 0;
+	unsigned i;
+
+	for (i = 0; i < len; i++) {
+		val = (val << 8) | buf[i];
+	}
+
+	return val;
+}
+
+int KSI_writeUInt(FILE *f, KSI_uint64_t val, unsigned len) {
+	unsigned char buf[8];
+
+	KSI_putUInt(buf, val, len);
+
+	return fwrite(buf, 1, len, f) == len ? KSI_OK : KSI_IO_ERROR;
+}
+
+int KSI_RDR_readUInt(KSI_RDR *rdr, unsigned len, KSI_uint64_t *val, size_t *readCount) {
+	int res;
+	unsigned char *ptr = NULL;
+
+	res = KSI_RDR_read_ptr(rdr, &ptr, len, readCount);
+	if (res != KSI_OK) return res;
+
+	if (*readCount == len) *val = KSI_getUInt(ptr, len);
+
+	return KSI_OK;
+}
+
 KSI_IMPLEMENT_GET_CTX(KSI_RDR);
@@ -36,6 +36,29 @@ extern "C" {
 	 */
 	int KSI_RDR_fromMem(KSI_CTX *ctx, const unsigned char *buffer, const size_t buffer_length, KSI_RDR **rdr);
 	int KSI_RDR_fromSharedMem(KSI_CTX *ctx, unsigned char *buffer, const size_t buffer_length, KSI_RDR **rdr);
+
+	/**
+	 * Creates a reader for the whole content of a file. A regular file is mapped into
+	 * memory read-only, so #KSI_RDR_read_ptr returns pointers into the mapping without
+	 * copying the data. Other files (e.g. pipes) and all files on platforms without \c mmap
+	 * are read to the end into a buffer owned by the reader.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	fileName	Name of the file.
+	 * \param[out]	rdr			Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The pointers returned by #KSI_RDR_read_ptr are valid until the reader is closed
+	 * and the data they refer to must not be modified.
+	 */
+	int KSI_RDR_fromFile(KSI_CTX *ctx, const char *fileName, KSI_RDR **rdr);
+	/**
+	 * Creates a reader for a connected socket. The reader receives the data into a read-ahead
+	 * buffer with as few calls as possible, so several TLVs arriving in one segment are read
+	 * with a single call, and #KSI_RDR_read_ptr returns pointers into the buffer.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	socketfd	Connected socket, which remains owned by the caller.
+	 * \param[out]	rdr			Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
 	int KSI_RDR_fromSocket(KSI_CTX *ctx, int socketfd, KSI_RDR **rdr);
 
 	/* TODO!
@@ -43,6 +66,15 @@ extern "C" {
 	 */
 	int KSI_RDR_isEOF(KSI_RDR *rdr);
 
+	/**
+	 * Checks if the reader holds data that has been received but not yet read. A socket
+	 * with buffered data may not become readable again, so the callers waiting for the
+	 * socket should check the buffer first.
+	 * \param[in]	rdr			Reader.
+	 * \return non-zero if there is buffered data, 0 otherwise.
+	 */
+	int KSI_RDR_isBuffered(KSI_RDR *rdr);
+
 	int KSI_RDR_getOffset(KSI_RDR *rdr, size_t *offset);
 
 	/* TODO!
@@ -58,7 +90,9 @@ extern "C" {
 	 *
 	 * \return The method will return KSI_OK when no error occurred.
 	 *
-	 * \note This method can be applied to only #KSI_RDR which is based on a memory buffer.
+	 * \note This method can be applied to only #KSI_RDR which is based on a memory buffer, a
+	 * mapped file (see #KSI_RDR_fromFile) or a socket. For a socket the pointer refers to the read-ahead buffer and is valid only until the
+	 * next read from the reader.
 	 */
 	int KSI_RDR_read_ptr(KSI_RDR *rdr, unsigned char **ptr, const size_t len, size_t *readCount);
 
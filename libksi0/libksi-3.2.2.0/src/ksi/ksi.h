@@ -394,6 +394,36 @@ int KSI_verifyPublicationsFile(KSI_CTX *ctx, KSI_PublicationsFile *pubFile);
  */
 int KSI_verifySignature(KSI_CTX *ctx, KSI_Signature *sig);
 
+/**
+ * Use the context to verify a batch of signatures. The outcome is the same as verifying
+ * the signatures one by one with #KSI_verifySignature, but the intermediate results common
+ * to the signatures are shared.
+ * \param[in]		ctx			KSI context.
+ * \param[in]		sigs		Array of KSI signatures.
+ * \param[in]		count		Number of signatures in \c sigs.
+ * \param[out]		results		Array of \c count status codes, may be \c NULL.
+ *
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note If \c results is \c NULL, the first failure is returned.
+ * \see #KSI_Signature_verifyMany
+ */
+int KSI_verifySignatures(KSI_CTX *ctx, KSI_Signature * const *sigs, size_t count, int *results);
+
+/**
+ * Use the context to verify a batch of signatures with a publication string. The
+ * publication string is decoded once for all the signatures.
+ * \param[in]		ctx			KSI context.
+ * \param[in]		sigs		Array of KSI signatures.
+ * \param[in]		count		Number of signatures in \c sigs.
+ * \param[in]		pubString	Publication string.
+ * \param[out]		results		Array of \c count status codes, may be \c NULL.
+ *
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note If \c results is \c NULL, the first failure is returned.
+ * \see #KSI_Signature_verifyMany
+ */
+int KSI_verifySignaturesWithPublicationString(KSI_CTX *ctx, KSI_Signature * const *sigs, size_t count, const char *pubString, int *results);
+
 /**
  * Create a KSI signature from a given data hash.
  * \param[in]		ctx			KSI context.
@@ -449,6 +479,19 @@ int KSI_CTX_setLoggerCallback(KSI_CTX *ctx, KSI_LoggerCallback cb, void *logCtx)
  */
 int KSI_CTX_setRequestHeaderCallback(KSI_CTX *ctx, KSI_RequestHeaderCallback cb);
 
+/**
+ * This function sets the callback which is executed every time a network request of the
+ * context completes a phase (resolving, connecting, sending, receiving, parsing). The
+ * callback is meant for measuring where the time of slow requests is spent; the same
+ * times can be read afterwards with #KSI_RequestHandle_getPhaseTime.
+ * \param[in]	ctx			KSI context.
+ * \param[in]	cb			Request phase callback function, \c NULL to disable.
+ * \param[in]	phaseCtx	Pointer passed to the callback, may be \c NULL.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \see #KSI_NetPhase
+ */
+int KSI_CTX_setRequestPhaseCallback(KSI_CTX *ctx, KSI_RequestPhaseCallback cb, void *phaseCtx);
+
 /**
  * Setter for publications file url.
  * \param[in]	ctx		KSI_context.
@@ -552,6 +595,19 @@ int KSI_CTX_getPublicationsFile(KSI_CTX *ctx, KSI_PublicationsFile **var);
  */
 int KSI_CTX_getPublicationCertEmail(KSI_CTX *ctx, const char **address);
 
+/**
+ * Enables caching of the calendar hash chains received from the extender. Extending
+ * and online verification consult the cache before sending an extend request, which
+ * saves a round trip for every signature sharing the aggregation time and the target
+ * publication time with an earlier one. Only chains that passed validation are cached.
+ * The cache is disabled by default.
+ * \param[in]	ctx			KSI context.
+ * \param[in]	maxEntries	Maximum number of cached chains, 0 disables the cache.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note Changing the size discards the cached chains.
+ */
+int KSI_CTX_setCalendarCacheSize(KSI_CTX *ctx, size_t maxEntries);
+
 /**
  * @}
  */
@@ -167,7 +167,7 @@ static int insertElementAt(KSI_List *list, size_t pos, void *o) {
 	if (res != KSI_OK) goto cleanup;
 
 	/* Shift the elements */
-	for (i = pos + 1; i < list->arr_len; i++) {
+	for (i = list->arr_len - 1; i > pos; i--) {
 		list->arr[i] = list->arr[i - 1];
 	}
 	list->arr[pos] = o;
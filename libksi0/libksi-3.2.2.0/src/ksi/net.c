@@ -19,12 +19,24 @@
 
 #include <string.h>
 
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <time.h>
+#  include <sys/time.h>
+#  include <sys/select.h>
+#endif
+
 #include "http_parser.h"
 #include "internal.h"
 #include "net_impl.h"
 #include "tlv.h"
+#include "tlv_template.h"
+#include "hash_impl.h"
 #include "ctx_impl.h"
 
+KSI_IMPORT_TLV_TEMPLATE(KSI_Header);
+
 KSI_IMPLEMENT_GET_CTX(KSI_NetworkClient);
 KSI_IMPLEMENT_GET_CTX(KSI_RequestHandle);
 
@@ -94,7 +106,19 @@ int KSI_RequestHandle_new(KSI_CTX *ctx, const unsigned char *request, unsigned r
 	tmp->response = NULL;
 	tmp->response_length = 0;
 
+	tmp->readResponse = NULL;
+	tmp->pollResponse = NULL;
+
 	tmp->client = NULL;
+	tmp->responseDone = NULL;
+	tmp->routeFree = NULL;
+	tmp->endpoint = NULL;
+	tmp->routedAt = 0;
+	tmp->isRoutePending = 0;
+	tmp->retry = NULL;
+
+	memset(tmp->phaseTime, 0, sizeof(tmp->phaseTime));
+	KSI_RequestHandle_setPhaseTime(tmp, KSI_NET_PHASE_START, 0);
 
 	*handle = tmp;
 	tmp = NULL;
@@ -140,6 +164,9 @@ void KSI_RequestHandle_free(KSI_RequestHandle *handle) {
 		if (handle->implCtx_free != NULL) {
 			handle->implCtx_free(handle->implCtx);
 		}
+		if (handle->routeFree != NULL) {
+			handle->routeFree(handle);
+		}
 		KSI_free(handle->request);
 		KSI_free(handle->response);
 		KSI_free(handle);
@@ -246,8 +273,126 @@ cleanup:
 	return res;
 }
 
+int KSI_NetworkClient_setEventCallbacks(KSI_NetworkClient *provider, KSI_NetSocketCallback socketCb, KSI_NetTimerCallback timerCb, KSI_NetDoneCallback doneCb, void *userCtx) {
+	int res;
+
+	if (provider == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(provider->ctx);
+
+	if (socketCb == NULL || timerCb == NULL) {
+		KSI_pushError(provider->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (provider->setEventCallbacks == NULL) {
+		KSI_pushError(provider->ctx, res = KSI_INVALID_ARGUMENT, "Network provider can not be driven by an external event loop.");
+		goto cleanup;
+	}
+
+	provider->socketCb = socketCb;
+	provider->timerCb = timerCb;
+	provider->doneCb = doneCb;
+	provider->eventCtx = userCtx;
+
+	res = provider->setEventCallbacks(provider);
+	if (res != KSI_OK) {
+		KSI_pushError(provider->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int onSocketEvent(KSI_NetworkClient *provider, int fd, int events) {
+	int res;
+
+	if (provider == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(provider->ctx);
+
+	if (!KSI_NetworkClient_isEventDriven(provider)) {
+		KSI_pushError(provider->ctx, res = KSI_INVALID_ARGUMENT, "Network provider is not event driven.");
+		goto cleanup;
+	}
+
+	res = provider->onSocketEvent(provider, fd, events);
+	if (res != KSI_OK) {
+		KSI_pushError(provider->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_NetworkClient_onReadable(KSI_NetworkClient *provider, int fd) {
+	return onSocketEvent(provider, fd, KSI_NET_EVENT_READ);
+}
+
+int KSI_NetworkClient_onWritable(KSI_NetworkClient *provider, int fd) {
+	return onSocketEvent(provider, fd, KSI_NET_EVENT_WRITE);
+}
+
+int KSI_NetworkClient_onTimeout(KSI_NetworkClient *provider) {
+	int res;
+
+	if (provider == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(provider->ctx);
+
+	if (!KSI_NetworkClient_isEventDriven(provider)) {
+		KSI_pushError(provider->ctx, res = KSI_INVALID_ARGUMENT, "Network provider is not event driven.");
+		goto cleanup;
+	}
+
+	res = provider->onTimeout(provider);
+	if (res != KSI_OK) {
+		KSI_pushError(provider->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_NetworkClient_watchSocket(KSI_NetworkClient *client, int fd, int events) {
+	if (client == NULL || !KSI_NetworkClient_isEventDriven(client)) return KSI_OK;
+	return client->socketCb(client->eventCtx, fd, events);
+}
+
+int KSI_NetworkClient_setTimer(KSI_NetworkClient *client, long timeoutMs) {
+	if (client == NULL || !KSI_NetworkClient_isEventDriven(client)) return KSI_OK;
+	return client->timerCb(client->eventCtx, timeoutMs);
+}
+
+void KSI_NetworkClient_requestDone(KSI_NetworkClient *client, KSI_RequestHandle *handle) {
+	if (client == NULL || handle == NULL || !KSI_NetworkClient_isEventDriven(client) || client->doneCb == NULL) return;
+	client->doneCb(client->eventCtx, handle);
+}
+
 void KSI_NetworkClient_free(KSI_NetworkClient *provider) {
 	if (provider != NULL) {
+		KSI_PreparedSignRequest_free(provider->preparedSign);
 		KSI_free(provider->aggrPass);
 		KSI_free(provider->aggrUser);
 		KSI_free(provider->extPass);
@@ -281,6 +426,7 @@ int KSI_RequestHandle_setResponse(KSI_RequestHandle *handle, const unsigned char
 		memcpy(resp, response, response_len);
 	}
 
+	KSI_free(handle->response);
 	handle->response = resp;
 	handle->response_length = response_len;
 
@@ -295,6 +441,32 @@ cleanup:
 	return res;
 }
 
+int KSI_RequestHandle_adoptResponse(KSI_RequestHandle *handle, unsigned char *response, unsigned response_len) {
+	int res;
+
+	if (handle == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(handle->ctx);
+
+	if (response == NULL && response_len > 0) {
+		KSI_pushError(handle->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	KSI_free(handle->response);
+	handle->response = response;
+	handle->response_length = response_len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_RequestHandle_setImplContext(KSI_RequestHandle *handle, void *netCtx, void (*netCtx_free)(void *)) {
 	int res;
 
@@ -337,6 +509,25 @@ cleanup:
 	return res;
 }
 
+int KSI_RequestHandle_setPollResponseFn(KSI_RequestHandle *handle, int (*fn)(KSI_RequestHandle *, unsigned, int *)) {
+	int res;
+
+	if (handle == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(handle->ctx);
+
+	handle->pollResponse = fn;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_RequestHandle_getRequest(KSI_RequestHandle *handle, const unsigned char **request, unsigned *request_len) {
 	int res;
 
@@ -372,8 +563,16 @@ static int receiveResponse(KSI_RequestHandle *handle) {
 		goto cleanup;
 	}
 
-
 	res = handle->readResponse(handle);
+
+	/* An event driven client does not wait for the response. */
+	if (res == KSI_ASYNC_NOT_FINISHED) goto cleanup;
+
+	/* Let the router learn from the outcome of the request. */
+	if (handle->responseDone != NULL) {
+		handle->responseDone(handle, res);
+	}
+
 	if (res != KSI_OK) {
 		KSI_pushError(handle->ctx, res, NULL);
 		goto cleanup;
@@ -386,6 +585,80 @@ cleanup:
 	return res;
 }
 
+KSI_uint64_t KSI_NET_getTimeUs(void) {
+#ifdef _WIN32
+	LARGE_INTEGER freq;
+	LARGE_INTEGER count;
+	if (!QueryPerformanceFrequency(&freq) || !QueryPerformanceCounter(&count)) {
+		return (KSI_uint64_t)GetTickCount() * 1000;
+	}
+	return (KSI_uint64_t)(count.QuadPart / freq.QuadPart) * 1000000 + (KSI_uint64_t)(count.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (KSI_uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (KSI_uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+KSI_uint64_t KSI_NET_getTimeMs(void) {
+	return KSI_NET_getTimeUs() / 1000;
+}
+
+void KSI_NET_sleepMs(KSI_uint64_t ms) {
+#ifdef _WIN32
+	Sleep((DWORD)ms);
+#else
+	struct timeval tv;
+	tv.tv_sec = (long)(ms / 1000);
+	tv.tv_usec = (long)(ms % 1000) * 1000;
+	select(0, NULL, NULL, NULL, &tv);
+#endif
+}
+
+int KSI_RequestHandle_setPhaseTime(KSI_RequestHandle *handle, int phase, KSI_uint64_t timeUs) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (handle == NULL || phase < 0 || phase >= KSI_NET_NOF_PHASES) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (timeUs == 0) timeUs = KSI_NET_getTimeUs();
+
+	handle->phaseTime[phase] = timeUs;
+
+	if (handle->ctx->requestPhaseCB != NULL) {
+		handle->ctx->requestPhaseCB(handle->ctx->requestPhaseCtx, handle, phase, timeUs);
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_RequestHandle_getPhaseTime(const KSI_RequestHandle *handle, int phase, KSI_uint64_t *timeUs) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (handle == NULL || phase < 0 || phase >= KSI_NET_NOF_PHASES || timeUs == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	*timeUs = handle->phaseTime[phase];
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_RequestHandle_getResponse(KSI_RequestHandle *handle, const unsigned char **response, unsigned *response_len) {
 	int res = KSI_UNKNOWN_ERROR;
 
@@ -579,6 +852,8 @@ int KSI_RequestHandle_getExtendResponse(KSI_RequestHandle *handle, KSI_ExtendRes
 		goto cleanup;
 	}
 
+	KSI_RequestHandle_setPhaseTime(handle, KSI_NET_PHASE_PARSE_DONE, 0);
+
 	*resp = tmp;
 	tmp = NULL;
 
@@ -702,6 +977,8 @@ int KSI_RequestHandle_getAggregationResponse(KSI_RequestHandle *handle, KSI_Aggr
 		goto cleanup;
 	}
 
+	KSI_RequestHandle_setPhaseTime(handle, KSI_NET_PHASE_PARSE_DONE, 0);
+
 	*resp = tmp;
 	tmp = NULL;
 
@@ -784,6 +1061,14 @@ int KSI_NetworkClient_init(KSI_CTX *ctx, KSI_NetworkClient *client) {
 	client->sendPublicationRequest = NULL;
 	client->sendSignRequest = NULL;
 	client->getStausCode = NULL;
+	client->socketCb = NULL;
+	client->timerCb = NULL;
+	client->doneCb = NULL;
+	client->eventCtx = NULL;
+	client->setEventCallbacks = NULL;
+	client->onSocketEvent = NULL;
+	client->onTimeout = NULL;
+	client->preparedSign = NULL;
 
 	res = KSI_OK;
 
@@ -934,3 +1219,405 @@ KSI_IMPLEMENT_GETTER(KSI_NetworkClient, const char *, extUser, ExtenderUser);
 KSI_IMPLEMENT_GETTER(KSI_NetworkClient, const char *, extPass, ExtenderPass);
 KSI_IMPLEMENT_GETTER(KSI_NetworkClient, const char *, aggrUser, AggregatorUser);
 KSI_IMPLEMENT_GETTER(KSI_NetworkClient, const char *, aggrPass, AggregatorPass);
+
+/* Block size of the hash functions used for the HMAC. */
+#define PREPARED_HMAC_BLOCK_LEN 64
+
+struct KSI_PreparedSignRequest_st {
+	KSI_CTX *ctx;
+
+	/* Credentials the request was prepared for. */
+	char *loginId;
+	char *key;
+
+	/* Key XOR-ed with the inner and outer padding of the HMAC. */
+	unsigned char ipadKey[PREPARED_HMAC_BLOCK_LEN];
+	unsigned char opadKey[PREPARED_HMAC_BLOCK_LEN];
+
+	/* Reused for every HMAC computation. */
+	KSI_DataHasher *hasher;
+	KSI_DataHash *innerHash;
+	KSI_DataHash *outerHash;
+
+	/* The PDU, with the serialized header following the 4 byte PDU header. */
+	unsigned char *buf;
+	unsigned buf_size;
+	unsigned header_len;
+};
+
+static int PreparedSignRequest_newHash(KSI_CTX *ctx, KSI_DataHash **hash) {
+	KSI_DataHash *tmp = NULL;
+
+	tmp = KSI_new(KSI_DataHash);
+	if (tmp == NULL) return KSI_OUT_OF_MEMORY;
+
+	tmp->ctx = ctx;
+	tmp->refCount = 1;
+	tmp->imprint_length = 0;
+
+	*hash = tmp;
+
+	return KSI_OK;
+}
+
+/* Serializes the request header, the same way as #KSI_AggregationReq_enclose. */
+static int PreparedSignRequest_serializeHeader(KSI_CTX *ctx, const char *loginId, unsigned char **raw, unsigned *raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Header *hdr = NULL;
+	KSI_Utf8String *login = NULL;
+
+	res = KSI_Header_new(ctx, &hdr);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Utf8String_new(ctx, loginId, (unsigned)strlen(loginId) + 1, &login);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Header_setLoginId(hdr, login);
+	if (res != KSI_OK) goto cleanup;
+	login = NULL;
+
+	if (ctx->requestHeaderCB != NULL) {
+		res = ctx->requestHeaderCB(hdr);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_TlvTemplate_serializeObject(ctx, hdr, 0x01, 0, 0, KSI_TLV_TEMPLATE(KSI_Header), raw, raw_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Utf8String_free(login);
+	KSI_Header_free(hdr);
+
+	return res;
+}
+
+int KSI_PreparedSignRequest_new(KSI_CTX *ctx, const char *loginId, const char *key, KSI_PreparedSignRequest **prep) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_PreparedSignRequest *tmp = NULL;
+	KSI_DataHash *hashedKey = NULL;
+	const unsigned char *keyBuf = NULL;
+	unsigned keyBuf_len = 0;
+	unsigned char *header = NULL;
+	unsigned header_len = 0;
+	int hashAlg;
+	size_t key_len;
+	unsigned i;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || loginId == NULL || key == NULL || prep == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	key_len = strlen(key);
+	if (key_len == 0 || key_len > 0xffff) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "Invalid key length.");
+		goto cleanup;
+	}
+
+	/* The HMAC of the requests is calculated with the default hash algorithm. */
+	hashAlg = KSI_getHashAlgorithmByName("default");
+	if (KSI_getHashLength(hashAlg) > PREPARED_HMAC_BLOCK_LEN) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "The hash length is greater than 64");
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_PreparedSignRequest);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->ctx = ctx;
+	tmp->loginId = NULL;
+	tmp->key = NULL;
+	tmp->hasher = NULL;
+	tmp->innerHash = NULL;
+	tmp->outerHash = NULL;
+	tmp->buf = NULL;
+	tmp->buf_size = 0;
+	tmp->header_len = 0;
+
+	res = setStringParam(&tmp->loginId, loginId);
+	if (res == KSI_OK) res = setStringParam(&tmp->key, key);
+	if (res == KSI_OK) res = PreparedSignRequest_newHash(ctx, &tmp->innerHash);
+	if (res == KSI_OK) res = PreparedSignRequest_newHash(ctx, &tmp->outerHash);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHasher_open(ctx, hashAlg, &tmp->hasher);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* If the key is longer than the block, it is replaced by its hash (see #KSI_HMAC_create). */
+	if (key_len > PREPARED_HMAC_BLOCK_LEN) {
+		res = KSI_DataHasher_add(tmp->hasher, key, key_len);
+		if (res == KSI_OK) res = KSI_DataHasher_close(tmp->hasher, &hashedKey);
+		if (res == KSI_OK) res = KSI_DataHash_extract(hashedKey, NULL, &keyBuf, &keyBuf_len);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	} else {
+		keyBuf = (const unsigned char *)key;
+		keyBuf_len = (unsigned)key_len;
+	}
+
+	for (i = 0; i < PREPARED_HMAC_BLOCK_LEN; i++) {
+		unsigned char k = i < keyBuf_len ? keyBuf[i] : 0;
+
+		tmp->ipadKey[i] = 0x36 ^ k;
+		tmp->opadKey[i] = 0x5c ^ k;
+	}
+
+	res = PreparedSignRequest_serializeHeader(ctx, loginId, &header, &header_len);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* PDU header, request header, request id, request hash, level and the HMAC. */
+	tmp->buf_size = 4 + header_len + 4 + (2 + 8) + (2 + KSI_MAX_IMPRINT_LEN) + (2 + 1) + (2 + KSI_MAX_IMPRINT_LEN);
+
+	/* The length of the PDU is encoded on 16 bits. */
+	if (tmp->buf_size - 4 > 0xffff) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "Login id too long.");
+		goto cleanup;
+	}
+
+	tmp->buf = KSI_malloc(tmp->buf_size);
+	if (tmp->buf == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	memcpy(tmp->buf + 4, header, header_len);
+	tmp->header_len = header_len;
+
+	*prep = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(header);
+	KSI_DataHash_free(hashedKey);
+	KSI_PreparedSignRequest_free(tmp);
+
+	return res;
+}
+
+void KSI_PreparedSignRequest_free(KSI_PreparedSignRequest *prep) {
+	if (prep != NULL) {
+		KSI_free(prep->loginId);
+		KSI_free(prep->key);
+		KSI_DataHasher_free(prep->hasher);
+		KSI_DataHash_free(prep->innerHash);
+		KSI_DataHash_free(prep->outerHash);
+		KSI_free(prep->buf);
+		KSI_free(prep);
+	}
+}
+
+/* Calculates the HMAC into the prepared outer hash object. */
+static int PreparedSignRequest_hmac(KSI_PreparedSignRequest *prep, const unsigned char *data, unsigned data_len) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	res = KSI_DataHasher_reset(prep->hasher);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHasher_add(prep->hasher, prep->ipadKey, PREPARED_HMAC_BLOCK_LEN);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHasher_add(prep->hasher, data, data_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = prep->hasher->closeExisting(prep->hasher, prep->innerHash);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHasher_reset(prep->hasher);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHasher_add(prep->hasher, prep->opadKey, PREPARED_HMAC_BLOCK_LEN);
+	if (res != KSI_OK) goto cleanup;
+
+	/* The digest of the inner hash, without the algorithm id. */
+	res = KSI_DataHasher_add(prep->hasher, prep->innerHash->imprint + 1, prep->innerHash->imprint_length - 1);
+	if (res != KSI_OK) goto cleanup;
+
+	res = prep->hasher->closeExisting(prep->hasher, prep->outerHash);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_PreparedSignRequest_build(KSI_PreparedSignRequest *prep, KSI_uint64_t requestId, const KSI_DataHash *hash, unsigned level, const unsigned char **raw, unsigned *raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	const unsigned char *imprint = NULL;
+	unsigned imprint_len = 0;
+	unsigned char *buf = NULL;
+	unsigned reqPos;
+	unsigned pos;
+	unsigned len;
+
+	if (prep == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(prep->ctx);
+	if (hash == NULL || raw == NULL || raw_len == NULL) {
+		KSI_pushError(prep->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	/* For now, the level may be just a single byte. */
+	if (level > 0xff) {
+		KSI_pushError(prep->ctx, res = KSI_INVALID_ARGUMENT, "Aggregation level may be only between 0x00 and 0xff");
+		goto cleanup;
+	}
+
+	res = KSI_DataHash_getImprint(hash, &imprint, &imprint_len);
+	if (res != KSI_OK || imprint == NULL || imprint_len > KSI_MAX_IMPRINT_LEN) {
+		KSI_pushError(prep->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	buf = prep->buf;
+	reqPos = 4 + prep->header_len;
+	pos = reqPos + 4;
+
+	/* Request id. */
+	len = KSI_UINT64_MINSIZE(requestId);
+	buf[pos++] = 0x01;
+	buf[pos++] = (unsigned char)len;
+	for (; len > 0; len--) {
+		buf[pos++] = (unsigned char)(requestId >> ((len - 1) * 8));
+	}
+
+	/* Request hash. */
+	buf[pos++] = 0x02;
+	buf[pos++] = (unsigned char)imprint_len;
+	memcpy(buf + pos, imprint, imprint_len);
+	pos += imprint_len;
+
+	/* Request level, only if specified. */
+	if (level > 0) {
+		buf[pos++] = 0x03;
+		buf[pos++] = 1;
+		buf[pos++] = (unsigned char)level;
+	}
+
+	len = pos - reqPos - 4;
+	buf[reqPos] = 0x82;
+	buf[reqPos + 1] = 0x01;
+	buf[reqPos + 2] = (unsigned char)(len >> 8);
+	buf[reqPos + 3] = (unsigned char)len;
+
+	/* The HMAC covers the header and the request. */
+	res = PreparedSignRequest_hmac(prep, buf + 4, pos - 4);
+	if (res != KSI_OK) {
+		KSI_pushError(prep->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	buf[pos++] = 0x1f;
+	buf[pos++] = (unsigned char)prep->outerHash->imprint_length;
+	memcpy(buf + pos, prep->outerHash->imprint, prep->outerHash->imprint_length);
+	pos += prep->outerHash->imprint_length;
+
+	len = pos - 4;
+	buf[0] = 0x82;
+	buf[1] = 0x00;
+	buf[2] = (unsigned char)(len >> 8);
+	buf[3] = (unsigned char)len;
+
+	*raw = buf;
+	*raw_len = pos;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_NetworkClient_serializeSignRequest(KSI_NetworkClient *client, KSI_AggregationReq *req, const unsigned char **raw, unsigned *raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Integer *reqId = NULL;
+	KSI_DataHash *reqHash = NULL;
+	KSI_Integer *reqLevel = NULL;
+	KSI_Config *config = NULL;
+	KSI_uint64_t level = 0;
+
+	if (client == NULL || req == NULL || raw == NULL || raw_len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	*raw = NULL;
+	*raw_len = 0;
+
+	/* The header callback may change the header of every request. */
+	if (client->aggrUser == NULL || client->aggrPass == NULL || client->ctx->requestHeaderCB != NULL) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	KSI_AggregationReq_getRequestId(req, &reqId);
+	KSI_AggregationReq_getRequestHash(req, &reqHash);
+	KSI_AggregationReq_getRequestLevel(req, &reqLevel);
+	KSI_AggregationReq_getConfig(req, &config);
+
+	if (reqLevel != NULL) level = KSI_Integer_getUInt64(reqLevel);
+
+	/* Only the plain requests are prepared. */
+	if (reqId == NULL || reqHash == NULL || config != NULL || level > 0xff) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	/* Prepare again, if the credentials have been changed. */
+	if (client->preparedSign != NULL &&
+			(strcmp(client->preparedSign->loginId, client->aggrUser) || strcmp(client->preparedSign->key, client->aggrPass))) {
+		KSI_PreparedSignRequest_free(client->preparedSign);
+		client->preparedSign = NULL;
+	}
+
+	if (client->preparedSign == NULL) {
+		res = KSI_PreparedSignRequest_new(client->ctx, client->aggrUser, client->aggrPass, &client->preparedSign);
+		if (res != KSI_OK) {
+			KSI_pushError(client->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_PreparedSignRequest_build(client->preparedSign, KSI_Integer_getUInt64(reqId), reqHash, (unsigned)level, raw, raw_len);
+	if (res != KSI_OK) {
+		KSI_pushError(client->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_nofree(reqId);
+	KSI_nofree(reqHash);
+	KSI_nofree(reqLevel);
+	KSI_nofree(config);
+
+	return res;
+}
@@ -36,6 +36,72 @@ extern "C" {
 	 * @{
 	 */
 
+	/**
+	 * Phases of a network request. Every request handle records the time each phase was
+	 * completed, see #KSI_RequestHandle_getPhaseTime.
+	 */
+	typedef enum KSI_NetPhase_en {
+		/** The request handle was created. */
+		KSI_NET_PHASE_START = 0,
+		/** The host name was resolved. Not recorded when an existing connection was reused. */
+		KSI_NET_PHASE_RESOLVED,
+		/** The connection was established. Not recorded when an existing connection was reused. */
+		KSI_NET_PHASE_CONNECTED,
+		/** The TLS handshake was completed. Recorded only for TLS connections. */
+		KSI_NET_PHASE_TLS_DONE,
+		/** The request was written to the connection (for HTTP, the transfer of the request began). */
+		KSI_NET_PHASE_REQUEST_SENT,
+		/** The first byte of the response was received. */
+		KSI_NET_PHASE_FIRST_BYTE,
+		/** The whole response was received. */
+		KSI_NET_PHASE_RESPONSE_DONE,
+		/** The response was parsed and verified. */
+		KSI_NET_PHASE_PARSE_DONE,
+		/** Number of the phases, not a phase itself. */
+		KSI_NET_NOF_PHASES
+	} KSI_NetPhase;
+
+	/**
+	 * Socket events a network client waits for, see #KSI_NetSocketCallback.
+	 */
+	typedef enum KSI_NetEvent_en {
+		/** The socket is not to be watched any more, it is about to be closed. */
+		KSI_NET_EVENT_REMOVE = 0,
+		/** Wait for the socket to become readable. */
+		KSI_NET_EVENT_READ = 0x01,
+		/** Wait for the socket to become writable. */
+		KSI_NET_EVENT_WRITE = 0x02
+	} KSI_NetEvent;
+
+	/**
+	 * Called by an event driven network client, when the set of events it waits for on a socket
+	 * changes. The host event loop reports the readiness of the socket with #KSI_NetworkClient_onReadable
+	 * and #KSI_NetworkClient_onWritable.
+	 * \param[in]		userCtx			The context passed to #KSI_NetworkClient_setEventCallbacks.
+	 * \param[in]		fd				The socket.
+	 * \param[in]		events			Bitwise or of #KSI_NET_EVENT_READ and #KSI_NET_EVENT_WRITE,
+	 * 									or #KSI_NET_EVENT_REMOVE.
+	 * \return #KSI_OK to continue, any other status code fails the operation in progress.
+	 */
+	typedef int (*KSI_NetSocketCallback)(void *userCtx, int fd, int events);
+
+	/**
+	 * Called by an event driven network client to (re)arm its single timer. The host event loop
+	 * calls #KSI_NetworkClient_onTimeout when the timer expires.
+	 * \param[in]		userCtx			The context passed to #KSI_NetworkClient_setEventCallbacks.
+	 * \param[in]		timeoutMs		Milliseconds from now, 0 to call as soon as possible and -1 to disarm the timer.
+	 * \return #KSI_OK to continue, any other status code fails the operation in progress.
+	 */
+	typedef int (*KSI_NetTimerCallback)(void *userCtx, long timeoutMs);
+
+	/**
+	 * Called by an event driven network client when a request has completed, either successfully or
+	 * with an error. The response or the error is read from the handle as usual, without blocking.
+	 * \param[in]		userCtx			The context passed to #KSI_NetworkClient_setEventCallbacks.
+	 * \param[in]		handle			The completed request.
+	 */
+	typedef void (*KSI_NetDoneCallback)(void *userCtx, KSI_RequestHandle *handle);
+
 	/**
 	 * Free network handle object.
 	 * \param[in]		handle			Network handle.
@@ -80,6 +146,61 @@ extern "C" {
 	 */
 	int KSI_NetworkClient_sendPublicationsFileRequest(KSI_NetworkClient *provider, KSI_RequestHandle **handle);
 
+	/**
+	 * Hands the network client over to an external event loop. The client does no blocking
+	 * network calls afterwards: it reports the sockets and the timeout it is waiting for with
+	 * \c socketCb and \c timerCb and expects to be driven with #KSI_NetworkClient_onReadable,
+	 * #KSI_NetworkClient_onWritable and #KSI_NetworkClient_onTimeout. Reading the response of a
+	 * request that has not completed yet returns #KSI_ASYNC_NOT_FINISHED instead of waiting.
+	 * \param[in]		provider		Network provider.
+	 * \param[in]		socketCb		Socket interest callback.
+	 * \param[in]		timerCb			Timer callback.
+	 * \param[in]		doneCb			Request completion callback, may be \c NULL.
+	 * \param[in]		userCtx			Context passed to the callbacks.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code).
+	 * \note Should be called before sending any requests. The TCP client and the libcurl based
+	 * HTTP client support event loops; resolving the host names is still done synchronously.
+	 * The URI client (the default provider of the context) passes the callbacks on to its
+	 * transports and fails the requests to a transport without event loop support. It does not
+	 * hedge nor retry the requests when event driven. The fault injecting and the recording
+	 * clients pass the callbacks on to the client they wrap.
+	 */
+	int KSI_NetworkClient_setEventCallbacks(KSI_NetworkClient *provider, KSI_NetSocketCallback socketCb, KSI_NetTimerCallback timerCb, KSI_NetDoneCallback doneCb, void *userCtx);
+
+	/**
+	 * Lets the event driven network client process the socket that has become readable.
+	 * \param[in]		provider		Network provider.
+	 * \param[in]		fd				The socket reported by the socket callback.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code). Failures of single requests are reported by their handles.
+	 * \see #KSI_NetworkClient_setEventCallbacks
+	 */
+	int KSI_NetworkClient_onReadable(KSI_NetworkClient *provider, int fd);
+
+	/**
+	 * Lets the event driven network client process the socket that has become writable.
+	 * \param[in]		provider		Network provider.
+	 * \param[in]		fd				The socket reported by the socket callback.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code). Failures of single requests are reported by their handles.
+	 * \see #KSI_NetworkClient_setEventCallbacks
+	 */
+	int KSI_NetworkClient_onWritable(KSI_NetworkClient *provider, int fd);
+
+	/**
+	 * Lets the event driven network client process the expiry of its timer.
+	 * \param[in]		provider		Network provider.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code). Failures of single requests are reported by their handles.
+	 * \see #KSI_NetworkClient_setEventCallbacks
+	 */
+	int KSI_NetworkClient_onTimeout(KSI_NetworkClient *provider);
+
 	/**
 	 * Setter for network request implementation context.
 	 * \param[in]		handle			Network handle.
@@ -128,6 +249,20 @@ extern "C" {
 	 */
 	int KSI_RequestHandle_setResponse(KSI_RequestHandle *handle, const unsigned char *response, unsigned response_len);
 
+	/**
+	 * Response value setter, which takes over the ownership of the response buffer instead of
+	 * copying it. Should be called only by the actual network provider implementation.
+	 * \param[in]		handle			Network handle.
+	 * \param[in]		response		Pointer to the response, allocated with #KSI_malloc or #KSI_calloc.
+	 * \param[in]		response_len	Response length.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code).
+	 * \note After a successful call the \c response memory belongs to the handle and may not be
+	 * used or freed by the caller.
+	 */
+	int KSI_RequestHandle_adoptResponse(KSI_RequestHandle *handle, unsigned char *response, unsigned response_len);
+
 	/**
 	 * A blocking function to read the response to the request. The function is blocking only
 	 * for the first call on one handle. If the first call succeeds following calls output the
@@ -181,6 +316,51 @@ extern "C" {
 	 */
 	int KSI_RequestHandle_setReadResponseFn(KSI_RequestHandle *handle, int (*fn)(KSI_RequestHandle *));
 
+	/**
+	 * Sets the function for waiting for the response without blocking longer than the given number of
+	 * milliseconds. The function sets the output flag, when the response reader would not block any more.
+	 * Network providers not setting the function do not support hedged requests.
+	 * \param[in]		handle			Network handle.
+	 * \param[in]		fn				Pointer to response polling function.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code).
+	 * \see #KSI_UriClient_setHedging
+	 */
+	int KSI_RequestHandle_setPollResponseFn(KSI_RequestHandle *handle, int (*fn)(KSI_RequestHandle *, unsigned, int *));
+
+	/**
+	 * Records the time the request completed the given phase. Should be called only by
+	 * the actual network provider implementation. A phase recorded again overwrites the
+	 * earlier time (i.e when the request is resent).
+	 * \param[in]		handle			Network handle.
+	 * \param[in]		phase			The completed phase (see #KSI_NetPhase).
+	 * \param[in]		timeUs			Time of completion on the clock of #KSI_NET_getTimeUs, 0 for the current time.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \see #KSI_CTX_setRequestPhaseCallback
+	 */
+	int KSI_RequestHandle_setPhaseTime(KSI_RequestHandle *handle, int phase, KSI_uint64_t timeUs);
+
+	/**
+	 * Getter for the time the request completed the given phase. The times are taken from a
+	 * monotonic clock in microseconds and are meaningful only relative to each other, e.g
+	 * the time spent waiting for the aggregator is the difference of #KSI_NET_PHASE_FIRST_BYTE
+	 * and #KSI_NET_PHASE_REQUEST_SENT.
+	 * \param[in]		handle			Network handle.
+	 * \param[in]		phase			The phase (see #KSI_NetPhase).
+	 * \param[out]		timeUs			Pointer to the receiving variable, set to 0 if the phase
+	 * 									has not been completed or was skipped.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_RequestHandle_getPhaseTime(const KSI_RequestHandle *handle, int phase, KSI_uint64_t *timeUs);
+
+	/**
+	 * Returns the value of the monotonic clock used for timing the request phases in microseconds.
+	 */
+	KSI_uint64_t KSI_NET_getTimeUs(void);
+
 	/**
 	 * Initialized for an existing abstract network provider.
 	 * \param[in]		ctx				KSI context.
@@ -242,6 +422,44 @@ extern "C" {
 	int KSI_NetworkClient_getAggregatorUser(const KSI_NetworkClient *net, const char **val);
 	int KSI_NetworkClient_getAggregatorPass(const KSI_NetworkClient *net, const char **val);
 
+	/**
+	 * Signing request prepared for a login id and key. The header of the request PDU is serialized
+	 * and the HMAC key is padded only once, every request only writes the request id and the hash
+	 * into a reusable buffer and calculates the HMAC, without allocating memory.
+	 */
+	typedef struct KSI_PreparedSignRequest_st KSI_PreparedSignRequest;
+
+	/**
+	 * Prepares the signing requests for the credentials.
+	 * \param[in]		ctx				KSI context.
+	 * \param[in]		loginId			Login id of the aggregator user.
+	 * \param[in]		key				Shared HMAC secret of the aggregator user.
+	 * \param[out]		prep			Pointer to the receiving pointer.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The request header callback of the context is applied once, to the prepared header.
+	 */
+	int KSI_PreparedSignRequest_new(KSI_CTX *ctx, const char *loginId, const char *key, KSI_PreparedSignRequest **prep);
+
+	/**
+	 * Cleanup method for the prepared signing request.
+	 * \param[in]		prep			Prepared signing request.
+	 */
+	void KSI_PreparedSignRequest_free(KSI_PreparedSignRequest *prep);
+
+	/**
+	 * Serializes the aggregation request PDU for the hash.
+	 * \param[in]		prep			Prepared signing request.
+	 * \param[in]		requestId		Request id.
+	 * \param[in]		hash			Hash to be signed.
+	 * \param[in]		level			Aggregation level of the hash, 0 if not specified.
+	 * \param[out]		raw				Receives the pointer to the serialized PDU, valid until the next call.
+	 * \param[out]		raw_len			Receives the length of the serialized PDU.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_PreparedSignRequest_build(KSI_PreparedSignRequest *prep, KSI_uint64_t requestId, const KSI_DataHash *hash, unsigned level, const unsigned char **raw, unsigned *raw_len);
+
 	/**
 	 * This function converts the aggregator response status code into a KSI status code.
 	 * \see #KSI_StatusCode
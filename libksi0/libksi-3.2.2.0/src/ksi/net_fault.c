@@ -0,0 +1,806 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include <string.h>
+
+#include "internal.h"
+#include "net_impl.h"
+#include "net_fault.h"
+
+/* Upper bound of the Pareto distributed delay as a multiple of the scale. */
+#define FAULT_PARETO_CAP 100
+
+/* Fates of a request. */
+enum {
+	FAULT_NONE = 0,
+	FAULT_TIMEOUT,
+	FAULT_TRUNCATE,
+	FAULT_ERROR_PDU
+};
+
+/* Kinds of the requests, the error PDU injected depends on it. */
+enum {
+	FAULT_REQ_AGGREGATION,
+	FAULT_REQ_EXTEND,
+	FAULT_REQ_PUBLICATIONS_FILE
+};
+
+struct KSI_FaultClient_st {
+	KSI_NetworkClient parent;
+
+	/* The client the requests are forwarded to. */
+	KSI_NetworkClient *inner;
+	/* Is #inner freed together with this client. */
+	int ownsInner;
+
+	/* The client holding the fault configuration and the generator, itself unless it
+	 * decorates an endpoint of a URI client (see #KSI_FaultClient_newForUriClient). */
+	KSI_FaultClient *root;
+	/* Is #inner a URI client with the endpoints decorated by fault clients. */
+	int decoratesEndpoints;
+
+	/* State of the pseudo-random generator (xorshift64). */
+	KSI_uint64_t seed;
+
+	int latencyDistribution;
+	unsigned latencyBaseMs;
+	unsigned latencyScaleMs;
+
+	unsigned timeoutPercent;
+	unsigned timeoutMs;
+	unsigned truncatePercent;
+	unsigned errorPercent;
+	unsigned errorStatus;
+	unsigned bytesPerSecond;
+};
+
+/**
+ * The injected fate of a single request, together with the transport functions of the
+ * wrapped client the handle is given back for calling them.
+ */
+typedef struct FaultHandleCtx_st {
+	KSI_FaultClient *client;
+	int kind;
+
+	int fate;
+	/* Fraction of the response kept by truncation, in millionths. */
+	KSI_uint64_t truncateAt;
+	unsigned errorStatus;
+	unsigned bytesPerSecond;
+
+	/* Time the response may be delivered at the earliest (see #KSI_NET_getTimeMs). */
+	KSI_uint64_t readyAt;
+	/* Has the response been received from the wrapped client and the fault applied. */
+	int isFetched;
+	/* Final status of the request. */
+	int status;
+
+	void *innerCtx;
+	void (*innerCtx_free)(void *);
+	int (*innerRead)(KSI_RequestHandle *);
+	int (*innerPoll)(KSI_RequestHandle *, unsigned, int *);
+} FaultHandleCtx;
+
+/* Returns the next pseudo-random value. */
+static KSI_uint64_t nextRandom(KSI_FaultClient *client) {
+	/* xorshift64 */
+	client->seed ^= client->seed << 13;
+	client->seed ^= client->seed >> 7;
+	client->seed ^= client->seed << 17;
+	return client->seed;
+}
+
+/* Maps a random value to the open interval (0, 1). */
+static double toUnit(KSI_uint64_t r) {
+	return ((double)(r >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/* Natural logarithm of a value in (0, 1], without depending on libm. */
+static double unitLog(double x) {
+	double y;
+	double y2;
+	double term;
+	double sum = 0;
+	int exp = 0;
+	int i;
+
+	/* Scale into [0.5, 1), where ln(x) = 2 * atanh((x - 1) / (x + 1)) converges fast. */
+	while (x < 0.5) {
+		x *= 2;
+		exp--;
+	}
+
+	y = (x - 1) / (x + 1);
+	y2 = y * y;
+	term = y;
+	for (i = 1; i < 40; i += 2) {
+		sum += term / i;
+		term *= y2;
+	}
+
+	return 2 * sum + exp * 0.69314718055994530942;
+}
+
+/* Square root by Newton's method, without depending on libm. */
+static double squareRoot(double x) {
+	double r = x > 1 ? x : 1;
+	int i;
+
+	if (x <= 0) return 0;
+	for (i = 0; i < 64; i++) {
+		double next = (r + x / r) / 2;
+		if (next >= r) break;
+		r = next;
+	}
+
+	return r;
+}
+
+/* Draws the delay of a request from the configured distribution. */
+static KSI_uint64_t drawLatency(KSI_FaultClient *client, KSI_uint64_t r) {
+	double u = toUnit(r);
+	double extra = 0;
+
+	switch (client->latencyDistribution) {
+		case KSI_FAULT_LATENCY_UNIFORM:
+			extra = u * client->latencyScaleMs;
+			break;
+		case KSI_FAULT_LATENCY_EXPONENTIAL:
+			extra = -unitLog(u) * client->latencyScaleMs;
+			break;
+		case KSI_FAULT_LATENCY_PARETO:
+			extra = (1 / squareRoot(u) - 1) * client->latencyScaleMs;
+			if (extra > (double)FAULT_PARETO_CAP * client->latencyScaleMs) extra = (double)FAULT_PARETO_CAP * client->latencyScaleMs;
+			break;
+		default:
+			break;
+	}
+
+	return client->latencyBaseMs + (KSI_uint64_t)extra;
+}
+
+static KSI_uint64_t transferTimeMs(unsigned len, unsigned bytesPerSecond) {
+	return bytesPerSecond > 0 ? (KSI_uint64_t)len * 1000 / bytesPerSecond : 0;
+}
+
+static void FaultHandleCtx_free(FaultHandleCtx *fc) {
+	if (fc != NULL) {
+		if (fc->innerCtx_free != NULL) fc->innerCtx_free(fc->innerCtx);
+		KSI_free(fc);
+	}
+}
+
+/* Calls a transport function of the wrapped client with its own context in the handle. */
+#define FAULT_CALL_INNER(handle, fc, call) \
+	do { \
+		(handle)->implCtx = (fc)->innerCtx; \
+		res = (call); \
+		(handle)->implCtx = (fc); \
+	} while (0)
+
+/* Creates an error PDU with the given status for the kind of the request. */
+static int createErrorPdu(KSI_CTX *ctx, int kind, unsigned status, unsigned char **raw, unsigned *raw_len) {
+	int res;
+	static const char msg[] = "Injected fault";
+	KSI_ErrorPdu *error = NULL;
+	KSI_Integer *statusInt = NULL;
+	KSI_Utf8String *errorMsg = NULL;
+	KSI_AggregationPdu *aggrPdu = NULL;
+	KSI_ExtendPdu *extPdu = NULL;
+
+	res = KSI_ErrorPdu_new(ctx, &error);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Integer_new(ctx, status, &statusInt);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ErrorPdu_setStatus(error, statusInt);
+	if (res != KSI_OK) goto cleanup;
+	statusInt = NULL;
+
+	res = KSI_Utf8String_new(ctx, msg, sizeof(msg), &errorMsg);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ErrorPdu_setErrorMessage(error, errorMsg);
+	if (res != KSI_OK) goto cleanup;
+	errorMsg = NULL;
+
+	if (kind == FAULT_REQ_AGGREGATION) {
+		res = KSI_AggregationPdu_new(ctx, &aggrPdu);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_AggregationPdu_setError(aggrPdu, error);
+		if (res != KSI_OK) goto cleanup;
+		error = NULL;
+
+		res = KSI_AggregationPdu_serialize(aggrPdu, raw, raw_len);
+		if (res != KSI_OK) goto cleanup;
+	} else {
+		res = KSI_ExtendPdu_new(ctx, &extPdu);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_ExtendPdu_setError(extPdu, error);
+		if (res != KSI_OK) goto cleanup;
+		error = NULL;
+
+		res = KSI_ExtendPdu_serialize(extPdu, raw, raw_len);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_ExtendPdu_free(extPdu);
+	KSI_AggregationPdu_free(aggrPdu);
+	KSI_Utf8String_free(errorMsg);
+	KSI_Integer_free(statusInt);
+	KSI_ErrorPdu_free(error);
+
+	return res;
+}
+
+/**
+ * Receives the response from the wrapped client and applies the injected fault. The
+ * transfer of the response at the limited bandwidth delays its delivery further.
+ */
+static int FaultHandleCtx_fetch(FaultHandleCtx *fc, KSI_RequestHandle *handle) {
+	int res;
+	unsigned char *raw = NULL;
+	unsigned raw_len = 0;
+
+	fc->isFetched = 1;
+
+	if (fc->fate == FAULT_TIMEOUT) {
+		KSI_pushError(handle->ctx, res = KSI_NETWORK_RECIEVE_TIMEOUT, "Injected timeout.");
+		goto cleanup;
+	}
+
+	FAULT_CALL_INNER(handle, fc, fc->innerRead(handle));
+	if (res == KSI_ASYNC_NOT_FINISHED) {
+		/* The wrapped client is driven by an event loop, try again once it is done. */
+		fc->isFetched = 0;
+		goto cleanup;
+	}
+	if (res != KSI_OK) {
+		KSI_pushError(handle->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	switch (fc->fate) {
+		case FAULT_TRUNCATE:
+			if (handle->response_length > 1) {
+				handle->response_length = (unsigned)(1 + (handle->response_length - 1) * fc->truncateAt / 1000000);
+			}
+			break;
+		case FAULT_ERROR_PDU:
+			res = createErrorPdu(handle->ctx, fc->kind, fc->errorStatus, &raw, &raw_len);
+			if (res != KSI_OK) {
+				KSI_pushError(handle->ctx, res, NULL);
+				goto cleanup;
+			}
+
+			res = KSI_RequestHandle_adoptResponse(handle, raw, raw_len);
+			if (res != KSI_OK) {
+				KSI_pushError(handle->ctx, res, NULL);
+				goto cleanup;
+			}
+			raw = NULL;
+			break;
+		default:
+			break;
+	}
+
+	fc->readyAt = KSI_NET_getTimeMs() + transferTimeMs(handle->response_length, fc->bytesPerSecond);
+
+	res = KSI_OK;
+
+cleanup:
+
+	fc->status = res;
+	KSI_free(raw);
+
+	return res;
+}
+
+static int faultRead(KSI_RequestHandle *handle) {
+	int res;
+	FaultHandleCtx *fc = NULL;
+	KSI_uint64_t now;
+
+	if (handle == NULL || handle->implCtx == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	fc = handle->implCtx;
+
+	now = KSI_NET_getTimeMs();
+	if (!fc->isFetched && now < fc->readyAt) KSI_NET_sleepMs(fc->readyAt - now);
+
+	if (!fc->isFetched) FaultHandleCtx_fetch(fc, handle);
+
+	now = KSI_NET_getTimeMs();
+	if (now < fc->readyAt) KSI_NET_sleepMs(fc->readyAt - now);
+
+	res = fc->status;
+
+cleanup:
+
+	return res;
+}
+
+static int faultPoll(KSI_RequestHandle *handle, unsigned timeoutMs, int *ready) {
+	int res;
+	FaultHandleCtx *fc = NULL;
+	KSI_uint64_t deadline;
+	KSI_uint64_t now;
+
+	if (handle == NULL || handle->implCtx == NULL || ready == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	fc = handle->implCtx;
+	now = KSI_NET_getTimeMs();
+	deadline = now + timeoutMs;
+	*ready = 0;
+
+	if (!fc->isFetched) {
+		if (now < fc->readyAt) {
+			KSI_NET_sleepMs((fc->readyAt < deadline ? fc->readyAt : deadline) - now);
+			now = KSI_NET_getTimeMs();
+			if (now < fc->readyAt) {
+				res = KSI_OK;
+				goto cleanup;
+			}
+		}
+
+		/* Wait for the wrapped client for the rest of the time. */
+		if (fc->fate != FAULT_TIMEOUT && fc->innerPoll != NULL) {
+			int innerReady = 0;
+
+			FAULT_CALL_INNER(handle, fc, fc->innerPoll(handle, (unsigned)(deadline > now ? deadline - now : 0), &innerReady));
+			if (res != KSI_OK) goto cleanup;
+
+			if (!innerReady) {
+				res = KSI_OK;
+				goto cleanup;
+			}
+		}
+
+		/* The outcome is kept for the reader. */
+		FaultHandleCtx_fetch(fc, handle);
+		now = KSI_NET_getTimeMs();
+	}
+
+	if (now < fc->readyAt && now < deadline) {
+		KSI_NET_sleepMs((fc->readyAt < deadline ? fc->readyAt : deadline) - now);
+		now = KSI_NET_getTimeMs();
+	}
+
+	*ready = now >= fc->readyAt;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Decides the fate of the request just sent by the wrapped client and takes over its handle.
+ * The same number of random values is drawn for every request, so changing the rate of one
+ * fault does not change the latencies and the other faults of the requests.
+ */
+static int wrapHandle(KSI_FaultClient *client, int kind, KSI_RequestHandle *handle) {
+	int res;
+	KSI_FaultClient *cfg = client->root;
+	FaultHandleCtx *fc = NULL;
+	KSI_uint64_t latency;
+	KSI_uint64_t rndFate;
+	KSI_uint64_t rndTruncate;
+
+	fc = KSI_new(FaultHandleCtx);
+	if (fc == NULL) {
+		KSI_pushError(client->parent.ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	fc->client = client;
+	fc->kind = kind;
+	fc->fate = FAULT_NONE;
+	fc->errorStatus = cfg->errorStatus;
+	fc->bytesPerSecond = cfg->bytesPerSecond;
+	fc->isFetched = 0;
+	fc->status = KSI_OK;
+
+	latency = drawLatency(cfg, nextRandom(cfg));
+	rndFate = nextRandom(cfg) % 100;
+	rndTruncate = nextRandom(cfg);
+
+	fc->truncateAt = rndTruncate % 1000000;
+
+	if (rndFate < cfg->timeoutPercent) {
+		fc->fate = FAULT_TIMEOUT;
+		latency = cfg->timeoutMs;
+	} else if (rndFate < cfg->timeoutPercent + cfg->truncatePercent) {
+		fc->fate = FAULT_TRUNCATE;
+	} else if (kind != FAULT_REQ_PUBLICATIONS_FILE && rndFate < cfg->timeoutPercent + cfg->truncatePercent + cfg->errorPercent) {
+		fc->fate = FAULT_ERROR_PDU;
+	}
+
+	fc->readyAt = KSI_NET_getTimeMs() + latency + transferTimeMs(handle->request_length, fc->bytesPerSecond);
+
+	fc->innerCtx = handle->implCtx;
+	fc->innerCtx_free = handle->implCtx_free;
+	fc->innerRead = handle->readResponse;
+	fc->innerPoll = handle->pollResponse;
+
+	handle->implCtx = fc;
+	handle->implCtx_free = (void (*)(void *))FaultHandleCtx_free;
+	handle->readResponse = faultRead;
+	handle->pollResponse = faultPoll;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Are the requests of the given kind faulted by the clients decorating the endpoints of
+ * the wrapped URI client. Without endpoints, the URI client sends them through its
+ * default transport, which is not decorated.
+ */
+static int isFaultedAtEndpoints(KSI_FaultClient *client, int kind) {
+	size_t count = 0;
+
+	if (!client->decoratesEndpoints) return 0;
+
+	if (kind == FAULT_REQ_AGGREGATION) {
+		KSI_UriClient_getAggregatorCount((KSI_UriClient *)client->inner, &count);
+	} else if (kind == FAULT_REQ_EXTEND) {
+		KSI_UriClient_getExtenderCount((KSI_UriClient *)client->inner, &count);
+	}
+
+	return count > 0;
+}
+
+static int sendSignRequest(KSI_NetworkClient *c, KSI_AggregationReq *req, KSI_RequestHandle **handle) {
+	int res;
+	KSI_FaultClient *client = (KSI_FaultClient *)c;
+	KSI_RequestHandle *tmp = NULL;
+
+	res = KSI_NetworkClient_sendSignRequest(client->inner, req, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	if (!isFaultedAtEndpoints(client, FAULT_REQ_AGGREGATION)) {
+		res = wrapHandle(client, FAULT_REQ_AGGREGATION, tmp);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	*handle = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_RequestHandle_free(tmp);
+
+	return res;
+}
+
+static int sendExtendRequest(KSI_NetworkClient *c, KSI_ExtendReq *req, KSI_RequestHandle **handle) {
+	int res;
+	KSI_FaultClient *client = (KSI_FaultClient *)c;
+	KSI_RequestHandle *tmp = NULL;
+
+	res = KSI_NetworkClient_sendExtendRequest(client->inner, req, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	if (!isFaultedAtEndpoints(client, FAULT_REQ_EXTEND)) {
+		res = wrapHandle(client, FAULT_REQ_EXTEND, tmp);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	*handle = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_RequestHandle_free(tmp);
+
+	return res;
+}
+
+static int sendPublicationRequest(KSI_NetworkClient *c, KSI_RequestHandle **handle) {
+	int res;
+	KSI_FaultClient *client = (KSI_FaultClient *)c;
+	KSI_RequestHandle *tmp = NULL;
+
+	res = KSI_NetworkClient_sendPublicationsFileRequest(client->inner, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = wrapHandle(client, FAULT_REQ_PUBLICATIONS_FILE, tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	*handle = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_RequestHandle_free(tmp);
+
+	return res;
+}
+
+static int getStatusCode(KSI_NetworkClient *c) {
+	KSI_FaultClient *client = (KSI_FaultClient *)c;
+	return client->inner->getStausCode != NULL ? client->inner->getStausCode(client->inner) : 0;
+}
+
+static int setEventCallbacks(KSI_NetworkClient *c) {
+	KSI_FaultClient *client = (KSI_FaultClient *)c;
+	return KSI_NetworkClient_setEventCallbacks(client->inner, c->socketCb, c->timerCb, c->doneCb, c->eventCtx);
+}
+
+static int onSocketEvent(KSI_NetworkClient *c, int fd, int events) {
+	KSI_FaultClient *client = (KSI_FaultClient *)c;
+	return client->inner->onSocketEvent(client->inner, fd, events);
+}
+
+static int onTimeout(KSI_NetworkClient *c) {
+	KSI_FaultClient *client = (KSI_FaultClient *)c;
+	return client->inner->onTimeout(client->inner);
+}
+
+static void faultClient_free(KSI_FaultClient *client) {
+	if (client != NULL) {
+		if (client->ownsInner) KSI_NetworkClient_free(client->inner);
+		KSI_free(client);
+	}
+}
+
+void KSI_FaultClient_free(KSI_FaultClient *client) {
+	KSI_NetworkClient_free((KSI_NetworkClient *)client);
+}
+
+/* Creates a fault client, with the configuration of \c root if given. */
+static int faultClient_create(KSI_CTX *ctx, KSI_NetworkClient *inner, KSI_FaultClient *root, int ownsInner, KSI_FaultClient **client) {
+	int res;
+	KSI_FaultClient *tmp = NULL;
+
+	tmp = KSI_new(KSI_FaultClient);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->inner = NULL;
+
+	res = KSI_NetworkClient_init(ctx, &tmp->parent);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	tmp->parent.sendSignRequest = sendSignRequest;
+	tmp->parent.sendExtendRequest = sendExtendRequest;
+	tmp->parent.sendPublicationRequest = sendPublicationRequest;
+	tmp->parent.getStausCode = getStatusCode;
+	tmp->parent.setEventCallbacks = setEventCallbacks;
+	tmp->parent.onSocketEvent = onSocketEvent;
+	tmp->parent.onTimeout = onTimeout;
+	tmp->parent.implFree = (void (*)(void *))faultClient_free;
+
+	tmp->root = root != NULL ? root : tmp;
+	tmp->decoratesEndpoints = 0;
+
+	tmp->seed = 0x9e3779b97f4a7c15ULL;
+	tmp->latencyDistribution = KSI_FAULT_LATENCY_FIXED;
+	tmp->latencyBaseMs = 0;
+	tmp->latencyScaleMs = 0;
+	tmp->timeoutPercent = 0;
+	tmp->timeoutMs = 0;
+	tmp->truncatePercent = 0;
+	tmp->errorPercent = 0;
+	tmp->errorStatus = 0;
+	tmp->bytesPerSecond = 0;
+
+	tmp->inner = inner;
+	tmp->ownsInner = ownsInner;
+
+	*client = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+
+	return res;
+}
+
+int KSI_FaultClient_new(KSI_CTX *ctx, KSI_NetworkClient *inner, KSI_FaultClient **client) {
+	int res;
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (ctx == NULL || inner == NULL || client == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = faultClient_create(ctx, inner, NULL, 1, client);
+
+cleanup:
+
+	return res;
+}
+
+/* Puts a fault client sharing the configuration of the root client in front of an endpoint. */
+static int decorateEndpoint(void *decoratorCtx, KSI_NetworkClient *inner, KSI_NetworkClient **client) {
+	int res;
+	KSI_FaultClient *tmp = NULL;
+
+	res = faultClient_create(inner->ctx, inner, (KSI_FaultClient *)decoratorCtx, 0, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	*client = &tmp->parent;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_FaultClient_newForUriClient(KSI_CTX *ctx, KSI_UriClient *inner, KSI_FaultClient **client) {
+	int res;
+	KSI_FaultClient *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (ctx == NULL || inner == NULL || client == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = faultClient_create(ctx, (KSI_NetworkClient *)inner, NULL, 0, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_UriClient_setEndpointDecorator(inner, decorateEndpoint, tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		/* Do not leave the endpoints decorated by the client being freed. */
+		KSI_UriClient_setEndpointDecorator(inner, NULL, NULL);
+		goto cleanup;
+	}
+
+	/* Owned only now, so a failure leaves the URI client to the caller. */
+	tmp->ownsInner = 1;
+	tmp->decoratesEndpoints = 1;
+
+	*client = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_FaultClient_free(tmp);
+
+	return res;
+}
+
+int KSI_FaultClient_setSeed(KSI_FaultClient *client, KSI_uint64_t seed) {
+	if (client == NULL) return KSI_INVALID_ARGUMENT;
+	/* Zero is a fixed point of the generator. */
+	client->seed = seed != 0 ? seed : 0x9e3779b97f4a7c15ULL;
+	return KSI_OK;
+}
+
+int KSI_FaultClient_setLatency(KSI_FaultClient *client, KSI_FaultLatency distribution, unsigned baseMs, unsigned scaleMs) {
+	int res;
+
+	if (client == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(client->parent.ctx);
+
+	if (distribution < KSI_FAULT_LATENCY_FIXED || distribution > KSI_FAULT_LATENCY_PARETO) {
+		KSI_pushError(client->parent.ctx, res = KSI_INVALID_ARGUMENT, "Unknown latency distribution.");
+		goto cleanup;
+	}
+
+	client->latencyDistribution = distribution;
+	client->latencyBaseMs = baseMs;
+	client->latencyScaleMs = scaleMs;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Checks that the percentages of the mutually exclusive faults add up to at most 100. */
+static int setPercentages(KSI_FaultClient *client, unsigned timeoutPercent, unsigned truncatePercent, unsigned errorPercent) {
+	int res;
+
+	if (timeoutPercent > 100 || truncatePercent > 100 || errorPercent > 100 || timeoutPercent + truncatePercent + errorPercent > 100) {
+		KSI_pushError(client->parent.ctx, res = KSI_INVALID_ARGUMENT, "Fault percentages may not exceed 100 in total.");
+		goto cleanup;
+	}
+
+	client->timeoutPercent = timeoutPercent;
+	client->truncatePercent = truncatePercent;
+	client->errorPercent = errorPercent;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_FaultClient_setTimeouts(KSI_FaultClient *client, unsigned percent, unsigned timeoutMs) {
+	int res;
+
+	if (client == NULL) return KSI_INVALID_ARGUMENT;
+	KSI_ERR_clearErrors(client->parent.ctx);
+
+	res = setPercentages(client, percent, client->truncatePercent, client->errorPercent);
+	if (res == KSI_OK) client->timeoutMs = timeoutMs;
+
+	return res;
+}
+
+int KSI_FaultClient_setTruncation(KSI_FaultClient *client, unsigned percent) {
+	if (client == NULL) return KSI_INVALID_ARGUMENT;
+	KSI_ERR_clearErrors(client->parent.ctx);
+
+	return setPercentages(client, client->timeoutPercent, percent, client->errorPercent);
+}
+
+int KSI_FaultClient_setErrorPdu(KSI_FaultClient *client, unsigned percent, unsigned status) {
+	int res;
+
+	if (client == NULL) return KSI_INVALID_ARGUMENT;
+	KSI_ERR_clearErrors(client->parent.ctx);
+
+	res = setPercentages(client, client->timeoutPercent, client->truncatePercent, percent);
+	if (res == KSI_OK) client->errorStatus = status;
+
+	return res;
+}
+
+int KSI_FaultClient_setBandwidth(KSI_FaultClient *client, unsigned bytesPerSecond) {
+	if (client == NULL) return KSI_INVALID_ARGUMENT;
+	client->bytesPerSecond = bytesPerSecond;
+	return KSI_OK;
+}
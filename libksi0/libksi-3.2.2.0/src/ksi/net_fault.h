@@ -0,0 +1,142 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef KSI_NET_FAULT_H_
+#define KSI_NET_FAULT_H_
+
+#include "net.h"
+#include "net_uri.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * A network client wrapping another network client and injecting delays and faults into
+	 * its requests, for testing the behaviour of the application under poor network conditions.
+	 * The fate of every request is drawn from a seeded pseudo-random generator at the time the
+	 * request is sent, so the same sequence of requests is treated the same on every run.
+	 */
+	typedef struct KSI_FaultClient_st KSI_FaultClient;
+
+	/**
+	 * Distributions of the injected latency, see #KSI_FaultClient_setLatency.
+	 */
+	typedef enum KSI_FaultLatency_en {
+		/** Every request is delayed by the base delay. */
+		KSI_FAULT_LATENCY_FIXED = 0,
+		/** The base delay plus a uniformly distributed delay between 0 and the scale. */
+		KSI_FAULT_LATENCY_UNIFORM,
+		/** The base delay plus an exponentially distributed delay with the mean equal to the scale. */
+		KSI_FAULT_LATENCY_EXPONENTIAL,
+		/** The base delay plus a Pareto (shape 2) distributed delay with a heavy tail: the median is
+		 * about 0.4 and the 99th percentile 9 times the scale. Capped at 100 times the scale. */
+		KSI_FAULT_LATENCY_PARETO
+	} KSI_FaultLatency;
+
+	/**
+	 * Creates a fault injecting client around the given network client.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	inner		The client to forward the requests to, owned by the new client on success.
+	 * \param[out]	client		Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The credentials and the service addresses are those of \c inner.
+	 */
+	int KSI_FaultClient_new(KSI_CTX *ctx, KSI_NetworkClient *inner, KSI_FaultClient **client);
+
+	/**
+	 * Creates a fault injecting client around a URI client with several endpoints. The faults
+	 * are injected in front of every endpoint (see #KSI_UriClient_setEndpointDecorator), so each
+	 * hedged and retried attempt is delayed and faulted on its own, as a real network would, and
+	 * the URI client measures the injected latency. Requests the URI client sends without
+	 * endpoints, like the publications file request, are faulted as by #KSI_FaultClient_new.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	inner		The URI client to forward the requests to, owned by the new client on success.
+	 * \param[out]	client		Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The endpoint decorator of \c inner may not be replaced while it is wrapped.
+	 */
+	int KSI_FaultClient_newForUriClient(KSI_CTX *ctx, KSI_UriClient *inner, KSI_FaultClient **client);
+
+	/**
+	 * Cleanup method for the fault injecting client, frees the wrapped client as well.
+	 * \param[in]	client		Fault injecting client.
+	 */
+	void KSI_FaultClient_free(KSI_FaultClient *client);
+
+	/**
+	 * Sets the seed of the pseudo-random generator deciding the fate of the requests.
+	 * \param[in]	client		Fault injecting client.
+	 * \param[in]	seed		Seed value.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_FaultClient_setSeed(KSI_FaultClient *client, KSI_uint64_t seed);
+
+	/**
+	 * Delays the responses. The delay is counted from sending the request.
+	 * \param[in]	client		Fault injecting client.
+	 * \param[in]	distribution	Distribution of the delay (see #KSI_FaultLatency).
+	 * \param[in]	baseMs		Minimum delay in milliseconds.
+	 * \param[in]	scaleMs		Scale of the random part of the delay in milliseconds.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_FaultClient_setLatency(KSI_FaultClient *client, KSI_FaultLatency distribution, unsigned baseMs, unsigned scaleMs);
+
+	/**
+	 * Makes the given percentage of the requests time out: the response is discarded and
+	 * #KSI_NETWORK_RECIEVE_TIMEOUT is reported \c timeoutMs after sending the request.
+	 * \param[in]	client		Fault injecting client.
+	 * \param[in]	percent		Percentage of the requests to time out.
+	 * \param[in]	timeoutMs	Time to report the timeout after.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_FaultClient_setTimeouts(KSI_FaultClient *client, unsigned percent, unsigned timeoutMs);
+
+	/**
+	 * Cuts the given percentage of the responses short at a random length.
+	 * \param[in]	client		Fault injecting client.
+	 * \param[in]	percent		Percentage of the responses to truncate.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_FaultClient_setTruncation(KSI_FaultClient *client, unsigned percent);
+
+	/**
+	 * Replaces the given percentage of the aggregation and extension responses with an error
+	 * PDU carrying the given status.
+	 * \param[in]	client		Fault injecting client.
+	 * \param[in]	percent		Percentage of the responses to replace.
+	 * \param[in]	status		Service status code of the error PDU, e.g 0x0200 for an internal error.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_FaultClient_setErrorPdu(KSI_FaultClient *client, unsigned percent, unsigned status);
+
+	/**
+	 * Limits the bandwidth of every request: the request and the response are delayed by the
+	 * time their transfer takes at the given rate.
+	 * \param[in]	client		Fault injecting client.
+	 * \param[in]	bytesPerSecond	Transfer rate, 0 for no limit.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_FaultClient_setBandwidth(KSI_FaultClient *client, unsigned bytesPerSecond);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KSI_NET_FAULT_H_ */
@@ -55,31 +55,23 @@ static int setIntParam(int *param, int val) {
 	return KSI_OK;
 }
 
-static int prepareRequest(
+static int sendRawRequest(
 		KSI_NetworkClient *client,
-		void *pdu,
-		int (*serialize)(void *, unsigned char **, unsigned *),
+		const unsigned char *raw,
+		unsigned raw_len,
 		KSI_RequestHandle **handle,
 		char *url,
 		const char *desc) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_HttpClient *http = (KSI_HttpClient *)client;
 	KSI_RequestHandle *tmp = NULL;
-	unsigned char *raw = NULL;
-	unsigned raw_len = 0;
 
-	if (client == NULL || pdu == NULL || handle == NULL) {
+	if (client == NULL || raw == NULL || handle == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 	KSI_ERR_clearErrors(client->ctx);
 
-	res = serialize(pdu, &raw, &raw_len);
-	if (res != KSI_OK) {
-		KSI_pushError(client->ctx, res, NULL);
-		goto cleanup;
-	}
-
 	KSI_LOG_logBlob(client->ctx, KSI_LOG_DEBUG, desc, raw, raw_len);
 
 	/* Create a new request handle */
@@ -108,6 +100,43 @@ static int prepareRequest(
 cleanup:
 
 	KSI_RequestHandle_free(tmp);
+
+	return res;
+}
+
+static int prepareRequest(
+		KSI_NetworkClient *client,
+		void *pdu,
+		int (*serialize)(void *, unsigned char **, unsigned *),
+		KSI_RequestHandle **handle,
+		char *url,
+		const char *desc) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *raw = NULL;
+	unsigned raw_len = 0;
+
+	if (client == NULL || pdu == NULL || handle == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(client->ctx);
+
+	res = serialize(pdu, &raw, &raw_len);
+	if (res != KSI_OK) {
+		KSI_pushError(client->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = sendRawRequest(client, raw, raw_len, handle, url, desc);
+	if (res != KSI_OK) {
+		KSI_pushError(client->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
 	KSI_free(raw);
 
 	return res;
@@ -143,6 +172,23 @@ cleanup:
 static int prepareAggregationRequest(KSI_NetworkClient *client, KSI_AggregationReq *req, KSI_RequestHandle **handle) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_AggregationPdu *pdu = NULL;
+	const unsigned char *raw = NULL;
+	unsigned raw_len = 0;
+
+	/* Plain requests are written by the prepared request without building the PDU. */
+	res = KSI_NetworkClient_serializeSignRequest(client, req, &raw, &raw_len);
+	if (res != KSI_OK) goto cleanup;
+
+	if (raw != NULL) {
+		res = sendRawRequest(
+				client,
+				raw,
+				raw_len,
+				handle,
+				((KSI_HttpClient*)client)->urlAggregator,
+				"Aggregation request");
+		goto cleanup;
+	}
 
 	res = KSI_AggregationReq_enclose(req, client->aggrUser, client->aggrPass, &pdu);
 	if (res != KSI_OK) goto cleanup;
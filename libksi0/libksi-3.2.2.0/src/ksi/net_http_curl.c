@@ -24,18 +24,74 @@
 #include <curl/curl.h>
 #include <string.h>
 
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
 #include "net_http_impl.h"
 #include "net_impl.h"
 
 static size_t curlGlobal_initCount = 0;
 
-typedef struct CurlNetHandleCtx_st {
+/* Upper limit for allocating the response buffer by the announced Content-Length. */
+#define CURL_MAX_PREALLOC (16 * 1024 * 1024)
+
+typedef struct CurlNetHandleCtx_st CurlNetHandleCtx;
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION CurlMutex;
+#else
+typedef pthread_mutex_t CurlMutex;
+#endif
+
+/**
+ * Transport context of the HTTP client. Every request gets its own easy handle, which is
+ * driven by the shared multi handle, so concurrent requests overlap and reuse the
+ * connections, DNS and TLS session caches of the client.
+ */
+typedef struct CurlClientCtx_st {
+	/* The owning client, for reporting to the host event loop. */
+	KSI_HttpClient *http;
+	CURLM *multi;
+	CURLSH *share;
+
+	/* Locks of the DNS, TLS session and connection caches in #share, which libcurl takes
+	 * whenever an easy handle uses them. Only the caches are protected: the multi handle and
+	 * the list of the request contexts are not locked, so a client and its requests must be
+	 * used by one thread at a time. */
+	CurlMutex locks[CURL_LOCK_DATA_LAST];
+	int locks_initialized;
+
+	/* All the request contexts using the easy handles of this client. */
+	CurlNetHandleCtx *first;
+} CurlClientCtx;
+
+struct CurlNetHandleCtx_st {
 	KSI_CTX *ctx;
 	CURL *curl;
+	/* The request handle, for reporting the completion to the host event loop. */
+	KSI_RequestHandle *handle;
+	/* The owning client, NULL if the client has been freed. */
+	CurlClientCtx *client;
+	/* Is the easy handle added to the multi handle. */
+	int isActive;
+	/* Has the transfer finished. */
+	int isDone;
+	CURLcode result;
+	char curlErr[CURL_ERROR_SIZE];
 	unsigned char *raw;
-    unsigned len;
-    char *url;
-} CurlNetHandleCtx;
+	unsigned len;
+	/* Allocated size of the response buffer. */
+	unsigned cap;
+	char *url;
+	/* Time the transfer was started (see #KSI_NET_getTimeUs). */
+	KSI_uint64_t startedAt;
+
+	CurlNetHandleCtx *prev;
+	CurlNetHandleCtx *next;
+};
 
 static int curlGlobal_init(void) {
 	int res = KSI_UNKNOWN_ERROR;
@@ -62,16 +118,154 @@ static void curlGlobal_cleanup(void) {
 	curl_global_cleanup();
 }
 
+static void mutexInit(CurlMutex *mutex) {
+#ifdef _WIN32
+	InitializeCriticalSection(mutex);
+#else
+	pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+static void mutexDestroy(CurlMutex *mutex) {
+#ifdef _WIN32
+	DeleteCriticalSection(mutex);
+#else
+	pthread_mutex_destroy(mutex);
+#endif
+}
+
+static void mutexLock(CurlMutex *mutex) {
+#ifdef _WIN32
+	EnterCriticalSection(mutex);
+#else
+	pthread_mutex_lock(mutex);
+#endif
+}
+
+static void mutexUnlock(CurlMutex *mutex) {
+#ifdef _WIN32
+	LeaveCriticalSection(mutex);
+#else
+	pthread_mutex_unlock(mutex);
+#endif
+}
+
+static void curlShareLock(CURL *curl, curl_lock_data data, curl_lock_access access, void *userptr) {
+	CurlClientCtx *client = userptr;
+	if (data >= 0 && data < CURL_LOCK_DATA_LAST) mutexLock(&client->locks[data]);
+}
+
+static void curlShareUnlock(CURL *curl, curl_lock_data data, void *userptr) {
+	CurlClientCtx *client = userptr;
+	if (data >= 0 && data < CURL_LOCK_DATA_LAST) mutexUnlock(&client->locks[data]);
+}
+
+/* Detaches the request context from the client, leaving the easy handle intact. */
+static void CurlNetHandleCtx_detach(CurlNetHandleCtx *handleCtx) {
+	CurlClientCtx *client = handleCtx->client;
+
+	if (client == NULL) return;
+
+	if (handleCtx->isActive) {
+		curl_multi_remove_handle(client->multi, handleCtx->curl);
+		handleCtx->isActive = 0;
+	}
+
+	/* The share may not be cleaned up while an easy handle is still using it. */
+	if (handleCtx->curl != NULL) {
+		curl_easy_setopt(handleCtx->curl, CURLOPT_SHARE, NULL);
+	}
+
+	if (handleCtx->prev != NULL) {
+		handleCtx->prev->next = handleCtx->next;
+	} else {
+		client->first = handleCtx->next;
+	}
+	if (handleCtx->next != NULL) {
+		handleCtx->next->prev = handleCtx->prev;
+	}
+
+	handleCtx->prev = NULL;
+	handleCtx->next = NULL;
+	handleCtx->client = NULL;
+}
+
 static void CurlNetHandleCtx_free(CurlNetHandleCtx *handleCtx) {
 	if (handleCtx != NULL) {
+		CurlNetHandleCtx_detach(handleCtx);
+		if (handleCtx->curl != NULL) curl_easy_cleanup(handleCtx->curl);
 		KSI_free(handleCtx->url);
 		KSI_free(handleCtx->raw);
 		KSI_free(handleCtx);
 	}
 }
 
+static void CurlClientCtx_free(CurlClientCtx *client) {
+	if (client != NULL) {
+		/* The handles may outlive the client, but can not be used for receiving any more. */
+		while (client->first != NULL) {
+			CurlNetHandleCtx_detach(client->first);
+		}
+		if (client->multi != NULL) curl_multi_cleanup(client->multi);
+		if (client->share != NULL) curl_share_cleanup(client->share);
+		if (client->locks_initialized) {
+			int i;
+			for (i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+				mutexDestroy(&client->locks[i]);
+			}
+		}
+		KSI_free(client);
+	}
+}
+
+/* Returns the announced length of the response body, or 0 if not known. */
+static size_t getContentLength(CURL *curl) {
+#if LIBCURL_VERSION_NUM >= 0x073700
+	curl_off_t len = -1;
+	if (curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &len) != CURLE_OK || len < 0 || (unsigned long long)len > UINT_MAX) return 0;
+#else
+	double len = -1;
+	if (curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &len) != CURLE_OK || len < 0 || len > UINT_MAX) return 0;
+#endif
+	return (size_t)len;
+}
+
+/* Records the completion of a phase from the timer of the transfer, if the phase was carried out. */
+static void setPhaseTime(KSI_RequestHandle *handle, CurlNetHandleCtx *nc, int phase, CURLINFO info) {
+#if LIBCURL_VERSION_NUM >= 0x073d00
+	curl_off_t us = 0;
+	if (curl_easy_getinfo(nc->curl, info, &us) != CURLE_OK || us <= 0) return;
+#else
+	double sec = 0;
+	curl_off_t us;
+	if (curl_easy_getinfo(nc->curl, info, &sec) != CURLE_OK || sec <= 0) return;
+	us = (curl_off_t)(sec * 1000000);
+#endif
+	KSI_RequestHandle_setPhaseTime(handle, phase, nc->startedAt + (KSI_uint64_t)us);
+}
+
+/* Fills the request phases from the timers of the finished transfer. */
+static void setPhaseTimes(KSI_RequestHandle *handle, CurlNetHandleCtx *nc) {
+#if LIBCURL_VERSION_NUM >= 0x073d00
+	setPhaseTime(handle, nc, KSI_NET_PHASE_RESOLVED, CURLINFO_NAMELOOKUP_TIME_T);
+	setPhaseTime(handle, nc, KSI_NET_PHASE_CONNECTED, CURLINFO_CONNECT_TIME_T);
+	setPhaseTime(handle, nc, KSI_NET_PHASE_TLS_DONE, CURLINFO_APPCONNECT_TIME_T);
+	setPhaseTime(handle, nc, KSI_NET_PHASE_REQUEST_SENT, CURLINFO_PRETRANSFER_TIME_T);
+	setPhaseTime(handle, nc, KSI_NET_PHASE_FIRST_BYTE, CURLINFO_STARTTRANSFER_TIME_T);
+	setPhaseTime(handle, nc, KSI_NET_PHASE_RESPONSE_DONE, CURLINFO_TOTAL_TIME_T);
+#else
+	setPhaseTime(handle, nc, KSI_NET_PHASE_RESOLVED, CURLINFO_NAMELOOKUP_TIME);
+	setPhaseTime(handle, nc, KSI_NET_PHASE_CONNECTED, CURLINFO_CONNECT_TIME);
+	setPhaseTime(handle, nc, KSI_NET_PHASE_TLS_DONE, CURLINFO_APPCONNECT_TIME);
+	setPhaseTime(handle, nc, KSI_NET_PHASE_REQUEST_SENT, CURLINFO_PRETRANSFER_TIME);
+	setPhaseTime(handle, nc, KSI_NET_PHASE_FIRST_BYTE, CURLINFO_STARTTRANSFER_TIME);
+	setPhaseTime(handle, nc, KSI_NET_PHASE_RESPONSE_DONE, CURLINFO_TOTAL_TIME);
+#endif
+}
+
 static size_t receiveDataFromLibCurl(void *ptr, size_t size, size_t nmemb, void *stream) {
 	size_t bytesCount = 0;
+	size_t capacity;
 	unsigned char *tmp_buffer = NULL;
 	CurlNetHandleCtx *nc = (CurlNetHandleCtx *) stream;
 
@@ -81,16 +275,27 @@ static size_t receiveDataFromLibCurl(void *ptr, size_t size, size_t nmemb, void
 	if (bytesCount > UINT_MAX) {
 		goto cleanup;
 	}
-	tmp_buffer = KSI_calloc(bytesCount, 1);
-	if (tmp_buffer == NULL) goto cleanup;
 
-	memcpy(tmp_buffer, nc->raw, nc->len);
-	memcpy(tmp_buffer + nc->len, ptr, size * nmemb);
+	if (bytesCount > nc->cap) {
+		/* Size the buffer by the Content-Length on the first chunk, grow geometrically otherwise. */
+		capacity = nc->raw == NULL ? getContentLength(nc->curl) : 2 * (size_t)nc->cap;
+		if (capacity > CURL_MAX_PREALLOC && capacity > bytesCount) capacity = CURL_MAX_PREALLOC;
+		if (capacity < bytesCount) capacity = bytesCount;
+		if (capacity > UINT_MAX) capacity = UINT_MAX;
 
-	KSI_free(nc->raw);
-	nc->raw = tmp_buffer;
+		tmp_buffer = KSI_malloc(capacity);
+		if (tmp_buffer == NULL) goto cleanup;
+
+		if (nc->raw != NULL) memcpy(tmp_buffer, nc->raw, nc->len);
+
+		KSI_free(nc->raw);
+		nc->raw = tmp_buffer;
+		nc->cap = (unsigned)capacity;
+		tmp_buffer = NULL;
+	}
+
+	memcpy(nc->raw + nc->len, ptr, size * nmemb);
 	nc->len = (unsigned)bytesCount;
-	tmp_buffer = NULL;
 
 	bytesCount = size * nmemb;
 
@@ -100,9 +305,108 @@ cleanup:
 	return bytesCount;
 }
 
+/* Collects the finished transfers of the client. */
+static void collectFinished(CurlClientCtx *client) {
+	CURLMsg *msg = NULL;
+	int left;
+
+	while ((msg = curl_multi_info_read(client->multi, &left)) != NULL) {
+		char *priv = NULL;
+		CurlNetHandleCtx *nc = NULL;
+
+		if (msg->msg != CURLMSG_DONE) continue;
+
+		if (curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &priv) != CURLE_OK || priv == NULL) continue;
+		nc = (CurlNetHandleCtx *)priv;
+
+		nc->isDone = 1;
+		nc->result = msg->data.result;
+
+		curl_multi_remove_handle(client->multi, nc->curl);
+		nc->isActive = 0;
+
+		KSI_NetworkClient_requestDone(&client->http->parent, nc->handle);
+	}
+}
+
+/* Lets the multi handle act on the socket (or the timeout) reported by the host event loop. */
+static int curlSocketAction(KSI_HttpClient *http, curl_socket_t fd, int flags) {
+	int res = KSI_UNKNOWN_ERROR;
+	CurlClientCtx *client = http->implCtx;
+	CURLMcode mres;
+	int running = 0;
+
+	mres = curl_multi_socket_action(client->multi, fd, flags, &running);
+	if (mres != CURLM_OK) {
+		KSI_pushError(http->parent.ctx, res = KSI_NETWORK_ERROR, curl_multi_strerror(mres));
+		goto cleanup;
+	}
+
+	collectFinished(client);
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int curlSocketCallback(CURL *easy, curl_socket_t fd, int what, void *userp, void *socketp) {
+	KSI_HttpClient *http = userp;
+	int events = KSI_NET_EVENT_REMOVE;
+
+	if (what != CURL_POLL_REMOVE) {
+		if (what & CURL_POLL_IN) events |= KSI_NET_EVENT_READ;
+		if (what & CURL_POLL_OUT) events |= KSI_NET_EVENT_WRITE;
+	}
+
+	return KSI_NetworkClient_watchSocket(&http->parent, (int)fd, events) == KSI_OK ? 0 : -1;
+}
+
+static int curlTimerCallback(CURLM *multi, long timeoutMs, void *userp) {
+	KSI_HttpClient *http = userp;
+
+	return KSI_NetworkClient_setTimer(&http->parent, timeoutMs) == KSI_OK ? 0 : -1;
+}
+
+static int curlSetEventCallbacks(KSI_NetworkClient *c) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_HttpClient *http = (KSI_HttpClient *)c;
+	CurlClientCtx *client = http->implCtx;
+
+	/* Mixing the socket interface with curl_multi_perform is not supported by libcurl. */
+	if (client->first != NULL) {
+		KSI_pushError(c->ctx, res = KSI_INVALID_ARGUMENT, "Event callbacks must be set before sending any requests.");
+		goto cleanup;
+	}
+
+	curl_multi_setopt(client->multi, CURLMOPT_SOCKETFUNCTION, curlSocketCallback);
+	curl_multi_setopt(client->multi, CURLMOPT_SOCKETDATA, http);
+	curl_multi_setopt(client->multi, CURLMOPT_TIMERFUNCTION, curlTimerCallback);
+	curl_multi_setopt(client->multi, CURLMOPT_TIMERDATA, http);
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int curlOnSocketEvent(KSI_NetworkClient *c, int fd, int events) {
+	int flags = 0;
+
+	if (events & KSI_NET_EVENT_READ) flags |= CURL_CSELECT_IN;
+	if (events & KSI_NET_EVENT_WRITE) flags |= CURL_CSELECT_OUT;
+
+	return curlSocketAction((KSI_HttpClient *)c, (curl_socket_t)fd, flags);
+}
+
+static int curlOnTimeout(KSI_NetworkClient *c) {
+	return curlSocketAction((KSI_HttpClient *)c, CURL_SOCKET_TIMEOUT, 0);
+}
+
 static int curlReceive(KSI_RequestHandle *handle) {
 	int res = KSI_UNKNOWN_ERROR;
-	char curlErr[CURL_ERROR_SIZE];
 	CurlNetHandleCtx *implCtx = NULL;
 	KSI_HttpClient *http = NULL;
 
@@ -116,50 +420,110 @@ static int curlReceive(KSI_RequestHandle *handle) {
 
 	implCtx = handle->implCtx;
 
-    curl_easy_setopt(implCtx->curl, CURLOPT_ERRORBUFFER, curlErr);
-    if (http->agentName != NULL) {
-    	curl_easy_setopt(implCtx->curl, CURLOPT_USERAGENT, http->agentName);
-    }
-
-	if (handle->request != NULL) {
-		curl_easy_setopt(implCtx->curl, CURLOPT_POST, 1);
-		curl_easy_setopt(implCtx->curl, CURLOPT_POSTFIELDS, (char *)handle->request);
-		curl_easy_setopt(implCtx->curl, CURLOPT_POSTFIELDSIZE, (long)handle->request_length);
-	} else {
-		curl_easy_setopt(implCtx->curl, CURLOPT_POST, 0);
+	/* The host event loop drives the transfers. */
+	if (!implCtx->isDone && implCtx->client != NULL && KSI_NetworkClient_isEventDriven(&http->parent)) {
+		res = KSI_ASYNC_NOT_FINISHED;
+		goto cleanup;
 	}
 
-    curl_easy_setopt(implCtx->curl, CURLOPT_WRITEDATA, implCtx);
+	/* Drive all the transfers of the client until this one has finished. */
+	while (!implCtx->isDone) {
+		CURLMcode mres;
+		int running = 0;
 
-    curl_easy_setopt(implCtx->curl, CURLOPT_CONNECTTIMEOUT, http->connectionTimeoutSeconds);
-    curl_easy_setopt(implCtx->curl, CURLOPT_TIMEOUT, http->readTimeoutSeconds);
+		if (implCtx->client == NULL) {
+			KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, "HTTP client closed before the response was received.");
+			goto cleanup;
+		}
 
-	curl_easy_setopt(implCtx->curl, CURLOPT_URL, implCtx->url);
+		mres = curl_multi_perform(implCtx->client->multi, &running);
+		if (mres != CURLM_OK) {
+			KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, curl_multi_strerror(mres));
+			goto cleanup;
+		}
+
+		collectFinished(implCtx->client);
+		if (implCtx->isDone) break;
+
+		mres = curl_multi_wait(implCtx->client->multi, NULL, 0, 1000, NULL);
+		if (mres != CURLM_OK) {
+			KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, curl_multi_strerror(mres));
+			goto cleanup;
+		}
+	}
 
-    res = curl_easy_perform(implCtx->curl);
-    if (res != CURLE_OK) {
-    	long httpCode;
-    	if (res == CURLE_HTTP_RETURNED_ERROR && curl_easy_getinfo(implCtx->curl, CURLINFO_HTTP_CODE, &httpCode) == CURLE_OK) {
-    		KSI_LOG_debug(handle->ctx, "Received HTTP error code %d. Curl error '%s'.", httpCode, curlErr);
+	setPhaseTimes(handle, implCtx);
+
+	if (implCtx->result != CURLE_OK) {
+		long httpCode;
+		if (implCtx->result == CURLE_HTTP_RETURNED_ERROR && curl_easy_getinfo(implCtx->curl, CURLINFO_HTTP_CODE, &httpCode) == CURLE_OK) {
+			KSI_LOG_debug(handle->ctx, "Received HTTP error code %d. Curl error '%s'.", httpCode, implCtx->curlErr);
 			http->httpStatus = httpCode;
 		} else {
-    		KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, curlErr);
+			KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, implCtx->curlErr[0] != '\0' ? implCtx->curlErr : curl_easy_strerror(implCtx->result));
 			goto cleanup;
-    	}
+		}
+	}
+
+	/* Hand the response buffer over to the handle. */
+	res = KSI_RequestHandle_adoptResponse(handle, implCtx->raw, implCtx->len);
+	if (res != KSI_OK) {
+		KSI_pushError(handle->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	implCtx->raw = NULL;
+	implCtx->len = 0;
+	implCtx->cap = 0;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+
+/* Drives the transfers of the client until the given one has finished or the timeout expires. */
+static int curlPoll(KSI_RequestHandle *handle, unsigned timeoutMs, int *ready) {
+	int res = KSI_UNKNOWN_ERROR;
+	CurlNetHandleCtx *implCtx = NULL;
+	KSI_uint64_t deadline;
+
+	if (handle == NULL || handle->implCtx == NULL || ready == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
 	}
 
-    res = KSI_RequestHandle_setResponse(handle, implCtx->raw, implCtx->len);
-    if (res != KSI_OK) {
-    	KSI_pushError(handle->ctx, res, NULL);
-    	goto cleanup;
-    }
+	implCtx = handle->implCtx;
+	deadline = KSI_NET_getTimeMs() + timeoutMs;
+
+	while (!implCtx->isDone && implCtx->client != NULL && !KSI_NetworkClient_isEventDriven(handle->client)) {
+		CURLMcode mres;
+		KSI_uint64_t now;
+		int running = 0;
+
+		mres = curl_multi_perform(implCtx->client->multi, &running);
+		if (mres != CURLM_OK) {
+			KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, curl_multi_strerror(mres));
+			goto cleanup;
+		}
+
+		collectFinished(implCtx->client);
 
-    /* Cleanup on success.*/
-    KSI_free(implCtx->raw);
-    implCtx->raw = NULL;
-    implCtx->len = 0;
+		now = KSI_NET_getTimeMs();
+		if (implCtx->isDone || now >= deadline) break;
+
+		mres = curl_multi_wait(implCtx->client->multi, NULL, 0, (int)(deadline - now), NULL);
+		if (mres != CURLM_OK) {
+			KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, curl_multi_strerror(mres));
+			goto cleanup;
+		}
+	}
 
-    res = KSI_OK;
+	*ready = implCtx->isDone || implCtx->client == NULL;
+
+	res = KSI_OK;
 
 cleanup:
 
@@ -171,6 +535,9 @@ static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, cha
 	int res = KSI_UNKNOWN_ERROR;
 	CurlNetHandleCtx *implCtx = NULL;
 	KSI_HttpClient *http = (KSI_HttpClient *)client;
+	CurlClientCtx *clientCtx = NULL;
+	CURLMcode mres;
+	int running = 0;
 	size_t len;
 
 	if (client == NULL || handle == NULL || url == NULL) {
@@ -179,6 +546,8 @@ static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, cha
 	}
 	KSI_ERR_clearErrors(client->ctx);
 
+	clientCtx = http->implCtx;
+
 	implCtx = KSI_new(CurlNetHandleCtx);
 	if (implCtx == NULL) {
 		KSI_pushError(client->ctx, res = KSI_OUT_OF_MEMORY, NULL);
@@ -186,15 +555,23 @@ static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, cha
 	}
 
 	implCtx->ctx = handle->ctx;
-	implCtx->curl = http->implCtx;
+	implCtx->curl = NULL;
+	implCtx->handle = handle;
+	implCtx->client = NULL;
+	implCtx->isActive = 0;
+	implCtx->isDone = 0;
+	implCtx->result = CURLE_OK;
+	implCtx->curlErr[0] = '\0';
 	implCtx->len = 0;
+	implCtx->cap = 0;
 	implCtx->raw = NULL;
+	implCtx->url = NULL;
+	implCtx->startedAt = 0;
+	implCtx->prev = NULL;
+	implCtx->next = NULL;
 
 	KSI_LOG_debug(handle->ctx, "Curl: Sending request to: %s", url);
 
-	handle->readResponse = curlReceive;
-	handle->client = client;
-
 	len = strlen(url) + 1;
 	implCtx->url = KSI_calloc(len, 1);
 	if (implCtx->url == NULL) {
@@ -203,15 +580,73 @@ static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, cha
 	}
 	strncpy(implCtx->url, url, len);
 
-    res = KSI_RequestHandle_setImplContext(handle, implCtx, (void (*)(void *))CurlNetHandleCtx_free);
-    if (res != KSI_OK) {
-    	KSI_pushError(handle->ctx, res, NULL);
-    	goto cleanup;
-    }
+	implCtx->curl = curl_easy_init();
+	if (implCtx->curl == NULL) {
+		KSI_pushError(client->ctx, res = KSI_OUT_OF_MEMORY, "Unable to init CURL");
+		goto cleanup;
+	}
+
+	curl_easy_setopt(implCtx->curl, CURLOPT_VERBOSE, 0);
+	curl_easy_setopt(implCtx->curl, CURLOPT_NOPROGRESS, 1);
+	curl_easy_setopt(implCtx->curl, CURLOPT_NOSIGNAL, 1);
+	curl_easy_setopt(implCtx->curl, CURLOPT_WRITEFUNCTION, receiveDataFromLibCurl);
+	curl_easy_setopt(implCtx->curl, CURLOPT_WRITEDATA, implCtx);
+	curl_easy_setopt(implCtx->curl, CURLOPT_PRIVATE, (char *)implCtx);
+	curl_easy_setopt(implCtx->curl, CURLOPT_ERRORBUFFER, implCtx->curlErr);
+	curl_easy_setopt(implCtx->curl, CURLOPT_SHARE, clientCtx->share);
+
+	if (http->agentName != NULL) {
+		curl_easy_setopt(implCtx->curl, CURLOPT_USERAGENT, http->agentName);
+	}
+
+	/* The request buffer belongs to the handle and lives as long as the transfer. */
+	if (handle->request != NULL) {
+		curl_easy_setopt(implCtx->curl, CURLOPT_POST, 1);
+		curl_easy_setopt(implCtx->curl, CURLOPT_POSTFIELDS, (char *)handle->request);
+		curl_easy_setopt(implCtx->curl, CURLOPT_POSTFIELDSIZE, (long)handle->request_length);
+	} else {
+		curl_easy_setopt(implCtx->curl, CURLOPT_POST, 0);
+	}
+
+	curl_easy_setopt(implCtx->curl, CURLOPT_CONNECTTIMEOUT, http->connectionTimeoutSeconds);
+	curl_easy_setopt(implCtx->curl, CURLOPT_TIMEOUT, http->readTimeoutSeconds);
 
-    implCtx = NULL;
+	curl_easy_setopt(implCtx->curl, CURLOPT_URL, implCtx->url);
+
+	implCtx->startedAt = KSI_NET_getTimeUs();
+	mres = curl_multi_add_handle(clientCtx->multi, implCtx->curl);
+	if (mres != CURLM_OK) {
+		KSI_pushError(client->ctx, res = KSI_NETWORK_ERROR, curl_multi_strerror(mres));
+		goto cleanup;
+	}
 
-    res = KSI_OK;
+	implCtx->client = clientCtx;
+	implCtx->isActive = 1;
+	implCtx->next = clientCtx->first;
+	if (clientCtx->first != NULL) clientCtx->first->prev = implCtx;
+	clientCtx->first = implCtx;
+
+	handle->readResponse = curlReceive;
+	handle->pollResponse = curlPoll;
+	handle->client = client;
+
+	res = KSI_RequestHandle_setImplContext(handle, implCtx, (void (*)(void *))CurlNetHandleCtx_free);
+	if (res != KSI_OK) {
+		KSI_pushError(handle->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	implCtx = NULL;
+
+	/* Start the transfer without waiting for it, an event driven client is started by its timer. */
+	if (!KSI_NetworkClient_isEventDriven(client)) {
+		mres = curl_multi_perform(clientCtx->multi, &running);
+		if (mres != CURLM_OK) {
+			KSI_LOG_debug(client->ctx, "Curl: Unable to start the transfer: %s", curl_multi_strerror(mres));
+		}
+	}
+
+	res = KSI_OK;
 
 cleanup:
 
@@ -222,45 +657,78 @@ cleanup:
 
 int KSI_HttpClientImpl_init(KSI_HttpClient *http) {
 	int res = KSI_UNKNOWN_ERROR;
-	CURL *curl = NULL;
+	CurlClientCtx *clientCtx = NULL;
+	int i;
 
 	if (http == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
-	if (http == NULL) {
-		KSI_pushError(http->parent.ctx, res = KSI_INVALID_ARGUMENT, "HttpClient network client context not initialized.");
+	/* Register global init and cleanup methods before creating any handles. */
+	res = KSI_CTX_registerGlobals(http->parent.ctx, curlGlobal_init, curlGlobal_cleanup);
+	if (res != KSI_OK) {
+		KSI_pushError(http->parent.ctx, res, NULL);
 		goto cleanup;
 	}
 
-	curl = curl_easy_init();
-	if (curl == NULL) {
-		KSI_pushError(http->parent.ctx, res = KSI_OUT_OF_MEMORY, "Unable to init CURL");
+	clientCtx = KSI_new(CurlClientCtx);
+	if (clientCtx == NULL) {
+		KSI_pushError(http->parent.ctx, res = KSI_OUT_OF_MEMORY, NULL);
 		goto cleanup;
 	}
 
-    curl_easy_setopt(curl, CURLOPT_VERBOSE, 0);
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, receiveDataFromLibCurl);
-	curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1);
-	http->implCtx = curl;
-	http->implCtx_free = curl_easy_cleanup;
-	curl = NULL;
+	clientCtx->http = http;
+	clientCtx->multi = NULL;
+	clientCtx->share = NULL;
+	clientCtx->locks_initialized = 0;
+	clientCtx->first = NULL;
 
-	http->sendRequest = sendRequest;
+	clientCtx->multi = curl_multi_init();
+	if (clientCtx->multi == NULL) {
+		KSI_pushError(http->parent.ctx, res = KSI_OUT_OF_MEMORY, "Unable to init CURL");
+		goto cleanup;
+	}
 
-	/* Register global init and cleanup methods. */
-	res = KSI_CTX_registerGlobals(http->parent.ctx, curlGlobal_init, curlGlobal_cleanup);
-	if (res != KSI_OK) {
-		KSI_pushError(http->parent.ctx, res, NULL);
+#ifdef CURLPIPE_MULTIPLEX
+	curl_multi_setopt(clientCtx->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+
+	clientCtx->share = curl_share_init();
+	if (clientCtx->share == NULL) {
+		KSI_pushError(http->parent.ctx, res = KSI_OUT_OF_MEMORY, "Unable to init CURL");
 		goto cleanup;
 	}
 
+	for (i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+		mutexInit(&clientCtx->locks[i]);
+	}
+	clientCtx->locks_initialized = 1;
+
+	curl_share_setopt(clientCtx->share, CURLSHOPT_LOCKFUNC, curlShareLock);
+	curl_share_setopt(clientCtx->share, CURLSHOPT_UNLOCKFUNC, curlShareUnlock);
+	curl_share_setopt(clientCtx->share, CURLSHOPT_USERDATA, clientCtx);
+	curl_share_setopt(clientCtx->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(clientCtx->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+	curl_share_setopt(clientCtx->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+
+	http->implCtx = clientCtx;
+	http->implCtx_free = (void (*)(void *))CurlClientCtx_free;
+	clientCtx = NULL;
+
+	http->sendRequest = sendRequest;
+
+	http->parent.setEventCallbacks = curlSetEventCallbacks;
+	http->parent.onSocketEvent = curlOnSocketEvent;
+	http->parent.onTimeout = curlOnTimeout;
+
 	res = KSI_OK;
 
 cleanup:
 
-	if (curl != NULL) curl_easy_cleanup(curl);
+	CurlClientCtx_free(clientCtx);
 
 	return res;
 
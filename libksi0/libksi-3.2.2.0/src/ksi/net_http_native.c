@@ -0,0 +1,1113 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include "internal.h"
+
+#if KSI_NET_HTTP_IMPL==KSI_IMPL_NATIVE
+
+#include <string.h>
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+
+#include "net_http_impl.h"
+#include "net_impl.h"
+#include "net_socket.h"
+#include "http_parser.h"
+
+#ifndef _WIN32
+#  include <errno.h>
+#  define socket_error errno
+#  define socketTimedOut(err) ((err) == EAGAIN || (err) == EWOULDBLOCK)
+#else
+#  define socket_error WSAGetLastError()
+#  define socketTimedOut(err) ((err) == WSAETIMEDOUT)
+#endif
+
+/* Maximum number of times a request is resent after a reused connection was found closed by the peer. */
+#define NATIVE_MAX_ATTEMPTS 2
+
+/* Size of the chunks the responses are received in. */
+#define NATIVE_RECV_SIZE 0x4000
+
+/* Upper limit for allocating the response buffer by the announced Content-Length. */
+#define NATIVE_MAX_PREALLOC (16 * 1024 * 1024)
+
+/* Time to keep the resolved addresses of a host. */
+#define NATIVE_DNS_CACHE_TTL_SECONDS 60
+
+static size_t nativeGlobal_initCount = 0;
+
+static const char *defaultCaFile =
+#ifdef OPENSSL_CA_FILE
+	OPENSSL_CA_FILE;
+#else
+	NULL;
+#endif
+
+static const char *defaultCaDir =
+#ifdef OPENSSL_CA_DIR
+	OPENSSL_CA_DIR;
+#else
+	NULL;
+#endif
+
+typedef struct NativeRequestCtx_st NativeRequestCtx;
+typedef struct NativeClientCtx_st NativeClientCtx;
+
+/**
+ * A persistent HTTP/1.1 connection to a single origin. The requests are queued in the order
+ * of submission and the responses, which arrive in the same order, are matched to them by
+ * their position in the queue.
+ */
+typedef struct NativeConnection_st {
+	KSI_CTX *ctx;
+	NativeClientCtx *client;
+
+	KSI_SocketPeer peer;
+	int isTls;
+
+	int sockfd;
+	SSL *ssl;
+	/* Session of the last TLS connection, offered for resumption by the next one. */
+	SSL_SESSION *session;
+
+	/* Parser of the response stream, reset for every new socket. */
+	http_parser parser;
+	/* The request the response being parsed belongs to. */
+	NativeRequestCtx *current;
+	/* Is the response being parsed an interim (1xx) response. */
+	int isInterim;
+	/* Has the server announced closing the socket after the last response. */
+	int isClosing;
+	/* Time the last chunk of the response stream was received. */
+	KSI_uint64_t receivedAt;
+
+	/* Number of responses received over the current socket. */
+	size_t responseCount;
+
+	/* Pending requests in the order of submission. */
+	NativeRequestCtx *first;
+	NativeRequestCtx *last;
+
+	struct NativeConnection_st *next;
+} NativeConnection;
+
+/**
+ * Transport context of the HTTP client.
+ */
+struct NativeClientCtx_st {
+	KSI_CTX *ctx;
+	/* TLS configuration, created with the first https connection. */
+	SSL_CTX *ssl;
+	NativeConnection *connections;
+};
+
+struct NativeRequestCtx_st {
+	/* The connection used for the request, NULL if the request is no longer pending. */
+	NativeConnection *conn;
+	/* The request handle, NULL if the handle was freed while the request was in flight. */
+	KSI_RequestHandle *handle;
+
+	/* The serialized request message. */
+	char *msg;
+	size_t msg_len;
+
+	/* Has the request been written to the current socket. */
+	int isSent;
+	/* Was the request written to a socket that had already been used before. */
+	int isReused;
+	int attempts;
+
+	/* Has the response been received. */
+	int isDone;
+	/* Final status of a failed request. */
+	int status;
+
+	unsigned httpStatus;
+	unsigned char *raw;
+	unsigned len;
+	/* Allocated size of the response buffer. */
+	unsigned cap;
+
+	NativeRequestCtx *prev;
+	NativeRequestCtx *next;
+};
+
+static int nativeGlobal_init(void) {
+	if (nativeGlobal_initCount++ > 0) {
+		/* Nothing to do */
+		return KSI_OK;
+	}
+
+	SSL_library_init();
+	SSL_load_error_strings();
+
+	return KSI_OK;
+}
+
+static void nativeGlobal_cleanup(void) {
+	if (--nativeGlobal_initCount > 0) {
+		/* Nothing to do. */
+		return;
+	}
+	ERR_free_strings();
+}
+
+static void NativeConnection_unlink(NativeConnection *conn, NativeRequestCtx *t) {
+	if (t->prev != NULL) {
+		t->prev->next = t->next;
+	} else {
+		conn->first = t->next;
+	}
+
+	if (t->next != NULL) {
+		t->next->prev = t->prev;
+	} else {
+		conn->last = t->prev;
+	}
+
+	if (conn->current == t) conn->current = NULL;
+
+	t->prev = NULL;
+	t->next = NULL;
+	t->conn = NULL;
+}
+
+static void NativeConnection_append(NativeConnection *conn, NativeRequestCtx *t) {
+	t->conn = conn;
+	t->prev = conn->last;
+	t->next = NULL;
+
+	if (conn->last != NULL) {
+		conn->last->next = t;
+	} else {
+		conn->first = t;
+	}
+	conn->last = t;
+}
+
+static void NativeRequestCtx_release(NativeRequestCtx *t) {
+	if (t != NULL) {
+		KSI_free(t->msg);
+		KSI_free(t->raw);
+		KSI_free(t);
+	}
+}
+
+static void NativeRequestCtx_free(NativeRequestCtx *t) {
+	if (t != NULL) {
+		/* The response to a request in flight still arrives, so the request keeps its place in
+		 * the queue and is released when the response has been skipped. */
+		if (t->conn != NULL && t->isSent) {
+			t->handle = NULL;
+			return;
+		}
+		if (t->conn != NULL) NativeConnection_unlink(t->conn, t);
+		NativeRequestCtx_release(t);
+	}
+}
+
+static void NativeConnection_close(NativeConnection *conn) {
+	if (conn != NULL) {
+		if (conn->ssl != NULL) SSL_free(conn->ssl);
+		conn->ssl = NULL;
+		KSI_Socket_close(conn->sockfd);
+		conn->sockfd = -1;
+		conn->current = NULL;
+		conn->isInterim = 0;
+		conn->isClosing = 0;
+		conn->responseCount = 0;
+	}
+}
+
+/**
+ * Closes the socket. The requests written to it are sent again over a new socket if the server
+ * has closed the connection gracefully (\c graceful) or if the socket had already been used
+ * before, as the server may have closed the idle connection. All other requests written to the
+ * socket are failed with the given status.
+ */
+static void NativeConnection_fail(NativeConnection *conn, int status, int graceful) {
+	NativeRequestCtx *t = conn->first;
+
+	while (t != NULL) {
+		NativeRequestCtx *next = t->next;
+
+		if (t->isSent) {
+			if (t->handle == NULL) {
+				NativeConnection_unlink(conn, t);
+				NativeRequestCtx_release(t);
+			} else if (graceful || (t->isReused && t->attempts < NATIVE_MAX_ATTEMPTS)) {
+				t->isSent = 0;
+				t->len = 0;
+			} else {
+				t->status = status;
+				NativeConnection_unlink(conn, t);
+			}
+		}
+
+		t = next;
+	}
+
+	NativeConnection_close(conn);
+}
+
+/**
+ * Fails the requests waiting to be written, when no connection to the server can be opened
+ * for them.
+ */
+static void NativeConnection_failUnsent(NativeConnection *conn, int status) {
+	NativeRequestCtx *t = conn->first;
+
+	while (t != NULL) {
+		NativeRequestCtx *next = t->next;
+
+		if (!t->isSent) {
+			t->status = status;
+			NativeConnection_unlink(conn, t);
+		}
+
+		t = next;
+	}
+}
+
+static void NativeConnection_free(NativeConnection *conn) {
+	if (conn != NULL) {
+		/* Detach the requests still waiting for a response. */
+		while (conn->first != NULL) {
+			NativeRequestCtx *t = conn->first;
+			NativeConnection_unlink(conn, t);
+			if (t->handle == NULL) {
+				NativeRequestCtx_release(t);
+			} else {
+				t->status = KSI_NETWORK_ERROR;
+			}
+		}
+		NativeConnection_close(conn);
+		if (conn->session != NULL) SSL_SESSION_free(conn->session);
+		KSI_SocketPeer_clear(&conn->peer);
+		KSI_free(conn);
+	}
+}
+
+static void NativeClientCtx_free(NativeClientCtx *client) {
+	if (client != NULL) {
+		while (client->connections != NULL) {
+			NativeConnection *next = client->connections->next;
+			NativeConnection_free(client->connections);
+			client->connections = next;
+		}
+		if (client->ssl != NULL) SSL_CTX_free(client->ssl);
+		KSI_free(client);
+	}
+}
+
+static int reserveResponse(NativeRequestCtx *t, size_t size) {
+	int res;
+	size_t capacity;
+	unsigned char *tmp = NULL;
+
+	if (size <= t->cap) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	if (size > UINT_MAX) {
+		res = KSI_BUFFER_OVERFLOW;
+		goto cleanup;
+	}
+
+	capacity = 2 * (size_t)t->cap;
+	if (capacity < size) capacity = size;
+	if (capacity > UINT_MAX) capacity = UINT_MAX;
+
+	tmp = KSI_malloc(capacity);
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	if (t->len > 0) memcpy(tmp, t->raw, t->len);
+
+	KSI_free(t->raw);
+	t->raw = tmp;
+	t->cap = (unsigned)capacity;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+
+	return res;
+}
+
+static int deliverResponse(NativeConnection *conn, NativeRequestCtx *t) {
+	int res;
+	KSI_RequestHandle *handle = t->handle;
+
+	NativeConnection_unlink(conn, t);
+
+	/* Nobody is waiting for the response any more. */
+	if (handle == NULL) {
+		NativeRequestCtx_release(t);
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	t->isDone = 1;
+
+	KSI_RequestHandle_setPhaseTime(handle, KSI_NET_PHASE_RESPONSE_DONE, conn->receivedAt);
+
+	if (t->httpStatus >= 400) {
+		KSI_LOG_debug(conn->ctx, "Received HTTP error code %u.", t->httpStatus);
+		((KSI_HttpClient *)handle->client)->httpStatus = (int)t->httpStatus;
+	}
+
+	/* Hand the response buffer over to the handle. */
+	res = KSI_RequestHandle_adoptResponse(handle, t->raw, t->len);
+	if (res != KSI_OK) {
+		t->status = res;
+		goto cleanup;
+	}
+
+	t->raw = NULL;
+	t->len = 0;
+	t->cap = 0;
+
+cleanup:
+
+	return res;
+}
+
+static int onMessageBegin(http_parser *parser) {
+	NativeConnection *conn = parser->data;
+	NativeRequestCtx *t = NULL;
+
+	/* The responses arrive in the order the requests were written. */
+	for (t = conn->first; t != NULL && !t->isSent; t = t->next);
+
+	if (t == NULL) {
+		KSI_LOG_warn(conn->ctx, "Http: Unexpected response from %s.", conn->peer.host);
+		return 1;
+	}
+
+	conn->current = t;
+	conn->isInterim = 0;
+	t->len = 0;
+
+	if (t->handle != NULL) KSI_RequestHandle_setPhaseTime(t->handle, KSI_NET_PHASE_FIRST_BYTE, conn->receivedAt);
+
+	return 0;
+}
+
+static int onHeadersComplete(http_parser *parser) {
+	NativeConnection *conn = parser->data;
+	NativeRequestCtx *t = conn->current;
+
+	if (t == NULL) return 1;
+
+	/* An interim response, such as 100 Continue, is followed by the final one. */
+	if (parser->status_code / 100 == 1) {
+		conn->isInterim = 1;
+		return 0;
+	}
+
+	t->httpStatus = parser->status_code;
+
+	/* Size the buffer by the Content-Length, a chunked body grows it geometrically. */
+	if (parser->content_length != (uint64_t)-1 && parser->content_length > 0) {
+		size_t size = parser->content_length > NATIVE_MAX_PREALLOC ? NATIVE_MAX_PREALLOC : (size_t)parser->content_length;
+		if (reserveResponse(t, size) != KSI_OK) return 1;
+	}
+
+	return 0;
+}
+
+static int onBody(http_parser *parser, const char *at, size_t length) {
+	NativeConnection *conn = parser->data;
+	NativeRequestCtx *t = conn->current;
+
+	if (t == NULL || reserveResponse(t, (size_t)t->len + length) != KSI_OK) return 1;
+
+	memcpy(t->raw + t->len, at, length);
+	t->len += (unsigned)length;
+
+	return 0;
+}
+
+static int onMessageComplete(http_parser *parser) {
+	NativeConnection *conn = parser->data;
+	NativeRequestCtx *t = conn->current;
+
+	if (t == NULL) return 1;
+
+	if (conn->isInterim) {
+		conn->isInterim = 0;
+		return 0;
+	}
+
+	conn->responseCount++;
+	if (!http_should_keep_alive(parser)) conn->isClosing = 1;
+
+	deliverResponse(conn, t);
+
+	return 0;
+}
+
+static const http_parser_settings parserSettings = {
+	onMessageBegin,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	onHeadersComplete,
+	onBody,
+	onMessageComplete
+};
+
+static int createSslCtx(NativeClientCtx *client) {
+	int res;
+	SSL_CTX *tmp = NULL;
+
+	tmp = SSL_CTX_new(SSLv23_client_method());
+	if (tmp == NULL) {
+		KSI_ERR_push(client->ctx, res = KSI_CRYPTO_FAILURE, (long)ERR_get_error(), __FILE__, __LINE__, "Unable to create TLS context.");
+		goto cleanup;
+	}
+
+	SSL_CTX_set_options(tmp, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
+	SSL_CTX_set_verify(tmp, SSL_VERIFY_PEER, NULL);
+	SSL_CTX_set_session_cache_mode(tmp, SSL_SESS_CACHE_CLIENT);
+
+	if (defaultCaFile != NULL || defaultCaDir != NULL) {
+		if (!SSL_CTX_load_verify_locations(tmp, defaultCaFile, defaultCaDir)) {
+			KSI_ERR_push(client->ctx, res = KSI_CRYPTO_FAILURE, (long)ERR_get_error(), __FILE__, __LINE__, "Unable to load the trusted CA certificates.");
+			goto cleanup;
+		}
+	} else if (!SSL_CTX_set_default_verify_paths(tmp)) {
+		KSI_ERR_push(client->ctx, res = KSI_CRYPTO_FAILURE, (long)ERR_get_error(), __FILE__, __LINE__, "Unable to load the trusted CA certificates.");
+		goto cleanup;
+	}
+
+	client->ssl = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (tmp != NULL) SSL_CTX_free(tmp);
+
+	return res;
+}
+
+static int NativeConnection_startTls(NativeConnection *conn, KSI_RequestHandle *handle) {
+	int res;
+
+	if (conn->client->ssl == NULL) {
+		res = createSslCtx(conn->client);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	conn->ssl = SSL_new(conn->client->ssl);
+	if (conn->ssl == NULL || !SSL_set_fd(conn->ssl, conn->sockfd)) {
+		KSI_pushError(conn->ctx, res = KSI_OUT_OF_MEMORY, "Unable to create TLS connection.");
+		goto cleanup;
+	}
+
+	SSL_set_tlsext_host_name(conn->ssl, conn->peer.host);
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+	X509_VERIFY_PARAM_set1_host(SSL_get0_param(conn->ssl), conn->peer.host, 0);
+#endif
+
+	if (conn->session != NULL) SSL_set_session(conn->ssl, conn->session);
+
+	ERR_clear_error();
+	if (SSL_connect(conn->ssl) != 1) {
+		KSI_ERR_push(conn->ctx, res = KSI_NETWORK_ERROR, (long)ERR_get_error(), __FILE__, __LINE__, "TLS handshake failed.");
+		goto cleanup;
+	}
+
+	if (conn->session != NULL) SSL_SESSION_free(conn->session);
+	conn->session = SSL_get1_session(conn->ssl);
+
+	KSI_RequestHandle_setPhaseTime(handle, KSI_NET_PHASE_TLS_DONE, 0);
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int NativeConnection_open(NativeConnection *conn, KSI_HttpClient *http, KSI_RequestHandle *handle) {
+	int res;
+
+	res = KSI_SocketPeer_connect(&conn->peer, http->connectionTimeoutSeconds, http->readTimeoutSeconds, NATIVE_DNS_CACHE_TTL_SECONDS, handle, &conn->sockfd);
+	if (res != KSI_OK) goto cleanup;
+
+	KSI_LOG_debug(conn->ctx, "Http: Connected to %s:%u", conn->peer.host, conn->peer.port);
+
+	if (conn->isTls) {
+		res = NativeConnection_startTls(conn, handle);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	http_parser_init(&conn->parser, HTTP_RESPONSE);
+	conn->parser.data = conn;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (res != KSI_OK) NativeConnection_close(conn);
+
+	return res;
+}
+
+static int NativeConnection_write(NativeConnection *conn, const char *data, size_t data_len) {
+	int res;
+	size_t count = 0;
+
+	while (count < data_len) {
+		int c;
+		size_t len = data_len - count;
+
+		if (len > INT_MAX) len = INT_MAX;
+
+		if (conn->ssl != NULL) {
+			c = SSL_write(conn->ssl, data + count, (int)len);
+		} else {
+			c = (int)send(conn->sockfd, data + count, (int)len, KSI_SEND_FLAGS);
+		}
+
+		if (c <= 0) {
+			KSI_pushError(conn->ctx, res = KSI_NETWORK_ERROR, "Unable to write to socket.");
+			goto cleanup;
+		}
+
+		count += (size_t)c;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Writes the queued requests. A new socket carries a single request until its response has
+ * shown the connection to be persistent, after that the requests are written back-to-back
+ * without waiting for the responses.
+ */
+static int NativeConnection_flush(NativeConnection *conn, KSI_HttpClient *http) {
+	int res;
+	NativeRequestCtx *t = NULL;
+	size_t inFlight = 0;
+
+	for (t = conn->first; t != NULL; t = t->next) {
+		if (t->isSent) inFlight++;
+	}
+
+	for (t = conn->first; t != NULL; t = t->next) {
+		if (t->isSent) continue;
+
+		if (inFlight > 0 && conn->responseCount == 0) break;
+
+		if (conn->sockfd < 0) {
+			res = NativeConnection_open(conn, http, t->handle);
+			if (res != KSI_OK) {
+				/* Reconnecting would fail the same way, so the requests are not retried. */
+				NativeConnection_failUnsent(conn, res);
+				goto cleanup;
+			}
+		}
+
+		t->isSent = 1;
+		t->isReused = conn->responseCount > 0;
+		t->attempts++;
+		inFlight++;
+
+		res = NativeConnection_write(conn, t->msg, t->msg_len);
+		if (res != KSI_OK) goto cleanup;
+
+		KSI_RequestHandle_setPhaseTime(t->handle, KSI_NET_PHASE_REQUEST_SENT, 0);
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Receives the next chunk of the response stream and delivers the responses completed by it.
+ */
+static int NativeConnection_receive(NativeConnection *conn) {
+	int res;
+	char buf[NATIVE_RECV_SIZE];
+	int c;
+
+	if (conn->ssl != NULL) {
+		ERR_clear_error();
+		c = SSL_read(conn->ssl, buf, sizeof(buf));
+		if (c <= 0) {
+			int err = SSL_get_error(conn->ssl, c);
+			/* A peer closing the socket without the TLS shutdown is treated as a plain close. */
+			if (err == SSL_ERROR_ZERO_RETURN || (err == SSL_ERROR_SYSCALL && ERR_peek_error() == 0 && c == 0)) {
+				c = 0;
+			} else if (err == SSL_ERROR_SYSCALL && socketTimedOut(socket_error)) {
+				KSI_pushError(conn->ctx, res = KSI_NETWORK_RECIEVE_TIMEOUT, "Unable to read from socket.");
+				goto cleanup;
+			} else {
+				KSI_ERR_push(conn->ctx, res = KSI_NETWORK_ERROR, (long)ERR_get_error(), __FILE__, __LINE__, "Unable to read from socket.");
+				goto cleanup;
+			}
+		}
+	} else {
+		c = (int)recv(conn->sockfd, buf, sizeof(buf), 0);
+		if (c < 0) {
+			if (socketTimedOut(socket_error)) {
+				KSI_pushError(conn->ctx, res = KSI_NETWORK_RECIEVE_TIMEOUT, "Unable to read from socket.");
+			} else {
+				KSI_pushError(conn->ctx, res = KSI_NETWORK_ERROR, "Unable to read from socket.");
+			}
+			goto cleanup;
+		}
+	}
+
+	conn->receivedAt = KSI_NET_getTimeUs();
+
+	/* An empty chunk tells the parser about the end of the stream. */
+	http_parser_execute(&conn->parser, &parserSettings, buf, (size_t)c);
+
+	/* Anything following a response announcing the close is ignored. */
+	if (conn->isClosing) {
+		NativeConnection_fail(conn, KSI_NETWORK_ERROR, 1);
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	if (HTTP_PARSER_ERRNO(&conn->parser) != HPE_OK) {
+		KSI_pushError(conn->ctx, res = KSI_NETWORK_ERROR, http_errno_description(HTTP_PARSER_ERRNO(&conn->parser)));
+		goto cleanup;
+	}
+
+	if (c == 0) {
+		KSI_pushError(conn->ctx, res = KSI_NETWORK_ERROR, "Connection closed by peer.");
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int nativeReceive(KSI_RequestHandle *handle) {
+	int res;
+	NativeRequestCtx *t = NULL;
+	KSI_HttpClient *http = NULL;
+	NativeConnection *conn = NULL;
+
+	if (handle == NULL || handle->client == NULL || handle->implCtx == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(handle->ctx);
+
+	t = handle->implCtx;
+	http = (KSI_HttpClient *)handle->client;
+
+	/* Write the queued requests and read the responses until this one is answered. */
+	while (!t->isDone && t->conn != NULL) {
+		conn = t->conn;
+
+		res = NativeConnection_flush(conn, http);
+		if (res == KSI_OK) {
+			res = NativeConnection_receive(conn);
+		}
+
+		if (res != KSI_OK) {
+			NativeConnection_fail(conn, res, 0);
+		}
+	}
+
+	if (!t->isDone || t->status != KSI_OK) {
+		res = t->status != KSI_OK ? t->status : KSI_NETWORK_ERROR;
+		KSI_pushError(handle->ctx, res, "Unable to receive response.");
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Waits for the response until it is received or the timeout expires. Responses to the
+ * requests written before it are delivered as they arrive.
+ */
+static int nativePoll(KSI_RequestHandle *handle, unsigned timeoutMs, int *ready) {
+	int res;
+	NativeRequestCtx *t = NULL;
+	KSI_HttpClient *http = NULL;
+	NativeConnection *conn = NULL;
+	KSI_uint64_t deadline;
+
+	if (handle == NULL || handle->implCtx == NULL || ready == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	t = handle->implCtx;
+	http = (KSI_HttpClient *)handle->client;
+	deadline = KSI_NET_getTimeMs() + timeoutMs;
+
+	while (!t->isDone && t->conn != NULL) {
+		KSI_uint64_t now;
+		int c;
+
+		conn = t->conn;
+
+		res = NativeConnection_flush(conn, http);
+		if (res != KSI_OK) {
+			NativeConnection_fail(conn, res, 0);
+			continue;
+		}
+
+		/* Decrypted data may be waiting in the TLS layer without the socket being readable. */
+		if (conn->ssl != NULL && SSL_pending(conn->ssl) > 0) {
+			c = 1;
+		} else {
+			now = KSI_NET_getTimeMs();
+			if (now >= deadline) break;
+
+			c = KSI_Socket_waitReadable(conn->sockfd, deadline - now);
+			if (c == 0) break;
+		}
+
+		res = c < 0 ? KSI_NETWORK_ERROR : NativeConnection_receive(conn);
+		if (res != KSI_OK) {
+			NativeConnection_fail(conn, res, 0);
+		}
+	}
+
+	/* A failed request is ready as well, reading it reports the error. */
+	*ready = t->isDone || t->conn == NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int getConnection(NativeClientCtx *client, int isTls, const char *host, unsigned port, NativeConnection **conn) {
+	int res;
+	NativeConnection *tmp = NULL;
+
+	for (tmp = client->connections; tmp != NULL; tmp = tmp->next) {
+		if (tmp->isTls == isTls && tmp->peer.port == port && !strcmp(tmp->peer.host, host)) {
+			*conn = tmp;
+			KSI_nofree(tmp);
+			res = KSI_OK;
+			goto cleanup;
+		}
+	}
+
+	tmp = KSI_new(NativeConnection);
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	tmp->ctx = client->ctx;
+	tmp->client = client;
+	tmp->peer.host = NULL;
+	tmp->peer.addresses = NULL;
+	tmp->isTls = isTls;
+	tmp->sockfd = -1;
+	tmp->ssl = NULL;
+	tmp->session = NULL;
+	tmp->current = NULL;
+	tmp->isInterim = 0;
+	tmp->isClosing = 0;
+	tmp->receivedAt = 0;
+	tmp->responseCount = 0;
+	tmp->first = NULL;
+	tmp->last = NULL;
+	tmp->next = NULL;
+
+	res = KSI_SocketPeer_init(client->ctx, &tmp->peer, host, port);
+	if (res != KSI_OK) goto cleanup;
+
+	tmp->next = client->connections;
+	client->connections = tmp;
+
+	*conn = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	NativeConnection_free(tmp);
+
+	return res;
+}
+
+/**
+ * Serializes the request message: a POST carrying the request PDU, or a GET if there is
+ * no request (the publications file).
+ */
+static int buildMessage(KSI_HttpClient *http, KSI_RequestHandle *handle, const char *target, const char *host, unsigned port, int hasPort, NativeRequestCtx *t) {
+	int res;
+	char hostHdr[300];
+	char lenHdr[64];
+	const char *agent = http->agentName != NULL ? http->agentName : "KSI HTTP Client";
+	size_t hdr_len;
+
+	/* An IPv6 address literal is enclosed in brackets. */
+	if (strchr(host, ':') != NULL) {
+		KSI_snprintf(hostHdr, sizeof(hostHdr), "[%s]", host);
+	} else {
+		KSI_snprintf(hostHdr, sizeof(hostHdr), "%s", host);
+	}
+	if (hasPort) {
+		size_t len = strlen(hostHdr);
+		KSI_snprintf(hostHdr + len, sizeof(hostHdr) - len, ":%u", port);
+	}
+
+	lenHdr[0] = '\0';
+	if (handle->request != NULL) {
+		KSI_snprintf(lenHdr, sizeof(lenHdr), "Content-Length: %u\r\n", handle->request_length);
+	}
+
+	hdr_len = strlen(target) + strlen(hostHdr) + strlen(agent) + strlen(lenHdr) + 128;
+
+	t->msg = KSI_malloc(hdr_len + handle->request_length);
+	if (t->msg == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	KSI_snprintf(t->msg, hdr_len,
+			"%s %s HTTP/1.1\r\n"
+			"Host: %s\r\n"
+			"User-Agent: %s\r\n"
+			"%s%s"
+			"\r\n",
+			handle->request != NULL ? "POST" : "GET", target, hostHdr, agent,
+			handle->request != NULL ? "Content-Type: application/ksi-request\r\n" : "", lenHdr);
+	t->msg_len = strlen(t->msg);
+
+	/* The header and the body are written with a single call. */
+	if (handle->request != NULL) {
+		memcpy(t->msg + t->msg_len, handle->request, handle->request_length);
+		t->msg_len += handle->request_length;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static char *copyUrlField(const char *url, const struct http_parser_url *u, int field) {
+	char *tmp = NULL;
+	size_t len = u->field_data[field].len;
+
+	tmp = KSI_malloc(len + 1);
+	if (tmp == NULL) return NULL;
+
+	memcpy(tmp, url + u->field_data[field].off, len);
+	tmp[len] = '\0';
+
+	return tmp;
+}
+
+static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, char *url) {
+	int res;
+	KSI_HttpClient *http = (KSI_HttpClient *)client;
+	NativeClientCtx *clientCtx = NULL;
+	NativeRequestCtx *t = NULL;
+	NativeConnection *conn = NULL;
+	struct http_parser_url u;
+	char *host = NULL;
+	char *target = NULL;
+	int isTls;
+	unsigned port;
+
+	if (client == NULL || handle == NULL || url == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(client->ctx);
+
+	clientCtx = http->implCtx;
+
+	KSI_LOG_debug(handle->ctx, "Http: Sending request to: %s", url);
+
+	if (http_parser_parse_url(url, strlen(url), 0, &u) != 0 || !(u.field_set & (1 << UF_SCHEMA)) || !(u.field_set & (1 << UF_HOST))) {
+		KSI_pushError(client->ctx, res = KSI_INVALID_ARGUMENT, "Unable to parse the URL.");
+		goto cleanup;
+	}
+
+	if (u.field_data[UF_SCHEMA].len == 5 && !strncmp(url + u.field_data[UF_SCHEMA].off, "https", 5)) {
+		isTls = 1;
+	} else if (u.field_data[UF_SCHEMA].len == 4 && !strncmp(url + u.field_data[UF_SCHEMA].off, "http", 4)) {
+		isTls = 0;
+	} else {
+		KSI_pushError(client->ctx, res = KSI_INVALID_ARGUMENT, "Unsupported URL scheme.");
+		goto cleanup;
+	}
+
+	port = (u.field_set & (1 << UF_PORT)) ? u.port : (isTls ? 443 : 80);
+
+	host = copyUrlField(url, &u, UF_HOST);
+	if (host == NULL) {
+		KSI_pushError(client->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	/* The request target runs from the path to the end of the query. */
+	if (u.field_set & (1 << UF_PATH)) {
+		int last = (u.field_set & (1 << UF_QUERY)) ? UF_QUERY : UF_PATH;
+		u.field_data[UF_PATH].len = (uint16_t)(u.field_data[last].off + u.field_data[last].len - u.field_data[UF_PATH].off);
+		target = copyUrlField(url, &u, UF_PATH);
+	} else {
+		target = KSI_malloc(2);
+		if (target != NULL) strcpy(target, "/");
+	}
+	if (target == NULL) {
+		KSI_pushError(client->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	t = KSI_new(NativeRequestCtx);
+	if (t == NULL) {
+		KSI_pushError(client->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	t->conn = NULL;
+	t->handle = handle;
+	t->msg = NULL;
+	t->msg_len = 0;
+	t->isSent = 0;
+	t->isReused = 0;
+	t->attempts = 0;
+	t->isDone = 0;
+	t->status = KSI_OK;
+	t->httpStatus = 0;
+	t->raw = NULL;
+	t->len = 0;
+	t->cap = 0;
+	t->prev = NULL;
+	t->next = NULL;
+
+	res = buildMessage(http, handle, target, host, port, (u.field_set & (1 << UF_PORT)) != 0, t);
+	if (res != KSI_OK) {
+		KSI_pushError(client->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = getConnection(clientCtx, isTls, host, port, &conn);
+	if (res != KSI_OK) {
+		KSI_pushError(client->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	handle->readResponse = nativeReceive;
+	handle->pollResponse = nativePoll;
+	handle->client = client;
+
+	res = KSI_RequestHandle_setImplContext(handle, t, (void (*)(void *))NativeRequestCtx_free);
+	if (res != KSI_OK) {
+		KSI_pushError(handle->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* The request is written with the next batch, when any of the pending responses is read. */
+	NativeConnection_append(conn, t);
+	t = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	NativeRequestCtx_release(t);
+	KSI_free(target);
+	KSI_free(host);
+
+	return res;
+}
+
+int KSI_HttpClientImpl_init(KSI_HttpClient *http) {
+	int res = KSI_UNKNOWN_ERROR;
+	NativeClientCtx *clientCtx = NULL;
+
+	if (http == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = KSI_CTX_registerGlobals(http->parent.ctx, nativeGlobal_init, nativeGlobal_cleanup);
+	if (res != KSI_OK) {
+		KSI_pushError(http->parent.ctx, res, NULL);
+		goto cleanup;
+	}
+
+	clientCtx = KSI_new(NativeClientCtx);
+	if (clientCtx == NULL) {
+		KSI_pushError(http->parent.ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	clientCtx->ctx = http->parent.ctx;
+	clientCtx->ssl = NULL;
+	clientCtx->connections = NULL;
+
+	http->implCtx = clientCtx;
+	http->implCtx_free = (void (*)(void *))NativeClientCtx_free;
+	clientCtx = NULL;
+
+	http->sendRequest = sendRequest;
+
+	res = KSI_OK;
+
+cleanup:
+
+	NativeClientCtx_free(clientCtx);
+
+	return res;
+}
+
+#endif
@@ -26,7 +26,7 @@
 extern "C" {
 #endif
 
-	#define KSI_NETWORK_CLIENT_INIT(ctx)  (KSI_NetworkClient) {(ctx), NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}
+	#define KSI_NETWORK_CLIENT_INIT(ctx)  (KSI_NetworkClient) {(ctx), NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}
 
 	struct KSI_NetworkClient_st {
 		KSI_CTX *ctx;
@@ -48,6 +48,22 @@ extern "C" {
 	
 		/** Cleanup for the provider, gets the #providerCtx as parameter. */
 		void (*implFree)(void *);
+
+		/** Host event loop callbacks, see #KSI_NetworkClient_setEventCallbacks. */
+		KSI_NetSocketCallback socketCb;
+		KSI_NetTimerCallback timerCb;
+		KSI_NetDoneCallback doneCb;
+		void *eventCtx;
+
+		/** Switches the provider to event driven mode, NULL if the provider does not support it. */
+		int (*setEventCallbacks)(KSI_NetworkClient *);
+		/** Processes the readiness of a socket of the provider (see #KSI_NetEvent). */
+		int (*onSocketEvent)(KSI_NetworkClient *, int, int);
+		/** Processes the expiry of the timer of the provider. */
+		int (*onTimeout)(KSI_NetworkClient *);
+
+		/** Signing request prepared for the aggregator credentials, NULL until first used. */
+		KSI_PreparedSignRequest *preparedSign;
 	};
 
 	struct KSI_NetHandle_st {
@@ -64,14 +80,72 @@ extern "C" {
 		unsigned response_length;
 
 		int (*readResponse)(KSI_RequestHandle *);
+		/** Waits for the response for at most the given number of milliseconds, NULL if not supported. */
+		int (*pollResponse)(KSI_RequestHandle *, unsigned, int *);
 
 		KSI_NetworkClient *client;
 
 		/** Additional context for the transport layer. */
 		void *implCtx;
 		void (*implCtx_free)(void *);
+
+		/** Tells the outcome of reading the response to the router of the request, NULL if not routed. */
+		void (*responseDone)(KSI_RequestHandle *, int);
+		/** Releases the routing state of the request, NULL if not routed. */
+		void (*routeFree)(KSI_RequestHandle *);
+
+		/** Endpoint of a service pool the request was routed to, NULL if not routed. */
+		struct KSI_UriEndpoint_st *endpoint;
+		/** Time the request was routed to the endpoint (see #KSI_NET_getTimeMs). */
+		KSI_uint64_t routedAt;
+		/** Set while the request is counted as outstanding at the endpoint. */
+		int isRoutePending;
+		/** State for hedging and retrying the routed request, NULL if not enabled. */
+		struct UriRetryCtx_st *retry;
+
+		/** Completion times of the request phases (see #KSI_NetPhase), 0 if not completed. */
+		KSI_uint64_t phaseTime[KSI_NET_NOF_PHASES];
 	};
 
+	/**
+	 * Returns the value of a monotonic clock in milliseconds, suitable only for measuring intervals.
+	 */
+	KSI_uint64_t KSI_NET_getTimeMs(void);
+
+	/**
+	 * Blocks the calling thread for the given number of milliseconds.
+	 */
+	void KSI_NET_sleepMs(KSI_uint64_t ms);
+
+	/** Is the client driven by a host event loop (see #KSI_NetworkClient_setEventCallbacks). */
+	#define KSI_NetworkClient_isEventDriven(client) ((client)->socketCb != NULL)
+
+	/**
+	 * Tells the host event loop which events to wait for on the socket, #KSI_NET_EVENT_REMOVE
+	 * before the socket is closed. Does nothing, unless the client is event driven.
+	 */
+	int KSI_NetworkClient_watchSocket(KSI_NetworkClient *client, int fd, int events);
+
+	/**
+	 * Arms the timer of the host event loop, -1 disarms it. Does nothing, unless the client
+	 * is event driven.
+	 */
+	int KSI_NetworkClient_setTimer(KSI_NetworkClient *client, long timeoutMs);
+
+	/**
+	 * Tells the host event loop the request has completed. Does nothing, unless the client
+	 * is event driven.
+	 */
+	void KSI_NetworkClient_requestDone(KSI_NetworkClient *client, KSI_RequestHandle *handle);
+
+	/**
+	 * Serializes the aggregation request PDU with the prepared signing request of the client. The
+	 * serialized PDU is valid until the next call. If the request can not be served by the prepared
+	 * request (e.g. a request header callback is set), \c *raw is set to \c NULL and the request has
+	 * to be enclosed with #KSI_AggregationReq_enclose.
+	 */
+	int KSI_NetworkClient_serializeSignRequest(KSI_NetworkClient *client, KSI_AggregationReq *req, const unsigned char **raw, unsigned *raw_len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,1202 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "internal.h"
+#include "io.h"
+#include "net_impl.h"
+#include "net_replay.h"
+
+#define CAPTURE_MAGIC "KSINREC1"
+#define CAPTURE_MAGIC_LEN 8
+
+/* Longest key of a request: the imprint and the level of an aggregation request. */
+#define CAPTURE_KEY_MAX (KSI_MAX_IMPRINT_LEN + 8)
+
+/* Kinds of the recorded requests. */
+enum {
+	CAPTURE_AGGREGATION = 1,
+	CAPTURE_EXTEND = 2,
+	CAPTURE_PUBLICATIONS_FILE = 3
+};
+
+struct KSI_RecordingClient_st {
+	KSI_NetworkClient parent;
+
+	/* The client the requests are forwarded to. */
+	KSI_NetworkClient *inner;
+
+	/* The capture file. */
+	FILE *file;
+	/* Time the client was created at (see #KSI_NET_getTimeMs). */
+	KSI_uint64_t startedAt;
+};
+
+/** A recorded request, the data points into the mapped capture file. */
+typedef struct CaptureRecord_st {
+	int kind;
+	int status;
+	unsigned durationMs;
+	const unsigned char *request;
+	unsigned request_len;
+	const unsigned char *response;
+	unsigned response_len;
+	/* What the request asked for, independent of the request id and the credentials. */
+	unsigned char key[CAPTURE_KEY_MAX];
+	unsigned key_len;
+	/* Number of times the record has been served. */
+	size_t uses;
+	/* Index of the next record in the same bucket, -1 for none. */
+	long next;
+} CaptureRecord;
+
+struct KSI_ReplayClient_st {
+	KSI_NetworkClient parent;
+
+	/* Reader of the capture file, holding the mapping the records point into. */
+	KSI_RDR *rdr;
+
+	CaptureRecord *records;
+	size_t records_len;
+
+	/* Heads of the chains of records with the same hash of the key, -1 for none. */
+	long *buckets;
+	size_t buckets_len;
+
+	double timeScale;
+};
+
+/* State of a recorded request. */
+typedef struct RecordingHandleCtx_st {
+	KSI_RecordingClient *client;
+	int kind;
+	KSI_uint64_t sentAt;
+	/* Time the response was seen ready by polling, 0 if not yet. */
+	KSI_uint64_t readyAt;
+	int isRecorded;
+
+	void *innerCtx;
+	void (*innerCtx_free)(void *);
+	int (*innerRead)(KSI_RequestHandle *);
+	int (*innerPoll)(KSI_RequestHandle *, unsigned, int *);
+} RecordingHandleCtx;
+
+/* State of a replayed request. */
+typedef struct ReplayHandleCtx_st {
+	const CaptureRecord *record;
+	/* Recorded response rewritten for the request, NULL to serve it as recorded. */
+	unsigned char *response;
+	unsigned response_len;
+	KSI_uint64_t readyAt;
+} ReplayHandleCtx;
+
+static int writeBlob(FILE *f, const unsigned char *data, unsigned len) {
+	int res;
+
+	res = KSI_writeUInt(f, len, 4);
+	if (res != KSI_OK) return res;
+
+	if (len > 0 && fwrite(data, 1, len, f) != len) return KSI_IO_ERROR;
+
+	return KSI_OK;
+}
+
+static int RecordingHandleCtx_write(RecordingHandleCtx *rc, KSI_RequestHandle *handle, int status) {
+	int res;
+	KSI_RecordingClient *client = rc->client;
+	KSI_uint64_t doneAt = rc->readyAt != 0 ? rc->readyAt : KSI_NET_getTimeMs();
+	FILE *f = client->file;
+
+	rc->isRecorded = 1;
+
+	if ((res = KSI_writeUInt(f, (KSI_uint64_t)rc->kind, 1)) != KSI_OK ||
+			(res = KSI_writeUInt(f, (KSI_uint64_t)status, 4)) != KSI_OK ||
+			(res = KSI_writeUInt(f, rc->sentAt - client->startedAt, 8)) != KSI_OK ||
+			(res = KSI_writeUInt(f, doneAt - rc->sentAt, 4)) != KSI_OK ||
+			(res = writeBlob(f, handle->request, handle->request_length)) != KSI_OK ||
+			(res = writeBlob(f, status == KSI_OK ? handle->response : NULL, status == KSI_OK ? handle->response_length : 0)) != KSI_OK) {
+		KSI_pushError(handle->ctx, res, "Unable to write the capture file.");
+		goto cleanup;
+	}
+
+	/* Keep the capture usable if the application does not shut down cleanly. */
+	fflush(f);
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static void RecordingHandleCtx_free(RecordingHandleCtx *rc) {
+	if (rc != NULL) {
+		if (rc->innerCtx_free != NULL) rc->innerCtx_free(rc->innerCtx);
+		KSI_free(rc);
+	}
+}
+
+static int recordRead(KSI_RequestHandle *handle) {
+	int res;
+	int status;
+	RecordingHandleCtx *rc = NULL;
+
+	if (handle == NULL || handle->implCtx == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	rc = handle->implCtx;
+
+	handle->implCtx = rc->innerCtx;
+	status = rc->innerRead(handle);
+	handle->implCtx = rc;
+
+	/* The wrapped client is driven by an event loop and has not finished yet. */
+	if (status == KSI_ASYNC_NOT_FINISHED) {
+		res = status;
+		goto cleanup;
+	}
+
+	if (!rc->isRecorded) {
+		res = RecordingHandleCtx_write(rc, handle, status);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = status;
+
+cleanup:
+
+	return res;
+}
+
+static int recordPoll(KSI_RequestHandle *handle, unsigned timeoutMs, int *ready) {
+	int res;
+	RecordingHandleCtx *rc = NULL;
+
+	if (handle == NULL || handle->implCtx == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	rc = handle->implCtx;
+
+	handle->implCtx = rc->innerCtx;
+	res = rc->innerPoll(handle, timeoutMs, ready);
+	handle->implCtx = rc;
+
+	/* The response time is measured up to the readiness, not up to reading it. */
+	if (res == KSI_OK && *ready && rc->readyAt == 0) rc->readyAt = KSI_NET_getTimeMs();
+
+cleanup:
+
+	return res;
+}
+
+/* Takes over the handle of the request just sent by the wrapped client. */
+static int wrapHandle(KSI_RecordingClient *client, int kind, KSI_uint64_t sentAt, KSI_RequestHandle *handle) {
+	int res;
+	RecordingHandleCtx *rc = NULL;
+
+	rc = KSI_new(RecordingHandleCtx);
+	if (rc == NULL) {
+		KSI_pushError(client->parent.ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	rc->client = client;
+	rc->kind = kind;
+	rc->sentAt = sentAt;
+	rc->readyAt = 0;
+	rc->isRecorded = 0;
+
+	rc->innerCtx = handle->implCtx;
+	rc->innerCtx_free = handle->implCtx_free;
+	rc->innerRead = handle->readResponse;
+	rc->innerPoll = handle->pollResponse;
+
+	handle->implCtx = rc;
+	handle->implCtx_free = (void (*)(void *))RecordingHandleCtx_free;
+	handle->readResponse = recordRead;
+	handle->pollResponse = rc->innerPoll != NULL ? recordPoll : NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int recordSignRequest(KSI_NetworkClient *c, KSI_AggregationReq *req, KSI_RequestHandle **handle) {
+	int res;
+	KSI_RecordingClient *client = (KSI_RecordingClient *)c;
+	KSI_RequestHandle *tmp = NULL;
+	KSI_uint64_t sentAt = KSI_NET_getTimeMs();
+
+	res = KSI_NetworkClient_sendSignRequest(client->inner, req, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = wrapHandle(client, CAPTURE_AGGREGATION, sentAt, tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	*handle = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_RequestHandle_free(tmp);
+
+	return res;
+}
+
+static int recordExtendRequest(KSI_NetworkClient *c, KSI_ExtendReq *req, KSI_RequestHandle **handle) {
+	int res;
+	KSI_RecordingClient *client = (KSI_RecordingClient *)c;
+	KSI_RequestHandle *tmp = NULL;
+	KSI_uint64_t sentAt = KSI_NET_getTimeMs();
+
+	res = KSI_NetworkClient_sendExtendRequest(client->inner, req, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = wrapHandle(client, CAPTURE_EXTEND, sentAt, tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	*handle = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_RequestHandle_free(tmp);
+
+	return res;
+}
+
+static int recordPublicationRequest(KSI_NetworkClient *c, KSI_RequestHandle **handle) {
+	int res;
+	KSI_RecordingClient *client = (KSI_RecordingClient *)c;
+	KSI_RequestHandle *tmp = NULL;
+	KSI_uint64_t sentAt = KSI_NET_getTimeMs();
+
+	res = KSI_NetworkClient_sendPublicationsFileRequest(client->inner, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = wrapHandle(client, CAPTURE_PUBLICATIONS_FILE, sentAt, tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	*handle = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_RequestHandle_free(tmp);
+
+	return res;
+}
+
+static int recordGetStatusCode(KSI_NetworkClient *c) {
+	KSI_RecordingClient *client = (KSI_RecordingClient *)c;
+	return client->inner->getStausCode != NULL ? client->inner->getStausCode(client->inner) : 0;
+}
+
+static int recordSetEventCallbacks(KSI_NetworkClient *c) {
+	KSI_RecordingClient *client = (KSI_RecordingClient *)c;
+	return KSI_NetworkClient_setEventCallbacks(client->inner, c->socketCb, c->timerCb, c->doneCb, c->eventCtx);
+}
+
+static int recordOnSocketEvent(KSI_NetworkClient *c, int fd, int events) {
+	KSI_RecordingClient *client = (KSI_RecordingClient *)c;
+	return client->inner->onSocketEvent(client->inner, fd, events);
+}
+
+static int recordOnTimeout(KSI_NetworkClient *c) {
+	KSI_RecordingClient *client = (KSI_RecordingClient *)c;
+	return client->inner->onTimeout(client->inner);
+}
+
+static void recordingClient_free(KSI_RecordingClient *client) {
+	if (client != NULL) {
+		KSI_NetworkClient_free(client->inner);
+		if (client->file != NULL) fclose(client->file);
+		KSI_free(client);
+	}
+}
+
+void KSI_RecordingClient_free(KSI_RecordingClient *client) {
+	KSI_NetworkClient_free((KSI_NetworkClient *)client);
+}
+
+int KSI_RecordingClient_new(KSI_CTX *ctx, KSI_NetworkClient *inner, const char *fileName, KSI_RecordingClient **client) {
+	int res;
+	KSI_RecordingClient *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (ctx == NULL || inner == NULL || fileName == NULL || client == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_RecordingClient);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->inner = NULL;
+	tmp->file = NULL;
+	tmp->startedAt = KSI_NET_getTimeMs();
+
+	res = KSI_NetworkClient_init(ctx, &tmp->parent);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	tmp->file = fopen(fileName, "wb");
+	if (tmp->file == NULL) {
+		KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to create the capture file.");
+		goto cleanup;
+	}
+
+	if (fwrite(CAPTURE_MAGIC, 1, CAPTURE_MAGIC_LEN, tmp->file) != CAPTURE_MAGIC_LEN || fflush(tmp->file) != 0) {
+		KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to write the capture file.");
+		goto cleanup;
+	}
+
+	tmp->parent.sendSignRequest = recordSignRequest;
+	tmp->parent.sendExtendRequest = recordExtendRequest;
+	tmp->parent.sendPublicationRequest = recordPublicationRequest;
+	tmp->parent.getStausCode = recordGetStatusCode;
+	tmp->parent.setEventCallbacks = recordSetEventCallbacks;
+	tmp->parent.onSocketEvent = recordOnSocketEvent;
+	tmp->parent.onTimeout = recordOnTimeout;
+	tmp->parent.implFree = (void (*)(void *))recordingClient_free;
+
+	tmp->inner = inner;
+
+	*client = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (tmp != NULL) {
+		if (tmp->file != NULL) fclose(tmp->file);
+		KSI_free(tmp);
+	}
+
+	return res;
+}
+
+/* FNV-1a hash of the kind and the key of a request. */
+static KSI_uint64_t hashKey(int kind, const unsigned char *key, unsigned key_len) {
+	KSI_uint64_t h = 0xcbf29ce484222325ULL;
+	unsigned i;
+
+	h = (h ^ (unsigned char)kind) * 0x100000001b3ULL;
+	for (i = 0; i < key_len; i++) {
+		h = (h ^ key[i]) * 0x100000001b3ULL;
+	}
+
+	return h;
+}
+
+/* The key of an aggregation request: the imprint of the request hash and the level. */
+static int aggregationKey(KSI_AggregationReq *req, unsigned char *key, unsigned *key_len) {
+	int res;
+	KSI_DataHash *hsh = NULL;
+	KSI_Integer *level = NULL;
+	const unsigned char *imprint = NULL;
+	unsigned imprint_len = 0;
+
+	res = KSI_AggregationReq_getRequestHash(req, &hsh);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationReq_getRequestLevel(req, &level);
+	if (res != KSI_OK) goto cleanup;
+
+	if (hsh == NULL) {
+		res = KSI_INVALID_FORMAT;
+		goto cleanup;
+	}
+
+	res = KSI_DataHash_getImprint(hsh, &imprint, &imprint_len);
+	if (res != KSI_OK) goto cleanup;
+
+	if (imprint_len > KSI_MAX_IMPRINT_LEN) {
+		res = KSI_INVALID_FORMAT;
+		goto cleanup;
+	}
+
+	memcpy(key, imprint, imprint_len);
+	KSI_putUInt(key + imprint_len, KSI_Integer_getUInt64(level), 8);
+	*key_len = imprint_len + 8;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* The key of an extension request: the aggregation time and the publication time, if any. */
+static int extendKey(KSI_ExtendReq *req, unsigned char *key, unsigned *key_len) {
+	int res;
+	KSI_Integer *aggrTime = NULL;
+	KSI_Integer *pubTime = NULL;
+
+	res = KSI_ExtendReq_getAggregationTime(req, &aggrTime);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendReq_getPublicationTime(req, &pubTime);
+	if (res != KSI_OK) goto cleanup;
+
+	KSI_putUInt(key, KSI_Integer_getUInt64(aggrTime), 8);
+	*key_len = 8;
+
+	/* Extending to the head of the calendar differs from extending to any publication. */
+	key[(*key_len)++] = pubTime != NULL;
+	if (pubTime != NULL) {
+		KSI_putUInt(key + *key_len, KSI_Integer_getUInt64(pubTime), 8);
+		*key_len += 8;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Parses the recorded request PDU for its key. */
+static int CaptureRecord_setKey(KSI_CTX *ctx, CaptureRecord *rec) {
+	int res;
+	KSI_AggregationPdu *aggrPdu = NULL;
+	KSI_ExtendPdu *extPdu = NULL;
+	KSI_AggregationReq *aggrReq = NULL;
+	KSI_ExtendReq *extReq = NULL;
+
+	rec->key_len = 0;
+
+	switch (rec->kind) {
+		case CAPTURE_AGGREGATION:
+			res = KSI_AggregationPdu_parse(ctx, rec->request, rec->request_len, &aggrPdu);
+			if (res != KSI_OK) goto cleanup;
+
+			res = KSI_AggregationPdu_getRequest(aggrPdu, &aggrReq);
+			if (res != KSI_OK) goto cleanup;
+
+			if (aggrReq == NULL) {
+				res = KSI_INVALID_FORMAT;
+				goto cleanup;
+			}
+
+			res = aggregationKey(aggrReq, rec->key, &rec->key_len);
+			if (res != KSI_OK) goto cleanup;
+			break;
+		case CAPTURE_EXTEND:
+			res = KSI_ExtendPdu_parse(ctx, rec->request, rec->request_len, &extPdu);
+			if (res != KSI_OK) goto cleanup;
+
+			res = KSI_ExtendPdu_getRequest(extPdu, &extReq);
+			if (res != KSI_OK) goto cleanup;
+
+			if (extReq == NULL) {
+				res = KSI_INVALID_FORMAT;
+				goto cleanup;
+			}
+
+			res = extendKey(extReq, rec->key, &rec->key_len);
+			if (res != KSI_OK) goto cleanup;
+			break;
+		default:
+			/* All publications file requests are the same. */
+			break;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_ExtendPdu_free(extPdu);
+	KSI_AggregationPdu_free(aggrPdu);
+
+	return res;
+}
+
+static int readBlob(KSI_RDR *rdr, const unsigned char **data, unsigned *len) {
+	int res;
+	KSI_uint64_t val = 0;
+	unsigned char *ptr = NULL;
+	size_t count = 0;
+
+	res = KSI_RDR_readUInt(rdr, 4, &val, &count);
+	if (res != KSI_OK) return res;
+	if (count != 4) return KSI_INVALID_FORMAT;
+
+	*data = NULL;
+	*len = (unsigned)val;
+	if (val == 0) return KSI_OK;
+
+	res = KSI_RDR_read_ptr(rdr, &ptr, (size_t)val, &count);
+	if (res != KSI_OK) return res;
+	if (count != val) return KSI_INVALID_FORMAT;
+
+	*data = ptr;
+
+	return KSI_OK;
+}
+
+/* Reads the records of the capture file and indexes them by the request. */
+static int ReplayClient_load(KSI_ReplayClient *client, const char *fileName) {
+	int res;
+	KSI_CTX *ctx = client->parent.ctx;
+	unsigned char *ptr = NULL;
+	size_t count = 0;
+	size_t capacity = 0;
+	size_t i;
+
+	res = KSI_RDR_fromFile(ctx, fileName, &client->rdr);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_RDR_read_ptr(client->rdr, &ptr, CAPTURE_MAGIC_LEN, &count);
+	if (res != KSI_OK || count != CAPTURE_MAGIC_LEN || memcmp(ptr, CAPTURE_MAGIC, CAPTURE_MAGIC_LEN) != 0) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Not a capture file.");
+		goto cleanup;
+	}
+
+	for (;;) {
+		CaptureRecord *rec = NULL;
+		KSI_uint64_t val = 0;
+
+		res = KSI_RDR_readUInt(client->rdr, 1, &val, &count);
+		if (res != KSI_OK) goto invalid;
+		if (count == 0) break;
+
+		if (client->records_len == capacity) {
+			CaptureRecord *tmp = NULL;
+
+			capacity = capacity > 0 ? capacity * 2 : 64;
+			tmp = KSI_malloc(capacity * sizeof(CaptureRecord));
+			if (tmp == NULL) {
+				KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+				goto cleanup;
+			}
+			if (client->records_len > 0) memcpy(tmp, client->records, client->records_len * sizeof(CaptureRecord));
+			KSI_free(client->records);
+			client->records = tmp;
+		}
+
+		rec = &client->records[client->records_len];
+		rec->kind = (int)val;
+		rec->uses = 0;
+		rec->next = -1;
+
+		res = KSI_RDR_readUInt(client->rdr, 4, &val, &count);
+		if (res != KSI_OK || count != 4) goto invalid;
+		rec->status = (int)val;
+
+		/* The send time is not needed for replaying. */
+		res = KSI_RDR_readUInt(client->rdr, 8, &val, &count);
+		if (res != KSI_OK || count != 8) goto invalid;
+
+		res = KSI_RDR_readUInt(client->rdr, 4, &val, &count);
+		if (res != KSI_OK || count != 4) goto invalid;
+		rec->durationMs = (unsigned)val;
+
+		res = readBlob(client->rdr, &rec->request, &rec->request_len);
+		if (res != KSI_OK) goto invalid;
+
+		res = readBlob(client->rdr, &rec->response, &rec->response_len);
+		if (res != KSI_OK) goto invalid;
+
+		res = CaptureRecord_setKey(ctx, rec);
+		if (res != KSI_OK) goto invalid;
+
+		client->records_len++;
+	}
+
+	client->buckets_len = 16;
+	while (client->buckets_len < client->records_len * 2) client->buckets_len *= 2;
+
+	client->buckets = KSI_malloc(client->buckets_len * sizeof(long));
+	if (client->buckets == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < client->buckets_len; i++) {
+		client->buckets[i] = -1;
+	}
+
+	/* Insert in reverse, so the chains are in the recorded order. */
+	for (i = client->records_len; i > 0; i--) {
+		CaptureRecord *rec = &client->records[i - 1];
+		size_t b = (size_t)(hashKey(rec->kind, rec->key, rec->key_len) & (client->buckets_len - 1));
+
+		rec->next = client->buckets[b];
+		client->buckets[b] = (long)(i - 1);
+	}
+
+	res = KSI_OK;
+	goto cleanup;
+
+invalid:
+
+	KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Truncated or corrupt capture file.");
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Finds the record for the request: the least served one of the recorded requests with the
+ * same key, the earliest one on a tie.
+ */
+static CaptureRecord *ReplayClient_find(KSI_ReplayClient *client, int kind, const unsigned char *key, unsigned key_len) {
+	CaptureRecord *best = NULL;
+	long i;
+
+	if (client->buckets_len == 0) return NULL;
+
+	i = client->buckets[hashKey(kind, key, key_len) & (client->buckets_len - 1)];
+	while (i >= 0) {
+		CaptureRecord *rec = &client->records[i];
+
+		if (rec->kind == kind && rec->key_len == key_len && (key_len == 0 || memcmp(rec->key, key, key_len) == 0)) {
+			if (best == NULL || rec->uses < best->uses) best = rec;
+		}
+		i = rec->next;
+	}
+
+	return best;
+}
+
+/* Replaces the request id of a response, the old one is freed. */
+static int replaceRequestId(KSI_CTX *ctx, void *resp, KSI_Integer *requestId,
+		int (*getId)(const void *, KSI_Integer **), int (*setId)(void *, KSI_Integer *)) {
+	int res;
+	KSI_Integer *oldId = NULL;
+	KSI_Integer *newId = NULL;
+
+	res = getId(resp, &oldId);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Integer_new(ctx, KSI_Integer_getUInt64(requestId), &newId);
+	if (res != KSI_OK) goto cleanup;
+
+	res = setId(resp, newId);
+	if (res != KSI_OK) goto cleanup;
+	newId = NULL;
+
+	KSI_Integer_free(oldId);
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Integer_free(newId);
+
+	return res;
+}
+
+/* The algorithm of the recorded HMAC, so the rewritten one has the same length. */
+static int getHmacAlgorithm(KSI_DataHash *hmac) {
+	int alg = KSI_getHashAlgorithmByName("default");
+
+	if (hmac != NULL) KSI_DataHash_getHashAlg(hmac, &alg);
+
+	return alg;
+}
+
+/* Rewrites a recorded aggregation response, see #ReplayClient_rewrite. */
+static int rewriteAggregationResponse(KSI_ReplayClient *client, const CaptureRecord *rec, KSI_Integer *requestId, unsigned char **raw, unsigned *raw_len) {
+	int res;
+	KSI_CTX *ctx = client->parent.ctx;
+	KSI_AggregationPdu *pdu = NULL;
+	KSI_AggregationResp *resp = NULL;
+	KSI_DataHash *hmac = NULL;
+	unsigned char *tmp = NULL;
+	unsigned tmp_len = 0;
+
+	/* A response that does not parse is served as recorded, to fail the same way. */
+	if (KSI_AggregationPdu_parse(ctx, rec->response, rec->response_len, &pdu) != KSI_OK) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = KSI_AggregationPdu_getResponse(pdu, &resp);
+	if (res != KSI_OK || resp == NULL) goto cleanup;
+
+	if (requestId != NULL) {
+		res = replaceRequestId(ctx, resp, requestId,
+				(int (*)(const void *, KSI_Integer **))KSI_AggregationResp_getRequestId,
+				(int (*)(void *, KSI_Integer *))KSI_AggregationResp_setRequestId);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	/* The HMAC is computed over the encoding kept from parsing, so the changed response is parsed again. */
+	res = KSI_AggregationPdu_serialize(pdu, &tmp, &tmp_len);
+	if (res != KSI_OK) goto cleanup;
+
+	KSI_AggregationPdu_free(pdu);
+	pdu = NULL;
+
+	res = KSI_AggregationPdu_parse(ctx, tmp, tmp_len, &pdu);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationPdu_getHmac(pdu, &hmac);
+	if (res != KSI_OK) goto cleanup;
+
+	if (client->parent.aggrPass != NULL) {
+		res = KSI_AggregationPdu_updateHmac(pdu, getHmacAlgorithm(hmac), client->parent.aggrPass);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_AggregationPdu_serialize(pdu, raw, raw_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_AggregationPdu_free(pdu);
+	KSI_free(tmp);
+
+	return res;
+}
+
+/* Rewrites a recorded extension response, see #ReplayClient_rewrite. */
+static int rewriteExtendResponse(KSI_ReplayClient *client, const CaptureRecord *rec, KSI_Integer *requestId, unsigned char **raw, unsigned *raw_len) {
+	int res;
+	KSI_CTX *ctx = client->parent.ctx;
+	KSI_ExtendPdu *pdu = NULL;
+	KSI_ExtendResp *resp = NULL;
+	KSI_DataHash *hmac = NULL;
+	unsigned char *tmp = NULL;
+	unsigned tmp_len = 0;
+
+	/* A response that does not parse is served as recorded, to fail the same way. */
+	if (KSI_ExtendPdu_parse(ctx, rec->response, rec->response_len, &pdu) != KSI_OK) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = KSI_ExtendPdu_getResponse(pdu, &resp);
+	if (res != KSI_OK || resp == NULL) goto cleanup;
+
+	if (requestId != NULL) {
+		res = replaceRequestId(ctx, resp, requestId,
+				(int (*)(const void *, KSI_Integer **))KSI_ExtendResp_getRequestId,
+				(int (*)(void *, KSI_Integer *))KSI_ExtendResp_setRequestId);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	/* The HMAC is computed over the encoding kept from parsing, so the changed response is parsed again. */
+	res = KSI_ExtendPdu_serialize(pdu, &tmp, &tmp_len);
+	if (res != KSI_OK) goto cleanup;
+
+	KSI_ExtendPdu_free(pdu);
+	pdu = NULL;
+
+	res = KSI_ExtendPdu_parse(ctx, tmp, tmp_len, &pdu);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendPdu_getHmac(pdu, &hmac);
+	if (res != KSI_OK) goto cleanup;
+
+	if (client->parent.extPass != NULL) {
+		res = KSI_ExtendPdu_updateHmac(pdu, getHmacAlgorithm(hmac), client->parent.extPass);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_ExtendPdu_serialize(pdu, raw, raw_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_ExtendPdu_free(pdu);
+	KSI_free(tmp);
+
+	return res;
+}
+
+/**
+ * Rewrites the recorded response for the request being replayed: the request id is replaced
+ * with the one of the request and the HMAC is recomputed with the credentials of the client.
+ * Error PDUs are left to be served as recorded, \c *raw is set to \c NULL for them.
+ */
+static int ReplayClient_rewrite(KSI_ReplayClient *client, const CaptureRecord *rec, KSI_Integer *requestId, unsigned char **raw, unsigned *raw_len) {
+	*raw = NULL;
+	*raw_len = 0;
+
+	switch (rec->kind) {
+		case CAPTURE_AGGREGATION:
+			return rewriteAggregationResponse(client, rec, requestId, raw, raw_len);
+		case CAPTURE_EXTEND:
+			return rewriteExtendResponse(client, rec, requestId, raw, raw_len);
+		default:
+			return KSI_OK;
+	}
+}
+
+static void ReplayHandleCtx_free(ReplayHandleCtx *rc) {
+	if (rc != NULL) {
+		KSI_free(rc->response);
+		KSI_free(rc);
+	}
+}
+
+static int replayRespond(KSI_RequestHandle *handle) {
+	int res;
+	ReplayHandleCtx *rc = handle->implCtx;
+
+	if (rc->record->status != KSI_OK) {
+		KSI_pushError(handle->ctx, res = rc->record->status, "Replaying a recorded failure.");
+		goto cleanup;
+	}
+
+	if (handle->response == NULL && rc->response != NULL) {
+		res = KSI_RequestHandle_adoptResponse(handle, rc->response, rc->response_len);
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+		rc->response = NULL;
+	} else if (handle->response == NULL) {
+		res = KSI_RequestHandle_setResponse(handle, rc->record->response, rc->record->response_len);
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int replayRead(KSI_RequestHandle *handle) {
+	int res;
+	ReplayHandleCtx *rc = NULL;
+	KSI_uint64_t now;
+
+	if (handle == NULL || handle->implCtx == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	rc = handle->implCtx;
+
+	now = KSI_NET_getTimeMs();
+	if (now < rc->readyAt) KSI_NET_sleepMs(rc->readyAt - now);
+
+	res = replayRespond(handle);
+
+cleanup:
+
+	return res;
+}
+
+static int replayPoll(KSI_RequestHandle *handle, unsigned timeoutMs, int *ready) {
+	int res;
+	ReplayHandleCtx *rc = NULL;
+	KSI_uint64_t now;
+
+	if (handle == NULL || handle->implCtx == NULL || ready == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	rc = handle->implCtx;
+
+	now = KSI_NET_getTimeMs();
+	if (now < rc->readyAt) {
+		KSI_NET_sleepMs(rc->readyAt - now < timeoutMs ? rc->readyAt - now : timeoutMs);
+		now = KSI_NET_getTimeMs();
+	}
+
+	*ready = now >= rc->readyAt;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int replayRequest(KSI_ReplayClient *client, int kind, const unsigned char *raw, unsigned raw_len,
+		const unsigned char *key, unsigned key_len, KSI_Integer *requestId, KSI_RequestHandle **handle) {
+	int res;
+	KSI_CTX *ctx = client->parent.ctx;
+	KSI_RequestHandle *tmp = NULL;
+	ReplayHandleCtx *rc = NULL;
+	CaptureRecord *rec = NULL;
+
+	rec = ReplayClient_find(client, kind, key, key_len);
+	if (rec == NULL) {
+		KSI_pushError(ctx, res = KSI_NETWORK_ERROR, "No recorded response for the request.");
+		goto cleanup;
+	}
+
+	res = KSI_RequestHandle_new(ctx, raw, raw_len, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	rc = KSI_new(ReplayHandleCtx);
+	if (rc == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	rc->record = rec;
+	rc->response = NULL;
+	rc->response_len = 0;
+
+	if (rec->status == KSI_OK) {
+		res = ReplayClient_rewrite(client, rec, requestId, &rc->response, &rc->response_len);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, "Unable to rewrite the recorded response.");
+			goto cleanup;
+		}
+	}
+
+	rec->uses++;
+	rc->readyAt = KSI_NET_getTimeMs() + (KSI_uint64_t)(rec->durationMs * client->timeScale);
+
+	tmp->client = &client->parent;
+	tmp->readResponse = replayRead;
+	tmp->pollResponse = replayPoll;
+	tmp->implCtx = rc;
+	tmp->implCtx_free = (void (*)(void *))ReplayHandleCtx_free;
+	rc = NULL;
+
+	*handle = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	ReplayHandleCtx_free(rc);
+	KSI_RequestHandle_free(tmp);
+
+	return res;
+}
+
+static int replaySignRequest(KSI_NetworkClient *c, KSI_AggregationReq *req, KSI_RequestHandle **handle) {
+	int res;
+	KSI_AggregationPdu *pdu = NULL;
+	KSI_Integer *requestId = NULL;
+	unsigned char *raw = NULL;
+	unsigned raw_len = 0;
+	unsigned char key[CAPTURE_KEY_MAX];
+	unsigned key_len = 0;
+
+	KSI_ERR_clearErrors(c->ctx);
+
+	if (req == NULL || handle == NULL) {
+		KSI_pushError(c->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AggregationReq_enclose(req, c->aggrUser, c->aggrPass, &pdu);
+	if (res != KSI_OK) {
+		KSI_pushError(c->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AggregationPdu_serialize(pdu, &raw, &raw_len);
+	if (res != KSI_OK) {
+		KSI_pushError(c->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = aggregationKey(req, key, &key_len);
+	if (res != KSI_OK) {
+		KSI_pushError(c->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AggregationReq_getRequestId(req, &requestId);
+	if (res != KSI_OK) {
+		KSI_pushError(c->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = replayRequest((KSI_ReplayClient *)c, CAPTURE_AGGREGATION, raw, raw_len, key, key_len, requestId, handle);
+
+cleanup:
+
+	KSI_AggregationPdu_setRequest(pdu, NULL);
+	KSI_AggregationPdu_free(pdu);
+	KSI_free(raw);
+
+	return res;
+}
+
+static int replayExtendRequest(KSI_NetworkClient *c, KSI_ExtendReq *req, KSI_RequestHandle **handle) {
+	int res;
+	KSI_ExtendPdu *pdu = NULL;
+	KSI_Integer *requestId = NULL;
+	unsigned char *raw = NULL;
+	unsigned raw_len = 0;
+	unsigned char key[CAPTURE_KEY_MAX];
+	unsigned key_len = 0;
+
+	KSI_ERR_clearErrors(c->ctx);
+
+	if (req == NULL || handle == NULL) {
+		KSI_pushError(c->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_ExtendReq_enclose(req, c->extUser, c->extPass, &pdu);
+	if (res != KSI_OK) {
+		KSI_pushError(c->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_ExtendPdu_serialize(pdu, &raw, &raw_len);
+	if (res != KSI_OK) {
+		KSI_pushError(c->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = extendKey(req, key, &key_len);
+	if (res != KSI_OK) {
+		KSI_pushError(c->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_ExtendReq_getRequestId(req, &requestId);
+	if (res != KSI_OK) {
+		KSI_pushError(c->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = replayRequest((KSI_ReplayClient *)c, CAPTURE_EXTEND, raw, raw_len, key, key_len, requestId, handle);
+
+cleanup:
+
+	KSI_ExtendPdu_setRequest(pdu, NULL);
+	KSI_ExtendPdu_free(pdu);
+	KSI_free(raw);
+
+	return res;
+}
+
+static int replayPublicationRequest(KSI_NetworkClient *c, KSI_RequestHandle **handle) {
+	KSI_ERR_clearErrors(c->ctx);
+
+	if (handle == NULL) {
+		KSI_pushError(c->ctx, KSI_INVALID_ARGUMENT, NULL);
+		return KSI_INVALID_ARGUMENT;
+	}
+
+	return replayRequest((KSI_ReplayClient *)c, CAPTURE_PUBLICATIONS_FILE, NULL, 0, NULL, 0, NULL, handle);
+}
+
+static void replayClient_free(KSI_ReplayClient *client) {
+	if (client != NULL) {
+		KSI_free(client->buckets);
+		KSI_free(client->records);
+		KSI_RDR_close(client->rdr);
+		KSI_free(client);
+	}
+}
+
+void KSI_ReplayClient_free(KSI_ReplayClient *client) {
+	KSI_NetworkClient_free((KSI_NetworkClient *)client);
+}
+
+int KSI_ReplayClient_new(KSI_CTX *ctx, const char *fileName, KSI_ReplayClient **client) {
+	int res;
+	KSI_ReplayClient *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (ctx == NULL || fileName == NULL || client == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_ReplayClient);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->rdr = NULL;
+	tmp->records = NULL;
+	tmp->records_len = 0;
+	tmp->buckets = NULL;
+	tmp->buckets_len = 0;
+	tmp->timeScale = 1.0;
+
+	res = KSI_NetworkClient_init(ctx, &tmp->parent);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	tmp->parent.sendSignRequest = replaySignRequest;
+	tmp->parent.sendExtendRequest = replayExtendRequest;
+	tmp->parent.sendPublicationRequest = replayPublicationRequest;
+	tmp->parent.implFree = (void (*)(void *))replayClient_free;
+
+	res = ReplayClient_load(tmp, fileName);
+	if (res != KSI_OK) goto cleanup;
+
+	*client = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_ReplayClient_free(tmp);
+
+	return res;
+}
+
+int KSI_ReplayClient_setTimeScale(KSI_ReplayClient *client, double scale) {
+	if (client == NULL || !(scale >= 0)) return KSI_INVALID_ARGUMENT;
+	client->timeScale = scale;
+	return KSI_OK;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef KSI_NET_REPLAY_H_
+#define KSI_NET_REPLAY_H_
+
+#include "net.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * A network client wrapping another network client and writing every request together
+	 * with its response and timing into a capture file, which can be served back by a
+	 * #KSI_ReplayClient.
+	 *
+	 * The capture file starts with the 8 byte signature "KSINREC1", followed by a record for
+	 * every completed request. All integers are big-endian:
+	 * - kind of the request (1 byte): 1 aggregation, 2 extension, 3 publications file;
+	 * - status of the transport (4 bytes), #KSI_OK if the response was received;
+	 * - time the request was sent at in milliseconds since the client was created (8 bytes);
+	 * - time it took to receive the response in milliseconds (4 bytes);
+	 * - length of the request (4 bytes) followed by the raw request PDU;
+	 * - length of the response (4 bytes) followed by the raw response PDU.
+	 */
+	typedef struct KSI_RecordingClient_st KSI_RecordingClient;
+
+	/**
+	 * A network client answering the requests with the responses from a capture file written
+	 * by #KSI_RecordingClient. The responses are looked up by what the request asks for: the
+	 * request hash and level of an aggregation request, the aggregation and publication time of
+	 * an extension request. The request id of the response is replaced with the one of the
+	 * request and the HMAC is recomputed with the credentials of the replaying client, so the
+	 * requests may be reproduced in any order, from any context. Equal requests are answered in
+	 * the recorded order, starting over when the recorded responses are used up.
+	 */
+	typedef struct KSI_ReplayClient_st KSI_ReplayClient;
+
+	/**
+	 * Creates a recording client around the given network client.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	inner		The client to forward the requests to, owned by the new client on success.
+	 * \param[in]	fileName	Name of the capture file, an existing file is overwritten.
+	 * \param[out]	client		Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The credentials and the service addresses are those of \c inner.
+	 */
+	int KSI_RecordingClient_new(KSI_CTX *ctx, KSI_NetworkClient *inner, const char *fileName, KSI_RecordingClient **client);
+
+	/**
+	 * Cleanup method for the recording client, closes the capture file and frees the wrapped client.
+	 * \param[in]	client		Recording client.
+	 */
+	void KSI_RecordingClient_free(KSI_RecordingClient *client);
+
+	/**
+	 * Creates a replaying client serving the responses from the given capture file.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	fileName	Name of the capture file.
+	 * \param[out]	client		Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The credentials the responses are authenticated with have to be set with
+	 * #KSI_NetworkClient_setAggregatorUser, #KSI_NetworkClient_setAggregatorPass and their
+	 * extender counterparts, they need not be the ones used for the recording.
+	 */
+	int KSI_ReplayClient_new(KSI_CTX *ctx, const char *fileName, KSI_ReplayClient **client);
+
+	/**
+	 * Cleanup method for the replaying client.
+	 * \param[in]	client		Replaying client.
+	 */
+	void KSI_ReplayClient_free(KSI_ReplayClient *client);
+
+	/**
+	 * Scales the recorded response times. By default the responses are delayed as long as
+	 * they took when recording.
+	 * \param[in]	client		Replaying client.
+	 * \param[in]	scale		Factor of the recorded response times, 0 to respond immediately.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_ReplayClient_setTimeScale(KSI_ReplayClient *client, double scale);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KSI_NET_REPLAY_H_ */
@@ -0,0 +1,512 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include <string.h>
+
+#include "net_socket.h"
+#include "net_impl.h"
+
+#ifndef _WIN32
+#  include <unistd.h>
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <sys/select.h>
+#  include <sys/un.h>
+#  include <netinet/in.h>
+#  define socket_error errno
+#  define socketInProgress(err) ((err) == EINPROGRESS)
+#else
+#  define close(soc) closesocket(soc)
+#  define socket_error WSAGetLastError()
+#  define socketInProgress(err) ((err) == WSAEWOULDBLOCK)
+#endif
+
+/* Delay before racing the next resolved address against the pending connection attempts (RFC 8305). */
+#define SOCKET_CONNECTION_ATTEMPT_DELAY_MS 250
+
+static int setNonBlocking(int sockfd, int nonBlocking) {
+#ifdef _WIN32
+	u_long mode = nonBlocking ? 1 : 0;
+	return ioctlsocket(sockfd, FIONBIO, &mode) == 0 ? KSI_OK : KSI_NETWORK_ERROR;
+#else
+	int flags = fcntl(sockfd, F_GETFL, 0);
+	if (flags < 0) return KSI_NETWORK_ERROR;
+	flags = nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+	return fcntl(sockfd, F_SETFL, flags) == 0 ? KSI_OK : KSI_NETWORK_ERROR;
+#endif
+}
+
+/**
+ * Resolves the host of the peer, unless the cached addresses are still valid.
+ */
+static int resolve(KSI_SocketPeer *peer, int dnsCacheTtlSeconds) {
+	int res;
+	int rc;
+	struct addrinfo hints;
+	struct addrinfo *addresses = NULL;
+	char port[16];
+
+	if (peer->addresses != NULL && time(NULL) < peer->addressesExpire) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_ADDRCONFIG;
+
+	KSI_snprintf(port, sizeof(port), "%u", peer->port);
+
+	rc = getaddrinfo(peer->host, port, &hints, &addresses);
+	if (rc != 0 || addresses == NULL) {
+		KSI_ERR_push(peer->ctx, KSI_NETWORK_ERROR, rc, __FILE__, __LINE__, "Unable to resolve host.");
+		res = KSI_NETWORK_ERROR;
+		goto cleanup;
+	}
+
+	if (peer->addresses != NULL) freeaddrinfo(peer->addresses);
+	peer->addresses = addresses;
+	peer->addressesExpire = time(NULL) + dnsCacheTtlSeconds;
+	addresses = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (addresses != NULL) freeaddrinfo(addresses);
+
+	return res;
+}
+
+/**
+ * Orders the addresses by alternating the address families, keeping the order of the
+ * resolver within each family (RFC 8305 section 4).
+ */
+static size_t orderAddresses(struct addrinfo *addresses, struct addrinfo **ordered, size_t ordered_size) {
+	size_t count = 0;
+	int firstFamily = addresses->ai_family;
+	struct addrinfo *first = addresses;
+	struct addrinfo *other = addresses;
+	int takeFirst = 1;
+
+	while (count < ordered_size && (first != NULL || other != NULL)) {
+		struct addrinfo **cur = takeFirst ? &first : &other;
+
+		while (*cur != NULL && (((*cur)->ai_family == firstFamily) != takeFirst)) {
+			*cur = (*cur)->ai_next;
+		}
+
+		if (*cur != NULL) {
+			ordered[count++] = *cur;
+			*cur = (*cur)->ai_next;
+		}
+
+		takeFirst = !takeFirst;
+	}
+
+	return count;
+}
+
+static void setSocketTimeouts(int fd, int seconds) {
+#ifdef _WIN32
+	DWORD transferTimeout = seconds * 1000;
+#else
+	struct timeval transferTimeout;
+	transferTimeout.tv_sec = seconds;
+	transferTimeout.tv_usec = 0;
+#endif
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (void*)&transferTimeout, sizeof(transferTimeout));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, (void*)&transferTimeout, sizeof(transferTimeout));
+}
+
+/**
+ * Connects to the Unix domain socket of a local gateway. There is nothing to resolve or
+ * to race, as the connection is established or refused immediately.
+ */
+static int connectLocal(KSI_SocketPeer *peer, int transferTimeoutSeconds, int *sockfd) {
+	int res;
+#ifndef _WIN32
+	struct sockaddr_un addr;
+	int fd = -1;
+
+	if (strlen(peer->host) >= sizeof(addr.sun_path)) {
+		KSI_pushError(peer->ctx, res = KSI_INVALID_ARGUMENT, "Unix domain socket path too long.");
+		goto cleanup;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, peer->host);
+
+	fd = (int)socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		KSI_ERR_push(peer->ctx, res = KSI_NETWORK_ERROR, socket_error, __FILE__, __LINE__, "Unable to create socket.");
+		goto cleanup;
+	}
+
+	setSocketTimeouts(fd, transferTimeoutSeconds);
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		KSI_ERR_push(peer->ctx, res = KSI_NETWORK_ERROR, socket_error, __FILE__, __LINE__, "Unable to connect.");
+		goto cleanup;
+	}
+
+	*sockfd = fd;
+	fd = -1;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (fd >= 0) close(fd);
+#else
+	KSI_pushError(peer->ctx, res = KSI_NETWORK_ERROR, "Unix domain sockets are not supported on this platform.");
+#endif
+
+	return res;
+}
+
+/**
+ * Connects to the first responding address. A new attempt is started whenever the previous
+ * one fails or has not succeeded within #SOCKET_CONNECTION_ATTEMPT_DELAY_MS, while the earlier
+ * attempts are kept running in parallel.
+ */
+static int connectAny(KSI_SocketPeer *peer, int connectTimeoutSeconds, int transferTimeoutSeconds, int *sockfd) {
+	int res;
+	struct addrinfo *ordered[32];
+	int socks[32];
+	size_t count;
+	size_t next = 0;
+	size_t pending = 0;
+	size_t i;
+	int winner = -1;
+	int lastError = 0;
+	KSI_uint64_t deadline;
+	KSI_uint64_t nextAttempt = 0;
+
+	count = orderAddresses(peer->addresses, ordered, sizeof(ordered) / sizeof(ordered[0]));
+	for (i = 0; i < count; i++) socks[i] = -1;
+
+	deadline = KSI_NET_getTimeMs() + (KSI_uint64_t)connectTimeoutSeconds * 1000;
+
+	while (winner < 0) {
+		fd_set wset;
+		fd_set eset;
+		struct timeval tv;
+		KSI_uint64_t now = KSI_NET_getTimeMs();
+		KSI_uint64_t wakeup;
+		int maxfd = -1;
+		int rc;
+
+		if (connectTimeoutSeconds > 0 && now >= deadline) {
+			KSI_pushError(peer->ctx, res = KSI_NETWORK_CONNECTION_TIMEOUT, "Unable to connect.");
+			goto cleanup;
+		}
+
+		/* Start the next attempt. */
+		if (next < count && (pending == 0 || now >= nextAttempt)) {
+			struct addrinfo *ai = ordered[next];
+			int fd;
+
+			fd = (int)socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+			if (fd >= 0) {
+				setSocketTimeouts(fd, transferTimeoutSeconds);
+
+				if (setNonBlocking(fd, 1) != KSI_OK) {
+					lastError = socket_error;
+					close(fd);
+				} else if (connect(fd, ai->ai_addr, (int)ai->ai_addrlen) == 0) {
+					socks[next] = fd;
+					winner = (int)next;
+				} else if (socketInProgress(socket_error)) {
+					socks[next] = fd;
+					pending++;
+				} else {
+					lastError = socket_error;
+					close(fd);
+				}
+			} else {
+				lastError = socket_error;
+			}
+
+			next++;
+			nextAttempt = now + SOCKET_CONNECTION_ATTEMPT_DELAY_MS;
+			continue;
+		}
+
+		if (pending == 0) {
+			KSI_ERR_push(peer->ctx, KSI_NETWORK_ERROR, lastError, __FILE__, __LINE__, "Unable to connect.");
+			res = KSI_NETWORK_ERROR;
+			goto cleanup;
+		}
+
+		/* Wait for any of the pending attempts, until the next attempt is due. */
+		FD_ZERO(&wset);
+		FD_ZERO(&eset);
+		for (i = 0; i < next; i++) {
+			if (socks[i] < 0) continue;
+			FD_SET(socks[i], &wset);
+			FD_SET(socks[i], &eset);
+			if (socks[i] > maxfd) maxfd = socks[i];
+		}
+
+		wakeup = next < count ? nextAttempt : deadline;
+		if (connectTimeoutSeconds > 0 && wakeup > deadline) wakeup = deadline;
+		if (next >= count && connectTimeoutSeconds == 0) wakeup = now + 1000;
+		wakeup = wakeup > now ? wakeup - now : 0;
+		tv.tv_sec = (long)(wakeup / 1000);
+		tv.tv_usec = (long)(wakeup % 1000) * 1000;
+
+		rc = select(maxfd + 1, NULL, &wset, &eset, &tv);
+		if (rc < 0) {
+#ifndef _WIN32
+			if (errno == EINTR) continue;
+#endif
+			KSI_pushError(peer->ctx, res = KSI_NETWORK_ERROR, "Unable to wait for the connection.");
+			goto cleanup;
+		}
+
+		for (i = 0; i < next && rc > 0; i++) {
+			int err = 0;
+			socklen_t err_len = sizeof(err);
+
+			if (socks[i] < 0 || (!FD_ISSET(socks[i], &wset) && !FD_ISSET(socks[i], &eset))) continue;
+
+			if (getsockopt(socks[i], SOL_SOCKET, SO_ERROR, (void *)&err, &err_len) != 0) err = socket_error;
+
+			if (err == 0) {
+				winner = (int)i;
+				break;
+			}
+
+			/* This attempt failed, start the next one without waiting. */
+			lastError = err;
+			close(socks[i]);
+			socks[i] = -1;
+			pending--;
+			nextAttempt = now;
+		}
+	}
+
+	res = setNonBlocking(socks[winner], 0);
+	if (res != KSI_OK) {
+		KSI_pushError(peer->ctx, res, "Unable to configure socket.");
+		goto cleanup;
+	}
+
+	*sockfd = socks[winner];
+	socks[winner] = -1;
+
+	res = KSI_OK;
+
+cleanup:
+
+	/* Abandon the attempts that lost the race. */
+	for (i = 0; i < next; i++) {
+		if (socks[i] >= 0) close(socks[i]);
+	}
+
+	return res;
+}
+
+int KSI_SocketPeer_init(KSI_CTX *ctx, KSI_SocketPeer *peer, const char *host, unsigned port) {
+	int res;
+	size_t len;
+
+	if (peer == NULL || host == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	peer->ctx = ctx;
+	peer->port = port;
+	peer->addresses = NULL;
+	peer->addressesExpire = 0;
+
+	len = strlen(host) + 1;
+	peer->host = KSI_malloc(len);
+	if (peer->host == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+	memcpy(peer->host, host, len);
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+void KSI_SocketPeer_clear(KSI_SocketPeer *peer) {
+	if (peer != NULL) {
+		if (peer->addresses != NULL) freeaddrinfo(peer->addresses);
+		peer->addresses = NULL;
+		KSI_free(peer->host);
+		peer->host = NULL;
+	}
+}
+
+int KSI_SocketPeer_connect(KSI_SocketPeer *peer, int connectTimeoutSeconds, int transferTimeoutSeconds, int dnsCacheTtlSeconds, KSI_RequestHandle *handle, int *sockfd) {
+	int res;
+
+	if (peer == NULL || sockfd == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (peer->port == 0) {
+		res = connectLocal(peer, transferTimeoutSeconds, sockfd);
+		if (res != KSI_OK) goto cleanup;
+	} else {
+		res = resolve(peer, dnsCacheTtlSeconds);
+		if (res != KSI_OK) goto cleanup;
+
+		KSI_RequestHandle_setPhaseTime(handle, KSI_NET_PHASE_RESOLVED, 0);
+
+		res = connectAny(peer, connectTimeoutSeconds, transferTimeoutSeconds, sockfd);
+		if (res != KSI_OK) {
+			/* The cached addresses may be stale, resolve them again next time. */
+			peer->addressesExpire = 0;
+			goto cleanup;
+		}
+	}
+
+	KSI_RequestHandle_setPhaseTime(handle, KSI_NET_PHASE_CONNECTED, 0);
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_Socket_waitReadable(int sockfd, KSI_uint64_t timeoutMs) {
+	fd_set readSet;
+	struct timeval tv;
+
+	FD_ZERO(&readSet);
+	FD_SET(sockfd, &readSet);
+	tv.tv_sec = (long)(timeoutMs / 1000);
+	tv.tv_usec = (long)(timeoutMs % 1000) * 1000;
+
+	return select(sockfd + 1, &readSet, NULL, NULL, &tv);
+}
+
+void KSI_Socket_close(int sockfd) {
+	if (sockfd >= 0) close(sockfd);
+}
+
+int KSI_SocketPeer_startConnect(KSI_SocketPeer *peer, int dnsCacheTtlSeconds, KSI_RequestHandle *handle, int *sockfd, int *inProgress) {
+	int res;
+	int fd = -1;
+	struct addrinfo *first[1] = {NULL};
+
+	if (peer == NULL || sockfd == NULL || inProgress == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	*inProgress = 0;
+
+	if (peer->port == 0) {
+		/* A local socket is connected or refused immediately. */
+		res = connectLocal(peer, 0, &fd);
+		if (res != KSI_OK) goto cleanup;
+	} else {
+		res = resolve(peer, dnsCacheTtlSeconds);
+		if (res != KSI_OK) goto cleanup;
+
+		KSI_RequestHandle_setPhaseTime(handle, KSI_NET_PHASE_RESOLVED, 0);
+
+		orderAddresses(peer->addresses, first, 1);
+
+		fd = (int)socket(first[0]->ai_family, first[0]->ai_socktype, first[0]->ai_protocol);
+		if (fd < 0) {
+			KSI_ERR_push(peer->ctx, res = KSI_NETWORK_ERROR, socket_error, __FILE__, __LINE__, "Unable to create socket.");
+			goto cleanup;
+		}
+	}
+
+	res = setNonBlocking(fd, 1);
+	if (res != KSI_OK) {
+		KSI_pushError(peer->ctx, res, "Unable to configure socket.");
+		goto cleanup;
+	}
+
+	if (peer->port != 0 && connect(fd, first[0]->ai_addr, (int)first[0]->ai_addrlen) != 0) {
+		if (!socketInProgress(socket_error)) {
+			KSI_ERR_push(peer->ctx, res = KSI_NETWORK_ERROR, socket_error, __FILE__, __LINE__, "Unable to connect.");
+			/* The cached addresses may be stale, resolve them again next time. */
+			peer->addressesExpire = 0;
+			goto cleanup;
+		}
+		*inProgress = 1;
+	}
+
+	if (!*inProgress) {
+		KSI_RequestHandle_setPhaseTime(handle, KSI_NET_PHASE_CONNECTED, 0);
+	}
+
+	*sockfd = fd;
+	fd = -1;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (fd >= 0) close(fd);
+
+	return res;
+}
+
+int KSI_SocketPeer_finishConnect(KSI_SocketPeer *peer, int sockfd, KSI_RequestHandle *handle) {
+	int res;
+	int err = 0;
+	socklen_t err_len = sizeof(err);
+
+	if (peer == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR, (void *)&err, &err_len) != 0) err = socket_error;
+	if (err != 0) {
+		KSI_ERR_push(peer->ctx, res = KSI_NETWORK_ERROR, err, __FILE__, __LINE__, "Unable to connect.");
+		peer->addressesExpire = 0;
+		goto cleanup;
+	}
+
+	KSI_RequestHandle_setPhaseTime(handle, KSI_NET_PHASE_CONNECTED, 0);
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_Socket_wouldBlock(void) {
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef NET_SOCKET_H_
+#define NET_SOCKET_H_
+
+#include <time.h>
+
+#include "internal.h"
+
+#ifndef _WIN32
+#  include <sys/types.h>
+#  include <sys/socket.h>
+#  include <netdb.h>
+#else
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+#endif
+
+#ifdef MSG_NOSIGNAL
+#  define KSI_SEND_FLAGS MSG_NOSIGNAL
+#else
+#  define KSI_SEND_FLAGS 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * A peer the transports open their own sockets to, together with the cached
+	 * result of resolving its name.
+	 */
+	typedef struct KSI_SocketPeer_st {
+		KSI_CTX *ctx;
+
+		/* Host name, or the path of a Unix domain socket if #port is 0. */
+		char *host;
+		unsigned port;
+
+		/* Cached result of the name resolution. */
+		struct addrinfo *addresses;
+		/* Time when the cached addresses expire. */
+		time_t addressesExpire;
+	} KSI_SocketPeer;
+
+	/**
+	 * Initializes the peer, the host name is copied.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	peer		Peer to be initialized.
+	 * \param[in]	host		Host name, or the path of a Unix domain socket if \c port is 0.
+	 * \param[in]	port		Port number.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SocketPeer_init(KSI_CTX *ctx, KSI_SocketPeer *peer, const char *host, unsigned port);
+
+	/**
+	 * Releases the resources held by the peer.
+	 * \param[in]	peer		Peer.
+	 */
+	void KSI_SocketPeer_clear(KSI_SocketPeer *peer);
+
+	/**
+	 * Opens a blocking socket to the peer. The host is resolved, unless the cached addresses
+	 * are still valid, and the resolved addresses are raced against each other (RFC 8305).
+	 * The name resolution and the connection setup are recorded as the phases of \c handle.
+	 * \param[in]	peer				Peer to connect to.
+	 * \param[in]	connectTimeoutSeconds	Time limit for connecting, 0 for no limit.
+	 * \param[in]	transferTimeoutSeconds	Send and receive timeout of the socket.
+	 * \param[in]	dnsCacheTtlSeconds	Time to keep the resolved addresses, 0 disables caching.
+	 * \param[in]	handle				Request the connection is opened for, may be \c NULL.
+	 * \param[out]	sockfd				The connected socket.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SocketPeer_connect(KSI_SocketPeer *peer, int connectTimeoutSeconds, int transferTimeoutSeconds, int dnsCacheTtlSeconds, KSI_RequestHandle *handle, int *sockfd);
+
+	/**
+	 * Starts connecting a non-blocking socket to the peer for an event driven transport. The host
+	 * name is still resolved synchronously, unless the cached addresses are valid, and only the
+	 * first address is tried.
+	 * \param[in]	peer				Peer to connect to.
+	 * \param[in]	dnsCacheTtlSeconds	Time to keep the resolved addresses, 0 disables caching.
+	 * \param[in]	handle				Request the connection is opened for, may be \c NULL.
+	 * \param[out]	sockfd				The non-blocking socket.
+	 * \param[out]	inProgress			Set if the connection is not established yet; the socket
+	 * 									becomes writable when it is, see #KSI_SocketPeer_finishConnect.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SocketPeer_startConnect(KSI_SocketPeer *peer, int dnsCacheTtlSeconds, KSI_RequestHandle *handle, int *sockfd, int *inProgress);
+
+	/**
+	 * Checks the outcome of a connection started by #KSI_SocketPeer_startConnect, after the socket
+	 * has become writable.
+	 * \param[in]	peer		Peer the socket was connected to.
+	 * \param[in]	sockfd		Socket.
+	 * \param[in]	handle		Request the connection is opened for, may be \c NULL.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SocketPeer_finishConnect(KSI_SocketPeer *peer, int sockfd, KSI_RequestHandle *handle);
+
+	/**
+	 * Tells whether the last failed operation on a non-blocking socket would have blocked.
+	 */
+	int KSI_Socket_wouldBlock(void);
+
+	/**
+	 * Waits until the socket becomes readable or the timeout expires.
+	 * \param[in]	sockfd		Socket.
+	 * \param[in]	timeoutMs	Maximum time to wait in milliseconds.
+	 * \return 1 if the socket is readable, 0 on timeout and -1 on error.
+	 */
+	int KSI_Socket_waitReadable(int sockfd, KSI_uint64_t timeoutMs);
+
+	/**
+	 * Closes the socket.
+	 * \param[in]	sockfd		Socket.
+	 */
+	void KSI_Socket_close(int sockfd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_SOCKET_H_ */
@@ -26,78 +26,909 @@
 #include "sys/types.h"
 #include "io.h"
 #include "tlv.h"
+#include "net_socket.h"
 
-#ifndef _WIN32
-#  include <unistd.h>
-#  include <sys/socket.h>
-#  include <netinet/in.h>
-#  include <netdb.h>
-#else
-#  include <winsock2.h>
-#  include <ws2tcpip.h>
-#  define close(soc) closesocket(soc)
-#endif
-
-typedef struct TcpClientCtx_st {
-	char *host;
-	unsigned port;
-} TcpClientCtx;
+/* Maximum number of times a request is resent after a reused connection was found closed by the peer. */
+#define TCP_MAX_ATTEMPTS 2
+
+/* Minimum free space of the receive buffer of an event driven connection before reading into it. */
+#define TCP_RECV_CHUNK 4096
+
+/* TLV header bits needed for finding the end of a response in the receive buffer. */
+#define TCP_TLV_MASK_TLV16 0x80u
+
+typedef struct TcpClientCtx_st TcpClientCtx;
+
+/**
+ * A persistent connection to a single host. Requests are written back-to-back and the
+ * responses are routed to the request handles by the request id.
+ */
+typedef struct TcpConnection_st {
+	KSI_CTX *ctx;
+	KSI_TcpClient *client;
+
+	/* Host and port, or the path of a Unix domain socket. */
+	KSI_SocketPeer peer;
+
+	int sockfd;
+	KSI_RDR *rdr;
+
+	/* Number of responses received over the current socket. */
+	size_t responseCount;
+	/* Number of requests written to the current socket. */
+	size_t requestCount;
+
+	/* Pending requests in the order of submission. */
+	TcpClientCtx *first;
+	TcpClientCtx *last;
+
+	/* Is the non-blocking connect still in progress (event driven client only). */
+	int isConnecting;
+	/* Socket events the host event loop has been asked to wait for. */
+	int watched;
+	/* The partially written request and the number of its bytes written. */
+	TcpClientCtx *writing;
+	size_t writeOffset;
+	/* Received bytes not yet forming a complete response (event driven client only). */
+	unsigned char *inbuf;
+	size_t inbuf_len;
+	size_t inbuf_size;
+	/* Arrival time of the first byte in the receive buffer. */
+	KSI_uint64_t firstByteAt;
+
+	struct TcpConnection_st *next;
+} TcpConnection;
+
+struct TcpClientCtx_st {
+	/* The connection used for the request, NULL if the request is no longer pending. */
+	TcpConnection *conn;
+	KSI_RequestHandle *handle;
+
+	/* Request id of the enclosed request. */
+	KSI_uint64_t requestId;
+	int hasRequestId;
+
+	/* Has the request been written to the current socket. */
+	int isSent;
+	/* Was the request written to a socket that had already been used before. */
+	int isReused;
+	int attempts;
+
+	/* Final status of a failed request. */
+	int status;
+
+	/* Time the request times out (see #KSI_NET_getTimeMs), 0 unless the client is event driven. */
+	KSI_uint64_t deadline;
+
+	TcpClientCtx *prev;
+	TcpClientCtx *next;
+};
+
+static void TcpConnection_unlink(TcpConnection *conn, TcpClientCtx *t) {
+	if (t->prev != NULL) {
+		t->prev->next = t->next;
+	} else {
+		conn->first = t->next;
+	}
+
+	if (t->next != NULL) {
+		t->next->prev = t->prev;
+	} else {
+		conn->last = t->prev;
+	}
+
+	t->prev = NULL;
+	t->next = NULL;
+	t->conn = NULL;
+}
+
+static void TcpConnection_append(TcpConnection *conn, TcpClientCtx *t) {
+	t->conn = conn;
+	t->prev = conn->last;
+	t->next = NULL;
+
+	if (conn->last != NULL) {
+		conn->last->next = t;
+	} else {
+		conn->first = t;
+	}
+	conn->last = t;
+}
+
+static void TcpConnection_close(TcpConnection *conn) {
+	if (conn != NULL) {
+		if (conn->watched) {
+			KSI_NetworkClient_watchSocket(&conn->client->parent, conn->sockfd, KSI_NET_EVENT_REMOVE);
+			conn->watched = 0;
+		}
+		KSI_RDR_close(conn->rdr);
+		conn->rdr = NULL;
+		KSI_Socket_close(conn->sockfd);
+		conn->sockfd = -1;
+		conn->responseCount = 0;
+		conn->requestCount = 0;
+		conn->isConnecting = 0;
+		conn->writing = NULL;
+		conn->writeOffset = 0;
+		conn->inbuf_len = 0;
+	}
+}
+
+static void TcpConnection_free(TcpConnection *conn) {
+	if (conn != NULL) {
+		/* Detach the requests still waiting for a response. */
+		while (conn->first != NULL) {
+			conn->first->status = KSI_NETWORK_ERROR;
+			TcpConnection_unlink(conn, conn->first);
+		}
+		TcpConnection_close(conn);
+		KSI_SocketPeer_clear(&conn->peer);
+		KSI_free(conn->inbuf);
+		KSI_free(conn);
+	}
+}
+
+static void TcpConnection_fail(TcpConnection *conn, int status);
+static int TcpConnection_drive(TcpConnection *conn);
 
 static void TcpClientCtx_free(TcpClientCtx *t) {
 	if (t != NULL) {
-		KSI_free(t->host);
+		TcpConnection *conn = t->conn;
+
+		/* A response to a dropped request will be discarded as unmatched. */
+		if (conn != NULL) {
+			TcpConnection_unlink(conn, t);
+
+			/* The rest of a partially written request can not be left out of the stream. */
+			if (conn->writing == t) {
+				TcpConnection_fail(conn, KSI_NETWORK_ERROR);
+				TcpConnection_drive(conn);
+			}
+		}
 		KSI_free(t);
 	}
 }
 
-static int setStringParam(char **param, const char *val) {
-	char *tmp = NULL;
-	int res = KSI_UNKNOWN_ERROR;
+static int setStringParam(char **param, const char *val) {
+	char *tmp = NULL;
+	int res = KSI_UNKNOWN_ERROR;
+
+
+	tmp = KSI_calloc(strlen(val) + 1, 1);
+	if (tmp == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	memcpy(tmp, val, strlen(val) + 1);
+
+	if (*param != NULL) {
+		KSI_free(*param);
+	}
+
+	*param = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+
+	return res;
+}
+
+static int setIntParam(int *param, int val) {
+	*param = val;
+	return KSI_OK;
+}
+
+static int getPduRequestId(KSI_CTX *ctx, const unsigned char *raw, unsigned raw_len, KSI_uint64_t *id, int *found) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_TLV *pdu = NULL;
+	KSI_LIST(KSI_TLV) *payloads = NULL;
+	KSI_Integer *reqId = NULL;
+	unsigned pduTag;
+	size_t i;
+	size_t j;
+
+	if (ctx == NULL || raw == NULL || id == NULL || found == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	*found = 0;
+
+	/* Parse in place, the buffer outlives the TLV. */
+	res = KSI_TLV_parseBlob2(ctx, (unsigned char *)raw, raw_len, 0, &pdu);
+	if (res != KSI_OK) goto cleanup;
+
+	pduTag = KSI_TLV_getTag(pdu);
+
+	res = KSI_TLV_cast(pdu, KSI_TLV_PAYLOAD_TLV);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TLV_getNestedList(pdu, &payloads);
+	if (res != KSI_OK) goto cleanup;
+
+	for (i = 0; i < KSI_TLVList_length(payloads); i++) {
+		KSI_TLV *payload = NULL;
+		KSI_LIST(KSI_TLV) *fields = NULL;
+
+		res = KSI_TLVList_elementAt(payloads, i, &payload);
+		if (res != KSI_OK) goto cleanup;
+
+		/* Only the request (0x201, 0x301) and response (0x202, 0x302) payloads carry the request id. */
+		if (KSI_TLV_getTag(payload) != pduTag + 1 && KSI_TLV_getTag(payload) != pduTag + 2) continue;
+
+		res = KSI_TLV_cast(payload, KSI_TLV_PAYLOAD_TLV);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_TLV_getNestedList(payload, &fields);
+		if (res != KSI_OK) goto cleanup;
+
+		for (j = 0; j < KSI_TLVList_length(fields); j++) {
+			KSI_TLV *field = NULL;
+
+			res = KSI_TLVList_elementAt(fields, j, &field);
+			if (res != KSI_OK) goto cleanup;
+
+			if (KSI_TLV_getTag(field) != 0x01) continue;
+
+			res = KSI_Integer_fromTlv(field, &reqId);
+			if (res != KSI_OK) goto cleanup;
+
+			*id = KSI_Integer_getUInt64(reqId);
+			*found = 1;
+
+			res = KSI_OK;
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Integer_free(reqId);
+	KSI_TLV_free(pdu);
+
+	return res;
+}
+
+/**
+ * Opens the socket for sending the request of the given handle, whose timing includes
+ * the name resolution and the connection setup.
+ */
+static int TcpConnection_open(TcpConnection *conn, KSI_TcpClient *client, KSI_RequestHandle *handle) {
+	int res;
+	int sockfd = -1;
+
+	res = KSI_SocketPeer_connect(&conn->peer, client->transferTimeoutSeconds, client->transferTimeoutSeconds, client->dnsCacheTtlSeconds, handle, &sockfd);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_RDR_fromSocket(conn->ctx, sockfd, &conn->rdr);
+	if (res != KSI_OK) {
+		KSI_pushError(conn->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	KSI_LOG_debug(conn->ctx, "Tcp: Connected to %s:%u", conn->peer.host, conn->peer.port);
+
+	conn->sockfd = sockfd;
+	sockfd = -1;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Socket_close(sockfd);
+
+	return res;
+}
+
+/**
+ * Closes the socket after an error. Requests that were written to a previously used
+ * socket are resent over a new one, as the peer may have closed the idle connection; all
+ * other requests written to the socket are failed with the given status.
+ */
+static void TcpConnection_fail(TcpConnection *conn, int status) {
+	TcpClientCtx *t = conn->first;
+
+	while (t != NULL) {
+		TcpClientCtx *next = t->next;
+
+		if (t->isSent) {
+			if (t->isReused && t->attempts < TCP_MAX_ATTEMPTS) {
+				t->isSent = 0;
+			} else {
+				t->status = status;
+				TcpConnection_unlink(conn, t);
+				KSI_NetworkClient_requestDone(&conn->client->parent, t->handle);
+			}
+		}
+
+		t = next;
+	}
+
+	TcpConnection_close(conn);
+}
+
+static int TcpConnection_flush(TcpConnection *conn, KSI_TcpClient *client) {
+	int res;
+	TcpClientCtx *t = NULL;
+
+	for (t = conn->first; t != NULL; t = t->next) {
+		KSI_RequestHandle *handle = t->handle;
+		size_t count;
+
+		if (t->isSent) continue;
+
+		t->isSent = 1;
+		t->isReused = 0;
+		t->attempts++;
+
+		if (conn->sockfd < 0) {
+			res = TcpConnection_open(conn, client, handle);
+			if (res != KSI_OK) goto cleanup;
+		}
+
+		t->isReused = conn->responseCount > 0;
+
+		KSI_LOG_logBlob(conn->ctx, KSI_LOG_DEBUG, "Sending request", handle->request, handle->request_length);
+		count = 0;
+		while (count < handle->request_length) {
+			int c;
+			c = send(conn->sockfd, (char*)handle->request + count, handle->request_length - count, KSI_SEND_FLAGS);
+			if (c < 0) {
+				KSI_pushError(conn->ctx, res = KSI_NETWORK_ERROR, "Unable to write to socket.");
+				goto cleanup;
+			}
+			count += c;
+		}
+
+		KSI_RequestHandle_setPhaseTime(handle, KSI_NET_PHASE_REQUEST_SENT, 0);
+
+		conn->requestCount++;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int deliverResponse(TcpClientCtx *t, unsigned char **raw, size_t raw_len, int shared, KSI_uint64_t firstByteAt) {
+	int res;
+	KSI_RequestHandle *handle = t->handle;
+	TcpConnection *conn = t->conn;
+
+	TcpConnection_unlink(conn, t);
+
+	KSI_RequestHandle_setPhaseTime(handle, KSI_NET_PHASE_FIRST_BYTE, firstByteAt);
+	KSI_RequestHandle_setPhaseTime(handle, KSI_NET_PHASE_RESPONSE_DONE, 0);
+
+	/* The buffer is handed over to the handle, unless it is delivered to several handles. */
+	if (shared) {
+		res = KSI_RequestHandle_setResponse(handle, *raw, (unsigned)raw_len);
+	} else {
+		res = KSI_RequestHandle_adoptResponse(handle, *raw, (unsigned)raw_len);
+		if (res == KSI_OK) *raw = NULL;
+	}
+	if (res != KSI_OK) t->status = res;
+
+	KSI_NetworkClient_requestDone(&conn->client->parent, handle);
+
+	return res;
+}
+
+/**
+ * Delivers a received response to the request it answers. The buffer is taken over by the
+ * handle of the request, if possible.
+ */
+static int TcpConnection_dispatch(TcpConnection *conn, unsigned char **raw, size_t count, KSI_uint64_t firstByteAt) {
+	int res;
+	KSI_uint64_t id = 0;
+	int hasId = 0;
+	TcpClientCtx *t = NULL;
+
+	conn->responseCount++;
+
+	res = getPduRequestId(conn->ctx, *raw, (unsigned)count, &id, &hasId);
+	if (res != KSI_OK) {
+		KSI_pushError(conn->ctx, res, "Unable to parse response from socket.");
+		goto cleanup;
+	}
+
+	if (!hasId) {
+		/* A response without a request id (an error PDU) concerns the whole connection. */
+		t = conn->first;
+		while (t != NULL) {
+			TcpClientCtx *next = t->next;
+			if (t->isSent) deliverResponse(t, raw, count, 1, firstByteAt);
+			t = next;
+		}
+	} else {
+		for (t = conn->first; t != NULL; t = t->next) {
+			if (t->isSent && t->hasRequestId && t->requestId == id) break;
+		}
+
+		/* Requests without an id are answered in order. */
+		if (t == NULL) {
+			for (t = conn->first; t != NULL; t = t->next) {
+				if (t->isSent && !t->hasRequestId) break;
+			}
+		}
+
+		if (t != NULL) {
+			deliverResponse(t, raw, count, 0, firstByteAt);
+		} else {
+			KSI_LOG_warn(conn->ctx, "Tcp: Discarding response with unmatched request id %llu.", (unsigned long long)id);
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int TcpConnection_readNext(TcpConnection *conn) {
+	int res;
+	size_t count = 0;
+	unsigned char *raw = NULL;
+	KSI_uint64_t firstByteAt;
+	char peek;
+
+	/* Wait for the next response without consuming it, to time the arrival of its first byte. */
+	if (!KSI_RDR_isBuffered(conn->rdr) && recv(conn->sockfd, &peek, 1, MSG_PEEK) < 0) {
+		KSI_pushError(conn->ctx, res = KSI_NETWORK_ERROR, "Unable to read from socket.");
+		goto cleanup;
+	}
+	firstByteAt = KSI_NET_getTimeUs();
+
+	res = KSI_TLV_readTlvAlloc(conn->rdr, &raw, &count);
+	if (res != KSI_OK) {
+		KSI_pushError(conn->ctx, res, "Unable to read TLV from socket.");
+		goto cleanup;
+	}
+
+	if (raw == NULL) {
+		KSI_pushError(conn->ctx, res = KSI_NETWORK_ERROR, "Connection closed by peer.");
+		goto cleanup;
+	}
+
+	if(count > UINT_MAX){
+		KSI_pushError(conn->ctx, res = KSI_BUFFER_OVERFLOW, "Too much data read from socket.");
+		goto cleanup;
+	}
+
+	res = TcpConnection_dispatch(conn, &raw, count, firstByteAt);
+
+cleanup:
+
+	KSI_free(raw);
+
+	return res;
+}
+
+/**
+ * Fails the requests not yet written to a socket, when no socket can be opened for them.
+ */
+static void TcpConnection_failUnsent(TcpConnection *conn, int status) {
+	TcpClientCtx *t = conn->first;
+
+	while (t != NULL) {
+		TcpClientCtx *next = t->next;
+
+		if (!t->isSent) {
+			t->status = status;
+			TcpConnection_unlink(conn, t);
+			KSI_NetworkClient_requestDone(&conn->client->parent, t->handle);
+		}
+
+		t = next;
+	}
+}
+
+/**
+ * Tells the host event loop to wait for the connection to be established, for the socket
+ * to accept the queued requests and for the responses.
+ */
+static int TcpConnection_updateWatch(TcpConnection *conn) {
+	int events = 0;
+	TcpClientCtx *t = NULL;
+
+	if (conn->sockfd < 0) return KSI_OK;
+
+	if (conn->isConnecting) {
+		events = KSI_NET_EVENT_WRITE;
+	} else {
+		/* Reading also notices the peer closing an idle connection. */
+		events = KSI_NET_EVENT_READ;
+		for (t = conn->first; t != NULL; t = t->next) {
+			if (!t->isSent) {
+				events |= KSI_NET_EVENT_WRITE;
+				break;
+			}
+		}
+	}
+
+	if (events == conn->watched) return KSI_OK;
+
+	conn->watched = events;
+	return KSI_NetworkClient_watchSocket(&conn->client->parent, conn->sockfd, events);
+}
+
+/**
+ * Starts opening a non-blocking socket for the request of the given handle.
+ */
+static int TcpConnection_start(TcpConnection *conn, KSI_RequestHandle *handle) {
+	int res;
+	int sockfd = -1;
+	int inProgress = 0;
+
+	res = KSI_SocketPeer_startConnect(&conn->peer, conn->client->dnsCacheTtlSeconds, handle, &sockfd, &inProgress);
+	if (res != KSI_OK) goto cleanup;
+
+	KSI_LOG_debug(conn->ctx, "Tcp: Connecting to %s:%u", conn->peer.host, conn->peer.port);
+
+	conn->sockfd = sockfd;
+	conn->isConnecting = inProgress;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Opens a socket for the queued requests of an event driven client and updates the events
+ * the host event loop waits for.
+ */
+static int TcpConnection_drive(TcpConnection *conn) {
+	int res;
+
+	if (conn->sockfd < 0 && conn->first != NULL) {
+		TcpClientCtx *t = NULL;
+
+		for (t = conn->first; t != NULL && t->isSent; t = t->next);
+
+		if (t != NULL) {
+			res = TcpConnection_start(conn, t->handle);
+			if (res != KSI_OK) TcpConnection_failUnsent(conn, res);
+		}
+	}
+
+	res = TcpConnection_updateWatch(conn);
+
+	return res;
+}
+
+/**
+ * Writes as much of the queued requests as the non-blocking socket accepts.
+ */
+static int TcpConnection_write(TcpConnection *conn) {
+	int res;
+	TcpClientCtx *t = NULL;
+
+	for (t = conn->first; t != NULL; t = t->next) {
+		KSI_RequestHandle *handle = t->handle;
+
+		if (t->isSent) continue;
+
+		if (conn->writing != t) {
+			conn->writing = t;
+			conn->writeOffset = 0;
+			t->isReused = conn->responseCount > 0;
+			t->attempts++;
+			KSI_LOG_logBlob(conn->ctx, KSI_LOG_DEBUG, "Sending request", handle->request, handle->request_length);
+		}
+
+		while (conn->writeOffset < handle->request_length) {
+			int c;
+			c = send(conn->sockfd, (char*)handle->request + conn->writeOffset, handle->request_length - conn->writeOffset, KSI_SEND_FLAGS);
+			if (c < 0) {
+				if (KSI_Socket_wouldBlock()) {
+					res = KSI_OK;
+					goto cleanup;
+				}
+				KSI_pushError(conn->ctx, res = KSI_NETWORK_ERROR, "Unable to write to socket.");
+				goto cleanup;
+			}
+			conn->writeOffset += c;
+		}
+
+		conn->writing = NULL;
+		conn->writeOffset = 0;
+		t->isSent = 1;
+
+		KSI_RequestHandle_setPhaseTime(handle, KSI_NET_PHASE_REQUEST_SENT, 0);
+
+		conn->requestCount++;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Reads what the non-blocking socket has to offer and delivers the complete responses.
+ */
+static int TcpConnection_receive(TcpConnection *conn) {
+	int res;
+	unsigned char *raw = NULL;
+
+	for (;;) {
+		int c;
+
+		if (conn->inbuf_size - conn->inbuf_len < TCP_RECV_CHUNK) {
+			size_t size = conn->inbuf_size > 0 ? conn->inbuf_size * 2 : 2 * TCP_RECV_CHUNK;
+			unsigned char *tmp = KSI_malloc(size);
+			if (tmp == NULL) {
+				KSI_pushError(conn->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+				goto cleanup;
+			}
+			if (conn->inbuf_len > 0) memcpy(tmp, conn->inbuf, conn->inbuf_len);
+			KSI_free(conn->inbuf);
+			conn->inbuf = tmp;
+			conn->inbuf_size = size;
+		}
+
+		c = recv(conn->sockfd, (char *)conn->inbuf + conn->inbuf_len, conn->inbuf_size - conn->inbuf_len, 0);
+		if (c < 0) {
+			if (KSI_Socket_wouldBlock()) break;
+			KSI_pushError(conn->ctx, res = KSI_NETWORK_ERROR, "Unable to read from socket.");
+			goto cleanup;
+		}
+
+		if (c == 0) {
+			KSI_pushError(conn->ctx, res = KSI_NETWORK_ERROR, "Connection closed by peer.");
+			goto cleanup;
+		}
+
+		if (conn->inbuf_len == 0) conn->firstByteAt = KSI_NET_getTimeUs();
+		conn->inbuf_len += c;
+
+		/* Deliver every complete response in the buffer. */
+		while (conn->inbuf_len >= 2) {
+			size_t hdr_len = 2;
+			size_t len = conn->inbuf[1];
+			KSI_uint64_t firstByteAt = conn->firstByteAt;
+
+			if (conn->inbuf[0] & TCP_TLV_MASK_TLV16) {
+				if (conn->inbuf_len < 4) break;
+				hdr_len = 4;
+				len = ((size_t)conn->inbuf[2] << 8) | conn->inbuf[3];
+			}
+			len += hdr_len;
+
+			if (conn->inbuf_len < len) break;
+
+			/* Take the response out of the buffer, delivering it may close the connection. */
+			raw = KSI_malloc(len);
+			if (raw == NULL) {
+				KSI_pushError(conn->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+				goto cleanup;
+			}
+			memcpy(raw, conn->inbuf, len);
+			conn->inbuf_len -= len;
+			memmove(conn->inbuf, conn->inbuf + len, conn->inbuf_len);
+			if (conn->inbuf_len > 0) conn->firstByteAt = KSI_NET_getTimeUs();
+
+			res = TcpConnection_dispatch(conn, &raw, len, firstByteAt);
+			if (res != KSI_OK) goto cleanup;
+
+			KSI_free(raw);
+			raw = NULL;
+
+			if (conn->sockfd < 0) {
+				res = KSI_OK;
+				goto cleanup;
+			}
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(raw);
+
+	return res;
+}
+
+/**
+ * Handles the readiness of the socket of an event driven connection.
+ */
+static int TcpConnection_process(TcpConnection *conn, int events) {
+	int res;
+
+	if (conn->isConnecting) {
+		TcpClientCtx *t = conn->first;
+
+		if (!(events & KSI_NET_EVENT_WRITE)) {
+			res = KSI_OK;
+			goto cleanup;
+		}
+
+		while (t != NULL && t->isSent) t = t->next;
+
+		res = KSI_SocketPeer_finishConnect(&conn->peer, conn->sockfd, t != NULL ? t->handle : NULL);
+		if (res != KSI_OK) {
+			TcpConnection_close(conn);
+			TcpConnection_failUnsent(conn, res);
+			goto drive;
+		}
+
+		KSI_LOG_debug(conn->ctx, "Tcp: Connected to %s:%u", conn->peer.host, conn->peer.port);
+		conn->isConnecting = 0;
+	}
+
+	if (events & KSI_NET_EVENT_WRITE) {
+		res = TcpConnection_write(conn);
+		if (res != KSI_OK) {
+			TcpConnection_fail(conn, res);
+			goto drive;
+		}
+	}
+
+	if ((events & KSI_NET_EVENT_READ) && conn->sockfd >= 0) {
+		res = TcpConnection_receive(conn);
+		if (res != KSI_OK) {
+			TcpConnection_fail(conn, res);
+		}
+	}
+
+drive:
+
+	res = TcpConnection_drive(conn);
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Fails the requests of the connection that have timed out. The requests already written to
+ * the socket fail with them, as the peer is not answering.
+ */
+static int TcpConnection_expire(TcpConnection *conn, KSI_uint64_t now) {
+	int res;
+	TcpClientCtx *t = NULL;
+	int status;
 
+	for (t = conn->first; t != NULL; t = t->next) {
+		if (t->deadline != 0 && t->deadline <= now) break;
+	}
 
-	tmp = KSI_calloc(strlen(val) + 1, 1);
-	if (tmp == NULL) {
-		res = KSI_INVALID_ARGUMENT;
+	if (t == NULL) {
+		res = KSI_OK;
 		goto cleanup;
 	}
-	memcpy(tmp, val, strlen(val) + 1);
 
-	if (*param != NULL) {
-		KSI_free(*param);
+	status = conn->isConnecting ? KSI_NETWORK_CONNECTION_TIMEOUT : KSI_NETWORK_RECIEVE_TIMEOUT;
+	KSI_LOG_debug(conn->ctx, "Tcp: Request to %s:%u timed out.", conn->peer.host, conn->peer.port);
+
+	TcpConnection_close(conn);
+
+	t = conn->first;
+	while (t != NULL) {
+		TcpClientCtx *next = t->next;
+
+		if (t->isSent || (t->deadline != 0 && t->deadline <= now)) {
+			t->status = status;
+			TcpConnection_unlink(conn, t);
+			KSI_NetworkClient_requestDone(&conn->client->parent, t->handle);
+		}
+
+		t = next;
 	}
 
-	*param = tmp;
-	tmp = NULL;
+	res = TcpConnection_drive(conn);
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Arms the timer of the host event loop for the earliest request deadline.
+ */
+static int TcpClient_updateTimer(KSI_TcpClient *client) {
+	TcpConnection *conn = NULL;
+	KSI_uint64_t next = 0;
+	KSI_uint64_t now;
+
+	for (conn = client->connections; conn != NULL; conn = conn->next) {
+		TcpClientCtx *t = NULL;
+		for (t = conn->first; t != NULL; t = t->next) {
+			if (t->deadline != 0 && (next == 0 || t->deadline < next)) next = t->deadline;
+		}
+	}
+
+	if (next == client->timerDeadline) return KSI_OK;
+	client->timerDeadline = next;
+
+	if (next == 0) return KSI_NetworkClient_setTimer(&client->parent, -1);
+
+	now = KSI_NET_getTimeMs();
+	return KSI_NetworkClient_setTimer(&client->parent, next > now ? (long)(next - now) : 0);
+}
+
+static int tcpSetEventCallbacks(KSI_NetworkClient *c) {
+	int res;
+	KSI_TcpClient *client = (KSI_TcpClient *)c;
+	TcpConnection *conn = NULL;
+
+	/* The sockets opened so far are blocking. */
+	for (conn = client->connections; conn != NULL; conn = conn->next) {
+		if (conn->sockfd >= 0 || conn->first != NULL) {
+			KSI_pushError(c->ctx, res = KSI_INVALID_ARGUMENT, "Event callbacks must be set before sending any requests.");
+			goto cleanup;
+		}
+	}
 
 	res = KSI_OK;
 
 cleanup:
 
-	KSI_free(tmp);
+	return res;
+}
+
+static int tcpOnSocketEvent(KSI_NetworkClient *c, int fd, int events) {
+	int res;
+	KSI_TcpClient *client = (KSI_TcpClient *)c;
+	TcpConnection *conn = NULL;
+
+	for (conn = client->connections; conn != NULL; conn = conn->next) {
+		if (conn->sockfd >= 0 && conn->sockfd == fd) break;
+	}
+
+	/* The socket may have been closed after the host event loop had polled it. */
+	if (conn != NULL) {
+		res = TcpConnection_process(conn, events);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = TcpClient_updateTimer(client);
+
+cleanup:
 
 	return res;
 }
 
-static int setIntParam(int *param, int val) {
-	*param = val;
-	return KSI_OK;
+static int tcpOnTimeout(KSI_NetworkClient *c) {
+	int res;
+	KSI_TcpClient *client = (KSI_TcpClient *)c;
+	TcpConnection *conn = NULL;
+	KSI_uint64_t now = KSI_NET_getTimeMs();
+
+	/* The timer has fired and is no longer armed. */
+	client->timerDeadline = 0;
+
+	for (conn = client->connections; conn != NULL; conn = conn->next) {
+		res = TcpConnection_expire(conn, now);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = TcpClient_updateTimer(client);
+
+cleanup:
+
+	return res;
 }
 
 static int readResponse(KSI_RequestHandle *handle) {
 	int res;
 	TcpClientCtx *tcp = NULL;
 	KSI_TcpClient *client = NULL;
-	int sockfd = -1;
-    struct sockaddr_in serv_addr;
-    struct hostent *server = NULL;
-    size_t count;
-    unsigned char buffer[0xffff + 4];
-    KSI_RDR *rdr = NULL;
-#ifdef _WIN32
-	DWORD transferTimeout = 0;
-#else
-	struct timeval  transferTimeout;
-#endif
+	TcpConnection *conn = NULL;
 
 	if (handle == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -109,85 +940,151 @@ static int readResponse(KSI_RequestHandle *handle) {
 	tcp = handle->implCtx;
 	client = (KSI_TcpClient*)handle->client;
 
-    sockfd = (int)socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0) {
-    	KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, "Unable to open socket.");
-    	goto cleanup;
-    }
-#ifdef _WIN32
-	transferTimeout = client->transferTimeoutSeconds*1000;
-#else
-	transferTimeout.tv_sec = client->transferTimeoutSeconds;
-    transferTimeout.tv_usec = 0;
-
-#endif
-
-	/*Set socket options*/
-	setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, (void*)&transferTimeout, sizeof(transferTimeout));
-	setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, (void*)&transferTimeout, sizeof(transferTimeout));
-
-    server = gethostbyname(tcp->host);
-    if (server == NULL) {
-    	KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, "Unable to open host.");
-    	goto cleanup;
-    }
-
-	memset((char *) &serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-
-	memmove((char *)&serv_addr.sin_addr.s_addr, (char *)server->h_addr, server->h_length);
-
-    serv_addr.sin_port = htons(tcp->port);
-
-    if ((res = connect(sockfd, (struct sockaddr *) &serv_addr, sizeof(serv_addr))) < 0) {
-    	KSI_ERR_push(handle->ctx, KSI_NETWORK_ERROR, res, __FILE__, __LINE__, "Unable to connect.");
-		res = KSI_NETWORK_ERROR;
-    	goto cleanup;
-    }
-
-    KSI_LOG_logBlob(handle->ctx, KSI_LOG_DEBUG, "Sending request", handle->request, handle->request_length);
-    count = 0;
-    while (count < handle->request_length) {
-    	int c;
-		c = send(sockfd, (char*)handle->request, handle->request_length, 0);
-		if (c < 0) {
-			KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, "Unable to write to socket.");
-			goto cleanup;
+	/* The host event loop is responsible for the input and output. */
+	if (handle->response == NULL && tcp->conn != NULL && KSI_NetworkClient_isEventDriven(&client->parent)) {
+		res = KSI_ASYNC_NOT_FINISHED;
+		goto cleanup;
+	}
+
+	/* Write all the queued requests and read the responses until this one is answered. */
+	while (handle->response == NULL && tcp->conn != NULL) {
+		conn = tcp->conn;
+
+		res = TcpConnection_flush(conn, client);
+		if (res == KSI_OK) {
+			res = TcpConnection_readNext(conn);
 		}
-		count += c;
-    }
 
-    res = KSI_RDR_fromSocket(handle->ctx, sockfd, &rdr);
-	if (res != KSI_OK) {
-		KSI_pushError(handle->ctx, res, NULL);
-		goto cleanup;
+		if (res != KSI_OK) {
+			TcpConnection_fail(conn, res);
+		}
 	}
 
-    res = KSI_TLV_readTlv(rdr, buffer, sizeof(buffer), &count);
-    if (res != KSI_OK || count == 0){
-		KSI_pushError(handle->ctx, res = KSI_INVALID_ARGUMENT, "Unable to read TLV from socket.");
+	if (handle->response == NULL) {
+		res = tcp->status != KSI_OK ? tcp->status : KSI_NETWORK_ERROR;
+		KSI_pushError(handle->ctx, res, "Unable to receive response.");
 		goto cleanup;
 	}
 
-	if(count > UINT_MAX){
-		KSI_pushError(handle->ctx, res = KSI_BUFFER_OVERFLOW, "Too much data read from socket.");
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Waits for the response until it is received or the timeout expires. Responses to
+ * other requests on the same connection are delivered as they arrive.
+ */
+static int pollResponse(KSI_RequestHandle *handle, unsigned timeoutMs, int *ready) {
+	int res;
+	TcpClientCtx *tcp = NULL;
+	KSI_TcpClient *client = NULL;
+	TcpConnection *conn = NULL;
+	KSI_uint64_t deadline;
+
+	if (handle == NULL || ready == NULL) {
+		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
-	handle->response = KSI_malloc(count);
-	if (handle->response == NULL) {
-		KSI_pushError(handle->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+	tcp = handle->implCtx;
+	client = (KSI_TcpClient*)handle->client;
+	deadline = KSI_NET_getTimeMs() + timeoutMs;
+
+	while (handle->response == NULL && tcp->conn != NULL && !KSI_NetworkClient_isEventDriven(&client->parent)) {
+		KSI_uint64_t now;
+		int c;
+
+		conn = tcp->conn;
+
+		res = TcpConnection_flush(conn, client);
+		if (res != KSI_OK) {
+			TcpConnection_fail(conn, res);
+			continue;
+		}
+
+		/* Responses received together with an earlier one are already in the read-ahead buffer. */
+		if (KSI_RDR_isBuffered(conn->rdr)) {
+			c = 1;
+		} else {
+			now = KSI_NET_getTimeMs();
+			if (now >= deadline) break;
+
+			c = KSI_Socket_waitReadable(conn->sockfd, deadline - now);
+			if (c == 0) break;
+		}
+
+		res = c < 0 ? KSI_NETWORK_ERROR : TcpConnection_readNext(conn);
+		if (res != KSI_OK) {
+			TcpConnection_fail(conn, res);
+		}
+	}
+
+	/* A failed request is ready as well, reading it reports the error. */
+	*ready = handle->response != NULL || tcp->conn == NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int getConnection(KSI_TcpClient *client, const char *host, unsigned port, TcpConnection **conn) {
+	int res;
+	TcpConnection *tmp = NULL;
+
+	for (tmp = client->connections; tmp != NULL; tmp = tmp->next) {
+		if (tmp->peer.port == port && !strcmp(tmp->peer.host, host)) {
+			*conn = tmp;
+			KSI_nofree(tmp);
+			res = KSI_OK;
+			goto cleanup;
+		}
+	}
+
+	tmp = KSI_new(TcpConnection);
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
 		goto cleanup;
 	}
-	memcpy(handle->response, buffer, count);
-	handle->response_length = (unsigned)count;
+
+	tmp->ctx = client->parent.ctx;
+	tmp->client = client;
+	tmp->peer.host = NULL;
+	tmp->peer.addresses = NULL;
+	tmp->sockfd = -1;
+	tmp->rdr = NULL;
+	tmp->responseCount = 0;
+	tmp->requestCount = 0;
+	tmp->first = NULL;
+	tmp->last = NULL;
+	tmp->isConnecting = 0;
+	tmp->watched = 0;
+	tmp->writing = NULL;
+	tmp->writeOffset = 0;
+	tmp->inbuf = NULL;
+	tmp->inbuf_len = 0;
+	tmp->inbuf_size = 0;
+	tmp->firstByteAt = 0;
+	tmp->next = NULL;
+
+	res = KSI_SocketPeer_init(tmp->ctx, &tmp->peer, host, port);
+	if (res != KSI_OK) goto cleanup;
+
+	tmp->next = client->connections;
+	client->connections = tmp;
+
+	*conn = tmp;
+	tmp = NULL;
 
 	res = KSI_OK;
 
 cleanup:
 
-	if (sockfd >= 0) close(sockfd);
-	KSI_RDR_close(rdr);
+	TcpConnection_free(tmp);
 
 	return res;
 }
@@ -195,6 +1092,7 @@ cleanup:
 static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, char *host, unsigned port) {
 	int res;
 	TcpClientCtx *tc = NULL;
+	TcpConnection *conn = NULL;
 
 	if (handle == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -208,46 +1106,87 @@ static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, cha
 		goto cleanup;
 	}
 
-
 	tc = KSI_new(TcpClientCtx);
 	if (tc == NULL) {
 		KSI_pushError(handle->ctx, res = KSI_OUT_OF_MEMORY, NULL);
 		goto cleanup;
 	}
-	tc->host = NULL;
-	tc->port = 0;
+	tc->conn = NULL;
+	tc->handle = handle;
+	tc->requestId = 0;
+	tc->hasRequestId = 0;
+	tc->isSent = 0;
+	tc->isReused = 0;
+	tc->attempts = 0;
+	tc->status = KSI_OK;
+	tc->deadline = 0;
+	tc->prev = NULL;
+	tc->next = NULL;
 
 	KSI_LOG_debug(handle->ctx, "Tcp: Sending request to: %s:%u", host, port);
 
-	tc->host = KSI_malloc(strlen(host) + 1);
-	if (tc->host == NULL) {
-		KSI_pushError(handle->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+	res = getPduRequestId(handle->ctx, handle->request, handle->request_length, &tc->requestId, &tc->hasRequestId);
+	if (res != KSI_OK) {
+		KSI_pushError(handle->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = getConnection((KSI_TcpClient *)client, host, port, &conn);
+	if (res != KSI_OK) {
+		KSI_pushError(handle->ctx, res, NULL);
 		goto cleanup;
 	}
-	KSI_strncpy(tc->host, host, strlen(host) + 1);
-	tc->port = port;
+
+	/* An event driven client reports a failure to connect right away. */
+	if (KSI_NetworkClient_isEventDriven(client) && conn->sockfd < 0) {
+		res = TcpConnection_start(conn, handle);
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
 
 	handle->readResponse = readResponse;
+	handle->pollResponse = pollResponse;
 	handle->client = client;
 
-    res = KSI_RequestHandle_setImplContext(handle, tc, (void (*)(void *))TcpClientCtx_free);
+	res = KSI_RequestHandle_setImplContext(handle, tc, (void (*)(void *))TcpClientCtx_free);
 	if (res != KSI_OK) {
 		KSI_pushError(handle->ctx, res, NULL);
 		goto cleanup;
 	}
 
+	/* The request is written with the next batch, when any of the pending responses is read. */
+	TcpConnection_append(conn, tc);
+
+	if (KSI_NetworkClient_isEventDriven(client)) {
+		int transferTimeout = ((KSI_TcpClient *)client)->transferTimeoutSeconds;
+		if (transferTimeout > 0) tc->deadline = KSI_NET_getTimeMs() + (KSI_uint64_t)transferTimeout * 1000;
+
+		/* The request is written when the host event loop finds the socket writable. */
+		res = TcpConnection_updateWatch(conn);
+		if (res == KSI_OK) res = TcpClient_updateTimer((KSI_TcpClient *)client);
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			tc = NULL;
+			goto cleanup;
+		}
+	}
+	tc = NULL;
 
 	res = KSI_OK;
 
 cleanup:
 
+	KSI_free(tc);
+
 	return res;
 }
 
-static int prepareRequest(
+static int sendRawRequest(
 		KSI_NetworkClient *client,
-		void *pdu,
-		int (*serialize)(void *, unsigned char **, unsigned *),
+		const unsigned char *raw,
+		unsigned raw_len,
 		KSI_RequestHandle **handle,
 		char *host,
 		unsigned port,
@@ -255,8 +1194,6 @@ static int prepareRequest(
 	int res;
 	KSI_TcpClient *tcp = (KSI_TcpClient *)client;
 	KSI_RequestHandle *tmp = NULL;
-	unsigned char *raw = NULL;
-	unsigned raw_len = 0;
 
 	if (client->ctx == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -265,17 +1202,11 @@ static int prepareRequest(
 
 	KSI_ERR_clearErrors(client->ctx);
 
-	if (pdu == NULL || handle == NULL) {
+	if (raw == NULL || handle == NULL) {
 		KSI_pushError(client->ctx, res = KSI_INVALID_ARGUMENT, NULL);
 		goto cleanup;
 	}
 
-	res = serialize(pdu, &raw, &raw_len);
-	if (res != KSI_OK) {
-		KSI_pushError(client->ctx, res, NULL);
-		goto cleanup;
-	}
-
 	KSI_LOG_logBlob(client->ctx, KSI_LOG_DEBUG, desc, raw, raw_len);
 
 	/* Create a new request handle */
@@ -304,6 +1235,44 @@ static int prepareRequest(
 cleanup:
 
 	KSI_RequestHandle_free(tmp);
+
+	return res;
+}
+
+static int prepareRequest(
+		KSI_NetworkClient *client,
+		void *pdu,
+		int (*serialize)(void *, unsigned char **, unsigned *),
+		KSI_RequestHandle **handle,
+		char *host,
+		unsigned port,
+		const char *desc) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *raw = NULL;
+	unsigned raw_len = 0;
+
+	if (client == NULL || pdu == NULL || handle == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(client->ctx);
+
+	res = serialize(pdu, &raw, &raw_len);
+	if (res != KSI_OK) {
+		KSI_pushError(client->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = sendRawRequest(client, raw, raw_len, handle, host, port, desc);
+	if (res != KSI_OK) {
+		KSI_pushError(client->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
 	KSI_free(raw);
 
 	return res;
@@ -339,6 +1308,24 @@ cleanup:
 static int prepareAggregationRequest(KSI_NetworkClient *client, KSI_AggregationReq *req, KSI_RequestHandle **handle) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_AggregationPdu *pdu = NULL;
+	const unsigned char *raw = NULL;
+	unsigned raw_len = 0;
+
+	/* Plain requests are written by the prepared request without building the PDU. */
+	res = KSI_NetworkClient_serializeSignRequest(client, req, &raw, &raw_len);
+	if (res != KSI_OK) goto cleanup;
+
+	if (raw != NULL) {
+		res = sendRawRequest(
+				client,
+				raw,
+				raw_len,
+				handle,
+				((KSI_TcpClient*)client)->aggrHost,
+				((KSI_TcpClient*)client)->aggrPort,
+				"Aggregation request");
+		goto cleanup;
+	}
 
 	res = KSI_AggregationReq_enclose(req, client->aggrUser, client->aggrPass, &pdu);
 	if (res != KSI_OK) goto cleanup;
@@ -381,6 +1368,11 @@ static void tcpClient_free(KSI_TcpClient *tcp) {
 	if (tcp != NULL) {
 		KSI_free(tcp->aggrHost);
 		KSI_free(tcp->extHost);
+		while (tcp->connections != NULL) {
+			TcpConnection *next = tcp->connections->next;
+			TcpConnection_free(tcp->connections);
+			tcp->connections = next;
+		}
 		KSI_HttpClient_free(tcp->http);
 		KSI_free(tcp);
 	}
@@ -416,8 +1408,10 @@ int KSI_TcpClient_init(KSI_CTX *ctx, KSI_TcpClient *client) {
 	client->extHost = NULL;
 	client->extPort = 0;
 	client->http = NULL;
+	client->connections = NULL;
 
 	client->transferTimeoutSeconds = 10;
+	client->dnsCacheTtlSeconds = 60;
 
 	res = KSI_HttpClient_new(ctx, &client->http);
 	if (res != KSI_OK) {
@@ -430,6 +1424,10 @@ int KSI_TcpClient_init(KSI_CTX *ctx, KSI_TcpClient *client) {
 	client->parent.sendPublicationRequest = sendPublicationRequest;
 	client->parent.getStausCode = NULL;
 	client->parent.implFree = (void (*)(void *))tcpClient_free;
+	client->parent.setEventCallbacks = tcpSetEventCallbacks;
+	client->parent.onSocketEvent = tcpOnSocketEvent;
+	client->parent.onTimeout = tcpOnTimeout;
+	client->timerDeadline = 0;
 
 	res = KSI_OK;
 
@@ -477,22 +1475,19 @@ cleanup:
 	return res;
 }
 
-int KSI_TcpClient_setExtender(KSI_TcpClient *client, const char *host, unsigned port, const char *user, const char *pass) {
+/* Sets the host and port of a service, port 0 stands for the Unix domain socket at \c host. */
+static int setService(char **hostField, unsigned *portField, char **userField, char **passField, const char *host, unsigned port, const char *user, const char *pass) {
 	int res = KSI_UNKNOWN_ERROR;
-	if (client == NULL || host == NULL || user == NULL || pass == NULL) {
-		res = KSI_INVALID_ARGUMENT;
-		goto cleanup;
-	}
 
-	res = setStringParam(&client->extHost, host);
+	res = setStringParam(hostField, host);
 	if (res != KSI_OK) goto cleanup;
 
-	client->extPort = port;
+	*portField = port;
 
-	res = setStringParam(&client->parent.extUser, user);
+	res = setStringParam(userField, user);
 	if (res != KSI_OK) goto cleanup;
 
-	res = setStringParam(&client->parent.extPass, pass);
+	res = setStringParam(passField, pass);
 	if (res != KSI_OK) goto cleanup;
 
 	res = KSI_OK;
@@ -502,26 +1497,58 @@ cleanup:
 	return res;
 }
 
+int KSI_TcpClient_setExtender(KSI_TcpClient *client, const char *host, unsigned port, const char *user, const char *pass) {
+	int res = KSI_UNKNOWN_ERROR;
+	if (client == NULL || host == NULL || port == 0 || user == NULL || pass == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = setService(&client->extHost, &client->extPort, &client->parent.extUser, &client->parent.extPass, host, port, user, pass);
+
+cleanup:
+
+	return res;
+}
+
+int KSI_TcpClient_setExtenderUnix(KSI_TcpClient *client, const char *path, const char *user, const char *pass) {
+	int res = KSI_UNKNOWN_ERROR;
+	if (client == NULL || path == NULL || *path == '\0' || user == NULL || pass == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = setService(&client->extHost, &client->extPort, &client->parent.extUser, &client->parent.extPass, path, 0, user, pass);
+
+cleanup:
+
+	return res;
+}
+
 int KSI_TcpClient_setAggregator(KSI_TcpClient *client, const char *host, unsigned port, const char *user, const char *pass) {
 	int res = KSI_UNKNOWN_ERROR;
 
-	if (client == NULL || host == NULL || user == NULL || pass == NULL) {
+	if (client == NULL || host == NULL || port == 0 || user == NULL || pass == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
-	res = setStringParam(&client->aggrHost, host);
-	if (res != KSI_OK) goto cleanup;
+	res = setService(&client->aggrHost, &client->aggrPort, &client->parent.aggrUser, &client->parent.aggrPass, host, port, user, pass);
 
-	client->aggrPort = port;
+cleanup:
 
-	res = setStringParam(&client->parent.aggrUser, user);
-	if (res != KSI_OK) goto cleanup;
+	return res;
+}
 
-	res = setStringParam(&client->parent.aggrPass, pass);
-	if (res != KSI_OK) goto cleanup;
+int KSI_TcpClient_setAggregatorUnix(KSI_TcpClient *client, const char *path, const char *user, const char *pass) {
+	int res = KSI_UNKNOWN_ERROR;
 
-	res = KSI_OK;
+	if (client == NULL || path == NULL || *path == '\0' || user == NULL || pass == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = setService(&client->aggrHost, &client->aggrPort, &client->parent.aggrUser, &client->parent.aggrPass, path, 0, user, pass);
 
 cleanup:
 
@@ -562,3 +1589,20 @@ cleanup:
 
 	return res;
 }
+
+int KSI_TcpClient_setDnsCacheTtlSeconds(KSI_TcpClient *client, int ttlSeconds) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (client == NULL || ttlSeconds < 0) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	client->dnsCacheTtlSeconds = ttlSeconds;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
@@ -30,7 +30,9 @@ extern "C" {
 	typedef struct KSI_TcpClient_st KSI_TcpClient;
 
 	/**
-	 * Creates a new TCP client.
+	 * Creates a new TCP client. The requests to the same host are written back-to-back over
+	 * a single persistent connection and the responses are matched to the request handles
+	 * by the request id, so several requests may be in flight at the same time.
 	 * \param[in]	ctx			KSI context.
 	 * \param[out]	client		Pointer to the receiving pointer.
 	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
@@ -73,6 +75,17 @@ extern "C" {
      */
 	int KSI_TcpClient_setExtender(KSI_TcpClient *client, const char *host, unsigned port, const char *user, const char *key);
 
+	/**
+	 * Setter for the extender parameters of a local gateway listening on a Unix domain socket
+	 * and speaking the same protocol as the tcp extender.
+	 * \param[in]	client		Pointer to tcp client.
+	 * \param[in]	path		Path of the socket.
+	 * \param[in]	user		User name.
+	 * \param[in]	key			HMAC shared secret.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_TcpClient_setExtenderUnix(KSI_TcpClient *client, const char *path, const char *user, const char *key);
+
 	/**
 	 * Setter for the tcp aggregator parameters.
      * \param[in]	client		Pointer to tcp client.
@@ -84,6 +97,17 @@ extern "C" {
      */
 	int KSI_TcpClient_setAggregator(KSI_TcpClient *client, const char *host, unsigned port, const char *user, const char *key);
 
+	/**
+	 * Setter for the aggregator parameters of a local gateway listening on a Unix domain socket
+	 * and speaking the same protocol as the tcp aggregator.
+	 * \param[in]	client		Pointer to tcp client.
+	 * \param[in]	path		Path of the socket.
+	 * \param[in]	user		User name.
+	 * \param[in]	key			HMAC shared secret.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_TcpClient_setAggregatorUnix(KSI_TcpClient *client, const char *path, const char *user, const char *key);
+
 	/**
 	 * Setter for the read, write, timeout in seconds.
 	 * \param[in]	client		Pointer to the tcp client.
@@ -92,6 +116,15 @@ extern "C" {
 	 */
 	int KSI_TcpClient_setTransferTimeoutSeconds(KSI_TcpClient *client, int val);
 
+	/**
+	 * Setter for the time the resolved addresses of the aggregator and extender hosts
+	 * are cached. The default is 60 seconds.
+	 * \param[in]	client		Pointer to the tcp client.
+	 * \param[in]	val			Time to live in seconds, 0 disables the cache.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_TcpClient_setDnsCacheTtlSeconds(KSI_TcpClient *client, int val);
+
 #ifdef __cplusplus
 }
 #endif
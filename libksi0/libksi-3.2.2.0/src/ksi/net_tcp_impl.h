@@ -35,6 +35,9 @@ extern "C" {
 
 		/* TODO: Is it required to be a signed int? */
 		int transferTimeoutSeconds;
+
+		/* Time to keep the resolved addresses of a host, 0 disables caching. */
+		int dnsCacheTtlSeconds;
 	
 		char *aggrHost;
 		unsigned aggrPort;
@@ -44,6 +47,12 @@ extern "C" {
 
 		int (*sendRequest)(KSI_NetworkClient *, KSI_RequestHandle *, char *host, unsigned port);
 		KSI_HttpClient *http;
+
+		/* Persistent connections, one per host and port. */
+		struct TcpConnection_st *connections;
+
+		/* Time the timer of the host event loop is armed for (see #KSI_NET_getTimeMs), 0 if disarmed. */
+		KSI_uint64_t timerDeadline;
 	};
 
 
@@ -18,6 +18,7 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
 
 #include "internal.h"
 
@@ -27,22 +28,1402 @@
 #include "net_tcp.h"
 #include "net_http.h"
 #include "http_parser.h"
+#include "tlv_template.h"
+
+KSI_IMPORT_TLV_TEMPLATE(KSI_ExtendReq);
+KSI_IMPORT_TLV_TEMPLATE(KSI_AggregationReq);
+
+/* Default number of consecutive failures after which an endpoint is taken out of rotation. */
+#define URI_DEFAULT_FAILURE_THRESHOLD 3
+/* Default time an unhealthy endpoint is excluded from the rotation. */
+#define URI_DEFAULT_RETRY_DELAY 30
+/* Weight of the latest sample in the moving average of the response time. */
+#define URI_LATENCY_EWMA_WEIGHT 0.3
+/* Hedging delay until enough response times have been observed. */
+#define URI_DEFAULT_HEDGE_DELAY_MS 500
+/* Minimum number of observed response times for using the percentiles. */
+#define URI_MIN_LATENCY_SAMPLES 16
+/* Default retry budget in retries per 100 requests. */
+#define URI_DEFAULT_RETRY_BUDGET 10
+/* Upper limit of the saved up retry budget, in retries. */
+#define URI_MAX_RETRY_TOKENS 10
+/* Maximum number of concurrent attempts of a single request. */
+#define URI_MAX_ATTEMPTS 8
+/* Time slice for waiting on each of several concurrent attempts. */
+#define URI_POLL_SLICE_MS 5
+
+enum serviceMethod_e {
+	SRV_EXTEND,
+	SRV_AGGREGATE
+};
+
+/* Calls the function for every transport of the client that has an event loop route. */
+static int UriClient_forEachRoute(KSI_UriClient *client, int (*fn)(UriEventRoute *, void *), void *arg) {
+	int res;
+	UriEndpointPool *pools[2];
+	size_t i;
+	size_t j;
+
+	pools[0] = &client->aggrPool;
+	pools[1] = &client->extPool;
+
+	if (client->httpRoute.client != NULL && (res = fn(&client->httpRoute, arg)) != KSI_OK) goto cleanup;
+	if (client->tcpRoute.client != NULL && (res = fn(&client->tcpRoute, arg)) != KSI_OK) goto cleanup;
+
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < pools[i]->count; j++) {
+			UriEventRoute *route = &pools[i]->list[j]->route;
+			if (route->client != NULL && (res = fn(route, arg)) != KSI_OK) goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int findEarliestTimer(UriEventRoute *route, void *arg) {
+	KSI_uint64_t *next = arg;
+	if (route->timerAt != 0 && (*next == 0 || route->timerAt < *next)) *next = route->timerAt;
+	return KSI_OK;
+}
+
+/* Arms the timer of the host event loop for the earliest timer of the transports. */
+static int UriClient_updateTimer(KSI_UriClient *client) {
+	KSI_uint64_t next = 0;
+	KSI_uint64_t now;
+
+	UriClient_forEachRoute(client, findEarliestTimer, &next);
+
+	if (next == client->timerAt) return KSI_OK;
+	client->timerAt = next;
+
+	if (next == 0) return KSI_NetworkClient_setTimer(&client->parent, -1);
+
+	now = KSI_NET_getTimeMs();
+	return KSI_NetworkClient_setTimer(&client->parent, next > now ? (long)(next - now) : 0);
+}
+
+static int uriWatchSocket(void *userCtx, int fd, int events) {
+	UriEventRoute *route = userCtx;
+	KSI_UriClient *client = route->owner;
+	size_t i;
+
+	for (i = 0; i < client->sockets_len && client->sockets[i].fd != fd; i++);
+
+	if (events == KSI_NET_EVENT_REMOVE) {
+		if (i < client->sockets_len) client->sockets[i] = client->sockets[--client->sockets_len];
+	} else if (i < client->sockets_len) {
+		client->sockets[i].route = route;
+	} else {
+		if (client->sockets_len == client->sockets_size) {
+			size_t size = client->sockets_size > 0 ? client->sockets_size * 2 : 8;
+			UriEventSocket *tmp = KSI_malloc(size * sizeof(UriEventSocket));
+			if (tmp == NULL) return KSI_OUT_OF_MEMORY;
+
+			if (client->sockets_len > 0) memcpy(tmp, client->sockets, client->sockets_len * sizeof(UriEventSocket));
+			KSI_free(client->sockets);
+			client->sockets = tmp;
+			client->sockets_size = size;
+		}
+
+		client->sockets[client->sockets_len].fd = fd;
+		client->sockets[client->sockets_len].route = route;
+		client->sockets_len++;
+	}
+
+	return KSI_NetworkClient_watchSocket(&client->parent, fd, events);
+}
+
+static int uriSetTimer(void *userCtx, long timeoutMs) {
+	UriEventRoute *route = userCtx;
+
+	/* A disarmed timer is left to expire early, the transports may be released meanwhile. */
+	if (timeoutMs < 0) {
+		route->timerAt = 0;
+		return KSI_OK;
+	}
+
+	route->timerAt = KSI_NET_getTimeMs() + (KSI_uint64_t)timeoutMs;
+	return UriClient_updateTimer(route->owner);
+}
+
+static void uriRequestDone(void *userCtx, KSI_RequestHandle *handle) {
+	UriEventRoute *route = userCtx;
+	KSI_NetworkClient_requestDone(&route->owner->parent, handle);
+}
+
+static int UriEventRoute_setCallbacks(UriEventRoute *route, void *arg) {
+	(void)arg;
+	/* Sending through a transport without event loop support fails instead (see #UriClient_checkTransport). */
+	if (route->client->setEventCallbacks == NULL) return KSI_OK;
+	return KSI_NetworkClient_setEventCallbacks(route->client, uriWatchSocket, uriSetTimer, uriRequestDone, route);
+}
+
+/* Routes the event loop callbacks of the transport through the client, once it is event driven. */
+static int UriClient_addRoute(KSI_UriClient *client, UriEventRoute *route, KSI_NetworkClient *transport) {
+	if (route->client == transport) return KSI_OK;
+
+	route->owner = client;
+	route->client = transport;
+	route->timerAt = 0;
+
+	if (transport == NULL || !KSI_NetworkClient_isEventDriven(&client->parent)) return KSI_OK;
+	return UriEventRoute_setCallbacks(route, NULL);
+}
+
+/* Fails, if the client is event driven, but the transport would block. */
+static int UriClient_checkTransport(KSI_UriClient *client, KSI_NetworkClient *transport) {
+	if (KSI_NetworkClient_isEventDriven(&client->parent) && !KSI_NetworkClient_isEventDriven(transport)) {
+		KSI_pushError(client->parent.ctx, KSI_INVALID_ARGUMENT, "Transport can not be driven by an external event loop.");
+		return KSI_INVALID_ARGUMENT;
+	}
+	return KSI_OK;
+}
+
+static void UriEndpoint_free(KSI_UriEndpoint *ep) {
+	if (ep != NULL && --ep->refCount == 0) {
+		KSI_NetworkClient_free(ep->sender);
+		if (ep->ownsClient) KSI_NetworkClient_free(ep->client);
+		KSI_free(ep->uri);
+		KSI_free(ep);
+	}
+}
+
+/**
+ * Removes the endpoint from its pool. Requests still referring to the endpoint
+ * keep it alive, but it will not be used for new requests.
+ */
+static void UriEndpoint_detach(KSI_UriEndpoint *ep) {
+	if (ep != NULL) {
+		KSI_NetworkClient_free(ep->sender);
+		ep->sender = NULL;
+		if (ep->ownsClient) KSI_NetworkClient_free(ep->client);
+		ep->client = NULL;
+		ep->ownsClient = 0;
+		ep->route.client = NULL;
+		UriEndpoint_free(ep);
+	}
+}
+
+static void UriEndpointPool_clear(UriEndpointPool *pool) {
+	size_t i;
+
+	for (i = 0; i < pool->count; i++) {
+		UriEndpoint_detach(pool->list[i]);
+	}
+	KSI_free(pool->list);
+	pool->list = NULL;
+	pool->count = 0;
+	pool->next = 0;
+}
+
+static int UriEndpointPool_add(KSI_UriClient *client, UriEndpointPool *pool, const char *uri, KSI_NetworkClient *netClient, enum client_e type, int ownsClient) {
+	int res;
+	KSI_UriEndpoint *tmp = NULL;
+	KSI_UriEndpoint **list = NULL;
+	KSI_NetworkClient *sender = NULL;
+	size_t len;
+
+	if (client->decorate != NULL) {
+		res = client->decorate(client->decoratorCtx, netClient, &sender);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_UriEndpoint);
+	list = KSI_calloc(pool->count + 1, sizeof(KSI_UriEndpoint *));
+	len = strlen(uri) + 1;
+	if (tmp != NULL) tmp->uri = KSI_malloc(len);
+	if (tmp == NULL || list == NULL || tmp->uri == NULL) {
+		if (tmp != NULL) KSI_free(tmp->uri);
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	memcpy(tmp->uri, uri, len);
+	tmp->ctx = client->parent.ctx;
+	tmp->refCount = 1;
+	tmp->client = netClient;
+	tmp->clientType = type;
+	tmp->ownsClient = ownsClient;
+	tmp->sender = sender;
+	tmp->outstanding = 0;
+	tmp->requestCount = 0;
+	tmp->failureCount = 0;
+	tmp->consecutiveFailures = 0;
+	tmp->latencyMs = 0;
+	tmp->downUntil = 0;
+	tmp->failureThreshold = client->failureThreshold;
+	tmp->retryDelaySeconds = client->retryDelaySeconds;
+	tmp->route.client = NULL;
+
+	if (ownsClient) {
+		res = UriClient_addRoute(client, &tmp->route, netClient);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	if (pool->count > 0) memcpy(list, pool->list, pool->count * sizeof(KSI_UriEndpoint *));
+	list[pool->count++] = tmp;
+	KSI_free(pool->list);
+	pool->list = list;
+
+	tmp = NULL;
+	list = NULL;
+	sender = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(list);
+	KSI_free(tmp);
+	KSI_NetworkClient_free(sender);
+
+	return res;
+}
+
+/* Returns the client the requests to the endpoint are sent through. */
+static KSI_NetworkClient *UriEndpoint_getSender(const KSI_UriEndpoint *ep) {
+	return ep->sender != NULL ? ep->sender : ep->client;
+}
+
+static void UriEndpoint_recordResult(KSI_UriEndpoint *ep, int status, KSI_uint64_t elapsedMs) {
+	if (status == KSI_OK) {
+		ep->consecutiveFailures = 0;
+		ep->downUntil = 0;
+		if (ep->latencyMs == 0) {
+			ep->latencyMs = (double)elapsedMs;
+		} else {
+			ep->latencyMs += URI_LATENCY_EWMA_WEIGHT * ((double)elapsedMs - ep->latencyMs);
+		}
+	} else {
+		ep->failureCount++;
+		ep->consecutiveFailures++;
+		if (ep->failureThreshold > 0 && ep->consecutiveFailures >= ep->failureThreshold) {
+			if (ep->downUntil == 0) {
+				KSI_LOG_warn(ep->ctx, "Endpoint %s is down after %u consecutive failures.", ep->uri, ep->consecutiveFailures);
+			}
+			ep->downUntil = KSI_NET_getTimeMs() + (KSI_uint64_t)ep->retryDelaySeconds * 1000;
+		}
+	}
+}
+
+static void UriRetryPolicy_free(UriRetryPolicy *policy) {
+	if (policy != NULL && --policy->refCount == 0) {
+		KSI_free(policy);
+	}
+}
+
+static int UriEndpointPool_getRetryPolicy(UriEndpointPool *pool, UriRetryPolicy **policy) {
+	int res;
+	UriRetryPolicy *tmp = NULL;
+
+	if (pool->retry == NULL) {
+		tmp = KSI_new(UriRetryPolicy);
+		if (tmp == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+
+		tmp->refCount = 1;
+		tmp->hedgePercentile = 0;
+		tmp->hedgeMinDelayMs = 0;
+		tmp->maxRetries = 0;
+		tmp->backoffMs = 0;
+		tmp->budgetPercent = URI_DEFAULT_RETRY_BUDGET;
+		tmp->tokens = URI_MAX_RETRY_TOKENS * 100;
+		tmp->timeoutFactor = 0;
+		tmp->timeoutMinMs = 0;
+		tmp->samples_len = 0;
+		tmp->samples_pos = 0;
+		tmp->seed = KSI_NET_getTimeMs() ^ (KSI_uint64_t)(size_t)tmp;
+
+		pool->retry = tmp;
+		tmp = NULL;
+	}
+
+	*policy = pool->retry;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+
+	return res;
+}
+
+static int UriRetryPolicy_isEnabled(const UriRetryPolicy *policy) {
+	return policy != NULL && (policy->hedgePercentile > 0 || policy->maxRetries > 0 || policy->timeoutFactor > 0);
+}
+
+static void UriRetryPolicy_addSample(UriRetryPolicy *policy, KSI_uint64_t elapsedMs) {
+	policy->samples[policy->samples_pos] = elapsedMs > UINT_MAX ? UINT_MAX : (unsigned)elapsedMs;
+	policy->samples_pos = (policy->samples_pos + 1) % URI_LATENCY_SAMPLES;
+	if (policy->samples_len < URI_LATENCY_SAMPLES) policy->samples_len++;
+}
+
+static int compareSamples(const void *a, const void *b) {
+	unsigned x = *(const unsigned *)a;
+	unsigned y = *(const unsigned *)b;
+	return x < y ? -1 : (x > y);
+}
+
+/**
+ * Returns the given percentile of the recent response times or 0 if not enough
+ * responses have been observed.
+ */
+static unsigned UriRetryPolicy_getPercentile(const UriRetryPolicy *policy, unsigned percentile) {
+	unsigned sorted[URI_LATENCY_SAMPLES];
+	size_t i;
+
+	if (policy->samples_len < URI_MIN_LATENCY_SAMPLES) return 0;
+
+	memcpy(sorted, policy->samples, policy->samples_len * sizeof(unsigned));
+	qsort(sorted, policy->samples_len, sizeof(unsigned), compareSamples);
+
+	i = (policy->samples_len * percentile + 99) / 100;
+	if (i > 0) i--;
+	if (i >= policy->samples_len) i = policy->samples_len - 1;
+
+	return sorted[i];
+}
+
+/* Takes a retry from the budget, returns 0 if the budget is exhausted. */
+static int UriRetryPolicy_takeToken(UriRetryPolicy *policy) {
+	if (policy->tokens < 100) return 0;
+	policy->tokens -= 100;
+	return 1;
+}
+
+/* Returns the delay before the n-th retry: a random value between a half and the whole of the exponential backoff. */
+static KSI_uint64_t UriRetryPolicy_getBackoff(UriRetryPolicy *policy, unsigned n) {
+	KSI_uint64_t delay = (KSI_uint64_t)policy->backoffMs << (n < 16 ? n : 16);
+
+	/* xorshift64 */
+	policy->seed ^= policy->seed << 13;
+	policy->seed ^= policy->seed >> 7;
+	policy->seed ^= policy->seed << 17;
+
+	return delay / 2 + (delay > 1 ? policy->seed % (delay / 2 + 1) : 0);
+}
+
+static void UriRetryCtx_free(UriRetryCtx *rc) {
+	size_t i;
+
+	if (rc != NULL) {
+		for (i = 0; i < rc->endpoints_len; i++) {
+			UriEndpoint_free(rc->endpoints[i]);
+		}
+		KSI_free(rc->endpoints);
+		if (rc->req_free != NULL) rc->req_free(rc->req);
+		UriRetryPolicy_free(rc->policy);
+		KSI_free(rc);
+	}
+}
+
+/**
+ * Chooses the endpoint for the next request, skipping the endpoints marked in \c excluded.
+ * Returns the index of the endpoint or -1 if there is none left.
+ */
+static int UriEndpointPool_pick(int balancing, UriEndpointPool *pool, const unsigned char *excluded) {
+	KSI_uint64_t now = KSI_NET_getTimeMs();
+	int best = -1;
+	double bestScore = 0;
+	int fallback = -1;
+	size_t k;
+
+	for (k = 0; k < pool->count; k++) {
+		size_t i = (pool->next + k) % pool->count;
+		KSI_UriEndpoint *ep = pool->list[i];
+		double score;
+
+		if (excluded[i] || ep->client == NULL) continue;
+
+		if (ep->downUntil > now) {
+			if (fallback < 0 || ep->downUntil < pool->list[fallback]->downUntil) fallback = (int)i;
+			continue;
+		}
+
+		switch (balancing) {
+			case KSI_URI_BALANCE_LEAST_OUTSTANDING:
+				score = (double)ep->outstanding;
+				break;
+			case KSI_URI_BALANCE_LATENCY:
+				/* Endpoints without measurements are preferred until they get one. */
+				score = (ep->latencyMs > 0 ? ep->latencyMs : 1.0) * (double)(ep->outstanding + 1);
+				break;
+			default:
+				score = (double)k;
+				break;
+		}
+
+		/* Ties are resolved in the round-robin order. */
+		if (best < 0 || score < bestScore) {
+			best = (int)i;
+			bestScore = score;
+		}
+	}
+
+	/* When all endpoints are down, try the one that will recover first. */
+	if (best < 0) best = fallback;
+
+	if (best >= 0) {
+		KSI_UriEndpoint *ep = pool->list[best];
+
+		/* Let only one probe through to an endpoint recovering from failures. */
+		if (ep->downUntil != 0) {
+			ep->downUntil = now + (KSI_uint64_t)ep->retryDelaySeconds * 1000;
+		}
+
+		pool->next = (best + 1) % pool->count;
+	}
+
+	return best;
+}
+
+/* Counts the request as outstanding at the endpoint. */
+static void UriEndpoint_attach(KSI_UriEndpoint *ep, KSI_RequestHandle *handle) {
+	ep->refCount++;
+	ep->outstanding++;
+	handle->endpoint = ep;
+	handle->routedAt = KSI_NET_getTimeMs();
+	handle->isRoutePending = 1;
+	handle->responseDone = KSI_UriEndpoint_requestDone;
+	handle->routeFree = KSI_UriEndpoint_releaseRequest;
+}
+
+/**
+ * Prepares the routed request for hedging and retries by the policy of the pool.
+ */
+static int UriRetryCtx_new(KSI_UriClient *client, UriEndpointPool *pool,
+		int (*send)(KSI_NetworkClient *, void *, KSI_RequestHandle **), int (*clone)(KSI_CTX *, void *, void **), void (*req_free)(void *),
+		int (*check)(KSI_CTX *, const unsigned char *, unsigned), void *req, UriRetryCtx **rc) {
+	int res;
+	UriRetryCtx *tmp = NULL;
+	size_t i;
+
+	tmp = KSI_new(UriRetryCtx);
+	if (tmp == NULL) {
+		KSI_pushError(client->parent.ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->policy = pool->retry;
+	tmp->policy->refCount++;
+	tmp->balancing = client->balancing;
+	tmp->endpoints = NULL;
+	tmp->endpoints_len = 0;
+	tmp->req = NULL;
+	tmp->req_free = NULL;
+	tmp->send = send;
+	tmp->check = check;
+	tmp->readResponse = NULL;
+
+	/* A single endpoint is retried as well, so the request is kept in any case. */
+	tmp->endpoints = KSI_calloc(pool->count, sizeof(KSI_UriEndpoint *));
+	if (tmp->endpoints == NULL) {
+		KSI_pushError(client->parent.ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < pool->count; i++) {
+		tmp->endpoints[i] = pool->list[i];
+		tmp->endpoints[i]->refCount++;
+	}
+	tmp->endpoints_len = pool->count;
+
+	/* The caller may free the request before reading the response. */
+	res = clone(client->parent.ctx, req, &tmp->req);
+	if (res != KSI_OK) {
+		KSI_pushError(client->parent.ctx, res, NULL);
+		goto cleanup;
+	}
+	tmp->req_free = req_free;
+
+	/* Every request earns a share of a retry. */
+	tmp->policy->tokens += tmp->policy->budgetPercent;
+	if (tmp->policy->tokens > URI_MAX_RETRY_TOKENS * 100) tmp->policy->tokens = URI_MAX_RETRY_TOKENS * 100;
+
+	*rc = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	UriRetryCtx_free(tmp);
+
+	return res;
+}
+
+/**
+ * Sends the request to an endpoint of the pool. If sending fails, the request is
+ * resent to the next endpoint until all of them have been tried.
+ */
+static int routeRequest(KSI_UriClient *client, UriEndpointPool *pool, KSI_NetworkClient *defaultClient,
+		int (*send)(KSI_NetworkClient *, void *, KSI_RequestHandle **), int (*clone)(KSI_CTX *, void *, void **), void (*req_free)(void *),
+		int (*check)(KSI_CTX *, const unsigned char *, unsigned), void *req, KSI_RequestHandle **handle) {
+	int res;
+	unsigned char *excluded = NULL;
+	KSI_RequestHandle *tmp = NULL;
+	size_t attempt;
+
+	/* No endpoints configured. */
+	if (pool->count == 0) {
+		res = UriClient_checkTransport(client, defaultClient);
+		if (res == KSI_OK) res = send(defaultClient, req, handle);
+		goto cleanup;
+	}
+
+	excluded = KSI_calloc(pool->count, 1);
+	if (excluded == NULL) {
+		KSI_pushError(client->parent.ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_UNKNOWN_ERROR;
+
+	for (attempt = 0; attempt < pool->count; attempt++) {
+		KSI_UriEndpoint *ep = NULL;
+		int i = UriEndpointPool_pick(client->balancing, pool, excluded);
+		if (i < 0) break;
+
+		ep = pool->list[i];
+		ep->requestCount++;
+
+		res = UriClient_checkTransport(client, ep->client);
+		if (res == KSI_OK) res = send(UriEndpoint_getSender(ep), req, &tmp);
+		if (res == KSI_OK) {
+			UriEndpoint_attach(ep, tmp);
+
+			KSI_LOG_debug(client->parent.ctx, "Request routed to %s.", ep->uri);
+
+			/* Waiting for the attempts is left to the host event loop. */
+			if (UriRetryPolicy_isEnabled(pool->retry) && !KSI_NetworkClient_isEventDriven(&client->parent)) {
+				res = UriRetryCtx_new(client, pool, send, clone, req_free, check, req, &tmp->retry);
+				if (res != KSI_OK) goto cleanup;
+
+				/* The request may be resent to the endpoints of the pool. */
+				tmp->retry->readResponse = tmp->readResponse;
+				tmp->readResponse = KSI_UriEndpoint_readResponse;
+			}
+
+			*handle = tmp;
+			tmp = NULL;
+			break;
+		}
+
+		UriEndpoint_recordResult(ep, res, 0);
+		excluded[i] = 1;
+
+		KSI_LOG_debug(client->parent.ctx, "Unable to send request to %s, failing over.", ep->uri);
+	}
+
+cleanup:
+
+	KSI_RequestHandle_free(tmp);
+	KSI_free(excluded);
+
+	return res;
+}
+
+static int sendExtendRequestTo(KSI_NetworkClient *client, void *req, KSI_RequestHandle **handle) {
+	return KSI_NetworkClient_sendExtendRequest(client, (KSI_ExtendReq *)req, handle);
+}
+
+static int sendAggregationRequestTo(KSI_NetworkClient *client, void *req, KSI_RequestHandle **handle) {
+	return KSI_NetworkClient_sendSignRequest(client, (KSI_AggregationReq *)req, handle);
+}
+
+static int cloneExtendRequest(KSI_CTX *ctx, void *req, void **clone) {
+	int res;
+	KSI_ExtendReq *tmp = NULL;
+
+	res = KSI_ExtendReq_new(ctx, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvTemplate_deepCopy(ctx, req, KSI_TLV_TEMPLATE(KSI_ExtendReq), tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	*clone = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_ExtendReq_free(tmp);
+
+	return res;
+}
+
+static int cloneAggregationRequest(KSI_CTX *ctx, void *req, void **clone) {
+	int res;
+	KSI_AggregationReq *tmp = NULL;
+
+	res = KSI_AggregationReq_new(ctx, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TlvTemplate_deepCopy(ctx, req, KSI_TLV_TEMPLATE(KSI_AggregationReq), tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	*clone = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_AggregationReq_free(tmp);
+
+	return res;
+}
+
+static int checkExtendResponse(KSI_CTX *ctx, const unsigned char *raw, unsigned len) {
+	int res;
+	KSI_ExtendPdu *pdu = NULL;
+	KSI_ErrorPdu *error = NULL;
+	KSI_ExtendResp *resp = NULL;
+	KSI_Integer *status = NULL;
+
+	res = KSI_ExtendPdu_parse(ctx, raw, len, &pdu);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendPdu_getError(pdu, &error);
+	if (res != KSI_OK) goto cleanup;
+
+	if (error != NULL) {
+		res = KSI_ErrorPdu_getStatus(error, &status);
+	} else {
+		res = KSI_ExtendPdu_getResponse(pdu, &resp);
+		if (res == KSI_OK && resp != NULL) res = KSI_ExtendResp_getStatus(resp, &status);
+	}
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_convertExtenderStatusCode(status);
+
+cleanup:
+
+	KSI_ExtendPdu_free(pdu);
+
+	return res;
+}
+
+static int checkAggregationResponse(KSI_CTX *ctx, const unsigned char *raw, unsigned len) {
+	int res;
+	KSI_AggregationPdu *pdu = NULL;
+	KSI_ErrorPdu *error = NULL;
+	KSI_AggregationResp *resp = NULL;
+	KSI_Integer *status = NULL;
+
+	res = KSI_AggregationPdu_parse(ctx, raw, len, &pdu);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationPdu_getError(pdu, &error);
+	if (res != KSI_OK) goto cleanup;
+
+	if (error != NULL) {
+		res = KSI_ErrorPdu_getStatus(error, &status);
+	} else {
+		res = KSI_AggregationPdu_getResponse(pdu, &resp);
+		if (res == KSI_OK && resp != NULL) res = KSI_AggregationResp_getStatus(resp, &status);
+	}
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_convertAggregatorStatusCode(status);
+
+cleanup:
+
+	KSI_AggregationPdu_free(pdu);
+
+	return res;
+}
 
 static int prepareExtendRequest(KSI_NetworkClient *client, KSI_ExtendReq *req, KSI_RequestHandle **handle) {
 	KSI_UriClient *uriClient = (KSI_UriClient *)client;
-	return KSI_NetworkClient_sendExtendRequest(uriClient->pExtendClient, req, handle);
+	return routeRequest(uriClient, &uriClient->extPool, uriClient->pExtendClient, sendExtendRequestTo,
+			cloneExtendRequest, (void (*)(void *))KSI_ExtendReq_free, checkExtendResponse, req, handle);
+}
+
+static int prepareAggregationRequest(KSI_NetworkClient *client, KSI_AggregationReq *req, KSI_RequestHandle **handle) {
+	KSI_UriClient *uriClient = (KSI_UriClient *)client;
+	return routeRequest(uriClient, &uriClient->aggrPool, uriClient->pAggregationClient, sendAggregationRequestTo,
+			cloneAggregationRequest, (void (*)(void *))KSI_AggregationReq_free, checkAggregationResponse, req, handle);
+}
+
+void KSI_UriEndpoint_requestDone(KSI_RequestHandle *handle, int status) {
+	if (handle != NULL && handle->endpoint != NULL && handle->isRoutePending) {
+		KSI_UriEndpoint *ep = handle->endpoint;
+
+		ep->outstanding--;
+		handle->isRoutePending = 0;
+
+		UriEndpoint_recordResult(ep, status, KSI_NET_getTimeMs() - handle->routedAt);
+	}
+}
+
+static void UriEndpoint_detachRequest(KSI_RequestHandle *handle) {
+	if (handle->endpoint != NULL) {
+		/* An abandoned request tells nothing about the endpoint. */
+		if (handle->isRoutePending) handle->endpoint->outstanding--;
+		handle->isRoutePending = 0;
+
+		UriEndpoint_free(handle->endpoint);
+		handle->endpoint = NULL;
+	}
+}
+
+void KSI_UriEndpoint_releaseRequest(KSI_RequestHandle *handle) {
+	if (handle != NULL) {
+		UriEndpoint_detachRequest(handle);
+
+		UriRetryCtx_free(handle->retry);
+		handle->retry = NULL;
+	}
+}
+
+/**
+ * Sends a copy of the request to an endpoint not tried yet. If every endpoint has been tried
+ * and \c reuse is set, the endpoints are tried again. Returns #KSI_OK with \c handle set
+ * to \c NULL if there is no endpoint left.
+ */
+static int UriRetryCtx_resend(UriRetryCtx *rc, unsigned char *excluded, int reuse, KSI_RequestHandle **handle) {
+	int res = KSI_OK;
+	UriEndpointPool pool;
+	KSI_RequestHandle *tmp = NULL;
+
+	pool.list = rc->endpoints;
+	pool.count = rc->endpoints_len;
+	pool.next = 0;
+	pool.retry = NULL;
+
+	*handle = NULL;
+
+	while (*handle == NULL) {
+		KSI_UriEndpoint *ep = NULL;
+		int i = UriEndpointPool_pick(rc->balancing, &pool, excluded);
+
+		/* Start over once, so that a retry is not lost by running out of endpoints. */
+		if (i < 0 && reuse) {
+			memset(excluded, 0, rc->endpoints_len);
+			reuse = 0;
+			i = UriEndpointPool_pick(rc->balancing, &pool, excluded);
+		}
+		if (i < 0) break;
+
+		ep = rc->endpoints[i];
+		excluded[i] = 1;
+		ep->requestCount++;
+
+		res = rc->send(UriEndpoint_getSender(ep), rc->req, &tmp);
+		if (res != KSI_OK) {
+			UriEndpoint_recordResult(ep, res, 0);
+			continue;
+		}
+
+		UriEndpoint_attach(ep, tmp);
+
+		KSI_LOG_debug(ep->ctx, "Request resent to %s.", ep->uri);
+
+		*handle = tmp;
+		tmp = NULL;
+	}
+
+	KSI_RequestHandle_free(tmp);
+
+	return res;
+}
+
+int KSI_UriEndpoint_readResponse(KSI_RequestHandle *handle) {
+	int res = KSI_UNKNOWN_ERROR;
+	UriRetryCtx *rc = NULL;
+	UriRetryPolicy *policy = NULL;
+	KSI_RequestHandle *attempts[URI_MAX_ATTEMPTS];
+	int active[URI_MAX_ATTEMPTS];
+	size_t attempts_len = 1;
+	unsigned char *excluded = NULL;
+	unsigned retries = 0;
+	KSI_uint64_t start = KSI_NET_getTimeMs();
+	KSI_uint64_t hedgeAt = 0;
+	KSI_uint64_t retryAt = 0;
+	KSI_uint64_t deadline = 0;
+	int lastError = KSI_NETWORK_ERROR;
+	int winner = -1;
+	int fallback = -1;
+	size_t i;
+
+	if (handle == NULL || handle->retry == NULL || handle->retry->readResponse == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	rc = handle->retry;
+	policy = rc->policy;
+
+	attempts[0] = handle;
+	active[0] = 1;
+
+	excluded = KSI_calloc(rc->endpoints_len + 1, 1);
+	if (excluded == NULL) {
+		KSI_pushError(handle->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < rc->endpoints_len; i++) {
+		if (rc->endpoints[i] == handle->endpoint) excluded[i] = 1;
+	}
+
+	/* Without polling the transport blocks until the response is received. */
+	if (handle->pollResponse != NULL) {
+		if (policy->hedgePercentile > 0 && rc->endpoints_len > 1) {
+			KSI_uint64_t delay = UriRetryPolicy_getPercentile(policy, policy->hedgePercentile);
+			if (delay == 0) delay = URI_DEFAULT_HEDGE_DELAY_MS;
+			if (delay < policy->hedgeMinDelayMs) delay = policy->hedgeMinDelayMs;
+			hedgeAt = start + delay;
+		}
+
+		if (policy->timeoutFactor > 0) {
+			KSI_uint64_t timeout = (KSI_uint64_t)UriRetryPolicy_getPercentile(policy, 99) * policy->timeoutFactor;
+			if (timeout > 0) {
+				if (timeout < policy->timeoutMinMs) timeout = policy->timeoutMinMs;
+				deadline = start + timeout;
+			}
+		}
+	}
+
+	while (winner < 0) {
+		KSI_uint64_t now = KSI_NET_getTimeMs();
+		KSI_uint64_t next = 0;
+		size_t activeCount = 0;
+
+		if (deadline != 0 && now >= deadline) {
+			if (fallback >= 0) break;
+			KSI_pushError(handle->ctx, res = KSI_NETWORK_RECIEVE_TIMEOUT, "No response within the adaptive timeout.");
+			goto cleanup;
+		}
+
+		/* Send a hedged request or a retry when due. */
+		if ((hedgeAt != 0 && now >= hedgeAt) || (retryAt != 0 && now >= retryAt)) {
+			KSI_RequestHandle *tmp = NULL;
+			int reuse = 1;
+
+			/* A hedged request is only worth sending to another endpoint. */
+			if (hedgeAt != 0 && now >= hedgeAt) {
+				hedgeAt = 0;
+				reuse = 0;
+			} else {
+				retryAt = 0;
+			}
+
+			if (attempts_len < URI_MAX_ATTEMPTS && UriRetryPolicy_takeToken(policy)) {
+				res = UriRetryCtx_resend(rc, excluded, reuse, &tmp);
+				if (res != KSI_OK) lastError = res;
+
+				if (tmp != NULL) {
+					attempts[attempts_len] = tmp;
+					active[attempts_len++] = 1;
+				}
+			}
+		}
+
+		for (i = 0; i < attempts_len; i++) {
+			if (active[i]) activeCount++;
+		}
+
+		if (hedgeAt != 0) next = hedgeAt;
+		if (retryAt != 0 && (next == 0 || retryAt < next)) next = retryAt;
+		if (deadline != 0 && (next == 0 || deadline < next)) next = deadline;
+
+		if (activeCount == 0) {
+			if (retryAt == 0) {
+				/* Nothing left to try, an error status is better than no response at all. */
+				if (fallback >= 0) break;
+
+				/* Every attempt failed and there is nothing left to try. */
+				KSI_pushError(handle->ctx, res = lastError, NULL);
+				goto cleanup;
+			}
+
+			/* Back off before the retry. */
+			KSI_NET_sleepMs(next > now ? next - now : 0);
+			continue;
+		}
+
+		for (i = 0; i < attempts_len && winner < 0; i++) {
+			KSI_RequestHandle *attempt = attempts[i];
+			int ready = 1;
+
+			if (!active[i]) continue;
+
+			/* Wait on a single attempt until the next event, share the time between several. */
+			if (attempt->pollResponse != NULL && (next != 0 || activeCount > 1)) {
+				KSI_uint64_t wait = next > now ? next - now : 0;
+				if (activeCount > 1 && (next == 0 || wait > URI_POLL_SLICE_MS)) wait = URI_POLL_SLICE_MS;
+
+				res = attempt->pollResponse(attempt, (unsigned)wait, &ready);
+				if (res != KSI_OK) ready = 1;
+			}
+
+			if (!ready) continue;
+
+			res = attempt == handle ? rc->readResponse(attempt) : attempt->readResponse(attempt);
+
+			/* The winner is accounted by the caller. */
+			if (res != KSI_OK || attempt != handle) {
+				KSI_UriEndpoint_requestDone(attempt, res);
+			}
+
+			active[i] = 0;
+			activeCount--;
+
+			/* While another attempt may still succeed, a response with an error status is held back. */
+			if (res == KSI_OK && rc->check != NULL && (activeCount > 0 || hedgeAt != 0 || retryAt != 0)) {
+				int status = rc->check(handle->ctx, attempt->response, attempt->response_length);
+				if (status != KSI_OK) {
+					KSI_LOG_debug(handle->ctx, "Response from %s has an error status, waiting for the other attempts.",
+							attempt->endpoint != NULL ? attempt->endpoint->uri : "");
+
+					if (fallback < 0) fallback = (int)i;
+
+					/* The endpoint has answered, there is no need to wait for the hedging delay. */
+					if (hedgeAt != 0) hedgeAt = KSI_NET_getTimeMs();
+					continue;
+				}
+			}
+
+			if (res == KSI_OK) {
+				UriRetryPolicy_addSample(policy, KSI_NET_getTimeMs() - attempt->routedAt);
+				winner = (int)i;
+			} else {
+				lastError = res;
+
+				if (retries < policy->maxRetries) {
+					retryAt = KSI_NET_getTimeMs() + UriRetryPolicy_getBackoff(policy, retries++);
+				}
+			}
+		}
+	}
+
+	if (winner < 0) winner = fallback;
+
+	if (winner > 0) {
+		KSI_RequestHandle *w = attempts[winner];
+
+		KSI_LOG_debug(handle->ctx, "Response received from %s.", w->endpoint != NULL ? w->endpoint->uri : "");
+
+		/* Take over the response, the endpoint and the client, whose credentials apply to it. */
+		res = KSI_RequestHandle_adoptResponse(handle, w->response, w->response_length);
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+		w->response = NULL;
+		w->response_length = 0;
+
+		UriEndpoint_detachRequest(handle);
+		handle->endpoint = w->endpoint;
+		handle->routedAt = w->routedAt;
+		handle->isRoutePending = 0;
+		handle->client = w->client;
+		w->endpoint = NULL;
+
+		/* The timing of the handle is that of the attempt which was answered, measured from the original start. */
+		for (i = KSI_NET_PHASE_START + 1; i < KSI_NET_NOF_PHASES; i++) {
+			handle->phaseTime[i] = w->phaseTime[i];
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	for (i = 1; i < attempts_len; i++) {
+		KSI_RequestHandle_free(attempts[i]);
+	}
+	KSI_free(excluded);
+
+	return res;
+}
+
+static int sendPublicationRequest(KSI_NetworkClient *client, KSI_RequestHandle **handle) {
+	int res;
+	KSI_UriClient *uriClient = (KSI_UriClient *)client;
+
+	res = UriClient_checkTransport(uriClient, (KSI_NetworkClient *)uriClient->httpClient);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_NetworkClient_sendPublicationsFileRequest((KSI_NetworkClient *)uriClient->httpClient, handle);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
 }
 
-static int prepareAggregationRequest(KSI_NetworkClient *client, KSI_AggregationReq *req, KSI_RequestHandle **handle) {
-	KSI_UriClient *uriClient = (KSI_UriClient *)client;
-	return KSI_NetworkClient_sendSignRequest(uriClient->pAggregationClient, req, handle);
+static int uriSetEventCallbacks(KSI_NetworkClient *c) {
+	return UriClient_forEachRoute((KSI_UriClient *)c, UriEventRoute_setCallbacks, NULL);
+}
+
+static int uriOnSocketEvent(KSI_NetworkClient *c, int fd, int events) {
+	KSI_UriClient *client = (KSI_UriClient *)c;
+	size_t i;
+
+	for (i = 0; i < client->sockets_len && client->sockets[i].fd != fd; i++);
+
+	/* The socket may have been closed after the host event loop had polled it. */
+	if (i == client->sockets_len) return KSI_OK;
+
+	return client->sockets[i].route->client->onSocketEvent(client->sockets[i].route->client, fd, events);
+}
+
+static int expireTimer(UriEventRoute *route, void *arg) {
+	KSI_uint64_t now = *(KSI_uint64_t *)arg;
+
+	if (route->timerAt == 0 || route->timerAt > now) return KSI_OK;
+
+	route->timerAt = 0;
+	return route->client->onTimeout(route->client);
+}
+
+static int uriOnTimeout(KSI_NetworkClient *c) {
+	int res;
+	KSI_UriClient *client = (KSI_UriClient *)c;
+	KSI_uint64_t now = KSI_NET_getTimeMs();
+
+	/* The timer has fired and is no longer armed. */
+	client->timerAt = 0;
+
+	res = UriClient_forEachRoute(client, expireTimer, &now);
+	if (res != KSI_OK) goto cleanup;
+
+	res = UriClient_updateTimer(client);
+
+cleanup:
+
+	return res;
+}
+
+int KSI_UriClient_new(KSI_CTX *ctx, KSI_UriClient **client) {
+	int res;
+	KSI_UriClient *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (ctx == NULL || client == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_UriClient);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->httpClient = NULL;
+	tmp->tcpClient = NULL;
+	tmp->pAggregationClient = NULL;
+	tmp->pExtendClient = NULL;
+	tmp->aggrPool.list = NULL;
+	tmp->aggrPool.count = 0;
+	tmp->aggrPool.next = 0;
+	tmp->aggrPool.retry = NULL;
+	tmp->extPool.list = NULL;
+	tmp->extPool.count = 0;
+	tmp->extPool.next = 0;
+	tmp->extPool.retry = NULL;
+	tmp->balancing = KSI_URI_BALANCE_ROUND_ROBIN;
+	tmp->failureThreshold = URI_DEFAULT_FAILURE_THRESHOLD;
+	tmp->retryDelaySeconds = URI_DEFAULT_RETRY_DELAY;
+	tmp->connectionTimeoutSeconds = -1;
+	tmp->transferTimeoutSeconds = -1;
+	tmp->decorate = NULL;
+	tmp->decoratorCtx = NULL;
+	tmp->httpRoute.client = NULL;
+	tmp->tcpRoute.client = NULL;
+	tmp->sockets = NULL;
+	tmp->sockets_len = 0;
+	tmp->sockets_size = 0;
+	tmp->timerAt = 0;
+
+	res = KSI_UriClient_init(ctx, tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*client = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_UriClient_free(tmp);
+
+	return res;
+}
+
+static void uriClient_free(KSI_UriClient *client) {
+	if (client != NULL) {
+		UriEndpointPool_clear(&client->aggrPool);
+		UriEndpointPool_clear(&client->extPool);
+		UriRetryPolicy_free(client->aggrPool.retry);
+		UriRetryPolicy_free(client->extPool.retry);
+		KSI_HttpClient_free(client->httpClient);
+		KSI_TcpClient_free(client->tcpClient);
+		KSI_free(client->sockets);
+		KSI_free(client);
+	}
+}
+
+int KSI_UriClient_init(KSI_CTX *ctx, KSI_UriClient *client) {
+	int res;
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (ctx == NULL || client == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+
+	res = KSI_NetworkClient_init(ctx, &client->parent);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_HttpClient_new(ctx, &client->httpClient);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	client->pExtendClient = (KSI_NetworkClient *)client->httpClient;
+	client->pAggregationClient = (KSI_NetworkClient *)client->httpClient;
+
+	res = UriClient_addRoute(client, &client->httpRoute, (KSI_NetworkClient *)client->httpClient);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	client->parent.sendExtendRequest = prepareExtendRequest;
+	client->parent.sendSignRequest = prepareAggregationRequest;
+	client->parent.sendPublicationRequest = sendPublicationRequest;
+	client->parent.setEventCallbacks = uriSetEventCallbacks;
+	client->parent.onSocketEvent = uriOnSocketEvent;
+	client->parent.onTimeout = uriOnTimeout;
+	client->parent.implFree = (void (*)(void *))uriClient_free;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+void KSI_UriClient_free(KSI_UriClient *client) {
+	KSI_NetworkClient_free((KSI_NetworkClient *) client);
+}
+int KSI_UriClient_setPublicationUrl(KSI_UriClient *client, const char *val) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (client == NULL || val == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = KSI_HttpClient_setPublicationUrl(client->httpClient, val);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int getClientByUriScheme(const char *uri, struct http_parser_url *u, const char **replaceScheme) {
+	int res;
+	int netClient = -1;
+
+	static const struct {
+		const char *scheme;
+		const char *replace;
+		enum client_e client;
+	} schemeMap[] = {
+			{"ksi", "http", URI_HTTP },
+			{"ksi+http", "http",URI_HTTP},
+			{"ksi+https", "https", URI_HTTP},
+			{"ksi+tcp", NULL, URI_TCP},
+			{"unix", NULL, URI_UNIX},
+			{NULL, NULL, -1}
+	};
+
+	memset(u, 0, sizeof(struct http_parser_url));
+	res = http_parser_parse_url(uri, strlen(uri), 0, u);
+	if (res == 0 && (u->field_set & (1 << UF_SCHEMA)) != 0) {
+		int i = 0;
+		while (schemeMap[i].scheme != NULL) {
+			if (strlen(schemeMap[i].scheme) == u->field_data[UF_SCHEMA].len &&
+					!strncmp(schemeMap[i].scheme, uri + u->field_data[UF_SCHEMA].off, strlen(schemeMap[i].scheme))) {
+				netClient = schemeMap[i].client;
+				*replaceScheme = schemeMap[i].replace;
+				break;
+			}
+			i++;
+		}
+	}
+
+	if (netClient == -1) {
+		netClient = URI_HTTP;
+	}
+
+	return netClient;
+}
+
+/**
+ * Configures the service on the HTTP or TCP client chosen by the URI scheme. The
+ * client is created, if the corresponding pointer is \c NULL.
+ */
+static int setService(KSI_UriClient *client, enum serviceMethod_e srv, const char *uri, const char *loginId, const char *key,
+		KSI_HttpClient **httpClient, KSI_TcpClient **tcpClient, KSI_NetworkClient **selected, enum client_e *type) {
+	int res;
+	char addr[0xffff];
+	struct http_parser_url u;
+	const char *replace = NULL;
+	int c;
+
+	c = getClientByUriScheme(uri, &u, &replace);
+
+	switch (c) {
+		case URI_HTTP:
+			if (replace != NULL) {
+				/* Create a new URL where the scheme is replaced with the correct one. */
+				KSI_snprintf(addr, sizeof(addr), "%s%s", replace, uri + u.field_data[UF_SCHEMA].off + u.field_data[UF_SCHEMA].len);
+			}
+
+			/* Make sure the HTTP client is initialized. */
+			if (*httpClient == NULL) {
+				res = KSI_HttpClient_new(client->parent.ctx, httpClient);
+				if (res != KSI_OK) goto cleanup;
+
+				if (client->connectionTimeoutSeconds >= 0) KSI_HttpClient_setConnectTimeoutSeconds(*httpClient, client->connectionTimeoutSeconds);
+				if (client->transferTimeoutSeconds >= 0) KSI_HttpClient_setReadTimeoutSeconds(*httpClient, client->transferTimeoutSeconds);
+			}
+
+			if (srv == SRV_EXTEND) {
+				res = KSI_HttpClient_setExtender(*httpClient, replace != NULL ? addr : uri, loginId, key);
+			} else {
+				res = KSI_HttpClient_setAggregator(*httpClient, replace != NULL ? addr : uri, loginId, key);
+			}
+			if (res != KSI_OK) goto cleanup;
+
+			*selected = (KSI_NetworkClient *)*httpClient;
+
+			break;
+		case URI_TCP:
+			if ((u.field_set & (1 << UF_HOST)) == 0 || u.port == 0) {
+				res = KSI_INVALID_ARGUMENT;
+				goto cleanup;
+			}
+
+			/* Make sure the TCP client is initialized. */
+			if (*tcpClient == NULL) {
+				res = KSI_TcpClient_new(client->parent.ctx, tcpClient);
+				if (res != KSI_OK) goto cleanup;
+
+				if (client->transferTimeoutSeconds >= 0) KSI_TcpClient_setTransferTimeoutSeconds(*tcpClient, client->transferTimeoutSeconds);
+			}
+
+			/* Extract the host to a proper null-terminated string. */
+			KSI_snprintf(addr, sizeof(addr), "%.*s", u.field_data[UF_HOST].len, uri + u.field_data[UF_HOST].off);
+
+			if (srv == SRV_EXTEND) {
+				res = KSI_TcpClient_setExtender(*tcpClient, addr, u.port, loginId, key);
+			} else {
+				res = KSI_TcpClient_setAggregator(*tcpClient, addr, u.port, loginId, key);
+			}
+			if (res != KSI_OK) goto cleanup;
+
+			*selected = (KSI_NetworkClient *)*tcpClient;
+
+			break;
+		case URI_UNIX:
+			/* The socket path is given as the path of the URI, e.g unix:///run/ksi/gateway.sock. */
+			if ((u.field_set & (1 << UF_PATH)) == 0 || u.field_data[UF_PATH].len <= 1) {
+				res = KSI_INVALID_ARGUMENT;
+				goto cleanup;
+			}
+
+			if (*tcpClient == NULL) {
+				res = KSI_TcpClient_new(client->parent.ctx, tcpClient);
+				if (res != KSI_OK) goto cleanup;
+
+				if (client->transferTimeoutSeconds >= 0) KSI_TcpClient_setTransferTimeoutSeconds(*tcpClient, client->transferTimeoutSeconds);
+			}
+
+			KSI_snprintf(addr, sizeof(addr), "%.*s", u.field_data[UF_PATH].len, uri + u.field_data[UF_PATH].off);
+
+			if (srv == SRV_EXTEND) {
+				res = KSI_TcpClient_setExtenderUnix(*tcpClient, addr, loginId, key);
+			} else {
+				res = KSI_TcpClient_setAggregatorUnix(*tcpClient, addr, loginId, key);
+			}
+			if (res != KSI_OK) goto cleanup;
+
+			*selected = (KSI_NetworkClient *)*tcpClient;
+
+			break;
+		default:
+			res = KSI_UNKNOWN_ERROR;
+			goto cleanup;
+	}
+
+	*type = (enum client_e)c;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
 }
 
-static int sendPublicationRequest(KSI_NetworkClient *client, KSI_RequestHandle **handle) {
-	int res;
-	KSI_UriClient *uriClient = (KSI_UriClient *)client;
+static int setEndpoint(KSI_UriClient *client, enum serviceMethod_e srv, const char *uri, const char *loginId, const char *key) {
+	int res;
+	UriEndpointPool *pool = NULL;
+	KSI_NetworkClient **selected = NULL;
+	KSI_NetworkClient *netClient = NULL;
+	enum client_e type;
+
+	if (client == NULL || uri == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	pool = (srv == SRV_EXTEND) ? &client->extPool : &client->aggrPool;
+	selected = (srv == SRV_EXTEND) ? &client->pExtendClient : &client->pAggregationClient;
+
+	res = setService(client, srv, uri, loginId, key, &client->httpClient, &client->tcpClient, &netClient, &type);
+	if (res != KSI_OK) goto cleanup;
+
+	/* The TCP client is created with the first TCP endpoint. */
+	res = UriClient_addRoute(client, &client->tcpRoute, (KSI_NetworkClient *)client->tcpClient);
+	if (res != KSI_OK) goto cleanup;
+
+	/* Set the client to be used in the requests. */
+	*selected = netClient;
 
-	res = KSI_NetworkClient_sendPublicationsFileRequest((KSI_NetworkClient *)uriClient->httpClient, handle);
+	/* The single endpoint is served by the shared client. */
+	UriEndpointPool_clear(pool);
+	res = UriEndpointPool_add(client, pool, uri, netClient, type, 0);
 	if (res != KSI_OK) goto cleanup;
 
 	res = KSI_OK;
@@ -52,84 +1433,101 @@ cleanup:
 	return res;
 }
 
-int KSI_UriClient_new(KSI_CTX *ctx, KSI_UriClient **client) {
+static int addEndpoint(KSI_UriClient *client, enum serviceMethod_e srv, const char *uri, const char *loginId, const char *key) {
 	int res;
-	KSI_UriClient *tmp = NULL;
-
-	KSI_ERR_clearErrors(ctx);
+	UriEndpointPool *pool = NULL;
+	KSI_HttpClient *http = NULL;
+	KSI_TcpClient *tcp = NULL;
+	KSI_NetworkClient *netClient = NULL;
+	enum client_e type;
 
-	if (ctx == NULL || client == NULL) {
-		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+	if (client == NULL || uri == NULL) {
+		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
-	tmp = KSI_new(KSI_UriClient);
-	if (tmp == NULL) {
-		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+	pool = (srv == SRV_EXTEND) ? &client->extPool : &client->aggrPool;
+	if (pool->count == 0) {
+		res = setEndpoint(client, srv, uri, loginId, key);
 		goto cleanup;
 	}
 
-	tmp->httpClient = NULL;
-	tmp->tcpClient = NULL;
-	tmp->pAggregationClient = NULL;
-	tmp->pExtendClient = NULL;
+	/* Every additional endpoint gets a transport of its own. */
+	res = setService(client, srv, uri, loginId, key, &http, &tcp, &netClient, &type);
+	if (res != KSI_OK) goto cleanup;
 
-	res = KSI_UriClient_init(ctx, tmp);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
-	}
+	res = UriEndpointPool_add(client, pool, uri, netClient, type, 1);
+	if (res != KSI_OK) goto cleanup;
 
-	*client = tmp;
-	tmp = NULL;
+	http = NULL;
+	tcp = NULL;
 
 	res = KSI_OK;
 
 cleanup:
 
-	KSI_UriClient_free(tmp);
+	KSI_HttpClient_free(http);
+	KSI_TcpClient_free(tcp);
 
 	return res;
 }
 
-static void uriClient_free(KSI_UriClient *client) {
-	if (client != NULL) {
-		KSI_HttpClient_free(client->httpClient);
-		KSI_TcpClient_free(client->tcpClient);
-		KSI_free(client);
-	}
+int KSI_UriClient_setExtender(KSI_UriClient *client, const char *uri, const char *loginId, const char *key) {
+	return setEndpoint(client, SRV_EXTEND, uri, loginId, key);
 }
 
-int KSI_UriClient_init(KSI_CTX *ctx, KSI_UriClient *client) {
-	int res;
+int KSI_UriClient_setAggregator(KSI_UriClient *client, const char *uri, const char *loginId, const char *key) {
+	return setEndpoint(client, SRV_AGGREGATE, uri, loginId, key);
+}
 
-	KSI_ERR_clearErrors(ctx);
+int KSI_UriClient_addExtender(KSI_UriClient *client, const char *uri, const char *loginId, const char *key) {
+	return addEndpoint(client, SRV_EXTEND, uri, loginId, key);
+}
 
-	if (ctx == NULL || client == NULL) {
-		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+int KSI_UriClient_addAggregator(KSI_UriClient *client, const char *uri, const char *loginId, const char *key) {
+	return addEndpoint(client, SRV_AGGREGATE, uri, loginId, key);
+}
+
+int KSI_UriClient_setLoadBalancing(KSI_UriClient *client, KSI_UriBalancing policy) {
+	int res;
+
+	if (client == NULL || policy < KSI_URI_BALANCE_ROUND_ROBIN || policy > KSI_URI_BALANCE_LATENCY) {
+		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
+	client->balancing = policy;
 
-	res = KSI_NetworkClient_init(ctx, &client->parent);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static void UriEndpointPool_setHealthCheck(UriEndpointPool *pool, unsigned failureThreshold, unsigned retryDelaySeconds) {
+	size_t i;
+
+	for (i = 0; i < pool->count; i++) {
+		pool->list[i]->failureThreshold = failureThreshold;
+		pool->list[i]->retryDelaySeconds = retryDelaySeconds;
+		if (failureThreshold == 0) pool->list[i]->downUntil = 0;
 	}
+}
 
-	res = KSI_HttpClient_new(ctx, &client->httpClient);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
+int KSI_UriClient_setHealthCheck(KSI_UriClient *client, unsigned failureThreshold, unsigned retryDelaySeconds) {
+	int res;
+
+	if (client == NULL) {
+		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
-	client->pExtendClient = (KSI_NetworkClient *)client->httpClient;
-	client->pAggregationClient = (KSI_NetworkClient *)client->httpClient;
+	client->failureThreshold = failureThreshold;
+	client->retryDelaySeconds = retryDelaySeconds;
 
-	client->parent.sendExtendRequest = prepareExtendRequest;
-	client->parent.sendSignRequest = prepareAggregationRequest;
-	client->parent.sendPublicationRequest = sendPublicationRequest;
-	client->parent.implFree = (void (*)(void *))uriClient_free;
+	UriEndpointPool_setHealthCheck(&client->aggrPool, failureThreshold, retryDelaySeconds);
+	UriEndpointPool_setHealthCheck(&client->extPool, failureThreshold, retryDelaySeconds);
 
 	res = KSI_OK;
 
@@ -138,20 +1536,25 @@ cleanup:
 	return res;
 }
 
-void KSI_UriClient_free(KSI_UriClient *client) {
-	KSI_NetworkClient_free((KSI_NetworkClient *) client);
-}
-int KSI_UriClient_setPublicationUrl(KSI_UriClient *client, const char *val) {
-	int res = KSI_UNKNOWN_ERROR;
+int KSI_UriClient_setHedging(KSI_UriClient *client, unsigned percentile, unsigned minDelayMs) {
+	int res;
+	UriRetryPolicy *aggr = NULL;
+	UriRetryPolicy *ext = NULL;
 
-	if (client == NULL || val == NULL) {
+	if (client == NULL || percentile > 99) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
 
-	res = KSI_HttpClient_setPublicationUrl(client->httpClient, val);
+	res = UriEndpointPool_getRetryPolicy(&client->aggrPool, &aggr);
+	if (res != KSI_OK) goto cleanup;
+
+	res = UriEndpointPool_getRetryPolicy(&client->extPool, &ext);
 	if (res != KSI_OK) goto cleanup;
 
+	aggr->hedgePercentile = ext->hedgePercentile = percentile;
+	aggr->hedgeMinDelayMs = ext->hedgeMinDelayMs = minDelayMs;
+
 	res = KSI_OK;
 
 cleanup:
@@ -159,97 +1562,74 @@ cleanup:
 	return res;
 }
 
-enum serviceMethod_e {
-	SRV_EXTEND,
-	SRV_AGGREGATE
-};
-
-int getClientByUriScheme(const char *uri, struct http_parser_url *u, const char **replaceScheme) {
+int KSI_UriClient_setRetry(KSI_UriClient *client, unsigned maxRetries, unsigned backoffMs, unsigned budgetPercent) {
 	int res;
-	int netClient = -1;
-
-	static const struct {
-		const char *scheme;
-		const char *replace;
-		enum client_e client;
-	} schemeMap[] = {
-			{"ksi", "http", URI_HTTP },
-			{"ksi+http", "http",URI_HTTP},
-			{"ksi+https", "https", URI_HTTP},
-			{"ksi+tcp", NULL, URI_TCP},
-			{NULL, NULL, -1}
-	};
+	UriRetryPolicy *aggr = NULL;
+	UriRetryPolicy *ext = NULL;
 
-	memset(u, 0, sizeof(struct http_parser_url));
-	res = http_parser_parse_url(uri, strlen(uri), 0, u);
-	if (res == 0 && (u->field_set & (1 << UF_SCHEMA)) != 0) {
-		int i = 0;
-		while (schemeMap[i].scheme != NULL) {
-			if (strlen(schemeMap[i].scheme) == u->field_data[UF_SCHEMA].len &&
-					!strncmp(schemeMap[i].scheme, uri + u->field_data[UF_SCHEMA].off, strlen(schemeMap[i].scheme))) {
-				netClient = schemeMap[i].client;
-				*replaceScheme = schemeMap[i].replace;
-				break;
-			}
-			i++;
-		}
+	if (client == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
 	}
 
-	if (netClient == -1) {
-		netClient = URI_HTTP;
-	}
+	res = UriEndpointPool_getRetryPolicy(&client->aggrPool, &aggr);
+	if (res != KSI_OK) goto cleanup;
 
-	return netClient;
+	res = UriEndpointPool_getRetryPolicy(&client->extPool, &ext);
+	if (res != KSI_OK) goto cleanup;
+
+	aggr->maxRetries = ext->maxRetries = maxRetries;
+	aggr->backoffMs = ext->backoffMs = backoffMs;
+	aggr->budgetPercent = ext->budgetPercent = budgetPercent;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
 }
 
-int KSI_UriClient_setExtender(KSI_UriClient *client, const char *uri, const char *loginId, const char *key) {
+int KSI_UriClient_setAdaptiveTimeout(KSI_UriClient *client, unsigned factor, unsigned minTimeoutMs) {
 	int res;
-	char addr[0xffff];
-	struct http_parser_url u;
-	const char *replace = NULL;
-	int c;
+	UriRetryPolicy *aggr = NULL;
+	UriRetryPolicy *ext = NULL;
 
-	c = getClientByUriScheme(uri, &u, &replace);
+	if (client == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
 
-	switch (c) {
-		case URI_HTTP:
-			if (replace != NULL) {
-				/* Create a new URL where the scheme is replaced with the correct one. */
-				KSI_snprintf(addr, sizeof(addr), "%s%s", replace, uri + u.field_data[UF_SCHEMA].off + u.field_data[UF_SCHEMA].len);
-			}
+	res = UriEndpointPool_getRetryPolicy(&client->aggrPool, &aggr);
+	if (res != KSI_OK) goto cleanup;
 
-			res = KSI_HttpClient_setExtender(client->httpClient, replace != NULL ? addr : uri, loginId, key);
-			if (res != KSI_OK) goto cleanup;
+	res = UriEndpointPool_getRetryPolicy(&client->extPool, &ext);
+	if (res != KSI_OK) goto cleanup;
 
-			/* Set the client to be used in extending requests. */
-			client->pExtendClient = (KSI_NetworkClient *)client->httpClient;
+	aggr->timeoutFactor = ext->timeoutFactor = factor;
+	aggr->timeoutMinMs = ext->timeoutMinMs = minTimeoutMs;
 
-			break;
-		case URI_TCP:
-			if ((u.field_set & (1 << UF_HOST)) == 0 || u.port == 0) {
-				res = KSI_INVALID_ARGUMENT;
-				goto cleanup;
-			}
+	res = KSI_OK;
 
-			/* Make sure the TCP client is initialized. */
-			if (client->tcpClient == NULL) {
-				res = KSI_TcpClient_new(client->parent.ctx, &client->tcpClient);
-				if (res != KSI_OK) goto cleanup;
-			}
+cleanup:
 
-			/* Extract the host to a proper null-terminated string. */
-			KSI_snprintf(addr, sizeof(addr), "%.*s", u.field_data[UF_HOST].len, uri + u.field_data[UF_HOST].off);
+	return res;
+}
 
-			res = KSI_TcpClient_setExtender(client->tcpClient, addr, u.port, loginId, key);
-			if (res != KSI_OK) goto cleanup;
+/* Replaces the decorators of the endpoint transports of the pool. */
+static int UriEndpointPool_decorate(KSI_UriClient *client, UriEndpointPool *pool) {
+	int res;
+	size_t i;
 
-			/* Set the client to be used in extending requests. */
-			client->pExtendClient = (KSI_NetworkClient *)client->tcpClient;
+	for (i = 0; i < pool->count; i++) {
+		KSI_UriEndpoint *ep = pool->list[i];
 
-			break;
-		default:
-			res = KSI_UNKNOWN_ERROR;
-			goto cleanup;
+		KSI_NetworkClient_free(ep->sender);
+		ep->sender = NULL;
+
+		if (client->decorate == NULL || ep->client == NULL) continue;
+
+		res = client->decorate(client->decoratorCtx, ep->client, &ep->sender);
+		if (res != KSI_OK) goto cleanup;
 	}
 
 	res = KSI_OK;
@@ -259,54 +1639,126 @@ cleanup:
 	return res;
 }
 
-int KSI_UriClient_setAggregator(KSI_UriClient *client, const char *uri, const char *loginId, const char *key) {
+int KSI_UriClient_setEndpointDecorator(KSI_UriClient *client, KSI_UriEndpointDecorator decorate, void *decoratorCtx) {
 	int res;
-	char addr[0xffff];
-	struct http_parser_url u;
-	const char *replace = NULL;
-	int c;
 
-	c = getClientByUriScheme(uri, &u, &replace);
+	if (client == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
 
-	switch (c) {
-		case URI_HTTP:
-			if (replace != NULL) {
-				/* Create a new URL where the scheme is replaced with the correct one. */
-				KSI_snprintf(addr, sizeof(addr), "%s%s", replace, uri + u.field_data[UF_SCHEMA].off + u.field_data[UF_SCHEMA].len);
-			}
+	KSI_ERR_clearErrors(client->parent.ctx);
 
-			res = KSI_HttpClient_setAggregator(client->httpClient, replace != NULL ? addr : uri, loginId, key);
-			if (res != KSI_OK) goto cleanup;
+	client->decorate = decorate;
+	client->decoratorCtx = decoratorCtx;
+
+	res = UriEndpointPool_decorate(client, &client->aggrPool);
+	if (res != KSI_OK) {
+		KSI_pushError(client->parent.ctx, res, NULL);
+		goto cleanup;
+	}
 
-			/* Set the client to be used in extending requests. */
-			client->pAggregationClient = (KSI_NetworkClient *)client->httpClient;
+	res = UriEndpointPool_decorate(client, &client->extPool);
+	if (res != KSI_OK) {
+		KSI_pushError(client->parent.ctx, res, NULL);
+		goto cleanup;
+	}
 
-			break;
-		case URI_TCP:
-			if ((u.field_set & (1 << UF_HOST)) == 0 || u.port == 0) {
-				res = KSI_INVALID_ARGUMENT;
-				goto cleanup;
-			}
+	res = KSI_OK;
 
-			/* Make sure the TCP client is initialized. */
-			if (client->tcpClient == NULL) {
-				res = KSI_TcpClient_new(client->parent.ctx, &client->tcpClient);
-				if (res != KSI_OK) goto cleanup;
-			}
+cleanup:
 
-			/* Extract the host to a proper null-terminated string. */
-			KSI_snprintf(addr, sizeof(addr), "%.*s", u.field_data[UF_HOST].len, uri + u.field_data[UF_HOST].off);
+	return res;
+}
 
-			res = KSI_TcpClient_setAggregator(client->tcpClient, addr, u.port, loginId, key);
-			if (res != KSI_OK) goto cleanup;
+static int UriEndpointPool_get(const UriEndpointPool *pool, size_t index, const KSI_UriEndpoint **endpoint) {
+	if (endpoint == NULL || index >= pool->count) return KSI_INVALID_ARGUMENT;
+	*endpoint = pool->list[index];
+	return KSI_OK;
+}
 
-			/* Set the client to be used in extending requests. */
-			client->pAggregationClient = (KSI_NetworkClient *)client->tcpClient;
+int KSI_UriClient_getAggregatorCount(const KSI_UriClient *client, size_t *count) {
+	if (client == NULL || count == NULL) return KSI_INVALID_ARGUMENT;
+	*count = client->aggrPool.count;
+	return KSI_OK;
+}
 
-			break;
-		default:
-			res = KSI_UNKNOWN_ERROR;
-			goto cleanup;
+int KSI_UriClient_getAggregator(const KSI_UriClient *client, size_t index, const KSI_UriEndpoint **endpoint) {
+	if (client == NULL) return KSI_INVALID_ARGUMENT;
+	return UriEndpointPool_get(&client->aggrPool, index, endpoint);
+}
+
+int KSI_UriClient_getExtenderCount(const KSI_UriClient *client, size_t *count) {
+	if (client == NULL || count == NULL) return KSI_INVALID_ARGUMENT;
+	*count = client->extPool.count;
+	return KSI_OK;
+}
+
+int KSI_UriClient_getExtender(const KSI_UriClient *client, size_t index, const KSI_UriEndpoint **endpoint) {
+	if (client == NULL) return KSI_INVALID_ARGUMENT;
+	return UriEndpointPool_get(&client->extPool, index, endpoint);
+}
+
+int KSI_RequestHandle_getEndpoint(const KSI_RequestHandle *handle, const KSI_UriEndpoint **endpoint) {
+	if (handle == NULL || endpoint == NULL) return KSI_INVALID_ARGUMENT;
+	*endpoint = handle->endpoint;
+	return KSI_OK;
+}
+
+int KSI_UriEndpoint_getUri(const KSI_UriEndpoint *endpoint, const char **uri) {
+	if (endpoint == NULL || uri == NULL) return KSI_INVALID_ARGUMENT;
+	*uri = endpoint->uri;
+	return KSI_OK;
+}
+
+int KSI_UriEndpoint_getOutstanding(const KSI_UriEndpoint *endpoint, size_t *count) {
+	if (endpoint == NULL || count == NULL) return KSI_INVALID_ARGUMENT;
+	*count = endpoint->outstanding;
+	return KSI_OK;
+}
+
+int KSI_UriEndpoint_getRequestCount(const KSI_UriEndpoint *endpoint, size_t *requests, size_t *failures) {
+	if (endpoint == NULL) return KSI_INVALID_ARGUMENT;
+	if (requests != NULL) *requests = endpoint->requestCount;
+	if (failures != NULL) *failures = endpoint->failureCount;
+	return KSI_OK;
+}
+
+int KSI_UriEndpoint_getLatency(const KSI_UriEndpoint *endpoint, double *latencyMs) {
+	if (endpoint == NULL || latencyMs == NULL) return KSI_INVALID_ARGUMENT;
+	*latencyMs = endpoint->latencyMs;
+	return KSI_OK;
+}
+
+int KSI_UriEndpoint_isHealthy(const KSI_UriEndpoint *endpoint, int *healthy) {
+	if (endpoint == NULL || healthy == NULL) return KSI_INVALID_ARGUMENT;
+	*healthy = endpoint->downUntil == 0 || endpoint->downUntil <= KSI_NET_getTimeMs();
+	return KSI_OK;
+}
+
+/**
+ * Applies the timeout to the transports owned by the endpoints of the pool.
+ */
+static int UriEndpointPool_setTimeout(UriEndpointPool *pool, int timeout, int isTransfer) {
+	int res;
+	size_t i;
+
+	for (i = 0; i < pool->count; i++) {
+		KSI_UriEndpoint *ep = pool->list[i];
+
+		if (!ep->ownsClient || ep->client == NULL) continue;
+
+		if (ep->clientType == URI_HTTP) {
+			if (isTransfer) {
+				res = KSI_HttpClient_setReadTimeoutSeconds((KSI_HttpClient *)ep->client, timeout);
+			} else {
+				res = KSI_HttpClient_setConnectTimeoutSeconds((KSI_HttpClient *)ep->client, timeout);
+			}
+			if (res != KSI_OK) goto cleanup;
+		} else if ((ep->clientType == URI_TCP || ep->clientType == URI_UNIX) && isTransfer) {
+			res = KSI_TcpClient_setTransferTimeoutSeconds((KSI_TcpClient *)ep->client, timeout);
+			if (res != KSI_OK) goto cleanup;
+		}
 	}
 
 	res = KSI_OK;
@@ -324,6 +1776,14 @@ int KSI_UriClient_setConnectionTimeoutSeconds(KSI_UriClient *client, int timeout
 		if (res != KSI_OK) goto cleanup;
 	}
 
+	res = UriEndpointPool_setTimeout(&client->aggrPool, timeout, 0);
+	if (res != KSI_OK) goto cleanup;
+
+	res = UriEndpointPool_setTimeout(&client->extPool, timeout, 0);
+	if (res != KSI_OK) goto cleanup;
+
+	client->connectionTimeoutSeconds = timeout;
+
 	res = KSI_OK;
 
 cleanup:
@@ -343,6 +1803,14 @@ int KSI_UriClient_setTransferTimeoutSeconds(KSI_UriClient *client, int timeout)
 		if (res != KSI_OK) goto cleanup;
 	}
 
+	res = UriEndpointPool_setTimeout(&client->aggrPool, timeout, 1);
+	if (res != KSI_OK) goto cleanup;
+
+	res = UriEndpointPool_setTimeout(&client->extPool, timeout, 1);
+	if (res != KSI_OK) goto cleanup;
+
+	client->transferTimeoutSeconds = timeout;
+
 	res = KSI_OK;
 
 cleanup:
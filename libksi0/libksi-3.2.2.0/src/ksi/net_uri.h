@@ -31,6 +31,33 @@ extern "C" {
 
 	typedef struct KSI_UriClient_st KSI_UriClient;
 
+	/**
+	 * A single aggregator or extender endpoint of a #KSI_UriClient service pool.
+	 */
+	typedef struct KSI_UriEndpoint_st KSI_UriEndpoint;
+
+	/**
+	 * Load balancing policies for choosing among several aggregator or extender endpoints.
+	 */
+	typedef enum KSI_UriBalancing_en {
+		/** Use the endpoints in turns. */
+		KSI_URI_BALANCE_ROUND_ROBIN = 0,
+		/** Use the endpoint with the least requests waiting for a response. */
+		KSI_URI_BALANCE_LEAST_OUTSTANDING,
+		/** Use the endpoint with the lowest expected wait, based on the moving average of
+		 * its response times and the number of outstanding requests. */
+		KSI_URI_BALANCE_LATENCY
+	} KSI_UriBalancing;
+
+	/**
+	 * Creates a client in front of the transport of an endpoint, see #KSI_UriClient_setEndpointDecorator.
+	 * \param[in]	decoratorCtx	The context given to #KSI_UriClient_setEndpointDecorator.
+	 * \param[in]	inner			The transport of the endpoint, which remains owned by the URI client.
+	 * \param[out]	client			Pointer to the receiving pointer, the new client is owned by the URI client.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	typedef int (*KSI_UriEndpointDecorator)(void *decoratorCtx, KSI_NetworkClient *inner, KSI_NetworkClient **client);
+
 	/**
 	 * Creates a new URI client.
 	 * \param[in]	ctx			KSI context.
@@ -63,9 +90,205 @@ extern "C" {
 	 */
 	int KSI_UriClient_setPublicationUrl(KSI_UriClient *client, const char *val);
 
+	/**
+	 * Setters for the extender and the aggregator. The transport is chosen by the scheme of
+	 * the URI: \c ksi+tcp:// for TCP, \c unix:// followed by the socket path (e.g
+	 * \c unix:///run/ksi/gateway.sock) for a local gateway listening on a Unix domain socket,
+	 * and HTTP for the rest.
+	 */
 	int KSI_UriClient_setExtender(KSI_UriClient *client, const char *uri, const char *loginId, const char *key);
 	int KSI_UriClient_setAggregator(KSI_UriClient *client, const char *uri, const char *loginId, const char *key);
 
+	/**
+	 * Adds an extender endpoint to the pool of extenders. The requests are distributed
+	 * among the endpoints according to the load balancing policy (see #KSI_UriClient_setLoadBalancing).
+	 * If the pool is empty, the call is equivalent to #KSI_UriClient_setExtender, which
+	 * in turn replaces the whole pool with a single endpoint.
+	 * \param[in]	client		Pointer to the URI client.
+	 * \param[in]	uri			Extender URI.
+	 * \param[in]	loginId		Login id for the endpoint.
+	 * \param[in]	key			Shared HMAC secret for the endpoint.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriClient_addExtender(KSI_UriClient *client, const char *uri, const char *loginId, const char *key);
+
+	/**
+	 * Adds an aggregator endpoint to the pool of aggregators. See #KSI_UriClient_addExtender.
+	 * \param[in]	client		Pointer to the URI client.
+	 * \param[in]	uri			Aggregator URI.
+	 * \param[in]	loginId		Login id for the endpoint.
+	 * \param[in]	key			Shared HMAC secret for the endpoint.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriClient_addAggregator(KSI_UriClient *client, const char *uri, const char *loginId, const char *key);
+
+	/**
+	 * Sets the load balancing policy for the aggregator and extender pools. The default
+	 * is #KSI_URI_BALANCE_ROUND_ROBIN.
+	 * \param[in]	client		Pointer to the URI client.
+	 * \param[in]	policy		Load balancing policy.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriClient_setLoadBalancing(KSI_UriClient *client, KSI_UriBalancing policy);
+
+	/**
+	 * Configures the passive health checking of the endpoints. After \c failureThreshold
+	 * consecutive failed requests the endpoint is not used for \c retryDelaySeconds, after
+	 * which a single request is let through to probe it. While all endpoints of a pool are
+	 * down, the one to recover first is used. The defaults are 3 failures and 30 seconds.
+	 * \param[in]	client				Pointer to the URI client.
+	 * \param[in]	failureThreshold	Number of consecutive failures, 0 disables health checking.
+	 * \param[in]	retryDelaySeconds	Time an unhealthy endpoint is excluded.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriClient_setHealthCheck(KSI_UriClient *client, unsigned failureThreshold, unsigned retryDelaySeconds);
+
+	/**
+	 * Enables hedged requests. When a request routed to a pool of several endpoints has not been
+	 * answered within the \c percentile of the recent response times of the pool, a duplicate is
+	 * sent to another endpoint and the first response is used. Until enough responses have been
+	 * observed, the delay is 500 milliseconds. Duplicates are limited by the retry budget (see
+	 * #KSI_UriClient_setRetry). A response with an error status is used only if none of the pending
+	 * requests is answered successfully; when it arrives before the delay, the duplicate is sent at once.
+	 * Hedging requires a transport supporting #KSI_RequestHandle_setPollResponseFn, otherwise the
+	 * response is waited for without sending duplicates.
+	 * \param[in]	client		Pointer to the URI client.
+	 * \param[in]	percentile	Latency percentile (1..99), 0 disables hedging.
+	 * \param[in]	minDelayMs	Lower bound of the delay in milliseconds.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriClient_setHedging(KSI_UriClient *client, unsigned percentile, unsigned minDelayMs);
+
+	/**
+	 * Configures resending failed requests to other endpoints of the pool. Once every endpoint has
+	 * been tried, the endpoints are tried again, so a pool of a single endpoint is retried as well.
+	 * The n-th retry is delayed by a random time between a half and the whole of
+	 * <tt>backoffMs * 2^n</tt>. Only the requests failing in the transport are retried, the responses
+	 * with an error status are returned as they are. Without #KSI_RequestHandle_setPollResponseFn
+	 * support in the transport, each attempt is read until it completes before the next one is sent.
+	 * Every request earns \c budgetPercent hundredths of a retry to the budget shared by retries and
+	 * hedged requests, so that at most the given share of the traffic is duplicated. The default
+	 * budget is 10 percent.
+	 * \param[in]	client			Pointer to the URI client.
+	 * \param[in]	maxRetries		Maximum number of retries per request, 0 disables retrying.
+	 * \param[in]	backoffMs		Base delay of the exponential backoff in milliseconds.
+	 * \param[in]	budgetPercent	Retries per 100 requests.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriClient_setRetry(KSI_UriClient *client, unsigned maxRetries, unsigned backoffMs, unsigned budgetPercent);
+
+	/**
+	 * Enables the adaptive response timeout. Once enough responses have been observed, a request
+	 * routed to a pool fails with #KSI_NETWORK_RECIEVE_TIMEOUT, when no response is received within
+	 * \c factor times the 99th percentile of the recent response times, but not earlier than
+	 * \c minTimeoutMs. The transfer timeout of the transport still applies. Like hedging, the
+	 * adaptive timeout requires a transport supporting #KSI_RequestHandle_setPollResponseFn.
+	 * \param[in]	client			Pointer to the URI client.
+	 * \param[in]	factor			Multiplier of the 99th percentile, 0 disables the adaptive timeout.
+	 * \param[in]	minTimeoutMs	Lower bound of the timeout in milliseconds.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriClient_setAdaptiveTimeout(KSI_UriClient *client, unsigned factor, unsigned minTimeoutMs);
+
+	/**
+	 * Sends the aggregation and extension requests to every endpoint through a client created by
+	 * \c decorate around the transport of the endpoint. Unlike a client wrapping the URI client, the
+	 * decorating client sees every request sent to an endpoint, including the hedged requests and the
+	 * retries, and the statistics of the endpoint include its effect. The endpoints configured before
+	 * and after the call are decorated alike.
+	 * \param[in]	client			Pointer to the URI client.
+	 * \param[in]	decorate		Function creating the decorating clients, \c NULL removes the decorators.
+	 * \param[in]	decoratorCtx	Context passed to \c decorate, it has to outlive the URI client.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriClient_setEndpointDecorator(KSI_UriClient *client, KSI_UriEndpointDecorator decorate, void *decoratorCtx);
+
+	/**
+	 * Returns the number of configured aggregator endpoints.
+	 * \param[in]	client		Pointer to the URI client.
+	 * \param[out]	count		Pointer to the receiving variable.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriClient_getAggregatorCount(const KSI_UriClient *client, size_t *count);
+
+	/**
+	 * Returns an aggregator endpoint. The endpoint belongs to the client and may not be freed.
+	 * \param[in]	client		Pointer to the URI client.
+	 * \param[in]	index		Index of the endpoint, in the order of configuration.
+	 * \param[out]	endpoint	Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriClient_getAggregator(const KSI_UriClient *client, size_t index, const KSI_UriEndpoint **endpoint);
+
+	/**
+	 * Returns the number of configured extender endpoints.
+	 * \param[in]	client		Pointer to the URI client.
+	 * \param[out]	count		Pointer to the receiving variable.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriClient_getExtenderCount(const KSI_UriClient *client, size_t *count);
+
+	/**
+	 * Returns an extender endpoint. The endpoint belongs to the client and may not be freed.
+	 * \param[in]	client		Pointer to the URI client.
+	 * \param[in]	index		Index of the endpoint, in the order of configuration.
+	 * \param[out]	endpoint	Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriClient_getExtender(const KSI_UriClient *client, size_t index, const KSI_UriEndpoint **endpoint);
+
+	/**
+	 * Returns the endpoint the request was routed to. The output is \c NULL, if the request
+	 * was not sent by a #KSI_UriClient with configured endpoints. The endpoint remains valid
+	 * for the lifetime of the handle.
+	 * \param[in]	handle		Request handle.
+	 * \param[out]	endpoint	Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_RequestHandle_getEndpoint(const KSI_RequestHandle *handle, const KSI_UriEndpoint **endpoint);
+
+	/**
+	 * Getter for the URI of the endpoint.
+	 * \param[in]	endpoint	The endpoint.
+	 * \param[out]	uri			Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriEndpoint_getUri(const KSI_UriEndpoint *endpoint, const char **uri);
+
+	/**
+	 * Getter for the number of requests waiting for a response from the endpoint.
+	 * \param[in]	endpoint	The endpoint.
+	 * \param[out]	count		Pointer to the receiving variable.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriEndpoint_getOutstanding(const KSI_UriEndpoint *endpoint, size_t *count);
+
+	/**
+	 * Getter for the total number of requests and failed requests routed to the endpoint.
+	 * \param[in]	endpoint	The endpoint.
+	 * \param[out]	requests	Pointer to the receiving variable, may be \c NULL.
+	 * \param[out]	failures	Pointer to the receiving variable, may be \c NULL.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriEndpoint_getRequestCount(const KSI_UriEndpoint *endpoint, size_t *requests, size_t *failures);
+
+	/**
+	 * Getter for the moving average of the response time of the endpoint in milliseconds.
+	 * The value is 0 until the first successful response.
+	 * \param[in]	endpoint	The endpoint.
+	 * \param[out]	latencyMs	Pointer to the receiving variable.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriEndpoint_getLatency(const KSI_UriEndpoint *endpoint, double *latencyMs);
+
+	/**
+	 * Returns whether the endpoint is currently in rotation.
+	 * \param[in]	endpoint	The endpoint.
+	 * \param[out]	healthy		Pointer to the receiving variable, set to 0 if the endpoint is down.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriEndpoint_isHealthy(const KSI_UriEndpoint *endpoint, int *healthy);
+
 	int KSI_UriClient_setTransferTimeoutSeconds(KSI_UriClient *client, int timeout);
 	int KSI_UriClient_setConnectionTimeoutSeconds(KSI_UriClient *client, int timeout);
 
@@ -20,6 +20,7 @@
 #ifndef NET_URI_IMPL_H_
 #define NET_URI_IMPL_H_
 
+#include "net_uri.h"
 #include "net_http.h"
 #include "net_tcp.h"
 #include "net_impl.h"
@@ -32,9 +33,135 @@ extern "C" {
 	enum client_e {
 		URI_HTTP,
 		URI_TCP,
+		/** Unix domain socket, served by the TCP client. */
+		URI_UNIX,
 		URI_CLIENT_COUNT
 	};
 
+	/**
+	 * Routes the host event loop callbacks of a transport through the URI client owning it
+	 * (see #KSI_NetworkClient_setEventCallbacks).
+	 */
+	typedef struct UriEventRoute_st {
+		struct KSI_UriClient_st *owner;
+		/** The transport, NULL if the route is not used. */
+		KSI_NetworkClient *client;
+		/** Time the timer of the transport expires (see #KSI_NET_getTimeMs), 0 if disarmed. */
+		KSI_uint64_t timerAt;
+	} UriEventRoute;
+
+	/** A socket of a transport watched by the host event loop. */
+	typedef struct UriEventSocket_st {
+		int fd;
+		UriEventRoute *route;
+	} UriEventSocket;
+
+	struct KSI_UriEndpoint_st {
+		KSI_CTX *ctx;
+		/** Number of owners: the pool and every request routed to the endpoint. */
+		size_t refCount;
+
+		/** The URI the endpoint was configured with. */
+		char *uri;
+		/** The transport serving the endpoint, NULL after the endpoint is removed from its pool. */
+		KSI_NetworkClient *client;
+		/** Type of #client. */
+		enum client_e clientType;
+		/** Is #client owned by the endpoint. */
+		int ownsClient;
+		/** Decorated #client the requests are sent through, NULL if not decorated (see #KSI_UriClient_setEndpointDecorator). */
+		KSI_NetworkClient *sender;
+		/** Event loop route of #client, if owned by the endpoint. */
+		UriEventRoute route;
+
+		/** Number of requests sent, but not yet answered. */
+		size_t outstanding;
+		/** Total number of requests routed to the endpoint. */
+		size_t requestCount;
+		/** Total number of failed requests. */
+		size_t failureCount;
+		/** Number of failures since the last successful request. */
+		unsigned consecutiveFailures;
+		/** Exponentially weighted moving average of the response time, 0 if not measured yet. */
+		double latencyMs;
+		/** Time until the endpoint is considered down (see #KSI_NET_getTimeMs), 0 when healthy. */
+		KSI_uint64_t downUntil;
+
+		/** Health check parameters, see #KSI_UriClient_setHealthCheck. */
+		unsigned failureThreshold;
+		unsigned retryDelaySeconds;
+	};
+
+	/** Number of recent response times kept for the latency percentiles. */
+	#define URI_LATENCY_SAMPLES 128
+
+	/**
+	 * Hedging and retry configuration of a pool together with the statistics it is based
+	 * on. Shared by the pool and the requests routed to it, as these may outlive the client.
+	 */
+	typedef struct UriRetryPolicy_st {
+		size_t refCount;
+
+		/** Latency percentile after which a duplicate request is sent, 0 if hedging is disabled. */
+		unsigned hedgePercentile;
+		/** Lower bound of the hedging delay. */
+		unsigned hedgeMinDelayMs;
+
+		/** Maximum number of times a failed request is resent. */
+		unsigned maxRetries;
+		/** Base of the exponential backoff between the retries. */
+		unsigned backoffMs;
+
+		/** Retry tokens earned per request, in hundredths of a retry. */
+		unsigned budgetPercent;
+		/** Available retry tokens, in hundredths of a retry. */
+		unsigned tokens;
+
+		/** Adaptive timeout as a multiple of the 99th percentile, 0 if disabled. */
+		unsigned timeoutFactor;
+		/** Lower bound of the adaptive timeout. */
+		unsigned timeoutMinMs;
+
+		/** Ring buffer of the recent response times in milliseconds. */
+		unsigned samples[URI_LATENCY_SAMPLES];
+		size_t samples_len;
+		size_t samples_pos;
+
+		/** State of the jitter generator. */
+		KSI_uint64_t seed;
+	} UriRetryPolicy;
+
+	/**
+	 * State of a routed request needed for sending it to another endpoint.
+	 */
+	typedef struct UriRetryCtx_st {
+		UriRetryPolicy *policy;
+		/** Load balancing policy at the time of routing. */
+		int balancing;
+
+		/** Endpoints of the pool at the time of routing. */
+		KSI_UriEndpoint **endpoints;
+		size_t endpoints_len;
+
+		/** Copy of the request. */
+		void *req;
+		void (*req_free)(void *);
+		int (*send)(KSI_NetworkClient *, void *, KSI_RequestHandle **);
+		/** Returns the status of a received response, which is not used while other attempts are pending, if not #KSI_OK. */
+		int (*check)(KSI_CTX *, const unsigned char *, unsigned);
+		/** Reads the response of the transport the request was first sent to. */
+		int (*readResponse)(KSI_RequestHandle *);
+	} UriRetryCtx;
+
+	typedef struct UriEndpointPool_st {
+		KSI_UriEndpoint **list;
+		size_t count;
+		/** Round-robin position. */
+		size_t next;
+		/** Hedging and retry policy, NULL if not configured. */
+		UriRetryPolicy *retry;
+	} UriEndpointPool;
+
 	struct KSI_UriClient_st {
 		KSI_NetworkClient parent;
 
@@ -43,8 +170,64 @@ extern "C" {
 
 		KSI_NetworkClient *pExtendClient;
 		KSI_NetworkClient *pAggregationClient;
+
+		/** Extender endpoints, the first one is served by #pExtendClient. */
+		UriEndpointPool extPool;
+		/** Aggregator endpoints, the first one is served by #pAggregationClient. */
+		UriEndpointPool aggrPool;
+
+		/** Load balancing policy (see #KSI_UriBalancing). */
+		int balancing;
+		/** Number of consecutive failures after which an endpoint is taken out of rotation. */
+		unsigned failureThreshold;
+		/** Time an endpoint stays out of rotation before it is probed again. */
+		unsigned retryDelaySeconds;
+
+		/** Timeouts applied to the transports of additional endpoints, negative if not set. */
+		int connectionTimeoutSeconds;
+		int transferTimeoutSeconds;
+
+		/** Decorator of the endpoint transports, NULL if not set. */
+		KSI_UriEndpointDecorator decorate;
+		void *decoratorCtx;
+
+		/** Event loop routes of #httpClient and #tcpClient. */
+		UriEventRoute httpRoute;
+		UriEventRoute tcpRoute;
+		/** Sockets watched by the host event loop, with the transports they belong to. */
+		UriEventSocket *sockets;
+		size_t sockets_len;
+		size_t sockets_size;
+		/** Time the timer of the host event loop expires (see #KSI_NET_getTimeMs), 0 if disarmed. */
+		KSI_uint64_t timerAt;
 	};
 
+	/**
+	 * Updates the statistics of the endpoint the request was routed to, once the
+	 * outcome of the request is known. Set as the \c responseDone callback of a routed
+	 * request handle.
+	 * \param[in]	handle		Request handle.
+	 * \param[in]	status		Status of reading the response.
+	 */
+	void KSI_UriEndpoint_requestDone(KSI_RequestHandle *handle, int status);
+
+	/**
+	 * Releases the endpoint reference and the retry state held by the request handle. Set
+	 * as the \c routeFree callback of a routed request handle.
+	 * \param[in]	handle		Request handle.
+	 */
+	void KSI_UriEndpoint_releaseRequest(KSI_RequestHandle *handle);
+
+	/**
+	 * Reads the response to a routed request with hedging and retries enabled. The
+	 * request may be resent to other endpoints and the first response is used. Set as
+	 * the response reader of the handle by the client, which keeps the reader of the
+	 * transport in the retry state.
+	 * \param[in]	handle		Request handle.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriEndpoint_readResponse(KSI_RequestHandle *handle);
+
 #ifdef __cplusplus
 }
 #endif
@@ -55,6 +55,21 @@ extern "C" {
 	 */
 	void KSI_PKITruststore_free(KSI_PKITruststore *store);
 
+	/**
+	 * Attaches the PKI Truststore to another KSI context without copying the certificates.
+	 * The store is shared and stays valid until both the original and the attached
+	 * truststore have been freed.
+	 * \param[in]	store			PKI Truststore object.
+	 * \param[in]	ctx				KSI context the attached truststore reports the errors to.
+	 * \param[out]	attached		Pointer to the receiving pointer.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code).
+	 * \note The truststore must not be modified after it has been attached. With OpenSSL
+	 * older than 1.1.0 using the store from several threads needs the OpenSSL locking callbacks.
+	 */
+	int KSI_PKITruststore_attach(KSI_PKITruststore *store, KSI_CTX *ctx, KSI_PKITruststore **attached);
+
 	/**
 	 * PKI Certificate constructor.
 	 * \param[in]	ctx			KSI context.
@@ -52,6 +52,11 @@ static int KSI_PKITruststore_global_initCount = 0;
 struct KSI_PKITruststore_st {
 	KSI_CTX *ctx;
 	X509_STORE *store;
+
+	/* The truststore the store belongs to if attached with #KSI_PKITruststore_attach, otherwise NULL. */
+	KSI_PKITruststore *shared;
+	/* Number of the attached truststores sharing the store, plus one for the truststore itself. */
+	KSI_RefCount refCount;
 };
 
 struct KSI_PKICertificate_st {
@@ -124,12 +129,56 @@ static int isMallocFailure(void) {
 }
 
 void KSI_PKITruststore_free(KSI_PKITruststore *trust) {
-	if (trust != NULL) {
+	if (trust != NULL && trust->shared != NULL) {
+		KSI_PKITruststore_free(trust->shared);
+		KSI_free(trust);
+	} else if (trust != NULL && KSI_REFCOUNT_DEC(trust->refCount) == 0) {
 		if (trust->store != NULL) X509_STORE_free(trust->store);
 		KSI_free(trust);
 	}
 }
 
+int KSI_PKITruststore_attach(KSI_PKITruststore *trust, KSI_CTX *ctx, KSI_PKITruststore **attached) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_PKITruststore *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (trust == NULL || ctx == NULL || attached == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_CTX_registerGlobals(ctx, openSslGlobal_init, openSslGlobal_cleanup);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_PKITruststore);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->ctx = ctx;
+	tmp->store = trust->store;
+	tmp->shared = trust->shared != NULL ? trust->shared : trust;
+	tmp->refCount = 1;
+
+	KSI_REFCOUNT_INC(tmp->shared->refCount);
+
+	*attached = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+
+	return res;
+}
+
 int KSI_PKICertificate_fromTlv(KSI_TLV *tlv, KSI_PKICertificate **cert) {
 	KSI_CTX *ctx = NULL;
 	int res;
@@ -320,6 +369,8 @@ int KSI_PKITruststore_new(KSI_CTX *ctx, int setDefaults, KSI_PKITruststore **tru
 
 	tmp->ctx = ctx;
 	tmp->store = NULL;
+	tmp->shared = NULL;
+	tmp->refCount = 1;
 
 	tmp->store = X509_STORE_new();
 	if (tmp->store == NULL) {
@@ -965,7 +1016,7 @@ int KSI_PKITruststore_verifyRawSignature(KSI_CTX *ctx, const unsigned char *data
 		goto cleanup;
     }
 
-	KSI_LOG_debug(certificate->ctx, "PKI signature verified successfully.");
+	KSI_LOG_debug(ctx, "PKI signature verified successfully.");
 
 	res = KSI_OK;
 
@@ -178,6 +178,8 @@ static int KSI_PublicationsFile_new(KSI_CTX *ctx, KSI_PublicationsFile **t) {
 	tmp->certificates = NULL;
 	tmp->publications = NULL;
 	tmp->signature = NULL;
+	tmp->shared = NULL;
+	tmp->refCount = 1;
 	*t = tmp;
 	tmp = NULL;
 	res = KSI_OK;
@@ -329,8 +331,6 @@ int KSI_PublicationsFile_fromFile(KSI_CTX *ctx, const char *fileName, KSI_Public
 	KSI_PublicationsFile *tmp = NULL;
 	unsigned char *raw = NULL;
 	size_t raw_len = 0;
-	long raw_size = 0;
-	FILE *f = NULL;
 
 	KSI_ERR_clearErrors(ctx);
 
@@ -339,48 +339,25 @@ int KSI_PublicationsFile_fromFile(KSI_CTX *ctx, const char *fileName, KSI_Public
 		goto cleanup;
 	}
 
-
-	f = fopen(fileName, "rb");
-	if (f == NULL) {
+	/* The file is mapped and parsed in place, without an intermediate copy. */
+	res = KSI_RDR_fromFile(ctx, fileName, &reader);
+	if (res != KSI_OK) {
 		KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to open publications file.");
 		goto cleanup;
 	}
 
-	res = fseek(f, 0, SEEK_END);
-	if (res != 0) {
-		KSI_pushError(ctx, res = KSI_IO_ERROR, NULL);
-		goto cleanup;
-	}
-
-	raw_size = ftell(f);
-	if (raw_size < 0) {
+	res = KSI_RDR_read_ptr(reader, &raw, UINT_MAX, &raw_len);
+	if (res != KSI_OK) {
 		KSI_pushError(ctx, res = KSI_IO_ERROR, NULL);
 		goto cleanup;
 	}
 
-	if (raw_size > UINT_MAX) {
+	res = KSI_RDR_verifyEnd(reader);
+	if (res != KSI_OK) {
 		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, NULL);
 		goto cleanup;
 	}
 
-	res = fseek(f, 0, SEEK_SET);
-	if (res != 0) {
-		KSI_pushError(ctx, res = KSI_IO_ERROR, NULL);
-		goto cleanup;
-	}
-
-	raw = KSI_calloc((unsigned)raw_size, 1);
-	if (raw == NULL) {
-		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
-		goto cleanup;
-	}
-
-	raw_len = fread(raw, 1, (unsigned)raw_size, f);
-	if (raw_len != raw_size) {
-		KSI_pushError(ctx, res = KSI_IO_ERROR, NULL);
-		goto cleanup;
-	}
-
 	res = KSI_PublicationsFile_parse(ctx, raw, (unsigned)raw_len, &tmp);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
@@ -394,8 +371,7 @@ int KSI_PublicationsFile_fromFile(KSI_CTX *ctx, const char *fileName, KSI_Public
 
 cleanup:
 
-	if (f != NULL) fclose(f);
-	KSI_free(raw);
+	KSI_nofree(raw);
 	KSI_RDR_close(reader);
 	KSI_PublicationsFile_free(tmp);
 
@@ -431,8 +407,47 @@ cleanup:
 }
 
 
+int KSI_PublicationsFile_attach(KSI_PublicationsFile *pubFile, KSI_CTX *ctx, KSI_PublicationsFile **attached) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_PublicationsFile *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (pubFile == NULL || ctx == NULL || attached == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (pubFile->raw == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "Publications file not loaded from serialized data.");
+		goto cleanup;
+	}
+
+	/* Parse the records again in the given context, so no object of the attached file refers
+	 * to the context of the original. */
+	res = KSI_PublicationsFile_parse(ctx, pubFile->raw, pubFile->raw_len, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	tmp->shared = pubFile->shared != NULL ? pubFile->shared : pubFile;
+	KSI_REFCOUNT_INC(tmp->shared->refCount);
+
+	*attached = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_PublicationsFile_free(tmp);
+
+	return res;
+}
+
 void KSI_PublicationsFile_free(KSI_PublicationsFile *t) {
-	if (t != NULL) {
+	if (t != NULL && KSI_REFCOUNT_DEC(t->refCount) == 0) {
+		KSI_PublicationsFile_free(t->shared);
 		KSI_PublicationsHeader_free(t->header);
 		KSI_CertificateRecordList_free(t->certificates);
 		KSI_PublicationRecordList_free(t->publications);
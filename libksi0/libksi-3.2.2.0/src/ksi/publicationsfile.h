@@ -198,6 +198,21 @@ extern "C" {
 	 */
 	void KSI_PublicationsFile_free(KSI_PublicationsFile *pubFile);
 
+	/**
+	 * Attaches the publications file to another KSI context. The records are parsed again from
+	 * the serialized file in \c ctx, so the attached file can be used in another thread than
+	 * \c pubFile and set to its context with #KSI_CTX_setPublicationsFile without downloading
+	 * the file again.
+	 * \param[in]	pubFile			Publications file.
+	 * \param[in]	ctx				KSI context of the attached file.
+	 * \param[out]	attached		Pointer to the receiving pointer.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code).
+	 * \note \c pubFile is kept alive until the attached file has been freed.
+	 */
+	int KSI_PublicationsFile_attach(KSI_PublicationsFile *pubFile, KSI_CTX *ctx, KSI_PublicationsFile **attached);
+
 	int KSI_PublicationsFile_findPublication(const KSI_PublicationsFile *trust, KSI_PublicationRecord *inRec, KSI_PublicationRecord **outRec);
 
 	/**
@@ -20,6 +20,8 @@
 #ifndef PUBLICATIONSFILE_IMPL_H_
 #define PUBLICATIONSFILE_IMPL_H_
 
+#include "internal.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -33,6 +35,11 @@ extern "C" {
 		KSI_LIST(KSI_PublicationRecord) *publications;
 		size_t signedDataLength;
 		KSI_PKISignature *signature;
+
+		/* The file this one was attached from with #KSI_PublicationsFile_attach, otherwise NULL. */
+		KSI_PublicationsFile *shared;
+		/* Number of the files attached from this one, plus one for the file itself. */
+		KSI_RefCount refCount;
 	};
 
 	struct KSI_PublicationData_st {
@@ -24,7 +24,9 @@
 #include "signature_impl.h"
 #include "publicationsfile_impl.h"
 #include "tlv.h"
+#include "io.h"
 #include "ctx_impl.h"
+#include "calendar_cache.h"
 #include "tlv_template.h"
 #include "hashchain.h"
 #include "net.h"
@@ -374,6 +376,11 @@ static int KSI_Signature_new(KSI_CTX *ctx, KSI_Signature **sig) {
 	tmp->aggregationChainList = NULL;
 	tmp->calendarAuthRec = NULL;
 	tmp->publication = NULL;
+	tmp->calendarRoot = NULL;
+	tmp->calendarAggrTime = 0;
+	tmp->calendarAggrTime_set = false;
+	tmp->aggregationRoot = NULL;
+	tmp->aggregationRootLevel = 0;
 
 	res = KSI_VerificationResult_init(&tmp->verificationResult, ctx);
 	if (res != KSI_OK) {
@@ -614,6 +621,13 @@ cleanup:
 	return res;
 }
 
+/* Forgets the values computed from the calendar hash chain. */
+static void forgetCalendarRoot(KSI_Signature *sig) {
+	KSI_DataHash_free(sig->calendarRoot);
+	sig->calendarRoot = NULL;
+	sig->calendarAggrTime_set = false;
+}
+
 int KSI_Signature_replaceCalendarChain(KSI_Signature *sig, KSI_CalendarHashChain *calendarHashChain) {
 	int res;
 	KSI_DataHash *newInputHash = NULL;
@@ -704,6 +718,8 @@ int KSI_Signature_replaceCalendarChain(KSI_Signature *sig, KSI_CalendarHashChain
 	KSI_CalendarHashChain_free(sig->calendarChain);
 	sig->calendarChain = calendarHashChain;
 
+	forgetCalendarRoot(sig);
+
 
 	res = KSI_OK;
 
@@ -857,6 +873,8 @@ int KSI_Signature_replacePublicationRecord(KSI_Signature *sig, KSI_PublicationRe
 			KSI_PublicationRecord_free(sig->publication);
 		}
 		sig->publication = pubRec;
+
+		forgetCalendarRoot(sig);
 	}
 
 	res = KSI_OK;
@@ -1102,50 +1120,140 @@ int KSI_Signature_create(KSI_CTX *ctx, KSI_DataHash *hsh, KSI_Signature **signat
 	return KSI_Signature_createAggregated(ctx, hsh, 0, signature);
 }
 
-int KSI_Signature_extendTo(const KSI_Signature *sig, KSI_CTX *ctx, KSI_Integer *to, KSI_Signature **extended) {
-	int res = KSI_UNKNOWN_ERROR;
-	KSI_ExtendReq *req = NULL;
-	KSI_Integer *signTime = NULL;
-	KSI_RequestHandle *handle = NULL;
-	KSI_ExtendResp *resp = NULL;
-	KSI_CalendarHashChain *calHashChain = NULL;
-	KSI_Signature *tmp = NULL;
+/* Maximum number of sign requests waiting for a response in the bulk operations. */
+#define SIGN_MANY_MAX_PENDING 16
 
+/**
+ * Reads the response to the sign request and creates the signature.
+ */
+static int receiveSignature(KSI_CTX *ctx, KSI_RequestHandle *handle, KSI_Signature **signature) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AggregationResp *response = NULL;
 
-	KSI_ERR_clearErrors(ctx);
-	if (sig == NULL || ctx == NULL || extended == NULL) {
-		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+	res = KSI_RequestHandle_getAggregationResponse(handle, &response);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Make a copy of the original signature */
-	res = KSI_Signature_clone(sig, &tmp);
+	res = parseAggregationResponse(ctx, response, signature);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Request the calendar hash chain from this moment on. */
-	res = KSI_Signature_getSigningTime(sig, &signTime);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_AggregationResp_free(response);
+
+	return res;
+}
+
+int KSI_Signature_createMany(KSI_CTX *ctx, KSI_DataHash * const *hashes, const KSI_uint64_t *levels, size_t count, KSI_Signature **signatures, int *status) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AggregationReq **reqs = NULL;
+	KSI_RequestHandle **handles = NULL;
+	int *tmpStatus = NULL;
+	size_t sendPos = 0;
+	size_t pending = 0;
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || (hashes == NULL && count > 0) || (signatures == NULL && count > 0)) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
 		goto cleanup;
 	}
 
-	/* Create request. */
-	res = createExtendRequest(ctx, signTime, to, &req);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
+	for (i = 0; i < count; i++) {
+		signatures[i] = NULL;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (hashes[i] == NULL || (levels != NULL && levels[i] > 0xff)) {
+			KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+			goto cleanup;
+		}
+	}
+
+	if (count == 0) {
+		res = KSI_OK;
 		goto cleanup;
 	}
 
-	/* Send the actual request. */
-	res = KSI_sendExtendRequest(ctx, req, &handle);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
+	reqs = KSI_calloc(count, sizeof(KSI_AggregationReq *));
+	handles = KSI_calloc(count, sizeof(KSI_RequestHandle *));
+	tmpStatus = KSI_calloc(count, sizeof(int));
+	if (reqs == NULL || handles == NULL || tmpStatus == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
 		goto cleanup;
 	}
 
+	KSI_LOG_debug(ctx, "Signing %llu hashes.", (unsigned long long)count);
+
+	for (i = 0; i < count; i++) {
+		/* Keep the pipeline full. */
+		for (; sendPos < count && pending < SIGN_MANY_MAX_PENDING; sendPos++) {
+			int *s = &tmpStatus[sendPos];
+
+			*s = createSignRequest(ctx, hashes[sendPos], levels != NULL ? (int)levels[sendPos] : 0, &reqs[sendPos]);
+			if (*s == KSI_OK) *s = KSI_sendSignRequest(ctx, reqs[sendPos], &handles[sendPos]);
+			if (*s == KSI_OK) pending++;
+		}
+
+		if (handles[i] != NULL) {
+			tmpStatus[i] = receiveSignature(ctx, handles[i], &signatures[i]);
+			pending--;
+
+			/* Release the connection resources early. */
+			KSI_RequestHandle_free(handles[i]);
+			handles[i] = NULL;
+		}
+		KSI_AggregationReq_free(reqs[i]);
+		reqs[i] = NULL;
+
+		if (status != NULL) {
+			status[i] = tmpStatus[i];
+		} else if (tmpStatus[i] != KSI_OK) {
+			KSI_pushError(ctx, res = tmpStatus[i], NULL);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	/* Without per-hash statuses, the outcome is all or nothing. */
+	if (res != KSI_OK && signatures != NULL) {
+		for (i = 0; i < count; i++) {
+			KSI_Signature_free(signatures[i]);
+			signatures[i] = NULL;
+		}
+	}
+
+	if (reqs != NULL && handles != NULL) {
+		for (i = 0; i < count; i++) {
+			KSI_RequestHandle_free(handles[i]);
+			KSI_AggregationReq_free(reqs[i]);
+		}
+	}
+	KSI_free(reqs);
+	KSI_free(handles);
+	KSI_free(tmpStatus);
+
+	return res;
+}
+
+/**
+ * Reads the response to the extend request and extracts the calendar hash chain.
+ */
+static int receiveCalendarChain(KSI_CTX *ctx, KSI_ExtendReq *req, KSI_RequestHandle *handle, KSI_CalendarHashChain **chain) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_ExtendResp *resp = NULL;
+	KSI_CalendarHashChain *tmp = NULL;
+
 	/* Get and parse the response. */
 	res = KSI_RequestHandle_getExtendResponse(handle, &resp);
 	if (res != KSI_OK) {
@@ -1161,25 +1269,170 @@ int KSI_Signature_extendTo(const KSI_Signature *sig, KSI_CTX *ctx, KSI_Integer *
 	}
 
 	/* Extract the calendar hash chain */
-	KSI_ExtendResp_getCalendarHashChain(resp, &calHashChain);
+	KSI_ExtendResp_getCalendarHashChain(resp, &tmp);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Extend response does not contain a calendar hash chain.");
+		goto cleanup;
+	}
 
 	/* Remove the chain from the structure, as it will be freed when this function finishes. */
 	KSI_ExtendResp_setCalendarHashChain(resp, NULL);
 
-	/* Add the hash chain to the signature. */
-	res = KSI_Signature_replaceCalendarChain(tmp, calHashChain);
+	*chain = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_ExtendResp_free(resp);
+
+	return res;
+}
+
+/**
+ * Serializes the calendar hash chain as an element of the signature.
+ */
+static int serializeCalendarChain(KSI_CTX *ctx, const KSI_CalendarHashChain *chain, unsigned char **raw, unsigned *raw_len) {
+	return KSI_TlvTemplate_serializeObject(ctx, chain, 0x0802, 0, 0, KSI_TLV_TEMPLATE(KSI_CalendarHashChain), raw, raw_len);
+}
+
+/**
+ * Creates the extended signature by splicing the serialized calendar hash chain \c calRaw in
+ * place of the calendar hash chain of the serialized signature. The calendar authentication
+ * record and the publication record are dropped and \c pubRaw, if not \c NULL, is appended
+ * instead. The rest of the signature is copied byte by byte and the result is parsed once.
+ */
+static int spliceCalendarChain(KSI_CTX *ctx, const KSI_Signature *sig, const KSI_CalendarHashChain *chain,
+		const unsigned char *calRaw, unsigned calRaw_len, const unsigned char *pubRaw, unsigned pubRaw_len, KSI_Signature **extended) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_DataHash *newInputHash = NULL;
+	KSI_DataHash *oldInputHash = NULL;
+	unsigned char *raw = NULL;
+	unsigned raw_len = 0;
+	unsigned char *buf = NULL;
+	unsigned buf_len = 4;
+	unsigned pos;
+	KSI_TLV *tlv = NULL;
+	KSI_Signature *tmp = NULL;
+
+	if (sig->calendarChain == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Signature does not contain a hash chain.");
+		goto cleanup;
+	}
+
+	res = KSI_CalendarHashChain_getInputHash(chain, &newInputHash);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (newInputHash == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Given calendar hash chain does not contain an input hash.");
+		goto cleanup;
+	}
+
+	res = KSI_CalendarHashChain_getInputHash(sig->calendarChain, &oldInputHash);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* The output hash and input hash have to be equal */
+	if (!KSI_DataHash_equals(newInputHash, oldInputHash)) {
+		KSI_pushError(ctx, res = KSI_EXTEND_WRONG_CAL_CHAIN, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_TLV_serialize(sig->baseTlv, &raw, &raw_len);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* The signature is always encoded with a 16-bit header. */
+	if (raw_len < 4 || (raw[0] & 0x80) == 0) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, NULL);
+		goto cleanup;
+	}
+
+	/* The result is never longer than the parts put together. */
+	buf = KSI_malloc(raw_len + calRaw_len + pubRaw_len);
+	if (buf == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	for (pos = 4; pos < raw_len;) {
+		unsigned tag;
+		unsigned len;
+
+		if (raw[pos] & 0x80) {
+			if (raw_len - pos < 4) break;
+			tag = ((raw[pos] & 0x1fu) << 8) | raw[pos + 1];
+			len = 4 + (((unsigned)raw[pos + 2] << 8) | raw[pos + 3]);
+		} else {
+			if (raw_len - pos < 2) break;
+			tag = raw[pos] & 0x1fu;
+			len = 2 + raw[pos + 1];
+		}
+
+		if (len > raw_len - pos) break;
+
+		switch (tag) {
+			case 0x0802:
+				memcpy(buf + buf_len, calRaw, calRaw_len);
+				buf_len += calRaw_len;
+				break;
+			case 0x0803:
+			case 0x0805:
+				/* Not valid for the new calendar hash chain. */
+				break;
+			default:
+				memcpy(buf + buf_len, raw + pos, len);
+				buf_len += len;
+		}
+
+		pos += len;
+	}
+
+	if (pos != raw_len) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Signature contains a truncated element.");
+		goto cleanup;
+	}
+
+	if (pubRaw != NULL) {
+		memcpy(buf + buf_len, pubRaw, pubRaw_len);
+		buf_len += pubRaw_len;
+	}
+
+	if (buf_len - 4 > 0xffff) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Extended signature too long.");
+		goto cleanup;
+	}
+
+	buf[0] = raw[0];
+	buf[1] = raw[1];
+	buf[2] = (unsigned char)((buf_len - 4) >> 8);
+	buf[3] = (unsigned char)(buf_len - 4);
+
+	res = KSI_TLV_parseBlob2(ctx, buf, buf_len, 1, &tlv);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
+	/* Owned by the TLV. */
+	buf = NULL;
 
-	/* Remove calendar auth record and publication. */
-	res = removeCalAuthAndPublication(tmp);
+	res = extractSignature(ctx, tlv, &tmp);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
+	tmp->baseTlv = tlv;
+	tlv = NULL;
+
 	/* Just to be sure, verify the internals. */
 	res = KSI_Signature_verifyPolicy(tmp, KSI_VP_INTERNAL , ctx);
 	if (res != KSI_OK) {
@@ -1194,82 +1447,83 @@ int KSI_Signature_extendTo(const KSI_Signature *sig, KSI_CTX *ctx, KSI_Integer *
 
 cleanup:
 
-	KSI_ExtendReq_free(req);
-	KSI_ExtendResp_free(resp);
-	KSI_RequestHandle_free(handle);
+	KSI_nofree(newInputHash);
+	KSI_nofree(oldInputHash);
+
+	KSI_free(raw);
+	KSI_free(buf);
+	KSI_TLV_free(tlv);
 	KSI_Signature_free(tmp);
 
 	return res;
 }
 
-int KSI_Signature_extend(const KSI_Signature *signature, KSI_CTX *ctx, const KSI_PublicationRecord *pubRec, KSI_Signature **extended) {
+/**
+ * Extends the signature to the publication time \c to, appending the serialized publication
+ * record \c pubRaw, if not \c NULL.
+ */
+static int extendSignatureTo(const KSI_Signature *sig, KSI_CTX *ctx, KSI_Integer *to, const unsigned char *pubRaw, unsigned pubRaw_len, KSI_Signature **extended) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_Integer *pubTime = NULL;
-	KSI_PublicationRecord *pubRecClone = NULL;
+	KSI_ExtendReq *req = NULL;
+	KSI_Integer *signTime = NULL;
+	KSI_RequestHandle *handle = NULL;
+	KSI_CalendarHashChain *calHashChain = NULL;
+	unsigned char *calRaw = NULL;
+	unsigned calRaw_len = 0;
 	KSI_Signature *tmp = NULL;
 
-	KSI_ERR_clearErrors(ctx);
-	if (signature == NULL || ctx == NULL || extended == NULL) {
-		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+	/* Request the calendar hash chain from this moment on. */
+	res = KSI_Signature_getSigningTime(sig, &signTime);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* If publication record is present, extract the publication time. */
-	if (pubRec != NULL) {
-		KSI_PublicationData *pubData = NULL;
-
-		/* Make a copy of the original publication record .*/
-		res = KSI_PublicationRecord_new(signature->ctx, &pubRecClone);
+	/* The chain to a given publication never changes, so it may be served from the cache. */
+	if (to != NULL) {
+		res = KSI_CalendarCache_get(ctx->calendarCache, signTime, to, &calHashChain);
 		if (res != KSI_OK) {
 			KSI_pushError(ctx, res, NULL);
 			goto cleanup;
 		}
+	}
 
-		res = KSI_TlvTemplate_deepCopy(signature->ctx, pubRec, KSI_TLV_TEMPLATE(KSI_PublicationRecord), pubRecClone);
+	if (calHashChain == NULL) {
+		/* Create request. */
+		res = createExtendRequest(ctx, signTime, to, &req);
 		if (res != KSI_OK) {
 			KSI_pushError(ctx, res, NULL);
 			goto cleanup;
 		}
 
-		/* Extract the published data object. */
-		res = KSI_PublicationRecord_getPublishedData(pubRec, &pubData);
+		/* Send the actual request. */
+		res = KSI_sendExtendRequest(ctx, req, &handle);
 		if (res != KSI_OK) {
 			KSI_pushError(ctx, res, NULL);
 			goto cleanup;
 		}
 
-		/* Read the publication time from the published data object. */
-		res = KSI_PublicationData_getTime(pubData, &pubTime);
+		res = receiveCalendarChain(ctx, req, handle, &calHashChain);
 		if (res != KSI_OK) {
 			KSI_pushError(ctx, res, NULL);
 			goto cleanup;
 		}
 	}
 
-	/* Perform the actual extension. */
-	res = KSI_Signature_extendTo(signature, ctx, pubTime, &tmp);
+	res = serializeCalendarChain(ctx, calHashChain, &calRaw, &calRaw_len);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	/* Set the publication as the trust anchor. */
-	res = KSI_Signature_replacePublicationRecord(tmp, pubRecClone);
+	res = spliceCalendarChain(ctx, sig, calHashChain, calRaw, calRaw_len, pubRaw, pubRaw_len, &tmp);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
-	pubRecClone = NULL;
-
-	/* To be sure we won't return a bad signature, lets verify it. */
-	if (pubRecClone == NULL) {
-		/* Just to be sure, verify the internals. */
-		res = KSI_Signature_verifyPolicy(tmp, KSI_VP_INTERNAL, ctx);
-	} else {
-		/* Perform an actual verification. */
-		res = KSI_Signature_verifyPolicy(tmp, KSI_VP_OFFLINE, ctx);
-	}
 
+	/* Remember the validated chain. */
+	res = KSI_CalendarCache_put(ctx->calendarCache, signTime, tmp->calendarChain);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
@@ -1282,74 +1536,456 @@ int KSI_Signature_extend(const KSI_Signature *signature, KSI_CTX *ctx, const KSI
 
 cleanup:
 
-	KSI_PublicationRecord_free(pubRecClone);
+	KSI_ExtendReq_free(req);
+	KSI_RequestHandle_free(handle);
+	KSI_CalendarHashChain_free(calHashChain);
+	KSI_free(calRaw);
 	KSI_Signature_free(tmp);
 
 	return res;
 }
 
-void KSI_Signature_free(KSI_Signature *sig) {
-	if (sig != NULL) {
-		KSI_TLV_free(sig->baseTlv);
-		KSI_CalendarHashChain_free(sig->calendarChain);
-		KSI_AggregationHashChainList_free(sig->aggregationChainList);
-		KSI_CalendarAuthRec_free(sig->calendarAuthRec);
-		KSI_AggregationAuthRec_free(sig->aggregationAuthRec);
-		KSI_PublicationRecord_free(sig->publication);
-		KSI_VerificationResult_reset(&sig->verificationResult);
-
-		KSI_free(sig);
-	}
-}
-
-
-int KSI_Signature_getDocumentHash(KSI_Signature *sig, KSI_DataHash **hsh) {
-	KSI_AggregationHashChain *aggr = NULL;
-	int res;
+int KSI_Signature_extendTo(const KSI_Signature *sig, KSI_CTX *ctx, KSI_Integer *to, KSI_Signature **extended) {
+	int res = KSI_UNKNOWN_ERROR;
 
-	if (sig == NULL || hsh == NULL) {
-		res = KSI_INVALID_ARGUMENT;
+	KSI_ERR_clearErrors(ctx);
+	if (sig == NULL || ctx == NULL || extended == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
 		goto cleanup;
 	}
-	KSI_ERR_clearErrors(sig->ctx);
 
-
-	res = KSI_AggregationHashChainList_elementAt(sig->aggregationChainList, 0, &aggr);
+	res = extendSignatureTo(sig, ctx, to, NULL, 0, extended);
 	if (res != KSI_OK) {
-		KSI_pushError(sig->ctx, res, NULL);
+		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	*hsh = aggr->inputHash;
-
 	res = KSI_OK;
 
 cleanup:
 
-	KSI_nofree(aggr);
-
 	return res;
 }
 
-int KSI_Signature_getSigningTime(const KSI_Signature *sig, KSI_Integer **signTime) {
-	int res = KSI_UNKNOWN_ERROR;
-	KSI_Integer *tmp = NULL;
+/* Maximum number of extend requests waiting for a response in the bulk operations. */
+#define EXTEND_MANY_MAX_PENDING 16
 
-	if (sig == NULL) {
-		res = KSI_INVALID_ARGUMENT;
-		goto cleanup;
-	}
+/**
+ * A group of signatures sharing the aggregation time, served by a single extend request.
+ */
+typedef struct ExtendGroup_st {
+	/* Aggregation time of the group, belongs to the first signature. */
+	KSI_Integer *aggrTime;
+	/* The calendar hash chain for the group, NULL if not received. */
+	KSI_CalendarHashChain *chain;
+	/* Outcome of the extend request. */
+	int status;
+	/* Set once the chain has passed validation. */
+	int isValidated;
+	/* The chain serialized for splicing into the signatures, NULL until needed. */
+	unsigned char *calRaw;
+	unsigned calRaw_len;
+
+	KSI_ExtendReq *req;
+	KSI_RequestHandle *handle;
+} ExtendGroup;
+
+typedef struct {
+	KSI_uint64_t aggrTime;
+	size_t index;
+} ExtendGroupKey;
+
+static int compareExtendGroupKeys(const void *a, const void *b) {
+	const ExtendGroupKey *ka = a;
+	const ExtendGroupKey *kb = b;
+
+	if (ka->aggrTime != kb->aggrTime) return ka->aggrTime < kb->aggrTime ? -1 : 1;
+	return ka->index < kb->index ? -1 : (ka->index > kb->index);
+}
 
-	KSI_ERR_clearErrors(sig->ctx);
+static void ExtendGroups_free(ExtendGroup *groups, size_t groups_len) {
+	size_t i;
 
-	if (signTime == NULL) {
-		KSI_pushError(sig->ctx, res = KSI_INVALID_ARGUMENT, NULL);
-		goto cleanup;
-	}
+	if (groups == NULL) return;
 
-	if (sig->calendarChain == NULL) {
-		KSI_pushError(sig->ctx, res = KSI_INVALID_FORMAT, NULL);
-		goto cleanup;
+	for (i = 0; i < groups_len; i++) {
+		KSI_CalendarHashChain_free(groups[i].chain);
+		KSI_free(groups[i].calRaw);
+		KSI_ExtendReq_free(groups[i].req);
+		KSI_RequestHandle_free(groups[i].handle);
+	}
+	KSI_free(groups);
+}
+
+/**
+ * Groups the signatures by the aggregation time and obtains the calendar hash chain for
+ * every group, either from the calendar cache or with a single extend request. The requests
+ * are sent ahead of reading the responses, with at most #EXTEND_MANY_MAX_PENDING unanswered
+ * requests at a time. A failure of a group is recorded in its \c status.
+ * \param[in]	anyEnd		If \c to is \c NULL, accept any cached chain starting from the aggregation time.
+ * \param[out]	groupOf		Receives the index of the group for each signature.
+ */
+static int fetchCalendarChains(KSI_CTX *ctx, KSI_Signature * const *sigs, size_t count, KSI_Integer *to, int anyEnd,
+		size_t *groupOf, ExtendGroup **groups, size_t *groups_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	ExtendGroupKey *keys = NULL;
+	ExtendGroup *tmp = NULL;
+	size_t tmp_len = 0;
+	size_t sendPos = 0;
+	size_t pending = 0;
+	size_t i;
+
+	keys = KSI_calloc(count, sizeof(ExtendGroupKey));
+	tmp = KSI_calloc(count, sizeof(ExtendGroup));
+	if (keys == NULL || tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; i++) {
+		KSI_Integer *signTime = NULL;
+
+		res = KSI_Signature_getSigningTime(sigs[i], &signTime);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		keys[i].aggrTime = KSI_Integer_getUInt64(signTime);
+		keys[i].index = i;
+	}
+
+	qsort(keys, count, sizeof(ExtendGroupKey), compareExtendGroupKeys);
+
+	for (i = 0; i < count; i++) {
+		if (i == 0 || keys[i].aggrTime != keys[i - 1].aggrTime) {
+			ExtendGroup *g = &tmp[tmp_len++];
+
+			KSI_Signature_getSigningTime(sigs[keys[i].index], &g->aggrTime);
+			g->status = KSI_OK;
+
+			/* A chain to the head of the calendar must be requested, unless any chain will do. */
+			if (to != NULL || anyEnd) {
+				res = KSI_CalendarCache_get(ctx->calendarCache, g->aggrTime, to, &g->chain);
+				if (res != KSI_OK) {
+					KSI_pushError(ctx, res, NULL);
+					goto cleanup;
+				}
+
+				/* Cached chains have been validated before. */
+				g->isValidated = g->chain != NULL;
+			}
+		}
+		groupOf[keys[i].index] = tmp_len - 1;
+	}
+
+	KSI_LOG_debug(ctx, "Extending %llu signatures in %llu groups.", (unsigned long long)count, (unsigned long long)tmp_len);
+
+	for (i = 0; i < tmp_len; i++) {
+		ExtendGroup *g = &tmp[i];
+
+		/* Keep the pipeline full. */
+		for (; sendPos < tmp_len && pending < EXTEND_MANY_MAX_PENDING; sendPos++) {
+			ExtendGroup *s = &tmp[sendPos];
+
+			if (s->chain != NULL) continue;
+
+			s->status = createExtendRequest(ctx, s->aggrTime, to, &s->req);
+			if (s->status == KSI_OK) s->status = KSI_sendExtendRequest(ctx, s->req, &s->handle);
+			if (s->status == KSI_OK) pending++;
+		}
+
+		if (g->handle == NULL) continue;
+
+		g->status = receiveCalendarChain(ctx, g->req, g->handle, &g->chain);
+		pending--;
+
+		/* Release the connection resources early. */
+		KSI_RequestHandle_free(g->handle);
+		g->handle = NULL;
+		KSI_ExtendReq_free(g->req);
+		g->req = NULL;
+	}
+
+	*groups = tmp;
+	*groups_len = tmp_len;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	ExtendGroups_free(tmp, tmp_len);
+	KSI_free(keys);
+
+	return res;
+}
+
+/**
+ * Extends the signatures to the publication time \c to, appending the serialized publication
+ * record \c pubRaw, if not \c NULL, to each of them.
+ */
+static int extendManyTo(KSI_Signature * const *sigs, size_t count, KSI_CTX *ctx, KSI_Integer *to,
+		const unsigned char *pubRaw, unsigned pubRaw_len, KSI_Signature **extended, int *status) {
+	int res = KSI_UNKNOWN_ERROR;
+	ExtendGroup *groups = NULL;
+	size_t groups_len = 0;
+	size_t *groupOf = NULL;
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || (sigs == NULL && count > 0) || (extended == NULL && count > 0)) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (sigs[i] == NULL) {
+			KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+			goto cleanup;
+		}
+		extended[i] = NULL;
+	}
+
+	if (count == 0) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	groupOf = KSI_calloc(count, sizeof(size_t));
+	if (groupOf == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	res = fetchCalendarChains(ctx, sigs, count, to, 0, groupOf, &groups, &groups_len);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; i++) {
+		ExtendGroup *g = &groups[groupOf[i]];
+		int sigRes = g->status;
+
+		/* The chain is serialized once for the whole group. */
+		if (sigRes == KSI_OK && g->calRaw == NULL) {
+			sigRes = serializeCalendarChain(ctx, g->chain, &g->calRaw, &g->calRaw_len);
+		}
+
+		if (sigRes == KSI_OK) {
+			sigRes = spliceCalendarChain(ctx, sigs[i], g->chain, g->calRaw, g->calRaw_len, pubRaw, pubRaw_len, &extended[i]);
+		}
+
+		/* Remember the chain once it has been validated with the first signature. */
+		if (sigRes == KSI_OK && !g->isValidated) {
+			g->isValidated = 1;
+			sigRes = KSI_CalendarCache_put(ctx->calendarCache, g->aggrTime, g->chain);
+		}
+
+		if (status != NULL) {
+			status[i] = sigRes;
+		} else if (sigRes != KSI_OK) {
+			KSI_pushError(ctx, res = sigRes, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	/* Without per-signature statuses, the outcome is all or nothing. */
+	if (res != KSI_OK && extended != NULL) {
+		for (i = 0; i < count; i++) {
+			KSI_Signature_free(extended[i]);
+			extended[i] = NULL;
+		}
+	}
+
+	ExtendGroups_free(groups, groups_len);
+	KSI_free(groupOf);
+
+	return res;
+}
+
+int KSI_Signature_extendManyTo(KSI_Signature * const *sigs, size_t count, KSI_CTX *ctx, KSI_Integer *to, KSI_Signature **extended, int *status) {
+	return extendManyTo(sigs, count, ctx, to, NULL, 0, extended, status);
+}
+
+/**
+ * Reads the publication time and serializes the publication record for splicing into the signatures.
+ */
+static int preparePublicationRecord(KSI_CTX *ctx, const KSI_PublicationRecord *pubRec, KSI_Integer **pubTime, unsigned char **pubRaw, unsigned *pubRaw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_PublicationData *pubData = NULL;
+
+	/* Extract the published data object. */
+	res = KSI_PublicationRecord_getPublishedData(pubRec, &pubData);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* Read the publication time from the published data object. */
+	res = KSI_PublicationData_getTime(pubData, pubTime);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_TlvTemplate_serializeObject(ctx, pubRec, 0x0803, 0, 0, KSI_TLV_TEMPLATE(KSI_PublicationRecord), pubRaw, pubRaw_len);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_nofree(pubData);
+
+	return res;
+}
+
+int KSI_Signature_extendMany(KSI_Signature * const *sigs, size_t count, KSI_CTX *ctx, const KSI_PublicationRecord *pubRec, KSI_Signature **extended, int *status) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Integer *pubTime = NULL;
+	unsigned char *pubRaw = NULL;
+	unsigned pubRaw_len = 0;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	/* If publication record is present, it is serialized once for all the signatures. */
+	if (pubRec != NULL) {
+		res = preparePublicationRecord(ctx, pubRec, &pubTime, &pubRaw, &pubRaw_len);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = extendManyTo(sigs, count, ctx, pubTime, pubRaw, pubRaw_len, extended, status);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(pubRaw);
+
+	return res;
+}
+
+int KSI_Signature_extend(const KSI_Signature *signature, KSI_CTX *ctx, const KSI_PublicationRecord *pubRec, KSI_Signature **extended) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Integer *pubTime = NULL;
+	unsigned char *pubRaw = NULL;
+	unsigned pubRaw_len = 0;
+
+	KSI_ERR_clearErrors(ctx);
+	if (signature == NULL || ctx == NULL || extended == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	/* If publication record is present, it is spliced in as the trust anchor. */
+	if (pubRec != NULL) {
+		res = preparePublicationRecord(ctx, pubRec, &pubTime, &pubRaw, &pubRaw_len);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	/* Perform the actual extension, the internals of the result are verified. */
+	res = extendSignatureTo(signature, ctx, pubTime, pubRaw, pubRaw_len, extended);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(pubRaw);
+
+	return res;
+}
+
+void KSI_Signature_free(KSI_Signature *sig) {
+	if (sig != NULL) {
+		KSI_TLV_free(sig->baseTlv);
+		KSI_CalendarHashChain_free(sig->calendarChain);
+		KSI_AggregationHashChainList_free(sig->aggregationChainList);
+		KSI_CalendarAuthRec_free(sig->calendarAuthRec);
+		KSI_AggregationAuthRec_free(sig->aggregationAuthRec);
+		KSI_PublicationRecord_free(sig->publication);
+		KSI_VerificationResult_reset(&sig->verificationResult);
+		KSI_DataHash_free(sig->calendarRoot);
+		KSI_DataHash_free(sig->aggregationRoot);
+
+		KSI_free(sig);
+	}
+}
+
+
+int KSI_Signature_getDocumentHash(KSI_Signature *sig, KSI_DataHash **hsh) {
+	KSI_AggregationHashChain *aggr = NULL;
+	int res;
+
+	if (sig == NULL || hsh == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(sig->ctx);
+
+
+	res = KSI_AggregationHashChainList_elementAt(sig->aggregationChainList, 0, &aggr);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*hsh = aggr->inputHash;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_nofree(aggr);
+
+	return res;
+}
+
+int KSI_Signature_getSigningTime(const KSI_Signature *sig, KSI_Integer **signTime) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Integer *tmp = NULL;
+
+	if (sig == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(sig->ctx);
+
+	if (signTime == NULL) {
+		KSI_pushError(sig->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (sig->calendarChain == NULL) {
+		KSI_pushError(sig->ctx, res = KSI_INVALID_FORMAT, NULL);
+		goto cleanup;
 	}
 
 	res = KSI_CalendarHashChain_getAggregationTime(sig->calendarChain, &tmp);
@@ -1465,7 +2101,7 @@ cleanup:
 
 int KSI_Signature_fromFile(KSI_CTX *ctx, const char *fileName, KSI_Signature **sig) {
 	int res;
-	FILE *f = NULL;
+	KSI_RDR *rdr = NULL;
 
 	unsigned char *raw = NULL;
 	size_t raw_len = 0;
@@ -1480,25 +2116,21 @@ int KSI_Signature_fromFile(KSI_CTX *ctx, const char *fileName, KSI_Signature **s
 		goto cleanup;
 	}
 
-	raw = KSI_calloc(raw_size, 1);
-	if (raw == NULL) {
-		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
-		goto cleanup;
-	}
-
-	f = fopen(fileName, "rb");
-	if (f == NULL) {
-		KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to open file.");
+	/* The file is mapped and parsed in place, without an intermediate copy. */
+	res = KSI_RDR_fromFile(ctx, fileName, &rdr);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
 
-	raw_len = fread(raw, 1, raw_size, f);
-	if (raw_len == 0) {
+	res = KSI_RDR_read_ptr(rdr, &raw, raw_size, &raw_len);
+	if (res != KSI_OK || raw_len == 0) {
 		KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to read file.");
 		goto cleanup;
 	}
 
-	if (!feof(f)) {
+	res = KSI_RDR_verifyEnd(rdr);
+	if (res != KSI_OK) {
 		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Input too long for a valid signature.");
 		goto cleanup;
 	}
@@ -1516,9 +2148,9 @@ int KSI_Signature_fromFile(KSI_CTX *ctx, const char *fileName, KSI_Signature **s
 
 cleanup:
 
-	if (f != NULL) fclose(f);
+	KSI_nofree(raw);
+	KSI_RDR_close(rdr);
 	KSI_Signature_free(tmp);
-	KSI_free(raw);
 
 	return res;
 }
@@ -1750,71 +2382,173 @@ int KSI_Signature_verifyDocument(KSI_Signature *sig, KSI_CTX *ctx, void *doc, si
 		goto cleanup;
 	}
 
-	res = KSI_DataHash_create(ctx, doc, doc_len, hash_id, &hsh);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
-	}
+	res = KSI_DataHash_create(ctx, doc, doc_len, hash_id, &hsh);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_Signature_verifyDataHash(sig, ctx, hsh);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_DataHash_free(hsh);
+
+	return res;
+}
+
+int KSI_Signature_createDataHasher(KSI_Signature *sig, KSI_DataHasher **hsr) {
+	int res;
+	KSI_DataHasher *tmp = NULL;
+	int hash_id = -1;
+
+	if (sig == NULL || hsr == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(sig->ctx);
+
+	res = KSI_Signature_getHashAlgorithm(sig, &hash_id);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHasher_open(sig->ctx, hash_id, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*hsr = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_DataHasher_free(tmp);
+
+	return res;
+}
+
+static int initPublicationsFile(KSI_VerificationResult *info, KSI_CTX *ctx) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (info->publicationsFile == NULL) {
+		res = KSI_receivePublicationsFile(ctx, &info->publicationsFile);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_OK;
+cleanup:
+
+	return res;
+}
+
+static int getCertificate(KSI_CTX *ctx, KSI_VerificationResult *info, const KSI_OctetString *certId, KSI_PKICertificate **cert) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_VerificationBatch *batch = info->batch;
+	KSI_PKICertificate *tmp = NULL;
+	size_t i;
+
+	if (batch != NULL) {
+		for (i = 0; i < batch->certs_len; i++) {
+			if (KSI_OctetString_equals(batch->certs[i].certId, certId)) {
+				*cert = batch->certs[i].cert;
+				res = KSI_OK;
+				goto cleanup;
+			}
+		}
+	}
+
+	res = initPublicationsFile(info, ctx);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_PublicationsFile_getPKICertificateById(info->publicationsFile, certId, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	if (batch != NULL && !batch->certsReadOnly) {
+		if (batch->certs_len == batch->certs_size) {
+			size_t size = batch->certs_size == 0 ? 4 : 2 * batch->certs_size;
+			KSI_CertificateLookup *certs = KSI_calloc(size, sizeof(KSI_CertificateLookup));
+
+			if (certs == NULL) {
+				res = KSI_OUT_OF_MEMORY;
+				goto cleanup;
+			}
+
+			if (batch->certs_len > 0) memcpy(certs, batch->certs, batch->certs_len * sizeof(KSI_CertificateLookup));
+			KSI_free(batch->certs);
+			batch->certs = certs;
+			batch->certs_size = size;
+		}
 
-	res = KSI_Signature_verifyDataHash(sig, ctx, hsh);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
+		batch->certs[batch->certs_len].certId = certId;
+		batch->certs[batch->certs_len].cert = tmp;
+		batch->certs_len++;
 	}
 
+	*cert = tmp;
+
 	res = KSI_OK;
 
 cleanup:
 
-	KSI_DataHash_free(hsh);
-
 	return res;
 }
 
-int KSI_Signature_createDataHasher(KSI_Signature *sig, KSI_DataHasher **hsr) {
-	int res;
-	KSI_DataHasher *tmp = NULL;
-	int hash_id = -1;
-
-	if (sig == NULL || hsr == NULL) {
-		res = KSI_INVALID_ARGUMENT;
-		goto cleanup;
-	}
-	KSI_ERR_clearErrors(sig->ctx);
-
-	res = KSI_Signature_getHashAlgorithm(sig, &hash_id);
-	if (res != KSI_OK) {
-		KSI_pushError(sig->ctx, res, NULL);
-		goto cleanup;
-	}
+/* Returns the root of the calendar hash chain, computed once per signature. */
+static int getCalendarRoot(KSI_Signature *sig, const KSI_DataHash **rootHash) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_VerificationBatch *batch = sig->verificationResult.batch;
+
+	if (sig->calendarRoot == NULL) {
+		if (batch != NULL && batch->calendarRoot != NULL) {
+			/* Reuse the root of an identical chain from the batch. */
+			if (*batch->calendarRoot == NULL) {
+				res = KSI_CalendarHashChain_aggregate(sig->calendarChain, batch->calendarRoot);
+				if (res != KSI_OK) goto cleanup;
+			}
 
-	res = KSI_DataHasher_open(sig->ctx, hash_id, &tmp);
-	if (res != KSI_OK) {
-		KSI_pushError(sig->ctx, res, NULL);
-		goto cleanup;
+			res = KSI_DataHash_clone(*batch->calendarRoot, &sig->calendarRoot);
+			if (res != KSI_OK) goto cleanup;
+		} else {
+			res = KSI_CalendarHashChain_aggregate(sig->calendarChain, &sig->calendarRoot);
+			if (res != KSI_OK) goto cleanup;
+		}
 	}
 
-	*hsr = tmp;
-	tmp = NULL;
+	*rootHash = sig->calendarRoot;
 
 	res = KSI_OK;
 
 cleanup:
 
-	KSI_DataHasher_free(tmp);
-
 	return res;
 }
 
-static int initPublicationsFile(KSI_VerificationResult *info, KSI_CTX *ctx) {
+/* Returns the aggregation time calculated from the calendar hash chain, computed once per signature. */
+static int getCalendarAggregationTime(KSI_Signature *sig, time_t *aggrTime) {
 	int res = KSI_UNKNOWN_ERROR;
 
-	if (info->publicationsFile == NULL) {
-		res = KSI_receivePublicationsFile(ctx, &info->publicationsFile);
+	if (!sig->calendarAggrTime_set) {
+		res = KSI_CalendarHashChain_calculateAggregationTime(sig->calendarChain, &sig->calendarAggrTime);
 		if (res != KSI_OK) goto cleanup;
+
+		sig->calendarAggrTime_set = true;
 	}
 
+	*aggrTime = sig->calendarAggrTime;
+
 	res = KSI_OK;
+
 cleanup:
 
 	return res;
@@ -1838,6 +2572,14 @@ static int verifyInternallyAggregationChain(KSI_Signature *sig) {
 
 	KSI_LOG_info(sig->ctx, "Verifying aggregation hash chain internal consistency.");
 
+	/* The chains are not modified after parsing, so a successful result can be reused. */
+	if (sig->aggregationRoot != NULL && sig->aggregationRootLevel == sig->verificationResult.docAggrLevel) {
+		res = KSI_DataHash_clone(sig->aggregationRoot, &sig->verificationResult.aggregationHash);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_VerificationResult_addSuccess(info, step, "Aggregation chain internally consistent.");
+		goto cleanup;
+	}
 
 	/* Aggregate all the aggregation chains. */
 	for (i = 0; i < KSI_AggregationHashChainList_length(sig->aggregationChainList); i++) {
@@ -1915,6 +2657,13 @@ static int verifyInternallyAggregationChain(KSI_Signature *sig) {
 		goto cleanup;
 	}
 
+	KSI_DataHash_free(sig->aggregationRoot);
+	sig->aggregationRoot = NULL;
+
+	res = KSI_DataHash_clone(hsh, &sig->aggregationRoot);
+	if (res != KSI_OK) goto cleanup;
+	sig->aggregationRootLevel = sig->verificationResult.docAggrLevel;
+
 	sig->verificationResult.aggregationHash = hsh;
 	hsh = NULL;
 
@@ -1971,7 +2720,7 @@ cleanup:
 
 static int verifyCalendarChain(KSI_Signature *sig) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_DataHash *rootHash = NULL;
+	const KSI_DataHash *rootHash = NULL;
 	KSI_Integer *calendarPubTm = NULL;
 	KSI_PublicationData *pubData = NULL;
 	KSI_DataHash *pubHash = NULL;
@@ -1987,7 +2736,7 @@ static int verifyCalendarChain(KSI_Signature *sig) {
 	KSI_LOG_info(sig->ctx, "Verifying calendar hash chain.");
 
 	/* Calculate the root hash value. */
-	res = KSI_CalendarHashChain_aggregate(sig->calendarChain, &rootHash);
+	res = getCalendarRoot(sig, &rootHash);
 	if (res != KSI_OK) goto cleanup;
 
 	/* Get the publication time from calendar hash chain. */
@@ -2018,7 +2767,7 @@ static int verifyCalendarChain(KSI_Signature *sig) {
 
 cleanup:
 
-	KSI_DataHash_free(rootHash);
+	KSI_nofree(rootHash);
 
 	return res;
 }
@@ -2032,7 +2781,7 @@ static int verifyInternallyCalendarChain(KSI_Signature *sig) {
 
 	KSI_LOG_info(sig->ctx, "Verifying calendar hash chain internally.");
 
-	res = KSI_CalendarHashChain_calculateAggregationTime(sig->calendarChain, &calculatedAggrTm);
+	res = getCalendarAggregationTime(sig, &calculatedAggrTm);
 	if (res != KSI_OK) goto cleanup;
 
 	res = KSI_CalendarHashChain_getAggregationTime(sig->calendarChain, &calendarAggrTm);
@@ -2078,10 +2827,7 @@ static int verifyCalAuthRec(KSI_CTX *ctx, KSI_Signature *sig) {
 		goto cleanup;
 	}
 
-	res = initPublicationsFile(&sig->verificationResult, ctx);
-	if (res != KSI_OK) goto cleanup;
-
-	res = KSI_PublicationsFile_getPKICertificateById(sig->verificationResult.publicationsFile, certId, &cert);
+	res = getCertificate(ctx, &sig->verificationResult, certId, &cert);
 	if (res != KSI_OK) goto cleanup;
 
 	if (cert == NULL) {
@@ -2294,6 +3040,7 @@ static int verifyOnline(KSI_CTX *ctx, KSI_Signature *sig) {
 	KSI_ExtendResp *resp = NULL;
 	KSI_Integer *status = NULL;
 	KSI_CalendarHashChain *calChain = NULL;
+	KSI_CalendarHashChain *cachedChain = NULL;
 	KSI_DataHash *rootHash = NULL;
 	KSI_DataHash *pubHash = NULL;
 	KSI_VerificationStep step = KSI_VERIFY_CALCHAIN_ONLINE;
@@ -2313,41 +3060,53 @@ static int verifyOnline(KSI_CTX *ctx, KSI_Signature *sig) {
 		res = KSI_PublicationData_getTime(sig->verificationResult.userPublication, &end);
 		if (res != KSI_OK) goto cleanup;
 	}
-	res = createExtendRequest(sig->ctx, start, end, &req);
-	if (res != KSI_OK) goto cleanup;
 
-	res = KSI_sendExtendRequest(ctx, req, &handle);
+	/* Any chain starting from the aggregation time proves the input hash of the calendar. */
+	res = KSI_CalendarCache_get(ctx->calendarCache, start, end, &cachedChain);
 	if (res != KSI_OK) goto cleanup;
 
-	res = KSI_RequestHandle_getExtendResponse(handle, &resp);
-	if (res != KSI_OK) goto cleanup;
+	if (cachedChain != NULL) {
+		calChain = cachedChain;
+	} else if (info->extenderChain != NULL && !info->useUserPublication) {
+		/* The chain was requested in advance by the caller. */
+		calChain = info->extenderChain;
+	} else {
+		res = createExtendRequest(sig->ctx, start, end, &req);
+		if (res != KSI_OK) goto cleanup;
 
-	/* Verify the correctness of the response. */
-	res = KSI_ExtendResp_verifyWithRequest(resp, req);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
-	}
+		res = KSI_sendExtendRequest(ctx, req, &handle);
+		if (res != KSI_OK) goto cleanup;
 
-	res = KSI_ExtendResp_getStatus(resp, &status);
-	if (res != KSI_OK) goto cleanup;
+		res = KSI_RequestHandle_getExtendResponse(handle, &resp);
+		if (res != KSI_OK) goto cleanup;
 
-	/* Verify status. */
-	if (status != NULL && !KSI_Integer_equalsUInt(status, 0)) {
-		KSI_Utf8String *respErr = NULL;
-		char errm[1024];
+		/* Verify the correctness of the response. */
+		res = KSI_ExtendResp_verifyWithRequest(resp, req);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
 
-		res = KSI_ExtendResp_getErrorMsg(resp, &respErr);
+		res = KSI_ExtendResp_getStatus(resp, &status);
 		if (res != KSI_OK) goto cleanup;
 
-		KSI_snprintf(errm, sizeof(errm), "Extend failure from server: '%s'", KSI_Utf8String_cstr(respErr));
+		/* Verify status. */
+		if (status != NULL && !KSI_Integer_equalsUInt(status, 0)) {
+			KSI_Utf8String *respErr = NULL;
+			char errm[1024];
 
-		res = KSI_VerificationResult_addFailure(info, step, errm);
-		goto cleanup;
-	}
+			res = KSI_ExtendResp_getErrorMsg(resp, &respErr);
+			if (res != KSI_OK) goto cleanup;
 
-	res = KSI_ExtendResp_getCalendarHashChain(resp, &calChain);
-	if (res != KSI_OK) goto cleanup;
+			KSI_snprintf(errm, sizeof(errm), "Extend failure from server: '%s'", KSI_Utf8String_cstr(respErr));
+
+			res = KSI_VerificationResult_addFailure(info, step, errm);
+			goto cleanup;
+		}
+
+		res = KSI_ExtendResp_getCalendarHashChain(resp, &calChain);
+		if (res != KSI_OK) goto cleanup;
+	}
 
 	res = KSI_CalendarHashChain_getInputHash(calChain, &extHash);
 	if (res != KSI_OK) goto cleanup;
@@ -2370,6 +3129,12 @@ static int verifyOnline(KSI_CTX *ctx, KSI_Signature *sig) {
 		}
 	}
 
+	/* Remember the validated chain. */
+	if (cachedChain == NULL) {
+		res = KSI_CalendarCache_put(ctx->calendarCache, start, calChain);
+		if (res != KSI_OK) goto cleanup;
+	}
+
 	res = KSI_VerificationResult_addSuccess(info, step, "Verified online.");
 
 cleanup:
@@ -2378,6 +3143,7 @@ cleanup:
 	KSI_ExtendReq_free(req);
 	KSI_RequestHandle_free(handle);
 	KSI_ExtendResp_free(resp);
+	KSI_CalendarHashChain_free(cachedChain);
 
 	return res;
 }
@@ -2386,7 +3152,7 @@ static int verifyCalendarChainWithPublication(KSI_Signature *sig){
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_CalendarHashChain *calChain = NULL;
 	KSI_Integer *pubTime = NULL;
-	KSI_DataHash *rootHash = NULL;
+	const KSI_DataHash *rootHash = NULL;
 	KSI_PublicationRecord *sigPubRec = NULL;
 	KSI_PublicationData *sigPubData = NULL;
 	KSI_DataHash *publishedHash = NULL;
@@ -2405,7 +3171,7 @@ static int verifyCalendarChainWithPublication(KSI_Signature *sig){
 	res = KSI_CalendarHashChain_getPublicationTime(calChain, &pubTime);
 	if (res != KSI_OK) goto cleanup;
 
-	res = KSI_CalendarHashChain_aggregate(calChain, &rootHash);
+	res = getCalendarRoot(sig, &rootHash);
 	if (res != KSI_OK) goto cleanup;
 
 	sigPubRec = sig->publication;
@@ -2437,7 +3203,7 @@ static int verifyCalendarChainWithPublication(KSI_Signature *sig){
 
 cleanup:
 
-	KSI_DataHash_free(rootHash);
+	KSI_nofree(rootHash);
 
 	return res;
 }
@@ -2632,6 +3398,296 @@ cleanup:
 	return res;
 }
 
+int KSI_Signature_verifyOnlineMany(KSI_Signature **sigs, size_t count, KSI_CTX *ctx, int *status) {
+	int res = KSI_UNKNOWN_ERROR;
+	ExtendGroup *groups = NULL;
+	size_t groups_len = 0;
+	size_t *groupOf = NULL;
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || (sigs == NULL && count > 0)) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (sigs[i] == NULL) {
+			KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+			goto cleanup;
+		}
+	}
+
+	if (count == 0) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	groupOf = KSI_calloc(count, sizeof(size_t));
+	if (groupOf == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	/* Any chain starting from the aggregation time proves the input hash of the calendar. */
+	res = fetchCalendarChains(ctx, (KSI_Signature * const *)sigs, count, NULL, 1, groupOf, &groups, &groups_len);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; i++) {
+		ExtendGroup *g = &groups[groupOf[i]];
+		int sigRes = g->status;
+
+		if (sigRes == KSI_OK) {
+			sigs[i]->verificationResult.extenderChain = g->chain;
+			sigRes = KSI_Signature_verifyOnline(sigs[i], ctx);
+			sigs[i]->verificationResult.extenderChain = NULL;
+		}
+
+		if (status != NULL) {
+			status[i] = sigRes;
+		} else if (sigRes != KSI_OK) {
+			KSI_pushError(ctx, res = sigRes, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	ExtendGroups_free(groups, groups_len);
+	KSI_free(groupOf);
+
+	return res;
+}
+
+typedef struct {
+	unsigned char *raw;
+	unsigned raw_len;
+	size_t index;
+} CalendarChainKey;
+
+static int compareCalendarChainKeys(const void *a, const void *b) {
+	const CalendarChainKey *ka = a;
+	const CalendarChainKey *kb = b;
+	int cmp;
+
+	if (ka->raw_len != kb->raw_len) return ka->raw_len < kb->raw_len ? -1 : 1;
+	if (ka->raw_len > 0) {
+		cmp = memcmp(ka->raw, kb->raw, ka->raw_len);
+		if (cmp != 0) return cmp;
+	}
+	return ka->index < kb->index ? -1 : (ka->index > kb->index);
+}
+
+int KSI_VerificationBatch_groupCalendarChains(KSI_CTX *ctx, KSI_Signature * const *sigs, size_t count, size_t *groupOf, size_t *groups_count) {
+	int res = KSI_UNKNOWN_ERROR;
+	CalendarChainKey *keys = NULL;
+	size_t groups_len = 0;
+	size_t i;
+
+	keys = KSI_calloc(count, sizeof(CalendarChainKey));
+	if (keys == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; i++) {
+		KSI_LIST(KSI_TLV) *nestedList = NULL;
+		size_t j;
+
+		keys[i].index = i;
+
+		if (sigs[i]->calendarChain == NULL) continue;
+
+		res = KSI_TLV_getNestedList(sigs[i]->baseTlv, &nestedList);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		for (j = 0; j < KSI_TLVList_length(nestedList); j++) {
+			KSI_TLV *tlv = NULL;
+
+			res = KSI_TLVList_elementAt(nestedList, j, &tlv);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+
+			if (tlv == NULL || KSI_TLV_getTag(tlv) != 0x0802) continue;
+
+			res = KSI_TLV_serialize(tlv, &keys[i].raw, &keys[i].raw_len);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+			break;
+		}
+	}
+
+	qsort(keys, count, sizeof(CalendarChainKey), compareCalendarChainKeys);
+
+	for (i = 0; i < count; i++) {
+		if (i == 0 || keys[i].raw == NULL || keys[i - 1].raw == NULL ||
+				keys[i].raw_len != keys[i - 1].raw_len || memcmp(keys[i].raw, keys[i - 1].raw, keys[i].raw_len) != 0) {
+			groups_len++;
+		}
+		groupOf[keys[i].index] = groups_len - 1;
+	}
+
+	KSI_LOG_debug(ctx, "Verifying %llu signatures with %llu calendar hash chains.", (unsigned long long)count, (unsigned long long)groups_len);
+
+	if (groups_count != NULL) *groups_count = groups_len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (keys != NULL) {
+		for (i = 0; i < count; i++) {
+			KSI_free(keys[i].raw);
+		}
+		KSI_free(keys);
+	}
+
+	return res;
+}
+
+int KSI_VerificationBatch_addCertificates(KSI_VerificationBatch *batch, KSI_CTX *ctx, KSI_Signature * const *sigs, size_t count) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_VerificationResult info;
+	size_t i;
+
+	/* Only the publications file and the batch are used from the scratch result. */
+	memset(&info, 0, sizeof(info));
+	info.batch = batch;
+
+	for (i = 0; i < count; i++) {
+		KSI_OctetString *certId = NULL;
+		KSI_PKICertificate *cert = NULL;
+
+		if (sigs[i]->calendarAuthRec == NULL) continue;
+
+		res = KSI_PKISignedData_getCertId(sigs[i]->calendarAuthRec->signatureData, &certId);
+		if (res != KSI_OK || certId == NULL) continue;
+
+		res = getCertificate(ctx, &info, certId, &cert);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_VerificationBatch_verify(KSI_VerificationBatch *batch, KSI_Signature *sig, KSI_CTX *ctx, const KSI_PublicationData *publication) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	KSI_VerificationResult_reset(&sig->verificationResult);
+
+	if (publication != NULL) {
+		sig->verificationResult.userPublication = publication;
+		sig->verificationResult.useUserPublication = true;
+	}
+
+	sig->verificationResult.batch = batch;
+
+	res = KSI_Signature_verifyPolicy(sig, publication != NULL ? KSI_VP_OFFLINE : KSI_VP_SIGNATURE, ctx);
+
+	sig->verificationResult.batch = NULL;
+
+	return res;
+}
+
+void KSI_VerificationBatch_cleanup(KSI_VerificationBatch *batch) {
+	if (batch != NULL) {
+		if (!batch->certsReadOnly) KSI_free(batch->certs);
+		batch->certs = NULL;
+		batch->certs_len = 0;
+		batch->certs_size = 0;
+	}
+}
+
+int KSI_Signature_verifyMany(KSI_Signature * const *sigs, size_t count, KSI_CTX *ctx, const KSI_PublicationData *publication, int *status) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_VerificationBatch batch;
+	KSI_DataHash **calendarRoots = NULL;
+	size_t *groupOf = NULL;
+	size_t i;
+
+	memset(&batch, 0, sizeof(batch));
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || (sigs == NULL && count > 0)) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (sigs[i] == NULL) {
+			KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+			goto cleanup;
+		}
+	}
+
+	if (count == 0) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	groupOf = KSI_calloc(count, sizeof(size_t));
+	calendarRoots = KSI_calloc(count, sizeof(KSI_DataHash *));
+	if (groupOf == NULL || calendarRoots == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_VerificationBatch_groupCalendarChains(ctx, sigs, count, groupOf, NULL);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; i++) {
+		int sigRes;
+
+		batch.calendarRoot = &calendarRoots[groupOf[i]];
+
+		sigRes = KSI_VerificationBatch_verify(&batch, sigs[i], ctx, publication);
+
+		if (status != NULL) {
+			status[i] = sigRes;
+		} else if (sigRes != KSI_OK) {
+			KSI_pushError(ctx, res = sigRes, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (calendarRoots != NULL) {
+		for (i = 0; i < count; i++) {
+			KSI_DataHash_free(calendarRoots[i]);
+		}
+		KSI_free(calendarRoots);
+	}
+	KSI_free(groupOf);
+	KSI_VerificationBatch_cleanup(&batch);
+
+	return res;
+}
+
 int KSI_Signature_verifyAggregatedHash(KSI_Signature *sig, KSI_CTX *ctx, const KSI_DataHash *rootHash, KSI_uint64_t rootLevel) {
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_CTX *useCtx = ctx;
@@ -78,6 +78,37 @@ extern "C" {
      */
 	int KSI_Signature_verifyOnline(KSI_Signature *sig, KSI_CTX *ctx);
 
+	/**
+	 * Verifies a batch of signatures using online resources. Signatures sharing the aggregation
+	 * time are verified with a single extend request.
+	 *
+	 * \param[in]	sigs		Array of KSI signatures.
+	 * \param[in]	count		Number of signatures in \c sigs.
+	 * \param[in]	ctx			KSI context.
+	 * \param[out]	status		Array of \c count status codes, may be \c NULL.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note If \c status is \c NULL, the first failure is returned.
+	 * \see #KSI_Signature_verifyOnline
+	 */
+	int KSI_Signature_verifyOnlineMany(KSI_Signature **sigs, size_t count, KSI_CTX *ctx, int *status);
+
+	/**
+	 * Verifies a batch of signatures like #KSI_Signature_verify, or like
+	 * #KSI_Signature_verifyWithPublication if \c publication is set. The work common to the
+	 * signatures is done once: the certificates are looked up from the publications file once per
+	 * certificate id and the root of a calendar hash chain is computed once for all the
+	 * signatures carrying the same chain.
+	 *
+	 * \param[in]	sigs		Array of KSI signatures.
+	 * \param[in]	count		Number of signatures in \c sigs.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	publication	Publication to verify the signatures with, may be \c NULL.
+	 * \param[out]	status		Array of \c count status codes, may be \c NULL.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note If \c status is \c NULL, the first failure is returned.
+	 */
+	int KSI_Signature_verifyMany(KSI_Signature * const *sigs, size_t count, KSI_CTX *ctx, const KSI_PublicationData *publication, int *status);
+
 	/**
 	 * Verifies that the document matches the signature.
 	 * \param[in]	sig			KSI signature.
@@ -166,6 +197,24 @@ extern "C" {
 	 */
 	int KSI_Signature_createAggregated(KSI_CTX *ctx, KSI_DataHash *rootHash, KSI_uint64_t rootLevel, KSI_Signature **signature);
 
+	/**
+	 * Signs a batch of root hash values. The requests are sent without waiting for the
+	 * responses to the previous ones, so the batch takes about as long as the slowest request.
+	 * \param[in]		ctx			KSI context.
+	 * \param[in]		hashes		Array of root hash values.
+	 * \param[in]		levels		Array of the aggregation levels of the root hashes, \c NULL if all are 0.
+	 * \param[in]		count		Number of hashes in \c hashes.
+	 * \param[out]		signatures	Array of \c count receiving pointers.
+	 * \param[out]		status		Array of \c count status codes, may be \c NULL.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code).
+	 * \note If \c status is not \c NULL, the outcome of every hash is stored in it and the
+	 * pointer of a failed hash in \c signatures is set to \c NULL. Otherwise the first failure is
+	 * returned and no signatures are produced.
+	 * \see #KSI_Signature_createAggregated
+	 */
+	int KSI_Signature_createMany(KSI_CTX *ctx, KSI_DataHash * const *hashes, const KSI_uint64_t *levels, size_t count, KSI_Signature **signatures, int *status);
+
 	/**
 	 * This function extends the signature to the given publication \c pubRec. If \c pubRec is \c NULL the signature is
 	 * extended to the head of the calendar database. This function requires access to a working KSI extender or it will
@@ -197,6 +246,44 @@ extern "C" {
 	 */
 	int KSI_Signature_extendTo(const KSI_Signature *signature, KSI_CTX *ctx, KSI_Integer *to, KSI_Signature **extended);
 
+	/**
+	 * Extends a batch of signatures to the given time \c to. Signatures sharing the aggregation time are
+	 * served by a single extend request and the requests for different aggregation times are sent
+	 * without waiting for the previous responses. If \c to is equal to \c NULL, the signatures are
+	 * extended to the head of the extender.
+	 * \param[in]		sigs		Array of KSI signatures to be extended.
+	 * \param[in]		count		Number of signatures in \c sigs.
+	 * \param[in]		ctx			KSI context.
+	 * \param[in]		to			UTC time to extend to.
+	 * \param[out]		extended	Array of \c count receiving pointers.
+	 * \param[out]		status		Array of \c count status codes, may be \c NULL.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code).
+	 *
+	 * \note If \c status is not \c NULL, the outcome of every signature is stored in it and the
+	 * pointer of a failed signature in \c extended is set to \c NULL. Otherwise the first failure is
+	 * returned and no extended signatures are produced.
+	 * \see #KSI_Signature_extendTo
+	 */
+	int KSI_Signature_extendManyTo(KSI_Signature * const *sigs, size_t count, KSI_CTX *ctx, KSI_Integer *to, KSI_Signature **extended, int *status);
+
+	/**
+	 * Extends a batch of signatures to the given publication \c pubRec. If \c pubRec is \c NULL the
+	 * signatures are extended to the head of the calendar database.
+	 * \param[in]		sigs		Array of KSI signatures to be extended.
+	 * \param[in]		count		Number of signatures in \c sigs.
+	 * \param[in]		ctx			KSI context.
+	 * \param[in]		pubRec		Publication record.
+	 * \param[out]		extended	Array of \c count receiving pointers.
+	 * \param[out]		status		Array of \c count status codes, may be \c NULL.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code).
+	 * \see #KSI_Signature_extendManyTo, #KSI_Signature_extend
+	 */
+	int KSI_Signature_extendMany(KSI_Signature * const *sigs, size_t count, KSI_CTX *ctx, const KSI_PublicationRecord *pubRec, KSI_Signature **extended, int *status);
+
 	/**
 	 * Access method for the signed document hash as a #KSI_DataHash object.
 	 * \param[in]		sig			KSI signature.
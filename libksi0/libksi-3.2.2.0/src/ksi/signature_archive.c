@@ -0,0 +1,852 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include <string.h>
+
+#include "internal.h"
+#include "io.h"
+#include "signature_archive.h"
+
+/*
+ * The archive starts with the 8 byte signature "KSIARC01", all integers are big-endian:
+ * - number of components (4 bytes), followed by the components, each as its length (4 bytes)
+ *   and the bytes of the TLV element;
+ * - number of signatures (4 bytes), followed by the signatures, each as the first two bytes of
+ *   the signature TLV header, the number of elements (2 bytes) and the indices of the
+ *   components (4 bytes each) in the order of the elements.
+ */
+#define ARCHIVE_MAGIC "KSIARC01"
+#define ARCHIVE_MAGIC_LEN 8
+
+/* Flag of the TLV header with a 16-bit tag and length. */
+#define ARCHIVE_TLV16 0x80u
+
+/* Signatures are TLVs with a 16-bit length. */
+#define ARCHIVE_MAX_SIGNATURE_LEN 0xffff
+
+typedef struct ArchiveComponent_st ArchiveComponent;
+
+struct ArchiveComponent_st {
+	unsigned char *data;
+	size_t data_len;
+	KSI_uint64_t hash;
+	/* Position of the component in the archive. */
+	size_t index;
+
+	/* Next component in the same bucket. */
+	ArchiveComponent *bucketNext;
+};
+
+typedef struct ArchiveEntry_st {
+	/* The first two bytes of the signature TLV header. */
+	unsigned char hdr[2];
+	/* Range of the component references of the signature. */
+	size_t refs_start;
+	size_t refs_len;
+} ArchiveEntry;
+
+struct KSI_SignatureArchiveWriter_st {
+	KSI_CTX *ctx;
+
+	ArchiveComponent **components;
+	size_t components_len;
+	size_t components_size;
+
+	ArchiveComponent **buckets;
+	size_t bucketCount;
+
+	ArchiveEntry *entries;
+	size_t entries_len;
+	size_t entries_size;
+
+	/* Component references of all the signatures. */
+	size_t *refs;
+	size_t refs_len;
+	size_t refs_size;
+};
+
+struct KSI_SignatureArchive_st {
+	KSI_CTX *ctx;
+
+	/* The reader of the mapped archive file, or the copy of the archive. */
+	KSI_RDR *rdr;
+	unsigned char *copy;
+	const unsigned char *data;
+	size_t data_len;
+
+	/* Offsets of the components and their lengths. */
+	size_t *compOffset;
+	size_t *compLen;
+	size_t components_len;
+
+	/* Offsets of the signature entries. */
+	size_t *entryOffset;
+	size_t entries_len;
+};
+
+static KSI_uint64_t hashBytes(const unsigned char *data, size_t data_len) {
+	/* FNV-1a. */
+	KSI_uint64_t hash = 0xcbf29ce484222325ull;
+	size_t i;
+
+	for (i = 0; i < data_len; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+/* Grows the array to hold at least one more element. */
+static int growArray(void **arr, size_t elem_size, size_t len, size_t *size) {
+	void *tmp = NULL;
+	size_t newSize;
+
+	if (len < *size) return KSI_OK;
+
+	newSize = *size > 0 ? *size * 2 : 16;
+
+	tmp = KSI_malloc(newSize * elem_size);
+	if (tmp == NULL) return KSI_OUT_OF_MEMORY;
+
+	if (len > 0) memcpy(tmp, *arr, len * elem_size);
+	KSI_free(*arr);
+	*arr = tmp;
+	*size = newSize;
+
+	return KSI_OK;
+}
+
+static int ArchiveWriter_rehash(KSI_SignatureArchiveWriter *writer) {
+	ArchiveComponent **buckets = NULL;
+	size_t bucketCount = writer->bucketCount > 0 ? writer->bucketCount * 2 : 64;
+	size_t i;
+
+	buckets = KSI_calloc(bucketCount, sizeof(ArchiveComponent *));
+	if (buckets == NULL) return KSI_OUT_OF_MEMORY;
+
+	for (i = 0; i < writer->components_len; i++) {
+		ArchiveComponent *comp = writer->components[i];
+		size_t b = (size_t)(comp->hash % bucketCount);
+
+		comp->bucketNext = buckets[b];
+		buckets[b] = comp;
+	}
+
+	KSI_free(writer->buckets);
+	writer->buckets = buckets;
+	writer->bucketCount = bucketCount;
+
+	return KSI_OK;
+}
+
+/* Returns the index of the component with the given contents, adding it if not present yet. */
+static int ArchiveWriter_intern(KSI_SignatureArchiveWriter *writer, const unsigned char *data, size_t data_len, size_t *index) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_uint64_t hash = hashBytes(data, data_len);
+	ArchiveComponent *comp = NULL;
+	ArchiveComponent *tmp = NULL;
+	size_t b;
+
+	if (writer->bucketCount > 0) {
+		for (comp = writer->buckets[(size_t)(hash % writer->bucketCount)]; comp != NULL; comp = comp->bucketNext) {
+			if (comp->hash == hash && comp->data_len == data_len && !memcmp(comp->data, data, data_len)) break;
+		}
+	}
+
+	if (comp == NULL) {
+		if (writer->components_len >= writer->bucketCount) {
+			res = ArchiveWriter_rehash(writer);
+			if (res != KSI_OK) goto cleanup;
+		}
+
+		res = growArray((void **)&writer->components, sizeof(ArchiveComponent *), writer->components_len, &writer->components_size);
+		if (res != KSI_OK) goto cleanup;
+
+		tmp = KSI_new(ArchiveComponent);
+		if (tmp == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+
+		tmp->data = KSI_malloc(data_len);
+		if (tmp->data == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+		memcpy(tmp->data, data, data_len);
+		tmp->data_len = data_len;
+		tmp->hash = hash;
+		tmp->index = writer->components_len;
+
+		b = (size_t)(hash % writer->bucketCount);
+		tmp->bucketNext = writer->buckets[b];
+		writer->buckets[b] = tmp;
+
+		writer->components[writer->components_len++] = tmp;
+		comp = tmp;
+		tmp = NULL;
+	}
+
+	*index = comp->index;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (tmp != NULL) {
+		KSI_free(tmp->data);
+		KSI_free(tmp);
+	}
+
+	return res;
+}
+
+int KSI_SignatureArchiveWriter_new(KSI_CTX *ctx, KSI_SignatureArchiveWriter **writer) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_SignatureArchiveWriter *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || writer == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_SignatureArchiveWriter);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->ctx = ctx;
+	tmp->components = NULL;
+	tmp->components_len = 0;
+	tmp->components_size = 0;
+	tmp->buckets = NULL;
+	tmp->bucketCount = 0;
+	tmp->entries = NULL;
+	tmp->entries_len = 0;
+	tmp->entries_size = 0;
+	tmp->refs = NULL;
+	tmp->refs_len = 0;
+	tmp->refs_size = 0;
+
+	*writer = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_SignatureArchiveWriter_free(tmp);
+
+	return res;
+}
+
+void KSI_SignatureArchiveWriter_free(KSI_SignatureArchiveWriter *writer) {
+	size_t i;
+
+	if (writer != NULL) {
+		for (i = 0; i < writer->components_len; i++) {
+			KSI_free(writer->components[i]->data);
+			KSI_free(writer->components[i]);
+		}
+		KSI_free(writer->components);
+		KSI_free(writer->buckets);
+		KSI_free(writer->entries);
+		KSI_free(writer->refs);
+		KSI_free(writer);
+	}
+}
+
+int KSI_SignatureArchiveWriter_addRaw(KSI_SignatureArchiveWriter *writer, const unsigned char *raw, size_t raw_len, size_t *index) {
+	int res = KSI_UNKNOWN_ERROR;
+	ArchiveEntry entry;
+	size_t refs_len;
+	size_t pos;
+
+	if (writer == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(writer->ctx);
+	if (raw == NULL) {
+		KSI_pushError(writer->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	/* Only the signature TLV with its 16-bit header is expected. */
+	if (raw_len < 4 || (raw[0] & ARCHIVE_TLV16) == 0 || KSI_getUInt(raw + 2, 2) != raw_len - 4) {
+		KSI_pushError(writer->ctx, res = KSI_INVALID_FORMAT, "Not a serialized signature.");
+		goto cleanup;
+	}
+
+	/* Roll back the references on failure. */
+	refs_len = writer->refs_len;
+
+	entry.hdr[0] = raw[0];
+	entry.hdr[1] = raw[1];
+	entry.refs_start = writer->refs_len;
+
+	for (pos = 4; pos < raw_len;) {
+		size_t hdr_len = (raw[pos] & ARCHIVE_TLV16) ? 4 : 2;
+		size_t elem_len;
+		size_t comp = 0;
+
+		if (pos + hdr_len > raw_len) {
+			writer->refs_len = refs_len;
+			KSI_pushError(writer->ctx, res = KSI_INVALID_FORMAT, "Truncated signature element.");
+			goto cleanup;
+		}
+
+		elem_len = hdr_len + (size_t)KSI_getUInt(raw + pos + hdr_len - (hdr_len == 4 ? 2 : 1), hdr_len == 4 ? 2 : 1);
+		if (pos + elem_len > raw_len) {
+			writer->refs_len = refs_len;
+			KSI_pushError(writer->ctx, res = KSI_INVALID_FORMAT, "Truncated signature element.");
+			goto cleanup;
+		}
+
+		res = ArchiveWriter_intern(writer, raw + pos, elem_len, &comp);
+		if (res == KSI_OK) {
+			res = growArray((void **)&writer->refs, sizeof(size_t), writer->refs_len, &writer->refs_size);
+		}
+		if (res != KSI_OK) {
+			writer->refs_len = refs_len;
+			KSI_pushError(writer->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		writer->refs[writer->refs_len++] = comp;
+		pos += elem_len;
+	}
+
+	entry.refs_len = writer->refs_len - entry.refs_start;
+	if (entry.refs_len > 0xffff) {
+		writer->refs_len = refs_len;
+		KSI_pushError(writer->ctx, res = KSI_INVALID_FORMAT, "Too many signature elements.");
+		goto cleanup;
+	}
+
+	res = growArray((void **)&writer->entries, sizeof(ArchiveEntry), writer->entries_len, &writer->entries_size);
+	if (res != KSI_OK) {
+		writer->refs_len = refs_len;
+		KSI_pushError(writer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (index != NULL) *index = writer->entries_len;
+	writer->entries[writer->entries_len++] = entry;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_SignatureArchiveWriter_add(KSI_SignatureArchiveWriter *writer, KSI_Signature *sig, size_t *index) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *raw = NULL;
+	unsigned raw_len = 0;
+
+	if (writer == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(writer->ctx);
+	if (sig == NULL) {
+		KSI_pushError(writer->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_Signature_serialize(sig, &raw, &raw_len);
+	if (res != KSI_OK) {
+		KSI_pushError(writer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_SignatureArchiveWriter_addRaw(writer, raw, raw_len, index);
+	if (res != KSI_OK) {
+		KSI_pushError(writer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(raw);
+
+	return res;
+}
+
+int KSI_SignatureArchiveWriter_serialize(KSI_SignatureArchiveWriter *writer, unsigned char **raw, size_t *raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *tmp = NULL;
+	size_t len = ARCHIVE_MAGIC_LEN + 4 + 4;
+	size_t pos;
+	size_t i;
+
+	if (writer == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(writer->ctx);
+	if (raw == NULL || raw_len == NULL) {
+		KSI_pushError(writer->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < writer->components_len; i++) {
+		len += 4 + writer->components[i]->data_len;
+	}
+	len += writer->entries_len * 4 + writer->refs_len * 4;
+
+	tmp = KSI_malloc(len);
+	if (tmp == NULL) {
+		KSI_pushError(writer->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	memcpy(tmp, ARCHIVE_MAGIC, ARCHIVE_MAGIC_LEN);
+	pos = ARCHIVE_MAGIC_LEN;
+
+	KSI_putUInt(tmp + pos, writer->components_len, 4);
+	pos += 4;
+
+	for (i = 0; i < writer->components_len; i++) {
+		const ArchiveComponent *comp = writer->components[i];
+
+		KSI_putUInt(tmp + pos, comp->data_len, 4);
+		memcpy(tmp + pos + 4, comp->data, comp->data_len);
+		pos += 4 + comp->data_len;
+	}
+
+	KSI_putUInt(tmp + pos, writer->entries_len, 4);
+	pos += 4;
+
+	for (i = 0; i < writer->entries_len; i++) {
+		const ArchiveEntry *entry = &writer->entries[i];
+		size_t j;
+
+		tmp[pos] = entry->hdr[0];
+		tmp[pos + 1] = entry->hdr[1];
+		KSI_putUInt(tmp + pos + 2, entry->refs_len, 2);
+		pos += 4;
+
+		for (j = 0; j < entry->refs_len; j++) {
+			KSI_putUInt(tmp + pos, writer->refs[entry->refs_start + j], 4);
+			pos += 4;
+		}
+	}
+
+	*raw = tmp;
+	*raw_len = len;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+
+	return res;
+}
+
+/* Builds the index of the archive, checking every reference. */
+static int SignatureArchive_index(KSI_SignatureArchive *archive) {
+	int res = KSI_UNKNOWN_ERROR;
+	const unsigned char *data = archive->data;
+	size_t data_len = archive->data_len;
+	size_t pos = ARCHIVE_MAGIC_LEN;
+	size_t count;
+	size_t i;
+
+	if (data_len < ARCHIVE_MAGIC_LEN + 4 || memcmp(data, ARCHIVE_MAGIC, ARCHIVE_MAGIC_LEN)) {
+		res = KSI_INVALID_FORMAT;
+		goto cleanup;
+	}
+
+	count = (size_t)KSI_getUInt(data + pos, 4);
+	pos += 4;
+
+	/* Every component takes at least 4 bytes. */
+	if (count > (data_len - pos) / 4) {
+		res = KSI_INVALID_FORMAT;
+		goto cleanup;
+	}
+
+	archive->compOffset = KSI_calloc(count > 0 ? count : 1, sizeof(size_t));
+	archive->compLen = KSI_calloc(count > 0 ? count : 1, sizeof(size_t));
+	if (archive->compOffset == NULL || archive->compLen == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; i++) {
+		size_t len;
+
+		if (data_len - pos < 4) {
+			res = KSI_INVALID_FORMAT;
+			goto cleanup;
+		}
+
+		len = (size_t)KSI_getUInt(data + pos, 4);
+		pos += 4;
+
+		if (len > data_len - pos || len > ARCHIVE_MAX_SIGNATURE_LEN) {
+			res = KSI_INVALID_FORMAT;
+			goto cleanup;
+		}
+
+		archive->compOffset[i] = pos;
+		archive->compLen[i] = len;
+		pos += len;
+	}
+	archive->components_len = count;
+
+	if (data_len - pos < 4) {
+		res = KSI_INVALID_FORMAT;
+		goto cleanup;
+	}
+
+	count = (size_t)KSI_getUInt(data + pos, 4);
+	pos += 4;
+
+	if (count > (data_len - pos) / 4) {
+		res = KSI_INVALID_FORMAT;
+		goto cleanup;
+	}
+
+	archive->entryOffset = KSI_calloc(count > 0 ? count : 1, sizeof(size_t));
+	if (archive->entryOffset == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; i++) {
+		size_t refs_len;
+		size_t sig_len = 0;
+		size_t j;
+
+		if (data_len - pos < 4) {
+			res = KSI_INVALID_FORMAT;
+			goto cleanup;
+		}
+
+		archive->entryOffset[i] = pos;
+		refs_len = (size_t)KSI_getUInt(data + pos + 2, 2);
+		pos += 4;
+
+		if (refs_len > (data_len - pos) / 4) {
+			res = KSI_INVALID_FORMAT;
+			goto cleanup;
+		}
+
+		for (j = 0; j < refs_len; j++) {
+			size_t comp = (size_t)KSI_getUInt(data + pos, 4);
+
+			if (comp >= archive->components_len) {
+				res = KSI_INVALID_FORMAT;
+				goto cleanup;
+			}
+
+			sig_len += archive->compLen[comp];
+			if (sig_len > ARCHIVE_MAX_SIGNATURE_LEN) {
+				res = KSI_INVALID_FORMAT;
+				goto cleanup;
+			}
+
+			pos += 4;
+		}
+	}
+	archive->entries_len = count;
+
+	if (pos != data_len) {
+		res = KSI_INVALID_FORMAT;
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int SignatureArchive_new(KSI_CTX *ctx, KSI_SignatureArchive **archive) {
+	KSI_SignatureArchive *tmp = NULL;
+
+	tmp = KSI_new(KSI_SignatureArchive);
+	if (tmp == NULL) return KSI_OUT_OF_MEMORY;
+
+	tmp->ctx = ctx;
+	tmp->rdr = NULL;
+	tmp->copy = NULL;
+	tmp->data = NULL;
+	tmp->data_len = 0;
+	tmp->compOffset = NULL;
+	tmp->compLen = NULL;
+	tmp->components_len = 0;
+	tmp->entryOffset = NULL;
+	tmp->entries_len = 0;
+
+	*archive = tmp;
+
+	return KSI_OK;
+}
+
+int KSI_SignatureArchive_parse(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, KSI_SignatureArchive **archive) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_SignatureArchive *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || raw == NULL || archive == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = SignatureArchive_new(ctx, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	tmp->copy = KSI_malloc(raw_len > 0 ? raw_len : 1);
+	if (tmp->copy == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+	memcpy(tmp->copy, raw, raw_len);
+	tmp->data = tmp->copy;
+	tmp->data_len = raw_len;
+
+	res = SignatureArchive_index(tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, "Invalid signature archive.");
+		goto cleanup;
+	}
+
+	*archive = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_SignatureArchive_free(tmp);
+
+	return res;
+}
+
+int KSI_SignatureArchive_fromFile(KSI_CTX *ctx, const char *fileName, KSI_SignatureArchive **archive) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_SignatureArchive *tmp = NULL;
+	unsigned char *raw = NULL;
+	size_t raw_len = 0;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || fileName == NULL || archive == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = SignatureArchive_new(ctx, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* The file stays mapped, so only the parts of the signatures read are loaded. */
+	res = KSI_RDR_fromFile(ctx, fileName, &tmp->rdr);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_RDR_read_ptr(tmp->rdr, &raw, (size_t)-1, &raw_len);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to read file.");
+		goto cleanup;
+	}
+
+	tmp->data = raw;
+	tmp->data_len = raw_len;
+
+	res = SignatureArchive_index(tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, "Invalid signature archive.");
+		goto cleanup;
+	}
+
+	*archive = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_nofree(raw);
+	KSI_SignatureArchive_free(tmp);
+
+	return res;
+}
+
+void KSI_SignatureArchive_free(KSI_SignatureArchive *archive) {
+	if (archive != NULL) {
+		KSI_RDR_close(archive->rdr);
+		KSI_free(archive->copy);
+		KSI_free(archive->compOffset);
+		KSI_free(archive->compLen);
+		KSI_free(archive->entryOffset);
+		KSI_free(archive);
+	}
+}
+
+int KSI_SignatureArchive_getCount(const KSI_SignatureArchive *archive, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (archive == NULL || count == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	*count = archive->entries_len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_SignatureArchive_getComponentCount(const KSI_SignatureArchive *archive, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (archive == NULL || count == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	*count = archive->components_len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_SignatureArchive_export(const KSI_SignatureArchive *archive, size_t index, unsigned char **raw, size_t *raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	const unsigned char *entry = NULL;
+	unsigned char *tmp = NULL;
+	size_t refs_len;
+	size_t len = 0;
+	size_t pos;
+	size_t i;
+
+	if (archive == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(archive->ctx);
+	if (index >= archive->entries_len || raw == NULL || raw_len == NULL) {
+		KSI_pushError(archive->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	entry = archive->data + archive->entryOffset[index];
+	refs_len = (size_t)KSI_getUInt(entry + 2, 2);
+
+	for (i = 0; i < refs_len; i++) {
+		len += archive->compLen[KSI_getUInt(entry + 4 + 4 * i, 4)];
+	}
+
+	tmp = KSI_malloc(len + 4);
+	if (tmp == NULL) {
+		KSI_pushError(archive->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp[0] = entry[0];
+	tmp[1] = entry[1];
+	KSI_putUInt(tmp + 2, len, 2);
+	pos = 4;
+
+	for (i = 0; i < refs_len; i++) {
+		size_t comp = (size_t)KSI_getUInt(entry + 4 + 4 * i, 4);
+
+		memcpy(tmp + pos, archive->data + archive->compOffset[comp], archive->compLen[comp]);
+		pos += archive->compLen[comp];
+	}
+
+	*raw = tmp;
+	*raw_len = len + 4;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+
+	return res;
+}
+
+int KSI_SignatureArchive_getSignature(const KSI_SignatureArchive *archive, size_t index, KSI_Signature **sig) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *raw = NULL;
+	size_t raw_len = 0;
+
+	if (archive == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(archive->ctx);
+	if (sig == NULL) {
+		KSI_pushError(archive->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_SignatureArchive_export(archive, index, &raw, &raw_len);
+	if (res != KSI_OK) {
+		KSI_pushError(archive->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_Signature_parse(archive->ctx, raw, (unsigned)raw_len, sig);
+	if (res != KSI_OK) {
+		KSI_pushError(archive->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(raw);
+
+	return res;
+}
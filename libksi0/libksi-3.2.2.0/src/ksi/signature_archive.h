@@ -0,0 +1,152 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef KSI_SIGNATURE_ARCHIVE_H_
+#define KSI_SIGNATURE_ARCHIVE_H_
+
+#include "ksi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * A container of many KSI signatures storing every component shared by the signatures
+	 * only once. The components are the elements of the signature TLV - the aggregation hash
+	 * chains, the calendar hash chain, the authentication records and the publication record
+	 * - so the signatures of the same aggregation round share their upper aggregation chains
+	 * and everything above them. Each signature is kept as a list of references to the
+	 * components and is exported back byte by byte as it was added.
+	 */
+	typedef struct KSI_SignatureArchive_st KSI_SignatureArchive;
+
+	/**
+	 * Builder of a #KSI_SignatureArchive, identifying the shared components by their contents.
+	 */
+	typedef struct KSI_SignatureArchiveWriter_st KSI_SignatureArchiveWriter;
+
+	/**
+	 * Creates an empty archive writer.
+	 * \param[in]	ctx			KSI context.
+	 * \param[out]	writer		Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SignatureArchiveWriter_new(KSI_CTX *ctx, KSI_SignatureArchiveWriter **writer);
+
+	/**
+	 * Cleanup method for the archive writer.
+	 * \param[in]	writer		Archive writer.
+	 */
+	void KSI_SignatureArchiveWriter_free(KSI_SignatureArchiveWriter *writer);
+
+	/**
+	 * Adds a signature to the archive.
+	 * \param[in]	writer		Archive writer.
+	 * \param[in]	sig			KSI signature.
+	 * \param[out]	index		Receives the index of the signature in the archive, may be \c NULL.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SignatureArchiveWriter_add(KSI_SignatureArchiveWriter *writer, KSI_Signature *sig, size_t *index);
+
+	/**
+	 * Adds a serialized signature to the archive without parsing it.
+	 * \param[in]	writer		Archive writer.
+	 * \param[in]	raw			Serialized KSI signature.
+	 * \param[in]	raw_len		Length of \c raw.
+	 * \param[out]	index		Receives the index of the signature in the archive, may be \c NULL.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SignatureArchiveWriter_addRaw(KSI_SignatureArchiveWriter *writer, const unsigned char *raw, size_t raw_len, size_t *index);
+
+	/**
+	 * Serializes the archive.
+	 * \param[in]	writer		Archive writer.
+	 * \param[out]	raw			Pointer to the receiving pointer, to be freed with #KSI_free.
+	 * \param[out]	raw_len		Receives the length of the archive.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SignatureArchiveWriter_serialize(KSI_SignatureArchiveWriter *writer, unsigned char **raw, size_t *raw_len);
+
+	/**
+	 * Parses a serialized archive. Only the index of the archive is built, the signatures are
+	 * assembled on demand.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	raw			Serialized archive.
+	 * \param[in]	raw_len		Length of \c raw.
+	 * \param[out]	archive		Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SignatureArchive_parse(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, KSI_SignatureArchive **archive);
+
+	/**
+	 * Reads an archive from a file.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	fileName	Name of the archive file.
+	 * \param[out]	archive		Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SignatureArchive_fromFile(KSI_CTX *ctx, const char *fileName, KSI_SignatureArchive **archive);
+
+	/**
+	 * Cleanup method for the archive.
+	 * \param[in]	archive		Signature archive.
+	 */
+	void KSI_SignatureArchive_free(KSI_SignatureArchive *archive);
+
+	/**
+	 * Returns the number of signatures in the archive.
+	 * \param[in]	archive		Signature archive.
+	 * \param[out]	count		Receives the number of signatures.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SignatureArchive_getCount(const KSI_SignatureArchive *archive, size_t *count);
+
+	/**
+	 * Returns the number of distinct components stored in the archive.
+	 * \param[in]	archive		Signature archive.
+	 * \param[out]	count		Receives the number of components.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SignatureArchive_getComponentCount(const KSI_SignatureArchive *archive, size_t *count);
+
+	/**
+	 * Exports a signature of the archive as a standalone serialized signature.
+	 * \param[in]	archive		Signature archive.
+	 * \param[in]	index		Index of the signature.
+	 * \param[out]	raw			Pointer to the receiving pointer, to be freed with #KSI_free.
+	 * \param[out]	raw_len		Receives the length of the signature.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SignatureArchive_export(const KSI_SignatureArchive *archive, size_t index, unsigned char **raw, size_t *raw_len);
+
+	/**
+	 * Returns a signature of the archive.
+	 * \param[in]	archive		Signature archive.
+	 * \param[in]	index		Index of the signature.
+	 * \param[out]	sig			Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The signature is not verified.
+	 */
+	int KSI_SignatureArchive_getSignature(const KSI_SignatureArchive *archive, size_t index, KSI_Signature **sig);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KSI_SIGNATURE_ARCHIVE_H_ */
@@ -70,6 +70,17 @@ extern "C" {
 		/* Verification info for the signature. */
 		KSI_VerificationResult verificationResult;
 
+		/* Root of the calendar hash chain, NULL if not computed yet. */
+		KSI_DataHash *calendarRoot;
+
+		/* Aggregation time calculated from the calendar hash chain, valid if calendarAggrTime_set. */
+		time_t calendarAggrTime;
+		bool calendarAggrTime_set;
+
+		/* Root of the aggregation hash chains computed from aggregationRootLevel, NULL if not computed yet. */
+		KSI_DataHash *aggregationRoot;
+		KSI_uint64_t aggregationRootLevel;
+
 	};
 
 
@@ -0,0 +1,689 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
+
+#include "internal.h"
+#include "io.h"
+#include "spool.h"
+
+/*
+ * The log file starts with the 8 byte signature "KSISPL01" followed by the records, all
+ * integers are big-endian:
+ * - 'P', sequence number (8 bytes), level (1 byte), length of the imprint (1 byte), imprint,
+ *   length of the metadata (4 bytes), metadata: a spooled hash;
+ * - 'D', sequence number (8 bytes): all hashes up to the sequence number have been processed.
+ */
+#define SPOOL_MAGIC "KSISPL01"
+#define SPOOL_MAGIC_LEN 8
+
+#define SPOOL_RECORD_PENDING 'P'
+#define SPOOL_RECORD_DONE 'D'
+
+#define SPOOL_DEFAULT_SYNC_BATCH 16
+#define SPOOL_DEFAULT_DRAIN_BATCH 64
+
+typedef struct SpoolEntry_st {
+	KSI_uint64_t seq;
+	KSI_uint64_t level;
+	KSI_DataHash *hsh;
+	unsigned char *meta;
+	size_t meta_len;
+} SpoolEntry;
+
+struct KSI_SigningSpool_st {
+	KSI_CTX *ctx;
+
+	char *fileName;
+	FILE *file;
+
+	/* The pending entries are entries[head .. entries_len - 1], in the order of spooling. */
+	SpoolEntry *entries;
+	size_t head;
+	size_t entries_len;
+	size_t entries_size;
+
+	KSI_uint64_t nextSeq;
+
+	/* Number of records written since the last sync. */
+	size_t unsynced;
+	size_t syncBatch;
+	size_t drainBatch;
+
+	KSI_SigningSpoolCallback cb;
+	void *cbCtx;
+};
+
+static void SpoolEntry_clean(SpoolEntry *e) {
+	KSI_DataHash_free(e->hsh);
+	KSI_free(e->meta);
+	e->hsh = NULL;
+	e->meta = NULL;
+}
+
+/* Is the failure caused by the aggregator being unreachable or overloaded, so a later attempt may succeed. */
+static int isTransientError(int res) {
+	switch (res) {
+		case KSI_NETWORK_ERROR:
+		case KSI_NETWORK_CONNECTION_TIMEOUT:
+		case KSI_NETWORK_SEND_TIMEOUT:
+		case KSI_NETWORK_RECIEVE_TIMEOUT:
+		case KSI_HTTP_ERROR:
+		case KSI_SERVICE_INTERNAL_ERROR:
+		case KSI_SERVICE_UPSTREAM_ERROR:
+		case KSI_SERVICE_UPSTREAM_TIMEOUT:
+		case KSI_SERVICE_AGGR_REQUEST_OVER_QUOTA:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/* Flushes the file and makes the written data durable. */
+static int syncFile(FILE *f) {
+	if (fflush(f) != 0) return KSI_IO_ERROR;
+#ifdef _WIN32
+	if (_commit(_fileno(f)) != 0) return KSI_IO_ERROR;
+#else
+	if (fsync(fileno(f)) != 0) return KSI_IO_ERROR;
+#endif
+	return KSI_OK;
+}
+
+static int writeEntry(FILE *f, const SpoolEntry *e) {
+	int res;
+	const unsigned char *imprint = NULL;
+	unsigned imprint_len = 0;
+
+	res = KSI_DataHash_getImprint(e->hsh, &imprint, &imprint_len);
+	if (res != KSI_OK) return res;
+
+	if ((res = KSI_writeUInt(f, SPOOL_RECORD_PENDING, 1)) != KSI_OK ||
+			(res = KSI_writeUInt(f, e->seq, 8)) != KSI_OK ||
+			(res = KSI_writeUInt(f, e->level, 1)) != KSI_OK ||
+			(res = KSI_writeUInt(f, imprint_len, 1)) != KSI_OK ||
+			fwrite(imprint, 1, imprint_len, f) != imprint_len ||
+			(res = KSI_writeUInt(f, e->meta_len, 4)) != KSI_OK ||
+			(e->meta_len > 0 && fwrite(e->meta, 1, e->meta_len, f) != e->meta_len)) {
+		return KSI_IO_ERROR;
+	}
+
+	return KSI_OK;
+}
+
+/* Appends the entry to the pending entries, taking over its hash and metadata. */
+static int SigningSpool_push(KSI_SigningSpool *spool, SpoolEntry *e) {
+	if (spool->entries_len == spool->entries_size) {
+		size_t count = spool->entries_len - spool->head;
+
+		/* Reuse the space of the processed entries before growing. */
+		if (spool->head > 0 && spool->head >= count) {
+			memmove(spool->entries, spool->entries + spool->head, count * sizeof(SpoolEntry));
+		} else {
+			SpoolEntry *tmp = NULL;
+			size_t size = spool->entries_size > 0 ? spool->entries_size * 2 : 64;
+
+			tmp = KSI_malloc(size * sizeof(SpoolEntry));
+			if (tmp == NULL) return KSI_OUT_OF_MEMORY;
+
+			if (count > 0) memcpy(tmp, spool->entries + spool->head, count * sizeof(SpoolEntry));
+			KSI_free(spool->entries);
+			spool->entries = tmp;
+			spool->entries_size = size;
+		}
+
+		spool->head = 0;
+		spool->entries_len = count;
+	}
+
+	spool->entries[spool->entries_len++] = *e;
+	e->hsh = NULL;
+	e->meta = NULL;
+
+	return KSI_OK;
+}
+
+/* Reads the log left by a previous run. Records torn by a crash at the end of the log are ignored. */
+static int SigningSpool_load(KSI_SigningSpool *spool) {
+	int res;
+	KSI_RDR *rdr = NULL;
+	unsigned char *ptr = NULL;
+	size_t count = 0;
+	KSI_uint64_t doneSeq = 0;
+	int hasDone = 0;
+	SpoolEntry e;
+	size_t i;
+
+	memset(&e, 0, sizeof(e));
+
+	res = KSI_RDR_fromFile(spool->ctx, spool->fileName, &rdr);
+	if (res != KSI_OK) {
+		/* There is no log yet. */
+		KSI_ERR_clearErrors(spool->ctx);
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	res = KSI_RDR_read_ptr(rdr, &ptr, SPOOL_MAGIC_LEN, &count);
+	if (res != KSI_OK) {
+		KSI_pushError(spool->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* An empty file is left by a crash right after creating it. */
+	if (count == 0) goto cleanup;
+
+	if (count != SPOOL_MAGIC_LEN || memcmp(ptr, SPOOL_MAGIC, SPOOL_MAGIC_LEN) != 0) {
+		KSI_pushError(spool->ctx, res = KSI_INVALID_FORMAT, "Not a signing spool file.");
+		goto cleanup;
+	}
+
+	for (;;) {
+		KSI_uint64_t type = 0;
+		KSI_uint64_t val = 0;
+
+		res = KSI_RDR_readUInt(rdr, 1, &type, &count);
+		if (res != KSI_OK || count != 1) break;
+
+		res = KSI_RDR_readUInt(rdr, 8, &e.seq, &count);
+		if (res != KSI_OK || count != 8) break;
+
+		if (type == SPOOL_RECORD_DONE) {
+			doneSeq = e.seq;
+			hasDone = 1;
+			continue;
+		}
+
+		if (type != SPOOL_RECORD_PENDING) {
+			KSI_pushError(spool->ctx, res = KSI_INVALID_FORMAT, "Corrupt signing spool file.");
+			goto cleanup;
+		}
+
+		res = KSI_RDR_readUInt(rdr, 1, &e.level, &count);
+		if (res != KSI_OK || count != 1) break;
+
+		res = KSI_RDR_readUInt(rdr, 1, &val, &count);
+		if (res != KSI_OK || count != 1) break;
+
+		res = KSI_RDR_read_ptr(rdr, &ptr, (size_t)val, &count);
+		if (res != KSI_OK || count != val) break;
+
+		res = KSI_DataHash_fromImprint(spool->ctx, ptr, (unsigned)val, &e.hsh);
+		if (res != KSI_OK) {
+			KSI_pushError(spool->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_RDR_readUInt(rdr, 4, &val, &count);
+		if (res != KSI_OK || count != 4) break;
+
+		e.meta_len = (size_t)val;
+		if (e.meta_len > 0) {
+			res = KSI_RDR_read_ptr(rdr, &ptr, e.meta_len, &count);
+			if (res != KSI_OK || count != e.meta_len) break;
+
+			e.meta = KSI_malloc(e.meta_len);
+			if (e.meta == NULL) {
+				KSI_pushError(spool->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+				goto cleanup;
+			}
+			memcpy(e.meta, ptr, e.meta_len);
+		}
+
+		res = SigningSpool_push(spool, &e);
+		if (res != KSI_OK) {
+			KSI_pushError(spool->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (e.seq >= spool->nextSeq) spool->nextSeq = e.seq + 1;
+	}
+
+	/* Drop the entries processed by the previous run. */
+	if (hasDone) {
+		for (i = spool->head; i < spool->entries_len && spool->entries[i].seq <= doneSeq; i++) {
+			SpoolEntry_clean(&spool->entries[i]);
+		}
+		spool->head = i;
+	}
+
+	KSI_LOG_debug(spool->ctx, "Signing spool: %llu hashes pending from a previous run.", (unsigned long long)(spool->entries_len - spool->head));
+
+	res = KSI_OK;
+
+cleanup:
+
+	SpoolEntry_clean(&e);
+	KSI_RDR_close(rdr);
+
+	return res;
+}
+
+/**
+ * Replaces the log with one holding only the pending entries and opens it for appending.
+ * The new log is written next to the old one and renamed over it, so a crash leaves one of
+ * them intact.
+ */
+static int SigningSpool_rewrite(KSI_SigningSpool *spool) {
+	int res;
+	char *tmpName = NULL;
+	size_t tmpName_len;
+	FILE *f = NULL;
+	size_t i;
+
+	if (spool->file != NULL) {
+		fclose(spool->file);
+		spool->file = NULL;
+	}
+
+	tmpName_len = strlen(spool->fileName) + 5;
+	tmpName = KSI_malloc(tmpName_len);
+	if (tmpName == NULL) {
+		KSI_pushError(spool->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+	KSI_snprintf(tmpName, tmpName_len, "%s.tmp", spool->fileName);
+
+	f = fopen(tmpName, "wb");
+	if (f == NULL) {
+		KSI_pushError(spool->ctx, res = KSI_IO_ERROR, "Unable to create the signing spool file.");
+		goto cleanup;
+	}
+
+	res = fwrite(SPOOL_MAGIC, 1, SPOOL_MAGIC_LEN, f) == SPOOL_MAGIC_LEN ? KSI_OK : KSI_IO_ERROR;
+	for (i = spool->head; res == KSI_OK && i < spool->entries_len; i++) {
+		res = writeEntry(f, &spool->entries[i]);
+	}
+	if (res == KSI_OK) res = syncFile(f);
+
+	if (fclose(f) != 0 && res == KSI_OK) res = KSI_IO_ERROR;
+	f = NULL;
+
+	if (res != KSI_OK) {
+		remove(tmpName);
+		KSI_pushError(spool->ctx, res, "Unable to write the signing spool file.");
+		goto cleanup;
+	}
+
+#ifdef _WIN32
+	/* Windows does not rename over an existing file. */
+	remove(spool->fileName);
+#endif
+	if (rename(tmpName, spool->fileName) != 0) {
+		KSI_pushError(spool->ctx, res = KSI_IO_ERROR, "Unable to replace the signing spool file.");
+		goto cleanup;
+	}
+
+	spool->file = fopen(spool->fileName, "ab");
+	if (spool->file == NULL) {
+		KSI_pushError(spool->ctx, res = KSI_IO_ERROR, "Unable to open the signing spool file.");
+		goto cleanup;
+	}
+
+	spool->unsynced = 0;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (f != NULL) fclose(f);
+	KSI_free(tmpName);
+
+	return res;
+}
+
+void KSI_SigningSpool_close(KSI_SigningSpool *spool) {
+	size_t i;
+
+	if (spool != NULL) {
+		if (spool->file != NULL) {
+			syncFile(spool->file);
+			fclose(spool->file);
+		}
+		for (i = spool->head; i < spool->entries_len; i++) {
+			SpoolEntry_clean(&spool->entries[i]);
+		}
+		KSI_free(spool->entries);
+		KSI_free(spool->fileName);
+		KSI_free(spool);
+	}
+}
+
+int KSI_SigningSpool_open(KSI_CTX *ctx, const char *fileName, KSI_SigningSpool **spool) {
+	int res;
+	KSI_SigningSpool *tmp = NULL;
+	size_t fileName_len;
+
+	KSI_ERR_clearErrors(ctx);
+
+	if (ctx == NULL || fileName == NULL || spool == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_SigningSpool);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->ctx = ctx;
+	tmp->fileName = NULL;
+	tmp->file = NULL;
+	tmp->entries = NULL;
+	tmp->head = 0;
+	tmp->entries_len = 0;
+	tmp->entries_size = 0;
+	tmp->nextSeq = 1;
+	tmp->unsynced = 0;
+	tmp->syncBatch = SPOOL_DEFAULT_SYNC_BATCH;
+	tmp->drainBatch = SPOOL_DEFAULT_DRAIN_BATCH;
+	tmp->cb = NULL;
+	tmp->cbCtx = NULL;
+
+	fileName_len = strlen(fileName) + 1;
+	tmp->fileName = KSI_malloc(fileName_len);
+	if (tmp->fileName == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+	memcpy(tmp->fileName, fileName, fileName_len);
+
+	res = SigningSpool_load(tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	/* Start with a compact log without the processed and the torn records. */
+	res = SigningSpool_rewrite(tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	*spool = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_SigningSpool_close(tmp);
+
+	return res;
+}
+
+int KSI_SigningSpool_setCallback(KSI_SigningSpool *spool, KSI_SigningSpoolCallback cb, void *cbCtx) {
+	if (spool == NULL) return KSI_INVALID_ARGUMENT;
+	spool->cb = cb;
+	spool->cbCtx = cbCtx;
+	return KSI_OK;
+}
+
+int KSI_SigningSpool_setSyncBatch(KSI_SigningSpool *spool, size_t count) {
+	if (spool == NULL || count == 0) return KSI_INVALID_ARGUMENT;
+	spool->syncBatch = count;
+	return KSI_OK;
+}
+
+int KSI_SigningSpool_setDrainBatch(KSI_SigningSpool *spool, size_t count) {
+	if (spool == NULL || count == 0) return KSI_INVALID_ARGUMENT;
+	spool->drainBatch = count;
+	return KSI_OK;
+}
+
+int KSI_SigningSpool_sync(KSI_SigningSpool *spool) {
+	int res;
+
+	if (spool == NULL) return KSI_INVALID_ARGUMENT;
+	KSI_ERR_clearErrors(spool->ctx);
+
+	res = spool->file != NULL ? syncFile(spool->file) : KSI_IO_ERROR;
+	if (res != KSI_OK) {
+		/* The records may not have reached the disk in one piece, write them anew. */
+		KSI_LOG_debug(spool->ctx, "Signing spool: unable to sync the log, rewriting it.");
+		res = SigningSpool_rewrite(spool);
+		if (res != KSI_OK) {
+			KSI_pushError(spool->ctx, res, "Unable to sync the signing spool file.");
+			return res;
+		}
+	}
+
+	spool->unsynced = 0;
+
+	return KSI_OK;
+}
+
+int KSI_SigningSpool_add(KSI_SigningSpool *spool, KSI_DataHash *hsh, KSI_uint64_t level, const unsigned char *meta, size_t meta_len) {
+	int res;
+	SpoolEntry e;
+
+	memset(&e, 0, sizeof(e));
+
+	if (spool == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(spool->ctx);
+
+	if (hsh == NULL || level > 0xff || (meta == NULL && meta_len > 0) || meta_len > 0xffffffff) {
+		KSI_pushError(spool->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	e.seq = spool->nextSeq;
+	e.level = level;
+	e.meta_len = meta_len;
+
+	res = KSI_DataHash_clone(hsh, &e.hsh);
+	if (res != KSI_OK) {
+		KSI_pushError(spool->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (meta_len > 0) {
+		e.meta = KSI_malloc(meta_len);
+		if (e.meta == NULL) {
+			KSI_pushError(spool->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+		memcpy(e.meta, meta, meta_len);
+	}
+
+	/* Reopen the log if recovering from an earlier write error failed. */
+	if (spool->file == NULL) {
+		res = SigningSpool_rewrite(spool);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = writeEntry(spool->file, &e);
+	if (res != KSI_OK) {
+		/* Drop the torn record, the following ones would be appended after it. */
+		SigningSpool_rewrite(spool);
+		KSI_pushError(spool->ctx, res, "Unable to write the signing spool file.");
+		goto cleanup;
+	}
+
+	res = SigningSpool_push(spool, &e);
+	if (res != KSI_OK) {
+		KSI_pushError(spool->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	spool->nextSeq++;
+
+	if (++spool->unsynced >= spool->syncBatch) {
+		res = KSI_SigningSpool_sync(spool);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	SpoolEntry_clean(&e);
+
+	return res;
+}
+
+int KSI_SigningSpool_sign(KSI_SigningSpool *spool, KSI_DataHash *hsh, KSI_uint64_t level, const unsigned char *meta, size_t meta_len, KSI_Signature **sig) {
+	int res;
+
+	if (spool == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(spool->ctx);
+
+	if (hsh == NULL || sig == NULL) {
+		KSI_pushError(spool->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	*sig = NULL;
+
+	/* Keep the order and do not wait for an aggregator known to be down. */
+	if (spool->entries_len == spool->head) {
+		res = KSI_Signature_createAggregated(spool->ctx, hsh, level, sig);
+		if (res == KSI_OK || !isTransientError(res)) goto cleanup;
+
+		KSI_LOG_info(spool->ctx, "Signing spool: aggregator not available (error 0x%x), spooling the hashes.", res);
+	}
+
+	res = KSI_SigningSpool_add(spool, hsh, level, meta, meta_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ASYNC_NOT_FINISHED;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_SigningSpool_drain(KSI_SigningSpool *spool, size_t maxCount, size_t *signedCount) {
+	int res;
+	KSI_DataHash **hashes = NULL;
+	KSI_uint64_t *levels = NULL;
+	KSI_Signature **sigs = NULL;
+	int *status = NULL;
+	size_t done = 0;
+	size_t i;
+
+	if (spool == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(spool->ctx);
+
+	hashes = KSI_calloc(spool->drainBatch, sizeof(KSI_DataHash *));
+	levels = KSI_calloc(spool->drainBatch, sizeof(KSI_uint64_t));
+	sigs = KSI_calloc(spool->drainBatch, sizeof(KSI_Signature *));
+	status = KSI_calloc(spool->drainBatch, sizeof(int));
+	if (hashes == NULL || levels == NULL || sigs == NULL || status == NULL) {
+		KSI_pushError(spool->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+	while (res == KSI_OK && spool->head < spool->entries_len && (maxCount == 0 || done < maxCount)) {
+		SpoolEntry *batch = spool->entries + spool->head;
+		size_t n = spool->entries_len - spool->head;
+		size_t k;
+
+		if (n > spool->drainBatch) n = spool->drainBatch;
+		if (maxCount != 0 && n > maxCount - done) n = maxCount - done;
+
+		for (i = 0; i < n; i++) {
+			hashes[i] = batch[i].hsh;
+			levels[i] = batch[i].level;
+		}
+
+		res = KSI_Signature_createMany(spool->ctx, hashes, levels, n, sigs, status);
+		if (res != KSI_OK) {
+			KSI_pushError(spool->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		/* The hashes are processed in order, the rest waits for the aggregator to come back. */
+		for (k = 0; k < n && !isTransientError(status[k]); k++) {
+			if (spool->cb != NULL) {
+				spool->cb(spool->cbCtx, batch[k].hsh, batch[k].meta, batch[k].meta_len, status[k], sigs[k]);
+			} else {
+				KSI_Signature_free(sigs[k]);
+			}
+			sigs[k] = NULL;
+		}
+
+		for (i = k; i < n; i++) {
+			KSI_Signature_free(sigs[i]);
+			sigs[i] = NULL;
+		}
+
+		if (k > 0) {
+			KSI_uint64_t lastSeq = batch[k - 1].seq;
+
+			for (i = 0; i < k; i++) {
+				SpoolEntry_clean(&batch[i]);
+			}
+			spool->head += k;
+			done += k;
+
+			if (spool->head == spool->entries_len) {
+				/* Start over with an empty log. */
+				spool->head = 0;
+				spool->entries_len = 0;
+				res = SigningSpool_rewrite(spool);
+			} else if (spool->file == NULL || KSI_writeUInt(spool->file, SPOOL_RECORD_DONE, 1) != KSI_OK || KSI_writeUInt(spool->file, lastSeq, 8) != KSI_OK) {
+				/* Drop the torn record, the processed entries are left out anyway. */
+				res = SigningSpool_rewrite(spool);
+			} else {
+				res = KSI_SigningSpool_sync(spool);
+			}
+			if (res != KSI_OK) goto cleanup;
+		}
+
+		if (k < n) {
+			KSI_LOG_debug(spool->ctx, "Signing spool: aggregator still not available (error 0x%x).", status[k]);
+			KSI_pushError(spool->ctx, res = status[k], NULL);
+		}
+	}
+
+cleanup:
+
+	if (signedCount != NULL) *signedCount = done;
+
+	KSI_free(hashes);
+	KSI_free(levels);
+	KSI_free(sigs);
+	KSI_free(status);
+
+	return res;
+}
+
+int KSI_SigningSpool_getPendingCount(const KSI_SigningSpool *spool, size_t *count) {
+	if (spool == NULL || count == NULL) return KSI_INVALID_ARGUMENT;
+	*count = spool->entries_len - spool->head;
+	return KSI_OK;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef KSI_SPOOL_H_
+#define KSI_SPOOL_H_
+
+#include "ksi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * A durable queue of root hashes waiting to be signed while the aggregator is not
+	 * reachable. The hashes are appended to a log file together with opaque metadata of
+	 * the caller, and signed in batches by #KSI_SigningSpool_drain once the aggregator
+	 * responds again. The signatures are delivered to the callback set with
+	 * #KSI_SigningSpool_setCallback.
+	 *
+	 * The spool is bound to a KSI context and, like the context, may be used by one thread
+	 * at a time. Applications wanting to sign the backlog in the background call
+	 * #KSI_SigningSpool_drain periodically from a worker or a timer of their own.
+	 */
+	typedef struct KSI_SigningSpool_st KSI_SigningSpool;
+
+	/**
+	 * Delivers the outcome of signing a spooled hash.
+	 * \param[in]	cbCtx		Context given to #KSI_SigningSpool_setCallback.
+	 * \param[in]	hsh			The signed root hash.
+	 * \param[in]	meta		Metadata stored with the hash, \c NULL if empty.
+	 * \param[in]	meta_len	Length of \c meta.
+	 * \param[in]	status		#KSI_OK if the hash was signed, otherwise the error the aggregator refused it with.
+	 * \param[in]	sig			The signature, owned by the callback, \c NULL on failure.
+	 */
+	typedef void (*KSI_SigningSpoolCallback)(void *cbCtx, const KSI_DataHash *hsh, const unsigned char *meta, size_t meta_len, int status, KSI_Signature *sig);
+
+	/**
+	 * Opens the spool stored in the given file, creating the file if it does not exist.
+	 * The hashes left pending by a previous run are loaded and the log is compacted.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	fileName	Name of the log file.
+	 * \param[out]	spool		Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SigningSpool_open(KSI_CTX *ctx, const char *fileName, KSI_SigningSpool **spool);
+
+	/**
+	 * Syncs the log file to the disk and frees the spool. The pending hashes remain in the
+	 * log for the next run.
+	 * \param[in]	spool		Signing spool.
+	 */
+	void KSI_SigningSpool_close(KSI_SigningSpool *spool);
+
+	/**
+	 * Sets the callback the signatures of the spooled hashes are delivered to.
+	 * \param[in]	spool		Signing spool.
+	 * \param[in]	cb			Callback function, \c NULL to discard the signatures.
+	 * \param[in]	cbCtx		Context passed to the callback.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SigningSpool_setCallback(KSI_SigningSpool *spool, KSI_SigningSpoolCallback cb, void *cbCtx);
+
+	/**
+	 * Sets the number of hashes appended to the log between the syncs of the log file to the
+	 * disk. After a crash up to \c count - 1 of the most recently spooled hashes may be lost,
+	 * unless #KSI_SigningSpool_sync has been called. Defaults to 16.
+	 * \param[in]	spool		Signing spool.
+	 * \param[in]	count		Number of hashes, at least 1.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SigningSpool_setSyncBatch(KSI_SigningSpool *spool, size_t count);
+
+	/**
+	 * Sets the maximum number of hashes signed with one call to #KSI_Signature_createMany
+	 * while draining. Defaults to 64.
+	 * \param[in]	spool		Signing spool.
+	 * \param[in]	count		Number of hashes, at least 1.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SigningSpool_setDrainBatch(KSI_SigningSpool *spool, size_t count);
+
+	/**
+	 * Appends a hash to the spool.
+	 * \param[in]	spool		Signing spool.
+	 * \param[in]	hsh			Root hash to be signed.
+	 * \param[in]	level		Aggregation level of the root hash (0 =< x <= 0xff).
+	 * \param[in]	meta		Metadata to be delivered with the signature, may be \c NULL.
+	 * \param[in]	meta_len	Length of \c meta.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note If the hash can not be written, it is not spooled and the log is rewritten from
+	 * the pending hashes, so no partial record is left in it.
+	 */
+	int KSI_SigningSpool_add(KSI_SigningSpool *spool, KSI_DataHash *hsh, KSI_uint64_t level, const unsigned char *meta, size_t meta_len);
+
+	/**
+	 * Signs the hash if the aggregator is reachable, otherwise appends it to the spool. While
+	 * the spool holds pending hashes, new hashes are appended without contacting the aggregator,
+	 * so the caller is not held up by the outage.
+	 * \param[in]	spool		Signing spool.
+	 * \param[in]	hsh			Root hash to be signed.
+	 * \param[in]	level		Aggregation level of the root hash (0 =< x <= 0xff).
+	 * \param[in]	meta		Metadata to be delivered with the signature, may be \c NULL.
+	 * \param[in]	meta_len	Length of \c meta.
+	 * \param[out]	sig			Pointer to the receiving pointer, set to \c NULL if the hash was spooled.
+	 * \return #KSI_OK if the hash was signed, #KSI_ASYNC_NOT_FINISHED if it was spooled,
+	 * otherwise an error code.
+	 */
+	int KSI_SigningSpool_sign(KSI_SigningSpool *spool, KSI_DataHash *hsh, KSI_uint64_t level, const unsigned char *meta, size_t meta_len, KSI_Signature **sig);
+
+	/**
+	 * Syncs the log file to the disk.
+	 * \param[in]	spool		Signing spool.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SigningSpool_sync(KSI_SigningSpool *spool);
+
+	/**
+	 * Signs the pending hashes in the order they were spooled and delivers the outcomes to
+	 * the callback. Draining stops at the first batch the aggregator could not be reached
+	 * for, leaving the rest of the hashes pending. Hashes the aggregator refuses are delivered
+	 * with the error and removed from the spool.
+	 * \param[in]	spool		Signing spool.
+	 * \param[in]	maxCount	Maximum number of hashes to sign, 0 for no limit.
+	 * \param[out]	signedCount	Number of hashes removed from the spool, may be \c NULL.
+	 * \return #KSI_OK if the hashes were processed, otherwise the error the aggregator could
+	 * not be reached with.
+	 * \note The hashes are removed from the log after their outcome has been delivered, so
+	 * a crash in between delivers them again on the next run.
+	 */
+	int KSI_SigningSpool_drain(KSI_SigningSpool *spool, size_t maxCount, size_t *signedCount);
+
+	/**
+	 * Returns the number of hashes waiting in the spool.
+	 * \param[in]	spool		Signing spool.
+	 * \param[out]	count		Receives the number of pending hashes.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SigningSpool_getPendingCount(const KSI_SigningSpool *spool, size_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KSI_SPOOL_H_ */
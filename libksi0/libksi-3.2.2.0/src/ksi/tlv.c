@@ -36,7 +36,7 @@ struct KSI_TLV_st {
 	KSI_CTX *ctx;
 
 	/** Reference count */
-	unsigned refCount;
+	KSI_RefCount refCount;
 
 	/** Reference to parent TLV */
 	KSI_TLV *parent;
@@ -506,7 +506,7 @@ cleanup:
  *
  */
 void KSI_TLV_free(KSI_TLV *tlv) {
-	if (tlv != NULL && --tlv->refCount == 0) {
+	if (tlv != NULL && KSI_REFCOUNT_DEC(tlv->refCount) == 0) {
 		KSI_free(tlv->buffer);
 		/* Free nested data */
 
@@ -517,7 +517,7 @@ void KSI_TLV_free(KSI_TLV *tlv) {
 
 void KSI_TLV_ref(KSI_TLV *tlv) {
 	if (tlv != NULL) {
-		tlv->refCount++;
+		KSI_REFCOUNT_INC(tlv->refCount);
 	}
 }
 
@@ -613,6 +613,67 @@ cleanup:
 }
 
 
+int KSI_TLV_readTlvAlloc(KSI_RDR *rdr, unsigned char **raw, size_t *raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char hdr[4];
+	size_t headerRead;
+	size_t valueRead;
+	unsigned valueLength = 0;
+	unsigned char *tmp = NULL;
+
+	if (rdr == NULL || raw == NULL || raw_len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(KSI_RDR_getCtx(rdr));
+
+	res = readHeader(rdr, hdr, &headerRead, NULL, NULL, NULL, &valueLength);
+	if (res != KSI_OK) {
+		KSI_pushError(KSI_RDR_getCtx(rdr), res, NULL);
+		goto cleanup;
+	}
+
+	if (headerRead == 0) {
+		/* Reached end of stream. */
+		*raw = NULL;
+		*raw_len = 0;
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	tmp = KSI_malloc(headerRead + valueLength);
+	if (tmp == NULL) {
+		KSI_pushError(KSI_RDR_getCtx(rdr), res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	memcpy(tmp, hdr, headerRead);
+
+	res = KSI_RDR_read_ex(rdr, tmp + headerRead, (size_t)valueLength, &valueRead);
+	if (res != KSI_OK) {
+		KSI_pushError(KSI_RDR_getCtx(rdr), res, NULL);
+		goto cleanup;
+	}
+
+	if (valueLength != valueRead) {
+		KSI_pushError(KSI_RDR_getCtx(rdr), res = KSI_INVALID_FORMAT, "Unexpected end of TLV.");
+		goto cleanup;
+	}
+
+	*raw = tmp;
+	*raw_len = headerRead + valueRead;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+
+	return res;
+}
+
 /**
  *
  */
@@ -352,6 +352,17 @@ extern "C" {
 	 */
 	int KSI_TLV_readTlv(KSI_RDR *rdr, unsigned char *buffer, size_t buffer_len, size_t *readCount);
 
+	/**
+	 * Reads a raw TLV from the reader into a buffer allocated to the exact size given by the
+	 * TLV header. The caller is responsible for freeing the buffer with #KSI_free.
+	 * \param[in]	rdr			Reader.
+	 * \param[out]	raw			Pointer to the receiving pointer, set to \c NULL at the end of the stream.
+	 * \param[out]	raw_len		Length of the TLV, including the header.
+	 *
+	 * \return On success returns KSI_OK, otherwise a status code is returned (see #KSI_StatusCode).
+	 */
+	int KSI_TLV_readTlvAlloc(KSI_RDR *rdr, unsigned char **raw, size_t *raw_len);
+
 	/**
 	 * Returns the absolute offset of the TLV object in the source raw data. If the TLV object is
 	 * created using #KSI_TLV_new, the offset is 0.
@@ -99,6 +99,15 @@ extern "C" {
 	 */
 	typedef struct KSI_NetHandle_st KSI_RequestHandle;
 
+	/**
+	 * Callback for timing the network requests, called every time a request completes a phase.
+	 * \param[in]	phaseCtx	Pointer to the context given to #KSI_CTX_setRequestPhaseCallback.
+	 * \param[in]	handle		The request handle.
+	 * \param[in]	phase		The completed phase (see #KSI_NetPhase).
+	 * \param[in]	timeUs		Time of completion in microseconds (see #KSI_RequestHandle_getPhaseTime).
+	 */
+	typedef void (*KSI_RequestPhaseCallback)(void *phaseCtx, const KSI_RequestHandle *handle, int phase, KSI_uint64_t timeUs);
+
 	/**
 	 * A generic network client, which needs to have a concrete implementation.
 	 * \see #KSI_HttpClient_new
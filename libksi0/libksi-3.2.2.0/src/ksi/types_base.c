@@ -25,20 +25,20 @@
 
 struct KSI_OctetString_st {
 	KSI_CTX *ctx;
-	size_t refCount;
+	KSI_RefCount refCount;
 	unsigned char *data;
 	unsigned int data_len;
 };
 
 struct KSI_Integer_st {
 	int staticAlloc;
-	size_t refCount;
+	KSI_RefCount refCount;
 	KSI_uint64_t value;
 };
 
 struct KSI_Utf8String_st {
 	KSI_CTX *ctx;
-	size_t refCount;
+	KSI_RefCount refCount;
 	char *value;
 	size_t len;
 };
@@ -63,7 +63,7 @@ KSI_IMPLEMENT_LIST(KSI_OctetString, KSI_OctetString_free);
  * KSI_OctetString
  */
 void KSI_OctetString_free(KSI_OctetString *o) {
-	if (o != NULL && --o->refCount == 0) {
+	if (o != NULL && KSI_REFCOUNT_DEC(o->refCount) == 0) {
 		KSI_free(o->data);
 		KSI_free(o);
 	}
@@ -112,7 +112,7 @@ cleanup:
 
 int KSI_OctetString_ref(KSI_OctetString *o) {
 	if (o != NULL) {
-		++o->refCount;
+		KSI_REFCOUNT_INC(o->refCount);
 	}
 	return KSI_OK;
 }
@@ -270,7 +270,7 @@ cleanup:
  * Utf8String
  */
 void KSI_Utf8String_free(KSI_Utf8String *o) {
-	if (o != NULL && --o->refCount == 0) {
+	if (o != NULL && KSI_REFCOUNT_DEC(o->refCount) == 0) {
 		KSI_free(o->value);
 		KSI_free(o);
 	}
@@ -329,7 +329,7 @@ cleanup:
 
 int KSI_Utf8String_ref(KSI_Utf8String *o) {
 	if (o != NULL) {
-		++o->refCount;
+		KSI_REFCOUNT_INC(o->refCount);
 	}
 	return KSI_OK;
 }
@@ -494,14 +494,14 @@ cleanup:
 }
 
 void KSI_Integer_free(KSI_Integer *o) {
-	if (o != NULL && !o->staticAlloc && --o->refCount == 0) {
+	if (o != NULL && !o->staticAlloc && KSI_REFCOUNT_DEC(o->refCount) == 0) {
 		KSI_free(o);
 	}
 }
 
 int KSI_Integer_ref(KSI_Integer *o) {
 	if (o != NULL && !o->staticAlloc) {
-		++o->refCount;
+		KSI_REFCOUNT_INC(o->refCount);
 	}
 	return KSI_OK;
 }
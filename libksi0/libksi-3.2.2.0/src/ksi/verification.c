@@ -41,6 +41,10 @@ int KSI_VerificationResult_reset(KSI_VerificationResult *info) {
 
 	info->publicationsFile = NULL;
 
+	info->extenderChain = NULL;
+
+	info->batch = NULL;
+
 	info->steps_len = 0;
 
 	KSI_DataHash_free(info->aggregationHash);
@@ -27,6 +27,8 @@
 extern "C" {
 #endif
 
+	typedef struct KSI_VerificationBatch_st KSI_VerificationBatch;
+
 	struct KSI_VerificationStepResult_st {
 		KSI_VerificationStep step;
 		int succeeded;
@@ -65,8 +67,77 @@ extern "C" {
 		const KSI_PublicationData *userPublication;
 
 		KSI_DataHash *aggregationHash;
+
+		/** Calendar hash chain received from the extender in advance (not owned). */
+		KSI_CalendarHashChain *extenderChain;
+
+		/** Intermediate results shared by the signatures verified together (not owned). */
+		KSI_VerificationBatch *batch;
 	};
 
+	typedef struct KSI_CertificateLookup_st {
+		/** Certificate id, belongs to the signature it was first seen in. */
+		const KSI_OctetString *certId;
+		/** The certificate from the publications file, \c NULL if not found. */
+		KSI_PKICertificate *cert;
+	} KSI_CertificateLookup;
+
+	/**
+	 * Intermediate results shared by the signatures verified together.
+	 */
+	struct KSI_VerificationBatch_st {
+		/** Certificates looked up from the publications file so far. */
+		KSI_CertificateLookup *certs;
+		size_t certs_len;
+		size_t certs_size;
+
+		/** Set if the certificate table is shared with other threads and must not be extended. */
+		bool certsReadOnly;
+
+		/** Root of the calendar hash chain of the signature being verified, shared by the
+		 * signatures carrying an identical chain. */
+		KSI_DataHash **calendarRoot;
+	};
+
+	/**
+	 * Groups the signatures carrying byte by byte identical calendar hash chains. A signature
+	 * without a calendar hash chain gets a group of its own.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	sigs		Array of KSI signatures.
+	 * \param[in]	count		Number of signatures in \c sigs.
+	 * \param[out]	groupOf		Receives the index of the group for each signature.
+	 * \param[out]	groups_count	Receives the number of groups, may be \c NULL.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_VerificationBatch_groupCalendarChains(KSI_CTX *ctx, KSI_Signature * const *sigs, size_t count, size_t *groupOf, size_t *groups_count);
+
+	/**
+	 * Looks up the certificates of the calendar authentication records of the signatures
+	 * from the publications file of the context into the certificate table of the batch.
+	 * \param[in]	batch		Verification batch.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	sigs		Array of KSI signatures.
+	 * \param[in]	count		Number of signatures in \c sigs.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_VerificationBatch_addCertificates(KSI_VerificationBatch *batch, KSI_CTX *ctx, KSI_Signature * const *sigs, size_t count);
+
+	/**
+	 * Verifies a signature of the batch like #KSI_Signature_verifyMany.
+	 * \param[in]	batch		Verification batch.
+	 * \param[in]	sig			KSI signature.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	publication	Publication to verify the signature with, may be \c NULL.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_VerificationBatch_verify(KSI_VerificationBatch *batch, KSI_Signature *sig, KSI_CTX *ctx, const KSI_PublicationData *publication);
+
+	/**
+	 * Frees the resources held by the batch.
+	 * \param[in]	batch		Verification batch.
+	 */
+	void KSI_VerificationBatch_cleanup(KSI_VerificationBatch *batch);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,804 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#  include <windows.h>
+#  include <process.h>
+#else
+#  include <pthread.h>
+#  include <unistd.h>
+#endif
+
+#include "internal.h"
+#include "ctx_impl.h"
+#include "pkitruststore.h"
+#include "publicationsfile_impl.h"
+#include "verification_impl.h"
+#include "signature_impl.h"
+#include "verification_pool.h"
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION PoolMutex;
+typedef HANDLE PoolThread;
+#else
+typedef pthread_mutex_t PoolMutex;
+typedef pthread_t PoolThread;
+#endif
+
+typedef struct VerificationWorker_st VerificationWorker;
+
+/* The work shared by the workers during a call to #KSI_VerificationPool_verify. */
+typedef struct VerificationJob_st {
+	/* Indices of the signatures to be verified by the workers. */
+	size_t *work;
+	size_t work_len;
+
+	/* Serialized signatures, in the order of \c work. */
+	unsigned char **raw;
+	unsigned *raw_len;
+
+	/* Calendar hash chain group of each signature, in the order of \c work. */
+	size_t *groupOf;
+	size_t groups_len;
+
+	/* Certificate ids of the signatures, looked up from the publications file of the pool's context. */
+	KSI_VerificationBatch certs;
+
+	KSI_Signature * const *sigs;
+	int *status;
+} VerificationJob;
+
+struct VerificationWorker_st {
+	KSI_VerificationPool *pool;
+	size_t id;
+
+	/* Context of the worker, the publications file and truststore of the pool's context are
+	 * attached to it. */
+	KSI_CTX *ctx;
+
+	/* Copy of the publication of the caller in the context of the worker. */
+	KSI_PublicationData *publication;
+
+	/* Certificates of the job looked up from the publications file of the worker. */
+	KSI_VerificationBatch batch;
+
+	/* Range [next, end) of the job still to be verified by the worker, guarded by the mutex. */
+	PoolMutex mutex;
+	size_t next;
+	size_t end;
+
+	/* Roots of the calendar hash chains computed by the worker, one per group. */
+	KSI_DataHash **calendarRoots;
+
+	PoolThread thread;
+	bool started;
+};
+
+struct KSI_VerificationPool_st {
+	KSI_CTX *ctx;
+
+	VerificationWorker *workers;
+	size_t workers_len;
+
+	/* The job being verified, only set during a call to #KSI_VerificationPool_verify. */
+	VerificationJob *job;
+};
+
+typedef struct SignatureRef_st {
+	const KSI_Signature *sig;
+	size_t index;
+} SignatureRef;
+
+static void mutexInit(PoolMutex *mutex) {
+#ifdef _WIN32
+	InitializeCriticalSection(mutex);
+#else
+	pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+static void mutexDestroy(PoolMutex *mutex) {
+#ifdef _WIN32
+	DeleteCriticalSection(mutex);
+#else
+	pthread_mutex_destroy(mutex);
+#endif
+}
+
+static void mutexLock(PoolMutex *mutex) {
+#ifdef _WIN32
+	EnterCriticalSection(mutex);
+#else
+	pthread_mutex_lock(mutex);
+#endif
+}
+
+static void mutexUnlock(PoolMutex *mutex) {
+#ifdef _WIN32
+	LeaveCriticalSection(mutex);
+#else
+	pthread_mutex_unlock(mutex);
+#endif
+}
+
+static size_t getOnlineProcessors(void) {
+	long count = 1;
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	count = (long)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return count > 0 ? (size_t)count : 1;
+}
+
+/* Takes the next signature of the worker, or steals the back half of the range of another worker. */
+static bool takeWork(VerificationWorker *worker, size_t *pos) {
+	KSI_VerificationPool *pool = worker->pool;
+	bool found = false;
+	size_t i;
+
+	mutexLock(&worker->mutex);
+	if (worker->next < worker->end) {
+		*pos = worker->next++;
+		found = true;
+	}
+	mutexUnlock(&worker->mutex);
+
+	for (i = 1; !found && i < pool->workers_len; i++) {
+		VerificationWorker *victim = &pool->workers[(worker->id + i) % pool->workers_len];
+		size_t begin = 0;
+		size_t end = 0;
+
+		mutexLock(&victim->mutex);
+		if (victim->next < victim->end) {
+			end = victim->end;
+			begin = end - (end - victim->next + 1) / 2;
+			victim->end = begin;
+		}
+		mutexUnlock(&victim->mutex);
+
+		if (begin < end) {
+			mutexLock(&worker->mutex);
+			*pos = begin;
+			worker->next = begin + 1;
+			worker->end = end;
+			mutexUnlock(&worker->mutex);
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+static void verifyWork(VerificationWorker *worker, size_t pos) {
+	int res = KSI_UNKNOWN_ERROR;
+	VerificationJob *job = worker->pool->job;
+	size_t i = job->work[pos];
+	KSI_Signature *sig = NULL;
+	KSI_VerificationResult *src = NULL;
+	KSI_VerificationResult *dst = &job->sigs[i]->verificationResult;
+
+	res = KSI_Signature_parse(worker->ctx, job->raw[pos], job->raw_len[pos], &sig);
+	if (res != KSI_OK) goto cleanup;
+
+	worker->batch.calendarRoot = &worker->calendarRoots[job->groupOf[pos]];
+
+	res = KSI_VerificationBatch_verify(&worker->batch, sig, worker->ctx, worker->publication);
+
+	/* Hand the outcome over to the signature of the caller. */
+	src = &sig->verificationResult;
+	dst->stepsPerformed = src->stepsPerformed;
+	dst->stepsFailed = src->stepsFailed;
+	dst->steps_len = src->steps_len;
+	memcpy(dst->steps, src->steps, src->steps_len * sizeof(KSI_VerificationStepResult));
+
+cleanup:
+
+	job->status[i] = res;
+	KSI_Signature_free(sig);
+}
+
+#ifdef _WIN32
+static unsigned __stdcall workerMain(void *arg) {
+#else
+static void *workerMain(void *arg) {
+#endif
+	VerificationWorker *worker = arg;
+	size_t pos;
+
+	while (takeWork(worker, &pos)) {
+		verifyWork(worker, pos);
+	}
+
+	return 0;
+}
+
+static bool startWorker(VerificationWorker *worker) {
+#ifdef _WIN32
+	uintptr_t handle = _beginthreadex(NULL, 0, workerMain, worker, 0, NULL);
+	if (handle == 0) return false;
+	worker->thread = (HANDLE)handle;
+	return true;
+#else
+	return pthread_create(&worker->thread, NULL, workerMain, worker) == 0;
+#endif
+}
+
+static void joinWorker(VerificationWorker *worker) {
+#ifdef _WIN32
+	WaitForSingleObject(worker->thread, INFINITE);
+	CloseHandle(worker->thread);
+#else
+	pthread_join(worker->thread, NULL);
+#endif
+}
+
+/* Copies the publication of the caller into the context of the worker. */
+static int copyPublication(KSI_CTX *ctx, const KSI_PublicationData *publication, KSI_PublicationData **copy) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_PublicationData *tmp = NULL;
+	KSI_Integer *pubTime = NULL;
+	KSI_DataHash *imprint = NULL;
+	const unsigned char *raw = NULL;
+	unsigned raw_len = 0;
+
+	res = KSI_PublicationData_new(ctx, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	if (publication->time != NULL) {
+		res = KSI_Integer_new(ctx, KSI_Integer_getUInt64(publication->time), &pubTime);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_PublicationData_setTime(tmp, pubTime);
+		if (res != KSI_OK) goto cleanup;
+		pubTime = NULL;
+	}
+
+	if (publication->imprint != NULL) {
+		res = KSI_DataHash_getImprint(publication->imprint, &raw, &raw_len);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_DataHash_fromImprint(ctx, raw, raw_len, &imprint);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_PublicationData_setImprint(tmp, imprint);
+		if (res != KSI_OK) goto cleanup;
+		imprint = NULL;
+	}
+
+	*copy = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Integer_free(pubTime);
+	KSI_DataHash_free(imprint);
+	KSI_PublicationData_free(tmp);
+
+	return res;
+}
+
+/* Attaches the publications file, the truststore and the publication to the worker. The
+ * attached objects belong to the context of the worker, so the workers never write to the
+ * pool's context. The publications file is parsed again only if the pool's context has got
+ * another one since the previous call. */
+static int attachWorker(VerificationWorker *worker, const KSI_VerificationBatch *certs, const KSI_PublicationData *publication) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CTX *ctx = worker->pool->ctx;
+	KSI_PublicationsFile *current = worker->ctx->publicationsFile;
+	KSI_PublicationsFile *origin = NULL;
+	KSI_PublicationsFile *pubFile = NULL;
+	KSI_PKITruststore *trust = NULL;
+	size_t i;
+
+	memset(&worker->batch, 0, sizeof(worker->batch));
+
+	if (publication != NULL) {
+		res = copyPublication(worker->ctx, publication, &worker->publication);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	if (ctx->publicationsFile != NULL) {
+		origin = ctx->publicationsFile->shared != NULL ? ctx->publicationsFile->shared : ctx->publicationsFile;
+	}
+
+	if (origin == NULL) {
+		res = KSI_CTX_setPublicationsFile(worker->ctx, NULL);
+		if (res != KSI_OK) goto cleanup;
+	} else if (current == NULL || current->shared != origin) {
+		res = KSI_PublicationsFile_attach(ctx->publicationsFile, worker->ctx, &pubFile);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_CTX_setPublicationsFile(worker->ctx, pubFile);
+		if (res != KSI_OK) goto cleanup;
+		pubFile = NULL;
+	}
+
+	if (ctx->pkiTruststore != NULL) {
+		res = KSI_PKITruststore_attach(ctx->pkiTruststore, worker->ctx, &trust);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_CTX_setPKITruststore(worker->ctx, trust);
+		if (res != KSI_OK) goto cleanup;
+		trust = NULL;
+	}
+
+	/* The certificate ids belong to the signatures of the caller, which outlive the call. The
+	 * table is complete, so the worker never adds the ids of its own copies to it. */
+	if (certs->certs_len > 0) {
+		worker->batch.certs = KSI_calloc(certs->certs_len, sizeof(KSI_CertificateLookup));
+		if (worker->batch.certs == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+		worker->batch.certs_size = certs->certs_len;
+
+		for (i = 0; i < certs->certs_len; i++) {
+			KSI_PKICertificate *cert = NULL;
+
+			if (certs->certs[i].cert != NULL) {
+				res = KSI_PublicationsFile_getPKICertificateById(worker->ctx->publicationsFile, certs->certs[i].certId, &cert);
+				if (res != KSI_OK) goto cleanup;
+			}
+
+			worker->batch.certs[i].certId = certs->certs[i].certId;
+			worker->batch.certs[i].cert = cert;
+			worker->batch.certs_len++;
+		}
+	}
+	worker->batch.certsReadOnly = true;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_PublicationsFile_free(pubFile);
+	KSI_PKITruststore_free(trust);
+
+	return res;
+}
+
+/* Releases the state of the worker for a call, the publications file is kept for the next one. */
+static void detachWorker(VerificationWorker *worker) {
+	KSI_CTX_setPKITruststore(worker->ctx, NULL);
+	KSI_PublicationData_free(worker->publication);
+	worker->publication = NULL;
+	worker->batch.certsReadOnly = false;
+	KSI_VerificationBatch_cleanup(&worker->batch);
+}
+
+static int compareSignatureRefs(const void *a, const void *b) {
+	const SignatureRef *ra = a;
+	const SignatureRef *rb = b;
+
+	if (ra->sig != rb->sig) return ra->sig < rb->sig ? -1 : 1;
+	return ra->index < rb->index ? -1 : (ra->index > rb->index);
+}
+
+/* Maps every signature to the index of its first occurrence in the array. */
+static int findDuplicates(KSI_CTX *ctx, KSI_Signature * const *sigs, size_t count, size_t *primary) {
+	int res = KSI_UNKNOWN_ERROR;
+	SignatureRef *refs = NULL;
+	size_t i;
+
+	refs = KSI_calloc(count, sizeof(SignatureRef));
+	if (refs == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; i++) {
+		refs[i].sig = sigs[i];
+		refs[i].index = i;
+	}
+
+	qsort(refs, count, sizeof(SignatureRef), compareSignatureRefs);
+
+	for (i = 0; i < count; i++) {
+		if (i > 0 && refs[i].sig == refs[i - 1].sig) {
+			primary[refs[i].index] = primary[refs[i - 1].index];
+		} else {
+			primary[refs[i].index] = refs[i].index;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(refs);
+
+	return res;
+}
+
+int KSI_VerificationPool_new(KSI_CTX *ctx, size_t threads, KSI_VerificationPool **pool) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_VerificationPool *tmp = NULL;
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || pool == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (threads == 0) threads = getOnlineProcessors();
+
+	tmp = KSI_new(KSI_VerificationPool);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->ctx = ctx;
+	tmp->workers_len = 0;
+	tmp->job = NULL;
+
+	tmp->workers = KSI_calloc(threads, sizeof(VerificationWorker));
+	if (tmp->workers == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < threads; i++) {
+		VerificationWorker *worker = &tmp->workers[i];
+
+		worker->pool = tmp;
+		worker->id = i;
+
+		res = KSI_CTX_new(&worker->ctx);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		/* The truststore of the pool's context is used instead. */
+		res = KSI_CTX_setPKITruststore(worker->ctx, NULL);
+		if (res != KSI_OK) {
+			KSI_CTX_free(worker->ctx);
+			worker->ctx = NULL;
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		mutexInit(&worker->mutex);
+		tmp->workers_len++;
+	}
+
+	*pool = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_VerificationPool_free(tmp);
+
+	return res;
+}
+
+void KSI_VerificationPool_free(KSI_VerificationPool *pool) {
+	size_t i;
+
+	if (pool != NULL) {
+		for (i = 0; i < pool->workers_len; i++) {
+			mutexDestroy(&pool->workers[i].mutex);
+			KSI_CTX_free(pool->workers[i].ctx);
+		}
+		KSI_free(pool->workers);
+		KSI_free(pool);
+	}
+}
+
+int KSI_VerificationPool_getThreadCount(const KSI_VerificationPool *pool, size_t *threads) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (pool == NULL || threads == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	*threads = pool->workers_len;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_VerificationPool_verify(KSI_VerificationPool *pool, KSI_Signature * const *sigs, size_t count, const KSI_PublicationData *publication, int *status) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CTX *ctx = NULL;
+	VerificationJob job;
+	size_t *primary = NULL;
+	int *tmpStatus = NULL;
+	int *useStatus = status;
+	KSI_Signature **workSigs = NULL;
+	KSI_Signature **onlineSigs = NULL;
+	size_t *onlineIdx = NULL;
+	int *onlineStatus = NULL;
+	size_t online_len = 0;
+	size_t started = 0;
+	bool needPubFile = false;
+	size_t i;
+
+	memset(&job, 0, sizeof(job));
+
+	if (pool == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	ctx = pool->ctx;
+
+	KSI_ERR_clearErrors(ctx);
+	if (sigs == NULL && count > 0) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (sigs[i] == NULL) {
+			KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+			goto cleanup;
+		}
+	}
+
+	if (count == 0) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	if (useStatus == NULL) {
+		tmpStatus = KSI_calloc(count, sizeof(int));
+		if (tmpStatus == NULL) {
+			KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+		useStatus = tmpStatus;
+	}
+
+	primary = KSI_calloc(count, sizeof(size_t));
+	job.work = KSI_calloc(count, sizeof(size_t));
+	onlineIdx = KSI_calloc(count, sizeof(size_t));
+	if (primary == NULL || job.work == NULL || onlineIdx == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	/* Every signature is verified once, the repeated ones get the outcome of the first. */
+	res = findDuplicates(ctx, sigs, count, primary);
+	if (res != KSI_OK) goto cleanup;
+
+	/* The signatures without a trust anchor of their own may need the extender, these are
+	 * left to the calling thread. */
+	for (i = 0; i < count; i++) {
+		if (primary[i] != i) continue;
+
+		if (publication == NULL) {
+			if (sigs[i]->calendarAuthRec == NULL && sigs[i]->publication == NULL) {
+				onlineIdx[online_len++] = i;
+				continue;
+			}
+			needPubFile = true;
+		} else if (sigs[i]->calendarAuthRec != NULL) {
+			needPubFile = true;
+		}
+		job.work[job.work_len++] = i;
+	}
+
+	/* The workers can not download the publications file, so it is received here. If that
+	 * fails, the signatures needing it fail with the same error without reaching a worker. */
+	if (needPubFile) {
+		KSI_PublicationsFile *pubFile = NULL;
+		int pubRes = KSI_receivePublicationsFile(ctx, &pubFile);
+
+		if (pubRes != KSI_OK) {
+			size_t k = 0;
+
+			KSI_LOG_debug(ctx, "Unable to receive the publications file for verification (error 0x%x).", pubRes);
+			for (i = 0; i < job.work_len; i++) {
+				if (publication == NULL || sigs[job.work[i]]->calendarAuthRec != NULL) {
+					useStatus[job.work[i]] = pubRes;
+				} else {
+					job.work[k++] = job.work[i];
+				}
+			}
+			job.work_len = k;
+			needPubFile = false;
+		}
+		KSI_ERR_clearErrors(ctx);
+	}
+
+	if (job.work_len > 0) {
+		job.raw = KSI_calloc(job.work_len, sizeof(unsigned char *));
+		job.raw_len = KSI_calloc(job.work_len, sizeof(unsigned));
+		job.groupOf = KSI_calloc(job.work_len, sizeof(size_t));
+		workSigs = KSI_calloc(job.work_len, sizeof(KSI_Signature *));
+		if (job.raw == NULL || job.raw_len == NULL || job.groupOf == NULL || workSigs == NULL) {
+			KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+
+		for (i = 0; i < job.work_len; i++) {
+			workSigs[i] = sigs[job.work[i]];
+
+			res = KSI_Signature_serialize(workSigs[i], &job.raw[i], &job.raw_len[i]);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+		}
+
+		res = KSI_VerificationBatch_groupCalendarChains(ctx, workSigs, job.work_len, job.groupOf, &job.groups_len);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		for (i = 0; i < pool->workers_len; i++) {
+			pool->workers[i].calendarRoots = KSI_calloc(job.groups_len, sizeof(KSI_DataHash *));
+			if (pool->workers[i].calendarRoots == NULL) {
+				KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+				goto cleanup;
+			}
+		}
+
+		/* The workers can not extend the certificate table either. The failures are left for
+		 * the workers to report per signature. */
+		if (needPubFile) {
+			KSI_VerificationBatch_addCertificates(&job.certs, ctx, workSigs, job.work_len);
+			KSI_ERR_clearErrors(ctx);
+		}
+
+		for (i = 0; i < job.work_len; i++) {
+			KSI_VerificationResult *info = &workSigs[i]->verificationResult;
+
+			KSI_VerificationResult_reset(info);
+			if (publication != NULL) {
+				info->userPublication = publication;
+				info->useUserPublication = true;
+			}
+		}
+	}
+
+	job.sigs = sigs;
+	job.status = useStatus;
+
+	pool->job = &job;
+
+	/* Split the work evenly, the calling thread takes the first range. */
+	for (i = 0; i < pool->workers_len; i++) {
+		VerificationWorker *worker = &pool->workers[i];
+
+		worker->next = i * job.work_len / pool->workers_len;
+		worker->end = (i + 1) * job.work_len / pool->workers_len;
+		worker->started = false;
+
+		res = attachWorker(worker, &job.certs, publication);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	for (i = 1; i < pool->workers_len && i < job.work_len; i++) {
+		pool->workers[i].started = startWorker(&pool->workers[i]);
+		if (pool->workers[i].started) started++;
+	}
+
+	KSI_LOG_debug(ctx, "Verifying %llu signatures with %llu threads.", (unsigned long long)job.work_len, (unsigned long long)started + 1);
+
+	/* The workers only use objects of their own contexts, so the calling thread verifies the
+	 * online-only signatures with the pool's context meanwhile. */
+	if (online_len > 0) {
+		onlineSigs = KSI_calloc(online_len, sizeof(KSI_Signature *));
+		onlineStatus = KSI_calloc(online_len, sizeof(int));
+
+		if (onlineSigs == NULL || onlineStatus == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			for (i = 0; i < online_len; i++) {
+				useStatus[onlineIdx[i]] = res;
+			}
+		} else {
+			for (i = 0; i < online_len; i++) {
+				onlineSigs[i] = sigs[onlineIdx[i]];
+			}
+
+			res = KSI_Signature_verifyMany(onlineSigs, online_len, ctx, NULL, onlineStatus);
+			for (i = 0; i < online_len; i++) {
+				useStatus[onlineIdx[i]] = res == KSI_OK ? onlineStatus[i] : res;
+			}
+		}
+	}
+
+	/* Join the workers, any range left by a thread that failed to start is taken over here. */
+	workerMain(&pool->workers[0]);
+
+	for (i = 1; i < pool->workers_len; i++) {
+		if (pool->workers[i].started) {
+			joinWorker(&pool->workers[i]);
+			pool->workers[i].started = false;
+		}
+	}
+
+	pool->job = NULL;
+
+	for (i = 0; i < count; i++) {
+		if (primary[i] != i) useStatus[i] = useStatus[primary[i]];
+	}
+
+	if (status == NULL) {
+		for (i = 0; i < count; i++) {
+			if (useStatus[i] != KSI_OK) {
+				KSI_pushError(ctx, res = useStatus[i], NULL);
+				goto cleanup;
+			}
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (pool != NULL) {
+		pool->job = NULL;
+		for (i = 0; i < pool->workers_len; i++) {
+			VerificationWorker *worker = &pool->workers[i];
+			size_t j;
+
+			detachWorker(worker);
+
+			if (worker->calendarRoots != NULL) {
+				for (j = 0; j < job.groups_len; j++) {
+					KSI_DataHash_free(worker->calendarRoots[j]);
+				}
+				KSI_free(worker->calendarRoots);
+				worker->calendarRoots = NULL;
+			}
+		}
+	}
+
+	if (job.raw != NULL) {
+		for (i = 0; i < job.work_len; i++) {
+			KSI_free(job.raw[i]);
+		}
+		KSI_free(job.raw);
+	}
+	KSI_VerificationBatch_cleanup(&job.certs);
+	KSI_free(job.raw_len);
+	KSI_free(job.groupOf);
+	KSI_free(job.work);
+	KSI_free(workSigs);
+	KSI_free(onlineSigs);
+	KSI_free(onlineStatus);
+	KSI_free(onlineIdx);
+	KSI_free(primary);
+	KSI_free(tmpStatus);
+
+	return res;
+}
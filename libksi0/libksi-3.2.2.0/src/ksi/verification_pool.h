@@ -0,0 +1,93 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef KSI_VERIFICATION_POOL_H_
+#define KSI_VERIFICATION_POOL_H_
+
+#include "ksi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * A pool of worker threads verifying batches of signatures in parallel. Every worker has
+	 * a KSI context of its own for the error stack and the intermediate results, the
+	 * publications file and the truststore of the pool's context are attached to the contexts
+	 * of the workers (see #KSI_PublicationsFile_attach). The signatures are split evenly between
+	 * the workers, and a worker running out of signatures takes half of the remaining ones of
+	 * another worker.
+	 *
+	 * The pool is bound to a KSI context and, like the context, may be used by one thread
+	 * at a time.
+	 * \note With OpenSSL older than 1.1.0 the application has to install the OpenSSL
+	 * locking callbacks before verifying in parallel.
+	 */
+	typedef struct KSI_VerificationPool_st KSI_VerificationPool;
+
+	/**
+	 * Creates a verification pool.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	threads		Number of workers including the calling thread, 0 for the number of online processors.
+	 * \param[out]	pool		Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_VerificationPool_new(KSI_CTX *ctx, size_t threads, KSI_VerificationPool **pool);
+
+	/**
+	 * Cleanup method for the verification pool.
+	 * \param[in]	pool		Verification pool.
+	 */
+	void KSI_VerificationPool_free(KSI_VerificationPool *pool);
+
+	/**
+	 * Returns the number of workers of the pool, including the calling thread.
+	 * \param[in]	pool		Verification pool.
+	 * \param[out]	threads		Receives the number of workers.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_VerificationPool_getThreadCount(const KSI_VerificationPool *pool, size_t *threads);
+
+	/**
+	 * Verifies a batch of signatures with the worker threads of the pool. The outcome for
+	 * every signature is the same as with #KSI_Signature_verifyMany, including the
+	 * verification result available with #KSI_Signature_getVerificationResult.
+	 *
+	 * The calling thread takes part in the verification as one of the workers. The signatures
+	 * having neither a calendar authentication record nor a publication record may only be
+	 * verified online, the calling thread verifies these with the network client of the
+	 * pool's context while the other workers verify the rest.
+	 *
+	 * \param[in]	pool		Verification pool.
+	 * \param[in]	sigs		Array of KSI signatures.
+	 * \param[in]	count		Number of signatures in \c sigs.
+	 * \param[in]	publication	Publication to verify the signatures with, may be \c NULL.
+	 * \param[out]	status		Array of \c count status codes in the order of \c sigs, may be \c NULL.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note If \c status is \c NULL, the first failure in the order of \c sigs is returned.
+	 * \note The signatures are serialized for the workers, so the whole batch is held in
+	 * memory twice while it is being verified.
+	 */
+	int KSI_VerificationPool_verify(KSI_VerificationPool *pool, KSI_Signature * const *sigs, size_t count, const KSI_PublicationData *publication, int *status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KSI_VERIFICATION_POOL_H_ */
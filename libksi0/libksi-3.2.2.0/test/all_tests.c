@@ -59,15 +59,15 @@ void KSITest_setFileMockResponse(CuTest *tc, const char *fileName) {
 }
 
 static void escapeStr(const char *str, CuString *escaped) {
-	int p;
+	const char *p;
 	static const char *replIndex = "<>&\"'";
 	static const char *repl[] = { "lt", "gt", "amp", "quot", "#39"};
 	while (*str) {
 		/* Find the index of current char. */
-		p = (int)(strchr(replIndex, *str) - replIndex);
+		p = strchr(replIndex, *str);
 		/* If the character is found, use the replacement */
-		if (p >= 0) {
-			CuStringAppendFormat(escaped, "&%s", repl[p]);
+		if (p != NULL) {
+			CuStringAppendFormat(escaped, "&%s;", repl[p - replIndex]);
 		} else {
 			CuStringAppendChar(escaped, *str);
 		}
@@ -223,17 +223,17 @@ static int RunAllTests() {
 	return failCount;
 }
 
-int KSITest_memcmp(void *ptr1, void *ptr2, size_t len) {
+int KSITest_memcmp(const void *ptr1, const void *ptr2, size_t len) {
 	int res;
 	size_t i;
 	res = memcmp(ptr1, ptr2, len);
 	if (res) {
 		printf("> ");
 		for (i = 0; i < len; i++)
-			printf("%02x", *((unsigned char *)ptr1 + i));
+			printf("%02x", *((const unsigned char *)ptr1 + i));
 		printf("\n< ");
 		for (i = 0; i < len; i++)
-			printf("%02x", *((unsigned char *)ptr2 + i));
+			printf("%02x", *((const unsigned char *)ptr2 + i));
 		printf("\n");
 	}
 	return res;
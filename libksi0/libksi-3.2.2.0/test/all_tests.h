@@ -34,7 +34,7 @@ extern "C" {
 
 const char* getFullResourcePath(const char* resource);
 
-int KSITest_memcmp(void *ptr1, void *ptr2, size_t len);
+int KSITest_memcmp(const void *ptr1, const void *ptr2, size_t len);
 
 int KSITest_DataHash_fromStr(KSI_CTX *ctx, const char *hexstr, KSI_DataHash **hsh);
 int KSITest_decodeHexStr(const char *hexstr, unsigned char *buf, unsigned buf_size, unsigned *buf_length);
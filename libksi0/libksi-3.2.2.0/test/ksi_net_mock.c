@@ -32,6 +32,7 @@ unsigned char *KSI_NET_MOCK_request = NULL;
 unsigned KSI_NET_MOCK_request_len = 0;
 unsigned char *KSI_NET_MOCK_response = NULL;
 unsigned KSI_NET_MOCK_response_len = 0;
+unsigned KSI_NET_MOCK_requestCount = 0;
 
 static size_t mockInitCount = 0;
 
@@ -126,6 +127,7 @@ static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, cha
 	memcpy((unsigned char *)KSI_NET_MOCK_request, handle->request, handle->request_length);
 
 	KSI_NET_MOCK_request_len = handle->request_length;
+	KSI_NET_MOCK_requestCount++;
 	res = KSI_OK;
 
 	return res;
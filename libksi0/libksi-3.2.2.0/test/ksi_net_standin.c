@@ -0,0 +1,1677 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ksi/ksi.h>
+#include <ksi/hashchain.h>
+#include <ksi/compatibility.h>
+
+#include "ksi_net_standin.h"
+
+void KSITest_StandInConfig_init(KSITest_StandInConfig *conf) {
+	if (conf == NULL) return;
+
+	memset(conf, 0, sizeof(*conf));
+	conf->loginId = "anon";
+	conf->key = "anon";
+	conf->failStatus = 0x0200;
+	conf->seed = 1;
+}
+
+#ifndef _WIN32
+
+#include <unistd.h>
+#include <errno.h>
+#include <strings.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define STANDIN_MAX_CONNECTIONS 32
+/* Room for the largest TLV16 PDU together with the HTTP request header. */
+#define STANDIN_MAX_HTTP_HEADER 0x2000
+#define STANDIN_BUFFER_SIZE (0xffff + 4 + STANDIN_MAX_HTTP_HEADER)
+#define STANDIN_HASH_ALG KSI_HASHALG_SHA2_256
+/* Size of the chunks of a chunked HTTP response body, small enough to split every response. */
+#define STANDIN_HTTP_CHUNK_SIZE 100
+
+#ifndef MSG_NOSIGNAL
+#  define MSG_NOSIGNAL 0
+#endif
+
+typedef struct StandInConn_st {
+	int fd;
+	/* Incremented on every close to invalidate the responses still queued. */
+	unsigned gen;
+	/* -1 until the first byte tells the transport apart. */
+	int isHttp;
+	int continued;
+	/* Time of the last request or response, for closing the idle HTTP connections. */
+	KSI_uint64_t activeAt;
+	unsigned char *buf;
+	size_t buf_len;
+} StandInConn;
+
+typedef struct StandInReply_st {
+	size_t slot;
+	unsigned gen;
+	KSI_uint64_t due;
+	/* A reply without data closes the connection. */
+	unsigned char *data;
+	size_t data_len;
+	struct StandInReply_st *next;
+} StandInReply;
+
+typedef struct StandInAggrReq_st {
+	size_t slot;
+	unsigned gen;
+	int hmacAlg;
+	KSI_Integer *requestId;
+	KSI_DataHash *hash;
+	unsigned level;
+	/* Filled in when the round is closed. */
+	KSI_LIST(KSI_HashChainLink) *chain;
+	KSI_uint64_t index;
+	unsigned depth;
+} StandInAggrReq;
+
+typedef struct StandInLeaf_st {
+	StandInAggrReq *req;
+	KSI_DataHash *hash;
+	unsigned level;
+} StandInLeaf;
+
+typedef struct StandInRound_st {
+	KSI_uint64_t time;
+	KSI_DataHash *root;
+} StandInRound;
+
+struct KSITest_StandIn_st {
+	KSI_CTX *ctx;
+	KSITest_StandInConfig conf;
+	char *loginId;
+	char *key;
+	char *httpHead;
+	int lsock;
+	/* Number of connections accepted so far. */
+	unsigned accepted;
+	unsigned short port;
+	StandInConn conn[STANDIN_MAX_CONNECTIONS];
+
+	/* Aggregation requests of the current round. */
+	StandInAggrReq *pending;
+	size_t pending_len;
+	size_t pending_size;
+	KSI_uint64_t roundStart;
+
+	/* Closed rounds in ascending order of time, the leaves of the calendar. */
+	StandInRound *rounds;
+	size_t rounds_len;
+	size_t rounds_size;
+
+	StandInReply *replies;
+	unsigned seed;
+};
+
+static KSI_uint64_t getTimeMs(void) {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (KSI_uint64_t)tv.tv_sec * 1000 + (KSI_uint64_t)tv.tv_usec / 1000;
+}
+
+static unsigned nextRandom(KSITest_StandIn *srv) {
+	/* Xorshift, good enough for picking the faults. */
+	unsigned x = srv->seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	srv->seed = x;
+	return x;
+}
+
+static int rollPercent(KSITest_StandIn *srv, unsigned percent) {
+	return percent > 0 && nextRandom(srv) % 100 < percent;
+}
+
+static KSI_uint64_t highBit(KSI_uint64_t n) {
+	n |= (n >> 1);
+	n |= (n >> 2);
+	n |= (n >> 4);
+	n |= (n >> 8);
+	n |= (n >> 16);
+	n |= (n >> 32);
+	return n - (n >> 1);
+}
+
+static char *copyString(const char *str) {
+	size_t len = strlen(str) + 1;
+	char *tmp = malloc(len);
+	if (tmp != NULL) memcpy(tmp, str, len);
+	return tmp;
+}
+
+static void StandInAggrReq_clear(StandInAggrReq *r) {
+	KSI_Integer_free(r->requestId);
+	KSI_DataHash_free(r->hash);
+	KSI_HashChainLinkList_free(r->chain);
+	memset(r, 0, sizeof(*r));
+}
+
+static void closeConn(KSITest_StandIn *srv, size_t slot) {
+	StandInConn *c = &srv->conn[slot];
+
+	if (c->fd >= 0) close(c->fd);
+	c->fd = -1;
+	c->gen++;
+	c->isHttp = -1;
+	c->continued = 0;
+	c->buf_len = 0;
+}
+
+static int sendAll(int fd, const unsigned char *buf, size_t len) {
+	size_t count = 0;
+
+	while (count < len) {
+		ssize_t c = send(fd, buf + count, len - count, MSG_NOSIGNAL);
+		if (c < 0 && errno == EINTR) continue;
+		if (c <= 0) return -1;
+		count += (size_t)c;
+	}
+
+	return 0;
+}
+
+/* Queues a serialized PDU for the connection in the given slot, \c data == NULL drops the connection. */
+static int queueReply(KSITest_StandIn *srv, size_t slot, unsigned gen, const unsigned char *data, size_t data_len) {
+	int res;
+	StandInReply *tmp = NULL;
+	StandInReply **last = NULL;
+	char hdr[256];
+	const char *head = hdr;
+	size_t hdr_len = 0;
+	size_t body_len = data_len;
+	size_t i;
+
+	tmp = calloc(1, sizeof(StandInReply));
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	tmp->slot = slot;
+	tmp->gen = gen;
+	tmp->due = getTimeMs() + srv->conf.latencyMs;
+	if (srv->conf.jitterMs > 0) tmp->due += nextRandom(srv) % (srv->conf.jitterMs + 1);
+
+	if (data != NULL) {
+		int isHttp = srv->conn[slot].isHttp == 1;
+
+		if (isHttp) {
+			if (srv->httpHead != NULL) {
+				head = srv->httpHead;
+			} else {
+				char length[64];
+
+				if (srv->conf.httpChunked) {
+					KSI_snprintf(length, sizeof(length), "Transfer-Encoding: chunked\r\n");
+				} else {
+					KSI_snprintf(length, sizeof(length), "Content-Length: %u\r\n", (unsigned)data_len);
+				}
+
+				KSI_snprintf(hdr, sizeof(hdr),
+						"HTTP/1.1 200 OK\r\n"
+						"Content-Type: application/ksi-response\r\n"
+						"%s%s"
+						"\r\n", length, srv->conf.httpKeepAlive ? "" : "Connection: close\r\n");
+			}
+			hdr_len = strlen(head);
+
+			/* Every chunk adds its size line and a line break, the last chunk is empty. */
+			if (srv->conf.httpChunked) {
+				body_len += (data_len / STANDIN_HTTP_CHUNK_SIZE + 1) * 16 + 5;
+			}
+		}
+
+		tmp->data = malloc(hdr_len + body_len);
+		if (tmp->data == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+
+		memcpy(tmp->data, head, hdr_len);
+		tmp->data_len = hdr_len;
+
+		if (isHttp && srv->conf.httpChunked) {
+			for (i = 0; i < data_len; i += STANDIN_HTTP_CHUNK_SIZE) {
+				size_t len = data_len - i < STANDIN_HTTP_CHUNK_SIZE ? data_len - i : STANDIN_HTTP_CHUNK_SIZE;
+
+				KSI_snprintf((char *)tmp->data + tmp->data_len, 16, "%x\r\n", (unsigned)len);
+				tmp->data_len += strlen((char *)tmp->data + tmp->data_len);
+				memcpy(tmp->data + tmp->data_len, data + i, len);
+				memcpy(tmp->data + tmp->data_len + len, "\r\n", 2);
+				tmp->data_len += len + 2;
+			}
+			memcpy(tmp->data + tmp->data_len, "0\r\n\r\n", 5);
+			tmp->data_len += 5;
+		} else {
+			memcpy(tmp->data + hdr_len, data, data_len);
+			tmp->data_len += data_len;
+		}
+	}
+
+	/* Keep the order of arrival for the responses with equal delays. */
+	last = &srv->replies;
+	while (*last != NULL) last = &(*last)->next;
+	*last = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (tmp != NULL) free(tmp->data);
+	free(tmp);
+
+	return res;
+}
+
+static void flushReplies(KSITest_StandIn *srv) {
+	StandInReply **p = &srv->replies;
+	KSI_uint64_t now = getTimeMs();
+
+	while (*p != NULL) {
+		StandInReply *r = *p;
+		StandInConn *c = NULL;
+
+		if (r->due > now) {
+			p = &r->next;
+			continue;
+		}
+
+		*p = r->next;
+
+		c = &srv->conn[r->slot];
+		if (c->gen == r->gen && c->fd >= 0) {
+			/* Unless kept alive, the HTTP responses are sent with "Connection: close". */
+			if (r->data == NULL || sendAll(c->fd, r->data, r->data_len) != 0 || (c->isHttp == 1 && !srv->conf.httpKeepAlive)) {
+				closeConn(srv, r->slot);
+			}
+			c->activeAt = now;
+		}
+
+		free(r->data);
+		free(r);
+	}
+}
+
+static int hashNode(KSI_CTX *ctx, const KSI_DataHash *left, const KSI_DataHash *right, unsigned level, KSI_DataHash **out) {
+	int res;
+	KSI_DataHasher *hsr = NULL;
+	const unsigned char *imprint = NULL;
+	unsigned imprint_len;
+	unsigned char lvl = (unsigned char)level;
+
+	res = KSI_DataHasher_open(ctx, STANDIN_HASH_ALG, &hsr);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHash_getImprint(left, &imprint, &imprint_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHasher_add(hsr, imprint, imprint_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHash_getImprint(right, &imprint, &imprint_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHasher_add(hsr, imprint, imprint_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHasher_add(hsr, &lvl, 1);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHasher_close(hsr, out);
+
+cleanup:
+
+	KSI_DataHasher_free(hsr);
+
+	return res;
+}
+
+/* Deterministic placeholder for values the stand-in does not keep. */
+static int hashFiller(KSI_CTX *ctx, unsigned char domain, KSI_uint64_t a, KSI_uint64_t b, KSI_DataHash **out) {
+	unsigned char buf[17];
+	int i;
+
+	buf[0] = domain;
+	for (i = 0; i < 8; i++) {
+		buf[1 + i] = (unsigned char)(a >> (56 - 8 * i));
+		buf[9 + i] = (unsigned char)(b >> (56 - 8 * i));
+	}
+
+	return KSI_DataHash_create(ctx, buf, sizeof(buf), STANDIN_HASH_ALG, out);
+}
+
+/* Returns the earliest round in the time range \c from .. \c to, or \c NULL. */
+static const StandInRound *findRound(const KSITest_StandIn *srv, KSI_uint64_t from, KSI_uint64_t to) {
+	size_t lo = 0;
+	size_t hi = srv->rounds_len;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (srv->rounds[mid].time < from) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (lo == srv->rounds_len || srv->rounds[lo].time > to) return NULL;
+	return &srv->rounds[lo];
+}
+
+/* Calculates the root of the calendar subtree over the seconds \c start .. \c start + \c r. */
+static int calendarNode(KSITest_StandIn *srv, KSI_uint64_t start, KSI_uint64_t r, KSI_DataHash **out) {
+	int res;
+	const StandInRound *round = NULL;
+	KSI_DataHash *left = NULL;
+	KSI_DataHash *right = NULL;
+	KSI_uint64_t h;
+
+	/* Subtrees without rounds are not expanded. */
+	round = findRound(srv, start, start + r);
+	if (round == NULL) {
+		res = hashFiller(srv->ctx, 0, start, r, out);
+		goto cleanup;
+	}
+
+	if (r == 0) {
+		res = KSI_DataHash_clone(round->root, out);
+		goto cleanup;
+	}
+
+	h = highBit(r);
+
+	res = calendarNode(srv, start, h - 1, &left);
+	if (res != KSI_OK) goto cleanup;
+
+	res = calendarNode(srv, start + h, r - h, &right);
+	if (res != KSI_OK) goto cleanup;
+
+	res = hashNode(srv->ctx, left, right, 0xff, out);
+
+cleanup:
+
+	KSI_DataHash_free(left);
+	KSI_DataHash_free(right);
+
+	return res;
+}
+
+static int buildCalendarChain(KSITest_StandIn *srv, KSI_uint64_t aggrTime, KSI_uint64_t pubTime, KSI_CalendarHashChain **chain) {
+	int res;
+	KSI_CalendarHashChain *tmp = NULL;
+	KSI_LIST(KSI_HashChainLink) *links = NULL;
+	KSI_HashChainLink *link = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_Integer *tm = NULL;
+	KSI_uint64_t start = 0;
+	KSI_uint64_t r = pubTime;
+
+	res = KSI_HashChainLinkList_new(&links);
+	if (res != KSI_OK) goto cleanup;
+
+	/* Walk down from the root, the shape is the same as in #KSI_CalendarHashChain_calculateAggregationTime. */
+	while (r > 0) {
+		KSI_uint64_t h = highBit(r);
+		int isLeft = aggrTime < start + h;
+
+		if (isLeft) {
+			res = calendarNode(srv, start + h, r - h, &hsh);
+			r = h - 1;
+		} else {
+			res = calendarNode(srv, start, h - 1, &hsh);
+			start += h;
+			r -= h;
+		}
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_HashChainLink_new(srv->ctx, &link);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_HashChainLink_setIsLeft(link, isLeft);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_HashChainLink_setImprint(link, hsh);
+		if (res != KSI_OK) goto cleanup;
+		hsh = NULL;
+
+		/* The chain starts from the leaf. */
+		res = KSI_HashChainLinkList_insertAt(links, 0, link);
+		if (res != KSI_OK) goto cleanup;
+		link = NULL;
+	}
+
+	res = KSI_CalendarHashChain_new(srv->ctx, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Integer_new(srv->ctx, pubTime, &tm);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_CalendarHashChain_setPublicationTime(tmp, tm);
+	if (res != KSI_OK) goto cleanup;
+	tm = NULL;
+
+	res = KSI_Integer_new(srv->ctx, aggrTime, &tm);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_CalendarHashChain_setAggregationTime(tmp, tm);
+	if (res != KSI_OK) goto cleanup;
+	tm = NULL;
+
+	res = calendarNode(srv, aggrTime, 0, &hsh);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_CalendarHashChain_setInputHash(tmp, hsh);
+	if (res != KSI_OK) goto cleanup;
+	hsh = NULL;
+
+	res = KSI_CalendarHashChain_setHashChain(tmp, links);
+	if (res != KSI_OK) goto cleanup;
+	links = NULL;
+
+	*chain = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_CalendarHashChain_free(tmp);
+	KSI_HashChainLinkList_free(links);
+	KSI_HashChainLink_free(link);
+	KSI_DataHash_free(hsh);
+	KSI_Integer_free(tm);
+
+	return res;
+}
+
+static int newHeader(KSITest_StandIn *srv, KSI_Header **hdr) {
+	int res;
+	KSI_Header *tmp = NULL;
+	KSI_Utf8String *loginId = NULL;
+
+	res = KSI_Header_new(srv->ctx, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Utf8String_new(srv->ctx, srv->loginId, (unsigned)strlen(srv->loginId) + 1, &loginId);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Header_setLoginId(tmp, loginId);
+	if (res != KSI_OK) goto cleanup;
+	loginId = NULL;
+
+	*hdr = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Utf8String_free(loginId);
+	KSI_Header_free(tmp);
+
+	return res;
+}
+
+/* Returns the status code for the credentials of the request. */
+static unsigned checkAuth(KSITest_StandIn *srv, KSI_Header *hdr, KSI_DataHash *hmac,
+		int (*calculateHmac)(void *, int, const char *, KSI_DataHash **), void *pdu, int *hmacAlg) {
+	unsigned status = 0x0102;
+	KSI_Utf8String *loginId = NULL;
+	KSI_DataHash *actual = NULL;
+
+	*hmacAlg = STANDIN_HASH_ALG;
+
+	if (hdr == NULL || hmac == NULL) goto cleanup;
+
+	if (KSI_Header_getLoginId(hdr, &loginId) != KSI_OK || loginId == NULL) goto cleanup;
+	if (strcmp(KSI_Utf8String_cstr(loginId), srv->loginId) != 0) goto cleanup;
+
+	if (KSI_DataHash_getHashAlg(hmac, hmacAlg) != KSI_OK) goto cleanup;
+	if (calculateHmac(pdu, *hmacAlg, srv->key, &actual) != KSI_OK) goto cleanup;
+	if (!KSI_DataHash_equals(hmac, actual)) goto cleanup;
+
+	status = 0;
+
+cleanup:
+
+	KSI_DataHash_free(actual);
+
+	return status;
+}
+
+static int newStatusObjects(KSITest_StandIn *srv, unsigned status, const char *msg, KSI_Integer **st, KSI_Utf8String **errMsg) {
+	int res;
+
+	res = KSI_Integer_new(srv->ctx, status, st);
+	if (res != KSI_OK) goto cleanup;
+
+	if (status != 0 && msg != NULL) {
+		res = KSI_Utf8String_new(srv->ctx, msg, (unsigned)strlen(msg) + 1, errMsg);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/* Sends the aggregation response, the ownership of \c resp is taken. */
+static int queueAggregationResp(KSITest_StandIn *srv, size_t slot, unsigned gen, int hmacAlg, KSI_AggregationResp *resp) {
+	int res;
+	KSI_AggregationPdu *pdu = NULL;
+	KSI_Header *hdr = NULL;
+	unsigned char *raw = NULL;
+	unsigned raw_len = 0;
+
+	res = KSI_AggregationPdu_new(srv->ctx, &pdu);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationPdu_setResponse(pdu, resp);
+	if (res != KSI_OK) goto cleanup;
+	resp = NULL;
+
+	res = newHeader(srv, &hdr);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationPdu_setHeader(pdu, hdr);
+	if (res != KSI_OK) goto cleanup;
+	hdr = NULL;
+
+	res = KSI_AggregationPdu_updateHmac(pdu, hmacAlg, srv->key);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationPdu_serialize(pdu, &raw, &raw_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = queueReply(srv, slot, gen, raw, raw_len);
+
+cleanup:
+
+	KSI_free(raw);
+	KSI_Header_free(hdr);
+	KSI_AggregationPdu_free(pdu);
+	KSI_AggregationResp_free(resp);
+
+	return res;
+}
+
+static int respondAggregation(KSITest_StandIn *srv, size_t slot, unsigned gen, int hmacAlg, KSI_Integer *requestId,
+		unsigned status, const char *msg, KSI_AggregationHashChain *aggr, KSI_CalendarHashChain *cal) {
+	int res;
+	KSI_AggregationResp *resp = NULL;
+	KSI_LIST(KSI_AggregationHashChain) *aggrList = NULL;
+	KSI_Integer *st = NULL;
+	KSI_Utf8String *errMsg = NULL;
+
+	res = KSI_AggregationResp_new(srv->ctx, &resp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationResp_setRequestId(resp, requestId);
+	if (res != KSI_OK) goto cleanup;
+	KSI_Integer_ref(requestId);
+
+	res = newStatusObjects(srv, status, msg, &st, &errMsg);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationResp_setStatus(resp, st);
+	if (res != KSI_OK) goto cleanup;
+	st = NULL;
+
+	res = KSI_AggregationResp_setErrorMsg(resp, errMsg);
+	if (res != KSI_OK) goto cleanup;
+	errMsg = NULL;
+
+	if (aggr != NULL) {
+		res = KSI_AggregationHashChainList_new(&aggrList);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_AggregationHashChainList_append(aggrList, aggr);
+		if (res != KSI_OK) goto cleanup;
+		aggr = NULL;
+
+		res = KSI_AggregationResp_setAggregationChainList(resp, aggrList);
+		if (res != KSI_OK) goto cleanup;
+		aggrList = NULL;
+	}
+
+	res = KSI_AggregationResp_setCalendarChain(resp, cal);
+	if (res != KSI_OK) goto cleanup;
+	cal = NULL;
+
+	res = queueAggregationResp(srv, slot, gen, hmacAlg, resp);
+	resp = NULL;
+
+cleanup:
+
+	KSI_AggregationResp_free(resp);
+	KSI_AggregationHashChainList_free(aggrList);
+	KSI_AggregationHashChain_free(aggr);
+	KSI_CalendarHashChain_free(cal);
+	KSI_Integer_free(st);
+	KSI_Utf8String_free(errMsg);
+
+	return res;
+}
+
+static int appendLink(KSITest_StandIn *srv, StandInAggrReq *r, int isLeft, const KSI_DataHash *sibling, unsigned levelCorrection) {
+	int res;
+	KSI_HashChainLink *link = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_Integer *lc = NULL;
+
+	res = KSI_HashChainLink_new(srv->ctx, &link);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_HashChainLink_setIsLeft(link, isLeft);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHash_clone((KSI_DataHash *)sibling, &hsh);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_HashChainLink_setImprint(link, hsh);
+	if (res != KSI_OK) goto cleanup;
+	hsh = NULL;
+
+	if (levelCorrection > 0) {
+		res = KSI_Integer_new(srv->ctx, levelCorrection, &lc);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_HashChainLink_setLevelCorrection(link, lc);
+		if (res != KSI_OK) goto cleanup;
+		lc = NULL;
+	}
+
+	res = KSI_HashChainLinkList_append(r->chain, link);
+	if (res != KSI_OK) goto cleanup;
+	link = NULL;
+
+	/* The links are added from the leaf, the chain index is read from the root. */
+	if (isLeft) r->index |= (KSI_uint64_t)1 << r->depth;
+	r->depth++;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_HashChainLink_free(link);
+	KSI_DataHash_free(hsh);
+	KSI_Integer_free(lc);
+
+	return res;
+}
+
+/* Builds the aggregation tree over the leaves \c lo .. \c hi - 1 and extends the chains of the requests in it. */
+static int aggregateRange(KSITest_StandIn *srv, StandInLeaf *leaves, size_t lo, size_t hi, KSI_DataHash **out, unsigned *outLevel) {
+	int res;
+	KSI_DataHash *left = NULL;
+	KSI_DataHash *right = NULL;
+	unsigned leftLevel;
+	unsigned rightLevel;
+	unsigned level;
+	size_t mid;
+	size_t i;
+
+	if (hi - lo == 1) {
+		*outLevel = leaves[lo].level;
+		res = KSI_DataHash_clone(leaves[lo].hash, out);
+		goto cleanup;
+	}
+
+	mid = lo + (hi - lo + 1) / 2;
+
+	res = aggregateRange(srv, leaves, lo, mid, &left, &leftLevel);
+	if (res != KSI_OK) goto cleanup;
+
+	res = aggregateRange(srv, leaves, mid, hi, &right, &rightLevel);
+	if (res != KSI_OK) goto cleanup;
+
+	level = (leftLevel > rightLevel ? leftLevel : rightLevel) + 1;
+	if (level > 0xff) {
+		res = KSI_INVALID_FORMAT;
+		goto cleanup;
+	}
+
+	for (i = lo; i < hi; i++) {
+		if (leaves[i].req == NULL) continue;
+
+		if (i < mid) {
+			res = appendLink(srv, leaves[i].req, 1, right, level - leftLevel - 1);
+		} else {
+			res = appendLink(srv, leaves[i].req, 0, left, level - rightLevel - 1);
+		}
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = hashNode(srv->ctx, left, right, level, out);
+	if (res != KSI_OK) goto cleanup;
+
+	*outLevel = level;
+
+cleanup:
+
+	KSI_DataHash_free(left);
+	KSI_DataHash_free(right);
+
+	return res;
+}
+
+static int newAggregationChain(KSITest_StandIn *srv, StandInAggrReq *r, KSI_uint64_t aggrTime, KSI_AggregationHashChain **chain) {
+	int res;
+	KSI_AggregationHashChain *tmp = NULL;
+	KSI_LIST(KSI_Integer) *chainIndex = NULL;
+	KSI_Integer *val = NULL;
+	KSI_DataHash *hsh = NULL;
+
+	res = KSI_AggregationHashChain_new(srv->ctx, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Integer_new(srv->ctx, aggrTime, &val);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationHashChain_setAggregationTime(tmp, val);
+	if (res != KSI_OK) goto cleanup;
+	val = NULL;
+
+	res = KSI_IntegerList_new(&chainIndex);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Integer_new(srv->ctx, ((KSI_uint64_t)1 << r->depth) | r->index, &val);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_IntegerList_append(chainIndex, val);
+	if (res != KSI_OK) goto cleanup;
+	val = NULL;
+
+	res = KSI_AggregationHashChain_setChainIndex(tmp, chainIndex);
+	if (res != KSI_OK) goto cleanup;
+	chainIndex = NULL;
+
+	res = KSI_DataHash_clone(r->hash, &hsh);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationHashChain_setInputHash(tmp, hsh);
+	if (res != KSI_OK) goto cleanup;
+	hsh = NULL;
+
+	res = KSI_Integer_new(srv->ctx, STANDIN_HASH_ALG, &val);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationHashChain_setAggrHashId(tmp, val);
+	if (res != KSI_OK) goto cleanup;
+	val = NULL;
+
+	res = KSI_AggregationHashChain_setChain(tmp, r->chain);
+	if (res != KSI_OK) goto cleanup;
+	r->chain = NULL;
+
+	*chain = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_AggregationHashChain_free(tmp);
+	KSI_IntegerList_free(chainIndex);
+	KSI_Integer_free(val);
+	KSI_DataHash_free(hsh);
+
+	return res;
+}
+
+static int appendRound(KSITest_StandIn *srv, KSI_uint64_t tm, KSI_DataHash *root) {
+	if (srv->rounds_len == srv->rounds_size) {
+		size_t size = srv->rounds_size ? srv->rounds_size * 2 : 16;
+		StandInRound *tmp = realloc(srv->rounds, size * sizeof(StandInRound));
+		if (tmp == NULL) return KSI_OUT_OF_MEMORY;
+		srv->rounds = tmp;
+		srv->rounds_size = size;
+	}
+
+	srv->rounds[srv->rounds_len].time = tm;
+	srv->rounds[srv->rounds_len].root = root;
+	srv->rounds_len++;
+
+	return KSI_OK;
+}
+
+/* Aggregates the pending requests into a new calendar second and answers them. */
+static int closeRound(KSITest_StandIn *srv) {
+	int res;
+	StandInLeaf *leaves = NULL;
+	KSI_DataHash *filler = NULL;
+	KSI_DataHash *root = NULL;
+	KSI_CalendarHashChain *calChain = NULL;
+	KSI_uint64_t tm;
+	size_t leaves_len = srv->pending_len;
+	unsigned level;
+	size_t i;
+
+	tm = (KSI_uint64_t)time(NULL);
+	if (srv->rounds_len > 0 && tm <= srv->rounds[srv->rounds_len - 1].time) {
+		tm = srv->rounds[srv->rounds_len - 1].time + 1;
+	}
+
+	leaves = calloc(leaves_len + 1, sizeof(StandInLeaf));
+	if (leaves == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	for (i = 0; i < srv->pending_len; i++) {
+		res = KSI_HashChainLinkList_new(&srv->pending[i].chain);
+		if (res != KSI_OK) goto cleanup;
+
+		leaves[i].req = &srv->pending[i];
+		leaves[i].hash = srv->pending[i].hash;
+		leaves[i].level = srv->pending[i].level;
+	}
+
+	/* An aggregation hash chain may not be empty. */
+	if (leaves_len == 1) {
+		res = hashFiller(srv->ctx, 1, tm, 0, &filler);
+		if (res != KSI_OK) goto cleanup;
+
+		leaves[leaves_len++].hash = filler;
+	}
+
+	res = aggregateRange(srv, leaves, 0, leaves_len, &root, &level);
+	if (res != KSI_OK) goto cleanup;
+
+	res = appendRound(srv, tm, root);
+	if (res != KSI_OK) goto cleanup;
+	root = NULL;
+
+	res = buildCalendarChain(srv, tm, tm, &calChain);
+	if (res != KSI_OK) goto cleanup;
+
+	for (i = 0; i < srv->pending_len; i++) {
+		StandInAggrReq *r = &srv->pending[i];
+		KSI_AggregationHashChain *aggr = NULL;
+		KSI_CalendarHashChain *cal = NULL;
+
+		res = newAggregationChain(srv, r, tm, &aggr);
+		if (res == KSI_OK) res = KSI_CalendarHashChain_clone(calChain, &cal);
+		if (res == KSI_OK) {
+			res = respondAggregation(srv, r->slot, r->gen, r->hmacAlg, r->requestId, 0, NULL, aggr, cal);
+		} else {
+			KSI_AggregationHashChain_free(aggr);
+			res = respondAggregation(srv, r->slot, r->gen, r->hmacAlg, r->requestId, 0x0200, "Unable to build the signature.", NULL, NULL);
+		}
+		if (res != KSI_OK) goto cleanup;
+
+		StandInAggrReq_clear(r);
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	/* Whatever is left unanswered failed with the round. */
+	for (i = 0; i < srv->pending_len; i++) {
+		StandInAggrReq *r = &srv->pending[i];
+		if (r->requestId == NULL) continue;
+
+		respondAggregation(srv, r->slot, r->gen, r->hmacAlg, r->requestId, 0x0200, "Aggregation round failed.", NULL, NULL);
+		StandInAggrReq_clear(r);
+	}
+	srv->pending_len = 0;
+
+	KSI_CalendarHashChain_free(calChain);
+	KSI_DataHash_free(root);
+	KSI_DataHash_free(filler);
+	free(leaves);
+
+	return res;
+}
+
+static int handleAggregation(KSITest_StandIn *srv, size_t slot, const unsigned char *raw, unsigned len) {
+	int res;
+	KSI_AggregationPdu *pdu = NULL;
+	KSI_AggregationReq *req = NULL;
+	KSI_Header *hdr = NULL;
+	KSI_DataHash *hmac = NULL;
+	KSI_Integer *requestId = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_Integer *level = NULL;
+	StandInAggrReq *r = NULL;
+	unsigned status;
+	int hmacAlg;
+
+	res = KSI_AggregationPdu_parse(srv->ctx, raw, len, &pdu);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationPdu_getRequest(pdu, &req);
+	if (res != KSI_OK || req == NULL) {
+		res = KSI_INVALID_FORMAT;
+		goto cleanup;
+	}
+
+	res = KSI_AggregationPdu_getHeader(pdu, &hdr);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationPdu_getHmac(pdu, &hmac);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationReq_getRequestId(req, &requestId);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationReq_getRequestHash(req, &hsh);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationReq_getRequestLevel(req, &level);
+	if (res != KSI_OK) goto cleanup;
+
+	status = checkAuth(srv, hdr, hmac, (int (*)(void *, int, const char *, KSI_DataHash **))KSI_AggregationPdu_calculateHmac, pdu, &hmacAlg);
+	if (status != 0) {
+		res = respondAggregation(srv, slot, srv->conn[slot].gen, hmacAlg, requestId, status, "Authentication failed.", NULL, NULL);
+		goto cleanup;
+	}
+
+	if (hsh == NULL || KSI_Integer_getUInt64(level) > 0xff) {
+		res = respondAggregation(srv, slot, srv->conn[slot].gen, hmacAlg, requestId, 0x0101, "Invalid request.", NULL, NULL);
+		goto cleanup;
+	}
+
+	if (rollPercent(srv, srv->conf.failPercent)) {
+		res = respondAggregation(srv, slot, srv->conn[slot].gen, hmacAlg, requestId, srv->conf.failStatus, "Injected failure.", NULL, NULL);
+		goto cleanup;
+	}
+
+	if (srv->pending_len == srv->pending_size) {
+		size_t size = srv->pending_size ? srv->pending_size * 2 : 16;
+		StandInAggrReq *tmp = realloc(srv->pending, size * sizeof(StandInAggrReq));
+		if (tmp == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+		srv->pending = tmp;
+		srv->pending_size = size;
+	}
+
+	if (srv->pending_len == 0) srv->roundStart = getTimeMs();
+
+	r = &srv->pending[srv->pending_len];
+	memset(r, 0, sizeof(*r));
+
+	res = KSI_DataHash_clone(hsh, &r->hash);
+	if (res != KSI_OK) goto cleanup;
+
+	r->slot = slot;
+	r->gen = srv->conn[slot].gen;
+	r->hmacAlg = hmacAlg;
+	r->requestId = requestId;
+	KSI_Integer_ref(requestId);
+	r->level = (unsigned)KSI_Integer_getUInt64(level);
+
+	srv->pending_len++;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_AggregationPdu_free(pdu);
+
+	return res;
+}
+
+/* Sends the extend response, the ownership of \c resp is taken. */
+static int queueExtendResp(KSITest_StandIn *srv, size_t slot, int hmacAlg, KSI_ExtendResp *resp) {
+	int res;
+	KSI_ExtendPdu *pdu = NULL;
+	KSI_Header *hdr = NULL;
+	unsigned char *raw = NULL;
+	unsigned raw_len = 0;
+
+	res = KSI_ExtendPdu_new(srv->ctx, &pdu);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendPdu_setResponse(pdu, resp);
+	if (res != KSI_OK) goto cleanup;
+	resp = NULL;
+
+	res = newHeader(srv, &hdr);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendPdu_setHeader(pdu, hdr);
+	if (res != KSI_OK) goto cleanup;
+	hdr = NULL;
+
+	res = KSI_ExtendPdu_updateHmac(pdu, hmacAlg, srv->key);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendPdu_serialize(pdu, &raw, &raw_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = queueReply(srv, slot, srv->conn[slot].gen, raw, raw_len);
+
+cleanup:
+
+	KSI_free(raw);
+	KSI_Header_free(hdr);
+	KSI_ExtendPdu_free(pdu);
+	KSI_ExtendResp_free(resp);
+
+	return res;
+}
+
+static int handleExtend(KSITest_StandIn *srv, size_t slot, const unsigned char *raw, unsigned len) {
+	int res;
+	KSI_ExtendPdu *pdu = NULL;
+	KSI_ExtendReq *req = NULL;
+	KSI_ExtendResp *resp = NULL;
+	KSI_Header *hdr = NULL;
+	KSI_DataHash *hmac = NULL;
+	KSI_Integer *requestId = NULL;
+	KSI_Integer *aggrTm = NULL;
+	KSI_Integer *pubTm = NULL;
+	KSI_Integer *st = NULL;
+	KSI_Utf8String *errMsg = NULL;
+	KSI_Integer *lastTime = NULL;
+	KSI_CalendarHashChain *chain = NULL;
+	KSI_uint64_t head = 0;
+	KSI_uint64_t aggrTime = 0;
+	KSI_uint64_t pubTime = 0;
+	unsigned status;
+	const char *msg = NULL;
+	int hmacAlg;
+
+	res = KSI_ExtendPdu_parse(srv->ctx, raw, len, &pdu);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendPdu_getRequest(pdu, &req);
+	if (res != KSI_OK || req == NULL) {
+		res = KSI_INVALID_FORMAT;
+		goto cleanup;
+	}
+
+	res = KSI_ExtendPdu_getHeader(pdu, &hdr);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendPdu_getHmac(pdu, &hmac);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendReq_getRequestId(req, &requestId);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendReq_getAggregationTime(req, &aggrTm);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendReq_getPublicationTime(req, &pubTm);
+	if (res != KSI_OK) goto cleanup;
+
+	if (srv->rounds_len > 0) head = srv->rounds[srv->rounds_len - 1].time;
+	aggrTime = KSI_Integer_getUInt64(aggrTm);
+	pubTime = pubTm != NULL ? KSI_Integer_getUInt64(pubTm) : head;
+
+	status = checkAuth(srv, hdr, hmac, (int (*)(void *, int, const char *, KSI_DataHash **))KSI_ExtendPdu_calculateHmac, pdu, &hmacAlg);
+	if (status != 0) {
+		msg = "Authentication failed.";
+	} else if (aggrTm == NULL) {
+		status = 0x0101;
+		msg = "Invalid request.";
+	} else if (srv->rounds_len == 0 || aggrTime > head) {
+		status = 0x0107;
+		msg = "Aggregation time is in the future.";
+	} else if (aggrTime < srv->rounds[0].time) {
+		status = 0x0105;
+		msg = "Aggregation time is before the calendar.";
+	} else if (pubTime > head) {
+		status = 0x0106;
+		msg = "Publication time is after the calendar head.";
+	} else if (aggrTime > pubTime) {
+		status = 0x0104;
+		msg = "Aggregation time is after the publication time.";
+	} else if (rollPercent(srv, srv->conf.failPercent)) {
+		status = srv->conf.failStatus;
+		msg = "Injected failure.";
+	}
+
+	res = KSI_ExtendResp_new(srv->ctx, &resp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendResp_setRequestId(resp, requestId);
+	if (res != KSI_OK) goto cleanup;
+	KSI_Integer_ref(requestId);
+
+	res = newStatusObjects(srv, status, msg, &st, &errMsg);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendResp_setStatus(resp, st);
+	if (res != KSI_OK) goto cleanup;
+	st = NULL;
+
+	res = KSI_ExtendResp_setErrorMsg(resp, errMsg);
+	if (res != KSI_OK) goto cleanup;
+	errMsg = NULL;
+
+	if (status == 0) {
+		res = KSI_Integer_new(srv->ctx, head, &lastTime);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_ExtendResp_setLastTime(resp, lastTime);
+		if (res != KSI_OK) goto cleanup;
+		lastTime = NULL;
+
+		res = buildCalendarChain(srv, aggrTime, pubTime, &chain);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_ExtendResp_setCalendarHashChain(resp, chain);
+		if (res != KSI_OK) goto cleanup;
+		chain = NULL;
+	}
+
+	res = queueExtendResp(srv, slot, hmacAlg, resp);
+	resp = NULL;
+
+cleanup:
+
+	KSI_ExtendPdu_free(pdu);
+	KSI_ExtendResp_free(resp);
+	KSI_Integer_free(st);
+	KSI_Utf8String_free(errMsg);
+	KSI_Integer_free(lastTime);
+	KSI_CalendarHashChain_free(chain);
+
+	return res;
+}
+
+static int handlePdu(KSITest_StandIn *srv, size_t slot, const unsigned char *raw, size_t len) {
+	unsigned tag;
+
+	if (len < 2) return KSI_INVALID_FORMAT;
+
+	if (raw[0] & 0x80) {
+		tag = ((raw[0] & 0x1f) << 8) | raw[1];
+	} else {
+		tag = raw[0] & 0x1f;
+	}
+
+	if (rollPercent(srv, srv->conf.dropPercent)) {
+		return queueReply(srv, slot, srv->conn[slot].gen, NULL, 0);
+	}
+
+	switch (tag) {
+		case 0x200:
+			return handleAggregation(srv, slot, raw, (unsigned)len);
+		case 0x300:
+			return handleExtend(srv, slot, raw, (unsigned)len);
+		default:
+			return KSI_INVALID_FORMAT;
+	}
+}
+
+static void consume(StandInConn *c, size_t len) {
+	memmove(c->buf, c->buf + len, c->buf_len - len);
+	c->buf_len -= len;
+}
+
+/* Returns the value of the header field, or \c NULL. */
+static const char *findHeader(const char *hdr, const char *name) {
+	size_t name_len = strlen(name);
+	const char *p = strstr(hdr, "\r\n");
+
+	while (p != NULL && p[2] != '\r') {
+		p += 2;
+		if (strncasecmp(p, name, name_len) == 0 && p[name_len] == ':') {
+			p += name_len + 1;
+			while (*p == ' ' || *p == '\t') p++;
+			return p;
+		}
+		p = strstr(p, "\r\n");
+	}
+
+	return NULL;
+}
+
+static int processHttp(KSITest_StandIn *srv, size_t slot) {
+	StandInConn *c = &srv->conn[slot];
+	char hdr[STANDIN_MAX_HTTP_HEADER + 1];
+
+	while (c->fd >= 0) {
+		const char *val = NULL;
+		size_t hdr_len = 0;
+		size_t body_len = 0;
+		size_t i;
+
+		for (i = 0; i + 3 < c->buf_len && i < STANDIN_MAX_HTTP_HEADER; i++) {
+			if (memcmp(c->buf + i, "\r\n\r\n", 4) == 0) {
+				hdr_len = i + 4;
+				break;
+			}
+		}
+
+		if (hdr_len == 0) {
+			if (c->buf_len >= STANDIN_MAX_HTTP_HEADER) return KSI_INVALID_FORMAT;
+			break;
+		}
+
+		memcpy(hdr, c->buf, hdr_len);
+		hdr[hdr_len] = '\0';
+
+		if (strncmp(hdr, "POST ", 5) != 0) return KSI_INVALID_FORMAT;
+
+		val = findHeader(hdr, "Content-Length");
+		if (val == NULL) return KSI_INVALID_FORMAT;
+		body_len = strtoul(val, NULL, 10);
+		if (hdr_len + body_len > STANDIN_BUFFER_SIZE) return KSI_INVALID_FORMAT;
+
+		val = findHeader(hdr, "Expect");
+		if (val != NULL && strncasecmp(val, "100-continue", 12) == 0 && !c->continued) {
+			static const char cont[] = "HTTP/1.1 100 Continue\r\n\r\n";
+			if (sendAll(c->fd, (const unsigned char *)cont, sizeof(cont) - 1) != 0) return KSI_IO_ERROR;
+			c->continued = 1;
+		}
+
+		if (c->buf_len < hdr_len + body_len) break;
+
+		if (handlePdu(srv, slot, c->buf + hdr_len, body_len) != KSI_OK) return KSI_INVALID_FORMAT;
+
+		consume(c, hdr_len + body_len);
+		c->continued = 0;
+	}
+
+	return KSI_OK;
+}
+
+static int processTlv(KSITest_StandIn *srv, size_t slot) {
+	StandInConn *c = &srv->conn[slot];
+
+	while (c->fd >= 0 && c->buf_len >= 2) {
+		size_t hdr_len;
+		size_t len;
+
+		if (c->buf[0] & 0x80) {
+			if (c->buf_len < 4) break;
+			hdr_len = 4;
+			len = (c->buf[2] << 8) | c->buf[3];
+		} else {
+			hdr_len = 2;
+			len = c->buf[1];
+		}
+
+		if (c->buf_len < hdr_len + len) break;
+
+		if (handlePdu(srv, slot, c->buf, hdr_len + len) != KSI_OK) return KSI_INVALID_FORMAT;
+
+		consume(c, hdr_len + len);
+	}
+
+	return KSI_OK;
+}
+
+static void readConn(KSITest_StandIn *srv, size_t slot) {
+	StandInConn *c = &srv->conn[slot];
+	ssize_t count;
+	int res;
+
+	count = recv(c->fd, c->buf + c->buf_len, STANDIN_BUFFER_SIZE - c->buf_len, 0);
+	if (count < 0 && errno == EINTR) return;
+	if (count <= 0) {
+		closeConn(srv, slot);
+		return;
+	}
+
+	c->buf_len += (size_t)count;
+	c->activeAt = getTimeMs();
+	if (c->isHttp < 0) c->isHttp = c->buf[0] == 'P';
+
+	res = c->isHttp ? processHttp(srv, slot) : processTlv(srv, slot);
+	if (res != KSI_OK) closeConn(srv, slot);
+}
+
+static void acceptConn(KSITest_StandIn *srv) {
+	size_t i;
+	int fd;
+
+	fd = accept(srv->lsock, NULL, NULL);
+	if (fd < 0) return;
+
+	if (srv->conf.acceptLimit > 0 && srv->accepted >= srv->conf.acceptLimit) {
+		close(fd);
+		return;
+	}
+	srv->accepted++;
+
+	for (i = 0; i < STANDIN_MAX_CONNECTIONS; i++) {
+		if (srv->conn[i].fd < 0) break;
+	}
+
+	if (i == STANDIN_MAX_CONNECTIONS || srv->conn[i].buf == NULL) {
+		close(fd);
+		return;
+	}
+
+	srv->conn[i].fd = fd;
+	srv->conn[i].isHttp = -1;
+	srv->conn[i].continued = 0;
+	srv->conn[i].activeAt = getTimeMs();
+	srv->conn[i].buf_len = 0;
+}
+
+/* Returns the time the connection becomes idle for too long, 0 if it is busy or never closed for being idle. */
+static KSI_uint64_t idleDeadline(KSITest_StandIn *srv, size_t slot) {
+	StandInConn *c = &srv->conn[slot];
+	StandInReply *r = NULL;
+	size_t i;
+
+	if (srv->conf.httpIdleMs == 0 || c->fd < 0 || c->isHttp != 1 || c->buf_len > 0) return 0;
+
+	for (r = srv->replies; r != NULL; r = r->next) {
+		if (r->slot == slot && r->gen == c->gen) return 0;
+	}
+
+	for (i = 0; i < srv->pending_len; i++) {
+		if (srv->pending[i].slot == slot && srv->pending[i].gen == c->gen) return 0;
+	}
+
+	return c->activeAt + srv->conf.httpIdleMs;
+}
+
+int KSITest_StandIn_serve(KSITest_StandIn *srv, unsigned timeoutMs) {
+	StandInReply *r = NULL;
+	fd_set rd;
+	struct timeval tv;
+	KSI_uint64_t now;
+	KSI_uint64_t wake;
+	int maxfd;
+	int count;
+	size_t i;
+
+	if (srv == NULL) return KSI_INVALID_ARGUMENT;
+
+	now = getTimeMs();
+	wake = now + timeoutMs;
+
+	for (r = srv->replies; r != NULL; r = r->next) {
+		if (r->due < wake) wake = r->due;
+	}
+
+	if (srv->pending_len > 0 && srv->roundStart + srv->conf.roundMs < wake) {
+		wake = srv->roundStart + srv->conf.roundMs;
+	}
+
+	for (i = 0; i < STANDIN_MAX_CONNECTIONS; i++) {
+		KSI_uint64_t idle = idleDeadline(srv, i);
+		if (idle != 0 && idle < wake) wake = idle;
+	}
+
+	if (wake < now) wake = now;
+
+	FD_ZERO(&rd);
+	FD_SET(srv->lsock, &rd);
+	maxfd = srv->lsock;
+
+	for (i = 0; i < STANDIN_MAX_CONNECTIONS; i++) {
+		if (srv->conn[i].fd < 0) continue;
+		FD_SET(srv->conn[i].fd, &rd);
+		if (srv->conn[i].fd > maxfd) maxfd = srv->conn[i].fd;
+	}
+
+	tv.tv_sec = (long)((wake - now) / 1000);
+	tv.tv_usec = (long)((wake - now) % 1000) * 1000;
+
+	count = select(maxfd + 1, &rd, NULL, NULL, &tv);
+	if (count < 0 && errno != EINTR) return KSI_IO_ERROR;
+
+	if (count > 0) {
+		for (i = 0; i < STANDIN_MAX_CONNECTIONS; i++) {
+			if (srv->conn[i].fd >= 0 && FD_ISSET(srv->conn[i].fd, &rd)) readConn(srv, i);
+		}
+
+		if (FD_ISSET(srv->lsock, &rd)) acceptConn(srv);
+	}
+
+	if (srv->pending_len > 0 && getTimeMs() >= srv->roundStart + srv->conf.roundMs) {
+		int res = closeRound(srv);
+		if (res != KSI_OK) return res;
+	}
+
+	flushReplies(srv);
+
+	now = getTimeMs();
+	for (i = 0; i < STANDIN_MAX_CONNECTIONS; i++) {
+		KSI_uint64_t idle = idleDeadline(srv, i);
+		if (idle != 0 && idle <= now) closeConn(srv, i);
+	}
+
+	return KSI_OK;
+}
+
+int KSITest_StandIn_new(KSI_CTX *ctx, const KSITest_StandInConfig *conf, unsigned short port, KSITest_StandIn **srv) {
+	int res;
+	KSITest_StandIn *tmp = NULL;
+	struct sockaddr_in addr;
+	struct sockaddr_un local;
+	socklen_t addr_len = sizeof(addr);
+	int on = 1;
+	size_t i;
+
+	if (ctx == NULL || srv == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	tmp = calloc(1, sizeof(KSITest_StandIn));
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	tmp->ctx = ctx;
+	tmp->lsock = -1;
+	for (i = 0; i < STANDIN_MAX_CONNECTIONS; i++) {
+		tmp->conn[i].fd = -1;
+		tmp->conn[i].isHttp = -1;
+	}
+
+	if (conf != NULL) {
+		tmp->conf = *conf;
+	} else {
+		KSITest_StandInConfig_init(&tmp->conf);
+	}
+	tmp->seed = tmp->conf.seed != 0 ? tmp->conf.seed : 1;
+
+	tmp->loginId = copyString(tmp->conf.loginId != NULL ? tmp->conf.loginId : "anon");
+	tmp->key = copyString(tmp->conf.key != NULL ? tmp->conf.key : "anon");
+	if (tmp->loginId == NULL || tmp->key == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	if (tmp->conf.httpHead != NULL) {
+		tmp->httpHead = copyString(tmp->conf.httpHead);
+		if (tmp->httpHead == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+	}
+	tmp->conf.loginId = NULL;
+	tmp->conf.key = NULL;
+	tmp->conf.socketPath = NULL;
+	tmp->conf.httpHead = NULL;
+
+	for (i = 0; i < STANDIN_MAX_CONNECTIONS; i++) {
+		tmp->conn[i].buf = malloc(STANDIN_BUFFER_SIZE);
+		if (tmp->conn[i].buf == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+	}
+
+	if (conf != NULL && conf->socketPath != NULL) {
+		if (strlen(conf->socketPath) >= sizeof(local.sun_path)) {
+			res = KSI_INVALID_ARGUMENT;
+			goto cleanup;
+		}
+
+		tmp->lsock = (int)socket(AF_UNIX, SOCK_STREAM, 0);
+		if (tmp->lsock < 0) {
+			res = KSI_IO_ERROR;
+			goto cleanup;
+		}
+
+		memset(&local, 0, sizeof(local));
+		local.sun_family = AF_UNIX;
+		strcpy(local.sun_path, conf->socketPath);
+
+		/* Replace the socket left over by an earlier server. */
+		unlink(conf->socketPath);
+
+		if (bind(tmp->lsock, (struct sockaddr *)&local, sizeof(local)) != 0 ||
+				listen(tmp->lsock, STANDIN_MAX_CONNECTIONS) != 0) {
+			res = KSI_IO_ERROR;
+			goto cleanup;
+		}
+	} else {
+		tmp->lsock = (int)socket(AF_INET, SOCK_STREAM, 0);
+		if (tmp->lsock < 0) {
+			res = KSI_IO_ERROR;
+			goto cleanup;
+		}
+
+		setsockopt(tmp->lsock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons(port);
+
+		if (bind(tmp->lsock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+				listen(tmp->lsock, STANDIN_MAX_CONNECTIONS) != 0 ||
+				getsockname(tmp->lsock, (struct sockaddr *)&addr, &addr_len) != 0) {
+			res = KSI_IO_ERROR;
+			goto cleanup;
+		}
+
+		tmp->port = ntohs(addr.sin_port);
+	}
+
+	*srv = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSITest_StandIn_free(tmp);
+
+	return res;
+}
+
+unsigned short KSITest_StandIn_getPort(const KSITest_StandIn *srv) {
+	return srv != NULL ? srv->port : 0;
+}
+
+int KSITest_StandIn_spawn(KSI_CTX *ctx, const KSITest_StandInConfig *conf, unsigned short *port, pid_t *pid) {
+	int res;
+	KSITest_StandIn *srv = NULL;
+	pid_t parent = getpid();
+	pid_t child;
+
+	if (ctx == NULL || port == NULL || pid == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = KSITest_StandIn_new(ctx, conf, 0, &srv);
+	if (res != KSI_OK) goto cleanup;
+
+	child = fork();
+	if (child < 0) {
+		res = KSI_IO_ERROR;
+		goto cleanup;
+	}
+
+	if (child == 0) {
+		/* Serve until killed or orphaned. */
+		while (getppid() == parent) {
+			if (KSITest_StandIn_serve(srv, 100) != KSI_OK) break;
+		}
+		_exit(0);
+	}
+
+	*port = srv->port;
+	*pid = child;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSITest_StandIn_free(srv);
+
+	return res;
+}
+
+void KSITest_StandIn_free(KSITest_StandIn *srv) {
+	size_t i;
+
+	if (srv == NULL) return;
+
+	for (i = 0; i < STANDIN_MAX_CONNECTIONS; i++) {
+		if (srv->conn[i].fd >= 0) close(srv->conn[i].fd);
+		free(srv->conn[i].buf);
+	}
+
+	if (srv->lsock >= 0) close(srv->lsock);
+
+	while (srv->replies != NULL) {
+		StandInReply *r = srv->replies;
+		srv->replies = r->next;
+		free(r->data);
+		free(r);
+	}
+
+	for (i = 0; i < srv->pending_len; i++) {
+		StandInAggrReq_clear(&srv->pending[i]);
+	}
+	free(srv->pending);
+
+	for (i = 0; i < srv->rounds_len; i++) {
+		KSI_DataHash_free(srv->rounds[i].root);
+	}
+	free(srv->rounds);
+
+	free(srv->loginId);
+	free(srv->key);
+	free(srv->httpHead);
+	free(srv);
+}
+
+#endif
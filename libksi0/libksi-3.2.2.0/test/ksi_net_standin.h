@@ -0,0 +1,131 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef KSI_NET_STANDIN_H_
+#define KSI_NET_STANDIN_H_
+
+#include <ksi/ksi.h>
+
+#ifndef _WIN32
+#  include <sys/types.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * Loopback stand-in for the aggregator and extender services. The server listens
+	 * on 127.0.0.1 (or on a Unix domain socket) and accepts both the TCP (raw TLV) and
+	 * the HTTP transport on the same port. Aggregation requests are collected into rounds and answered with real
+	 * aggregation hash chains over a calendar maintained by the server itself, so the
+	 * returned signatures can be extended and verified online against the same server.
+	 */
+	typedef struct KSITest_StandIn_st KSITest_StandIn;
+
+	typedef struct KSITest_StandInConfig_st {
+		/** Login id expected in the request headers. */
+		const char *loginId;
+		/** HMAC key used to check the requests and to sign the responses. */
+		const char *key;
+		/** Length of an aggregation round in milliseconds, 0 closes the round after every read. */
+		unsigned roundMs;
+		/** Delay added to every response in milliseconds. */
+		unsigned latencyMs;
+		/** Upper bound of a uniformly distributed extra delay in milliseconds. */
+		unsigned jitterMs;
+		/** Percentage of requests answered with \c failStatus. */
+		unsigned failPercent;
+		/** Status code returned for the failing requests. */
+		unsigned failStatus;
+		/** Percentage of requests answered by closing the connection. */
+		unsigned dropPercent;
+		/** Seed for the latency jitter and the injected faults. */
+		unsigned seed;
+		/** Path of a Unix domain socket to listen on instead of a loopback port, \c NULL for TCP. */
+		const char *socketPath;
+		/** Number of connections accepted, further ones are closed at once, 0 for no limit. */
+		unsigned acceptLimit;
+		/** Keep the HTTP connections open after the responses instead of closing them. */
+		int httpKeepAlive;
+		/** Send the HTTP response bodies with the chunked transfer coding. */
+		int httpChunked;
+		/** Time in milliseconds after which an idle HTTP connection is closed without notice, 0 for no limit. */
+		unsigned httpIdleMs;
+		/** Status line and header fields, including the empty line, sent instead of the regular ones, \c NULL for the regular head. */
+		const char *httpHead;
+	} KSITest_StandInConfig;
+
+	/**
+	 * Initializes the configuration with the defaults: credentials "anon"/"anon",
+	 * no latency and no injected faults.
+	 * \param[out]	conf		Configuration to be initialized.
+	 */
+	void KSITest_StandInConfig_init(KSITest_StandInConfig *conf);
+
+#ifndef _WIN32
+	/**
+	 * Creates a stand-in server listening on the loopback interface.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	conf		Configuration, may be \c NULL for the defaults.
+	 * \param[in]	port		Port to listen on, 0 for an ephemeral port. Ignored when listening on a Unix domain socket.
+	 * \param[out]	srv			Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSITest_StandIn_new(KSI_CTX *ctx, const KSITest_StandInConfig *conf, unsigned short port, KSITest_StandIn **srv);
+
+	/**
+	 * Returns the port the server is listening on.
+	 * \param[in]	srv			Stand-in server.
+	 * \return the port number, 0 when listening on a Unix domain socket.
+	 */
+	unsigned short KSITest_StandIn_getPort(const KSITest_StandIn *srv);
+
+	/**
+	 * Waits up to \c timeoutMs for network activity, serves it and delivers the responses
+	 * that have become due.
+	 * \param[in]	srv			Stand-in server.
+	 * \param[in]	timeoutMs	Maximum time to wait in milliseconds.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSITest_StandIn_serve(KSITest_StandIn *srv, unsigned timeoutMs);
+
+	/**
+	 * Starts a stand-in server in a child process. The child terminates when it is
+	 * killed or when the calling process exits.
+	 * \param[in]	ctx			KSI context.
+	 * \param[in]	conf		Configuration, may be \c NULL for the defaults.
+	 * \param[out]	port		The port the server is listening on.
+	 * \param[out]	pid			Process id of the child.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSITest_StandIn_spawn(KSI_CTX *ctx, const KSITest_StandInConfig *conf, unsigned short *port, pid_t *pid);
+
+	/**
+	 * Closes the connections and frees the server.
+	 * \param[in]	srv			Stand-in server.
+	 */
+	void KSITest_StandIn_free(KSITest_StandIn *srv);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KSI_NET_STANDIN_H_ */
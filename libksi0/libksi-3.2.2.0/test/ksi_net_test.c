@@ -28,7 +28,16 @@
 #include "../src/ksi/net_tcp_impl.h"
 #include "ksi/net_uri.h"
 
+#ifndef _WIN32
+#  include <unistd.h>
+#  include <sys/socket.h>
+#  include <sys/wait.h>
+#  include <netinet/in.h>
+#  include <arpa/inet.h>
+#endif
+
 extern KSI_CTX *ctx;
+extern unsigned KSI_NET_MOCK_requestCount;
 
 #define TEST_SIGNATURE_FILE "resource/tlv/ok-sig-2014-04-30.1.ksig"
 
@@ -248,6 +257,105 @@ static void testAggregationHeader(CuTest* tc) {
 	KSI_RequestHandle_free(handle);
 }
 
+static void testPreparedSignRequest(CuTest* tc) {
+	int res;
+	static const KSI_uint64_t ids[] = {1, 0xff, 0x100, 0x1234567890ull};
+	static const unsigned levels[] = {0, 3, 0, 0xff};
+	static const char *keys[] = {
+		"anon",
+		"0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef-longer-than-a-block"
+	};
+	KSI_PreparedSignRequest *prep = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_DataHash *reqHash = NULL;
+	KSI_AggregationReq *req = NULL;
+	KSI_AggregationPdu *pdu = NULL;
+	KSI_Integer *tmp = NULL;
+	const unsigned char *raw = NULL;
+	unsigned raw_len = 0;
+	unsigned char *expected = NULL;
+	unsigned expected_len = 0;
+	char *longLogin = NULL;
+	size_t i;
+	size_t k;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_DataHash_fromImprint(ctx, mockImprint, sizeof(mockImprint), &hsh);
+	CuAssert(tc, "Unable to create data hash object from raw imprint", res == KSI_OK && hsh != NULL);
+
+	for (k = 0; k < sizeof(keys) / sizeof(*keys); k++) {
+		res = KSI_PreparedSignRequest_new(ctx, "anon", keys[k], &prep);
+		CuAssert(tc, "Unable to prepare sign request.", res == KSI_OK && prep != NULL);
+
+		/* The prepared request must be identical to the enclosed one. */
+		for (i = 0; i < sizeof(ids) / sizeof(*ids); i++) {
+			res = KSI_PreparedSignRequest_build(prep, ids[i], hsh, levels[i], &raw, &raw_len);
+			CuAssert(tc, "Unable to build sign request.", res == KSI_OK && raw != NULL);
+
+			res = KSI_AggregationReq_new(ctx, &req);
+			CuAssert(tc, "Unable to create aggregation request.", res == KSI_OK && req != NULL);
+
+			res = KSI_DataHash_clone(hsh, &reqHash);
+			CuAssert(tc, "Unable to clone data hash.", res == KSI_OK && reqHash != NULL);
+
+			res = KSI_AggregationReq_setRequestHash(req, reqHash);
+			CuAssert(tc, "Unable to set request data hash.", res == KSI_OK);
+
+			res = KSI_Integer_new(ctx, ids[i], &tmp);
+			CuAssert(tc, "Unable to create request id.", res == KSI_OK && tmp != NULL);
+
+			res = KSI_AggregationReq_setRequestId(req, tmp);
+			CuAssert(tc, "Unable to set request id.", res == KSI_OK);
+
+			if (levels[i] > 0) {
+				res = KSI_Integer_new(ctx, levels[i], &tmp);
+				CuAssert(tc, "Unable to create request level.", res == KSI_OK && tmp != NULL);
+
+				res = KSI_AggregationReq_setRequestLevel(req, tmp);
+				CuAssert(tc, "Unable to set request level.", res == KSI_OK);
+			}
+
+			res = KSI_AggregationReq_enclose(req, "anon", (char *)keys[k], &pdu);
+			CuAssert(tc, "Unable to enclose request.", res == KSI_OK && pdu != NULL);
+
+			res = KSI_AggregationPdu_serialize(pdu, &expected, &expected_len);
+			CuAssert(tc, "Unable to serialize request pdu.", res == KSI_OK && expected != NULL);
+
+			CuAssert(tc, "Prepared request length mismatch.", raw_len == expected_len);
+			CuAssert(tc, "Prepared request mismatch.", !KSITest_memcmp(raw, expected, expected_len));
+
+			KSI_free(expected);
+			expected = NULL;
+			KSI_AggregationPdu_free(pdu);
+			pdu = NULL;
+		}
+
+		KSI_PreparedSignRequest_free(prep);
+		prep = NULL;
+	}
+
+	res = KSI_PreparedSignRequest_new(ctx, "anon", "anon", &prep);
+	CuAssert(tc, "Unable to prepare sign request.", res == KSI_OK && prep != NULL);
+
+	res = KSI_PreparedSignRequest_build(prep, 1, hsh, 0x100, &raw, &raw_len);
+	CuAssert(tc, "Level out of range should fail.", res == KSI_INVALID_ARGUMENT);
+
+	KSI_PreparedSignRequest_free(prep);
+	prep = NULL;
+
+	/* The header fits in a TLV, but the whole PDU would not. */
+	longLogin = KSI_calloc(0xffff - 0x40 + 1, 1);
+	CuAssert(tc, "Out of memory.", longLogin != NULL);
+	memset(longLogin, 'a', 0xffff - 0x40);
+
+	res = KSI_PreparedSignRequest_new(ctx, longLogin, "anon", &prep);
+	CuAssert(tc, "Too long login id should fail.", res == KSI_INVALID_ARGUMENT && prep == NULL);
+
+	KSI_free(longLogin);
+	KSI_DataHash_free(hsh);
+}
+
 static void testExtending(CuTest* tc) {
 	int res;
 	KSI_Signature *sig = NULL;
@@ -330,6 +438,211 @@ static void testExtendTo(CuTest* tc) {
 
 }
 
+static void testExtendToCached(CuTest* tc) {
+	int res;
+	KSI_Signature *sig = NULL;
+	KSI_Signature *ext = NULL;
+	KSI_Signature *cached = NULL;
+	unsigned char *serialized = NULL;
+	unsigned serialized_len = 0;
+	unsigned char *serializedCached = NULL;
+	unsigned serializedCached_len = 0;
+	KSI_Integer *to = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_CTX_setCalendarCacheSize(ctx, 16);
+	CuAssert(tc, "Unable to enable calendar cache.", res == KSI_OK);
+
+	res = KSI_Signature_fromFile(ctx, getFullResourcePath(TEST_SIGNATURE_FILE), &sig);
+	CuAssert(tc, "Unable to load signature from file.", res == KSI_OK && sig != NULL);
+
+	KSITest_setFileMockResponse(tc, getFullResourcePath("resource/tlv/ok-sig-2014-04-30.1-extend_response.tlv"));
+
+	KSI_Integer_new(ctx, 1400112000, &to);
+
+	res = KSI_Signature_extendTo(sig, ctx, to, &ext);
+	CuAssert(tc, "Unable to extend the signature", res == KSI_OK && ext != NULL);
+
+	/* The second extension must not reach the extender. */
+	KSITest_setFileMockResponse(tc, getFullResourcePath("resource/tlv/ok_extend_err_response-1.tlv"));
+
+	res = KSI_Signature_extendTo(sig, ctx, to, &cached);
+	CuAssert(tc, "Extension should be served from the cache.", res == KSI_OK && cached != NULL);
+
+	res = KSI_Signature_serialize(ext, &serialized, &serialized_len);
+	CuAssert(tc, "Unable to serialize extended signature", res == KSI_OK && serialized != NULL && serialized_len > 0);
+
+	res = KSI_Signature_serialize(cached, &serializedCached, &serializedCached_len);
+	CuAssert(tc, "Unable to serialize cached signature", res == KSI_OK && serializedCached != NULL && serializedCached_len > 0);
+
+	CuAssert(tc, "Cached extension differs from the original.", serialized_len == serializedCached_len && !KSITest_memcmp(serialized, serializedCached, serialized_len));
+
+	res = KSI_CTX_setCalendarCacheSize(ctx, 0);
+	CuAssert(tc, "Unable to disable calendar cache.", res == KSI_OK);
+
+	KSI_free(serialized);
+	KSI_free(serializedCached);
+
+	KSI_Integer_free(to);
+	KSI_Signature_free(sig);
+	KSI_Signature_free(ext);
+	KSI_Signature_free(cached);
+}
+
+static void testExtendManyTo(CuTest* tc) {
+	int res;
+	KSI_Signature *sigs[3] = {NULL, NULL, NULL};
+	KSI_Signature *ext[3] = {NULL, NULL, NULL};
+	int status[3];
+	unsigned char *serialized = NULL;
+	unsigned serialized_len = 0;
+	unsigned char expected[0x1ffff];
+	unsigned expected_len = 0;
+	FILE *f = NULL;
+	KSI_Integer *to = NULL;
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	for (i = 0; i < 3; i++) {
+		res = KSI_Signature_fromFile(ctx, getFullResourcePath(TEST_SIGNATURE_FILE), &sigs[i]);
+		CuAssert(tc, "Unable to load signature from file.", res == KSI_OK && sigs[i] != NULL);
+	}
+
+	/* All the signatures share the aggregation time, a single response must serve them all. */
+	KSITest_setFileMockResponse(tc, getFullResourcePath("resource/tlv/ok-sig-2014-04-30.1-extend_response.tlv"));
+
+	KSI_Integer_new(ctx, 1400112000, &to);
+
+	KSI_NET_MOCK_requestCount = 0;
+
+	res = KSI_Signature_extendManyTo(sigs, 3, ctx, to, ext, status);
+	CuAssert(tc, "Unable to extend the signatures", res == KSI_OK);
+	CuAssert(tc, "Signatures with the same aggregation time should be extended with a single request.", KSI_NET_MOCK_requestCount == 1);
+
+	/* Read in the expected result */
+	f = fopen(getFullResourcePath("resource/tlv/ok-sig-2014-04-30.1-extended_1400112000.ksig"), "rb");
+	CuAssert(tc, "Unable to read expected result file", f != NULL);
+	expected_len = (unsigned)fread(expected, 1, sizeof(expected), f);
+	fclose(f);
+
+	for (i = 0; i < 3; i++) {
+		CuAssert(tc, "Signature not extended.", status[i] == KSI_OK && ext[i] != NULL);
+
+		res = KSI_Signature_serialize(ext[i], &serialized, &serialized_len);
+		CuAssert(tc, "Unable to serialize extended signature", res == KSI_OK && serialized != NULL && serialized_len > 0);
+
+		CuAssert(tc, "Expected result length mismatch", expected_len == serialized_len);
+		CuAssert(tc, "Unexpected extended signature.", !KSITest_memcmp(expected, serialized, expected_len));
+
+		KSI_free(serialized);
+		serialized = NULL;
+	}
+
+	KSI_Integer_free(to);
+	for (i = 0; i < 3; i++) {
+		KSI_Signature_free(sigs[i]);
+		KSI_Signature_free(ext[i]);
+	}
+}
+
+static void testVerifyOnlineMany(CuTest* tc) {
+	int res;
+	KSI_Signature *sigs[3] = {NULL, NULL, NULL};
+	int status[3];
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	for (i = 0; i < 3; i++) {
+		res = KSI_Signature_fromFile(ctx, getFullResourcePath("resource/tlv/ok-sig-2014-04-30.1-head.ksig"), &sigs[i]);
+		CuAssert(tc, "Unable to load signature from file.", res == KSI_OK && sigs[i] != NULL);
+	}
+
+	KSITest_setFileMockResponse(tc, getFullResourcePath("resource/tlv/ok-sig-2014-04-30.1-head-extend_response.tlv"));
+
+	KSI_NET_MOCK_requestCount = 0;
+
+	res = KSI_Signature_verifyOnlineMany(sigs, 3, ctx, status);
+	CuAssert(tc, "Unable to verify the signatures.", res == KSI_OK);
+	CuAssert(tc, "Signatures with the same aggregation time should be verified with a single request.", KSI_NET_MOCK_requestCount == 1);
+
+	for (i = 0; i < 3; i++) {
+		CuAssert(tc, "Signature should verify.", status[i] == KSI_OK);
+	}
+
+	/* Without a status array, the outcome is all or nothing. */
+	ctx->requestCounter = 0;
+	KSI_NET_MOCK_requestCount = 0;
+
+	res = KSI_Signature_verifyOnlineMany(sigs, 3, ctx, NULL);
+	CuAssert(tc, "Signatures should verify.", res == KSI_OK && KSI_NET_MOCK_requestCount == 1);
+
+	for (i = 0; i < 3; i++) {
+		KSI_Signature_free(sigs[i]);
+	}
+}
+
+static void testExtendManyWithPublication(CuTest* tc) {
+	int res;
+	KSI_Signature *sigs[2] = {NULL, NULL};
+	KSI_Signature *ext[2] = {NULL, NULL};
+	KSI_Signature *published = NULL;
+	KSI_PublicationRecord *pubRec = NULL;
+	int status[2];
+	unsigned char *serialized = NULL;
+	unsigned serialized_len = 0;
+	unsigned char expected[0x1ffff];
+	unsigned expected_len = 0;
+	FILE *f = NULL;
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	for (i = 0; i < 2; i++) {
+		res = KSI_Signature_fromFile(ctx, getFullResourcePath(TEST_SIGNATURE_FILE), &sigs[i]);
+		CuAssert(tc, "Unable to load signature from file.", res == KSI_OK && sigs[i] != NULL);
+	}
+
+	/* Take the publication record from the expected result. */
+	res = KSI_Signature_fromFile(ctx, getFullResourcePath("resource/tlv/ok-sig-2014-04-30.1-extended.ksig"), &published);
+	CuAssert(tc, "Unable to load signature from file.", res == KSI_OK && published != NULL);
+
+	res = KSI_Signature_getPublicationRecord(published, &pubRec);
+	CuAssert(tc, "Unable to get publication record.", res == KSI_OK && pubRec != NULL);
+
+	KSITest_setFileMockResponse(tc, getFullResourcePath("resource/tlv/ok-sig-2014-04-30.1-extend_response.tlv"));
+
+	res = KSI_Signature_extendMany(sigs, 2, ctx, pubRec, ext, status);
+	CuAssert(tc, "Unable to extend the signatures", res == KSI_OK);
+
+	f = fopen(getFullResourcePath("resource/tlv/ok-sig-2014-04-30.1-extended.ksig"), "rb");
+	CuAssert(tc, "Unable to read expected result file", f != NULL);
+	expected_len = (unsigned)fread(expected, 1, sizeof(expected), f);
+	fclose(f);
+
+	/* The spliced signatures must be identical to the ones built from the objects. */
+	for (i = 0; i < 2; i++) {
+		CuAssert(tc, "Signature not extended.", status[i] == KSI_OK && ext[i] != NULL);
+
+		res = KSI_Signature_serialize(ext[i], &serialized, &serialized_len);
+		CuAssert(tc, "Unable to serialize extended signature", res == KSI_OK && serialized != NULL && serialized_len > 0);
+
+		CuAssert(tc, "Expected result length mismatch", expected_len == serialized_len);
+		CuAssert(tc, "Unexpected extended signature.", !KSITest_memcmp(expected, serialized, expected_len));
+
+		KSI_free(serialized);
+		serialized = NULL;
+	}
+
+	KSI_Signature_free(published);
+	for (i = 0; i < 2; i++) {
+		KSI_Signature_free(sigs[i]);
+		KSI_Signature_free(ext[i]);
+	}
+}
+
 static void testExtenderWrongData(CuTest* tc) {
 	int res;
 	KSI_Signature *sig = NULL;
@@ -765,6 +1078,168 @@ static void testLocalAggregationSigning(CuTest* tc) {
 	KSI_Signature_free(sig);
 }
 
+#ifndef _WIN32
+static int recvAll(int fd, unsigned char *buf, size_t len) {
+	size_t count = 0;
+	while (count < len) {
+		ssize_t c = recv(fd, buf + count, len - count, 0);
+		if (c <= 0) return -1;
+		count += (size_t)c;
+	}
+	return 0;
+}
+
+/* Turns the nested request of a TLV16 PDU into a response by fixing the tag. */
+static void mockTcpPatchRequest(unsigned char *buf, size_t len) {
+	size_t i;
+
+	for (i = 4; i + 1 < len;) {
+		if (buf[i] & 0x80) {
+			if (((buf[i] & 0x1f) << 8 | buf[i + 1]) == 0x201) buf[i + 1] = 0x02;
+			i += 4 + ((buf[i + 2] << 8) | buf[i + 3]);
+		} else {
+			i += 2 + buf[i + 1];
+		}
+	}
+}
+
+/* Reads a single TLV16 PDU from the socket and turns it into a response. */
+static int mockTcpAnswer(int fd, unsigned char *buf, size_t *len) {
+	size_t pdu_len;
+
+	if (recvAll(fd, buf, 4) != 0) return -1;
+	pdu_len = (buf[2] << 8) | buf[3];
+	if (recvAll(fd, buf + 4, pdu_len) != 0) return -1;
+
+	*len = pdu_len + 4;
+	mockTcpPatchRequest(buf, *len);
+
+	return 0;
+}
+
+/* Accepts a single connection, reads two requests and answers the first one twice before the second. */
+static void mockTcpServer(int lsock) {
+	unsigned char buf[2][0xffff + 4];
+	size_t len[2];
+	int fd;
+	int i;
+
+	/* Do not outlive a failed test. */
+	alarm(10);
+
+	fd = accept(lsock, NULL, NULL);
+	if (fd < 0) _exit(1);
+
+	for (i = 0; i < 2; i++) {
+		if (mockTcpAnswer(fd, buf[i], &len[i]) != 0) _exit(1);
+	}
+
+	if (send(fd, buf[0], len[0], 0) != (ssize_t)len[0]) _exit(1);
+	if (send(fd, buf[0], len[0], 0) != (ssize_t)len[0]) _exit(1);
+	if (send(fd, buf[1], len[1], 0) != (ssize_t)len[1]) _exit(1);
+
+	close(fd);
+	_exit(0);
+}
+
+static void testTcpPipelining(CuTest* tc) {
+	int res;
+	int lsock;
+	int status;
+	pid_t pid;
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	KSI_TcpClient *tcp = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_RequestHandle *handle[3] = {NULL, NULL, NULL};
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	lsock = (int)socket(AF_INET, SOCK_STREAM, 0);
+	CuAssert(tc, "Unable to open socket.", lsock >= 0);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	CuAssert(tc, "Unable to bind socket.", bind(lsock, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+	CuAssert(tc, "Unable to listen.", listen(lsock, 1) == 0);
+	CuAssert(tc, "Unable to get port.", getsockname(lsock, (struct sockaddr *)&addr, &addr_len) == 0);
+
+	pid = fork();
+	CuAssert(tc, "Unable to fork.", pid >= 0);
+	if (pid == 0) mockTcpServer(lsock);
+	close(lsock);
+
+	res = KSI_TcpClient_new(ctx, &tcp);
+	CuAssert(tc, "Unable to create TCP client.", res == KSI_OK && tcp != NULL);
+
+	res = KSI_TcpClient_setAggregator(tcp, "localhost", ntohs(addr.sin_port), "anon", "anon");
+	CuAssert(tc, "Unable to set aggregator.", res == KSI_OK);
+
+	res = KSI_DataHash_fromImprint(ctx, mockImprint, sizeof(mockImprint), &hsh);
+	CuAssert(tc, "Unable to create data hash object from raw imprint", res == KSI_OK && hsh != NULL);
+
+	for (i = 0; i < 3; i++) {
+		KSI_AggregationReq *req = NULL;
+		KSI_Integer *reqId = NULL;
+		KSI_DataHash *reqHsh = NULL;
+
+		res = KSI_AggregationReq_new(ctx, &req);
+		CuAssert(tc, "Unable to create aggregation request.", res == KSI_OK && req != NULL);
+
+		res = KSI_Integer_new(ctx, 100 + i, &reqId);
+		CuAssert(tc, "Unable to create request id.", res == KSI_OK && reqId != NULL);
+
+		res = KSI_DataHash_clone(hsh, &reqHsh);
+		CuAssert(tc, "Unable to clone data hash.", res == KSI_OK && reqHsh != NULL);
+
+		KSI_AggregationReq_setRequestId(req, reqId);
+		KSI_AggregationReq_setRequestHash(req, reqHsh);
+
+		res = KSI_NetworkClient_sendSignRequest((KSI_NetworkClient *)tcp, req, &handle[i]);
+		CuAssert(tc, "Unable to send aggregation request.", res == KSI_OK && handle[i] != NULL);
+
+		KSI_AggregationReq_free(req);
+	}
+
+	/* A request dropped before it is written must not be sent. */
+	KSI_RequestHandle_free(handle[1]);
+	handle[1] = NULL;
+
+	/* Reading the last response routes the first one to its handle and discards the duplicate. */
+	for (i = 0; i < 2; i++) {
+		static const size_t order[] = {2, 0};
+		const unsigned char *req = NULL;
+		unsigned req_len = 0;
+		const unsigned char *raw = NULL;
+		unsigned raw_len = 0;
+		unsigned char expected[0xffff + 4];
+
+		res = KSI_RequestHandle_getResponse(handle[order[i]], &raw, &raw_len);
+		CuAssert(tc, "Unable to read the pipelined response.", res == KSI_OK && raw != NULL);
+
+		res = KSI_RequestHandle_getRequest(handle[order[i]], &req, &req_len);
+		CuAssert(tc, "Unable to get the request.", res == KSI_OK && req != NULL && req_len <= sizeof(expected));
+
+		memcpy(expected, req, req_len);
+		mockTcpPatchRequest(expected, req_len);
+
+		CuAssert(tc, "Response routed to the wrong request handle.", raw_len == req_len && !memcmp(raw, expected, req_len));
+	}
+
+	CuAssert(tc, "Mock server failed.", waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	for (i = 0; i < 3; i++) {
+		KSI_RequestHandle_free(handle[i]);
+	}
+	KSI_DataHash_free(hsh);
+	KSI_TcpClient_free(tcp);
+}
+#endif
+
 CuSuite* KSITest_NET_getSuite(void) {
 	CuSuite* suite = CuSuiteNew();
 
@@ -774,17 +1249,25 @@ CuSuite* KSITest_NET_getSuite(void) {
 	SUITE_ADD_TEST(suite, testAggreAuthFailure);
 	SUITE_ADD_TEST(suite, testExtending);
 	SUITE_ADD_TEST(suite, testExtendTo);
+	SUITE_ADD_TEST(suite, testExtendToCached);
+	SUITE_ADD_TEST(suite, testExtendManyTo);
+	SUITE_ADD_TEST(suite, testVerifyOnlineMany);
+	SUITE_ADD_TEST(suite, testExtendManyWithPublication);
 	SUITE_ADD_TEST(suite, testExtenderWrongData);
 	SUITE_ADD_TEST(suite, testExtAuthFailure);
 	SUITE_ADD_TEST(suite, testExtendingWithoutPublication);
 	SUITE_ADD_TEST(suite, testExtendingToNULL);
 	SUITE_ADD_TEST(suite, testSigningInvalidResponse);
 	SUITE_ADD_TEST(suite, testAggregationHeader);
+	SUITE_ADD_TEST(suite, testPreparedSignRequest);
 	SUITE_ADD_TEST(suite, testSigningErrorResponse);
 	SUITE_ADD_TEST(suite, testExtendingErrorResponse);
 	SUITE_ADD_TEST(suite, testUrlSplit);
 	SUITE_ADD_TEST(suite, testSmartServiceSetters);
 	SUITE_ADD_TEST(suite, testLocalAggregationSigning);
+#ifndef _WIN32
+	SUITE_ADD_TEST(suite, testTcpPipelining);
+#endif
 
 	return suite;
 }
@@ -199,6 +199,67 @@ static void testFindPublicationByTime(CuTest *tc) {
 	KSI_DataHash_free(expHsh);
 }
 
+static void testAttachPublicationsFile(CuTest *tc) {
+	int res;
+	KSI_CTX *other = NULL;
+	KSI_PublicationsFile *pubFile = NULL;
+	KSI_PublicationsFile *attached = NULL;
+	KSI_PublicationsFile *received = NULL;
+	KSI_PKITruststore *pki = NULL;
+	KSI_PKITruststore *attachedPki = NULL;
+	KSI_PublicationRecord *pubRec = NULL;
+	KSI_PublicationRecord *origRec = NULL;
+	KSI_Integer *pubTime = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_PublicationsFile_fromFile(ctx, getFullResourcePath(TEST_PUBLICATIONS_FILE), &pubFile);
+	CuAssert(tc, "Unable to read publications file", res == KSI_OK && pubFile != NULL);
+
+	res = KSI_CTX_new(&other);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && other != NULL);
+
+	res = KSI_PublicationsFile_attach(pubFile, other, &attached);
+	CuAssert(tc, "Unable to attach publications file.", res == KSI_OK && attached != NULL);
+
+	res = KSI_CTX_setPublicationsFile(other, attached);
+	CuAssert(tc, "Unable to set publications file.", res == KSI_OK);
+
+	res = KSI_CTX_getPKITruststore(ctx, &pki);
+	CuAssert(tc, "Unable to get truststore.", res == KSI_OK && pki != NULL);
+
+	res = KSI_PKITruststore_attach(pki, other, &attachedPki);
+	CuAssert(tc, "Unable to attach truststore.", res == KSI_OK && attachedPki != NULL);
+
+	res = KSI_CTX_setPKITruststore(other, attachedPki);
+	CuAssert(tc, "Unable to set truststore.", res == KSI_OK);
+
+	res = KSI_Integer_new(ctx, 1397520000, &pubTime);
+	CuAssert(tc, "Unable to create ksi integer object.", res == KSI_OK && pubTime != NULL);
+
+	res = KSI_PublicationsFile_getPublicationDataByTime(pubFile, pubTime, &origRec);
+	CuAssert(tc, "Unable to get publication record by publication date.", res == KSI_OK && origRec != NULL);
+
+	KSI_Integer_free(pubTime);
+	pubTime = NULL;
+
+	/* The attached file must outlive the original. */
+	KSI_PublicationsFile_free(pubFile);
+
+	res = KSI_receivePublicationsFile(other, &received);
+	CuAssert(tc, "Attached publications file not used.", res == KSI_OK && received == attached);
+
+	res = KSI_Integer_new(other, 1397520000, &pubTime);
+	CuAssert(tc, "Unable to create ksi integer object.", res == KSI_OK && pubTime != NULL);
+
+	res = KSI_PublicationsFile_getPublicationDataByTime(received, pubTime, &pubRec);
+	CuAssert(tc, "Unable to get publication record by publication date.", res == KSI_OK && pubRec != NULL);
+	CuAssert(tc, "Records of the attached file shared with the original.", pubRec != origRec);
+
+	KSI_Integer_free(pubTime);
+	KSI_CTX_free(other);
+}
+
 static void testFindPublicationRef(CuTest *tc) {
 	int res;
 	KSI_PublicationsFile *pubFile = NULL;
@@ -281,6 +342,7 @@ CuSuite* KSITest_Publicationsfile_getSuite(void) {
 	SUITE_ADD_TEST(suite, testFindPublicationByPubStr);
 	SUITE_ADD_TEST(suite, testFindPublicationByTime);
 	SUITE_ADD_TEST(suite, testFindPublicationRef);
+	SUITE_ADD_TEST(suite, testAttachPublicationsFile);
 	SUITE_ADD_TEST(suite, testSerializePublicationsFile);
 
 	return suite;
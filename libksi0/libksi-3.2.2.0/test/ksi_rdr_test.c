@@ -25,6 +25,12 @@
 #include "all_tests.h"
 #include  <ksi/tlv.h>
 #include  <ksi/io.h>
+#include  <ksi/compatibility.h>
+
+#ifndef _WIN32
+#  include <unistd.h>
+#  include <sys/socket.h>
+#endif
 
 extern KSI_CTX *ctx;
 
@@ -42,7 +48,7 @@ struct KSI_RDR_st {
 		/* KSI_IO_FILE type input. */
 		FILE *file;
 
-		/* KSI_IO_MEM type input */
+		/* KSI_IO_MEM and KSI_IO_MMAP type input. */
 		struct {
 			char *buffer;
 			size_t buffer_length;
@@ -50,6 +56,15 @@ struct KSI_RDR_st {
 			/* Does the memory belong to this reader? */
 			int ownCopy;
 		} mem;
+
+		/* KSI_IO_SOCKET type input. */
+		struct {
+			int fd;
+			unsigned char *buffer;
+			size_t buffer_size;
+			size_t start;
+			size_t end;
+		} sock;
 	} data;
 
 	/* Offset of stream. */
@@ -174,6 +189,121 @@ static void TestRdrMemInitExtStorage(CuTest* tc) {
 	KSI_RDR_close(rdr);
 }
 
+static void TestRdrMappedFile(CuTest* tc) {
+	int res;
+	KSI_RDR *rdr = NULL;
+	unsigned char *ptr = NULL;
+	unsigned char tmpBuf[8];
+	size_t readCount;
+	static char testStr[] = "Randomness is too important to be left to chance";
+	FILE *f = NULL;
+
+	f = fopen(getFullResourcePath(TMP_FILE), "wb");
+	CuAssert(tc, "Unable to create temporary file", f != NULL);
+	CuAssert(tc, "Unable to write temporary file", fprintf(f, "%s", testStr) > 0);
+	CuAssert(tc, "Unable to close temporary file", !fclose(f));
+
+	res = KSI_RDR_fromFile(ctx, getFullResourcePath(TMP_FILE), &rdr);
+	CuAssert(tc, "Unable to create reader from file.", res == KSI_OK && rdr != NULL);
+
+	res = KSI_RDR_read_ex(rdr, tmpBuf, sizeof(tmpBuf), &readCount);
+	CuAssert(tc, "Unable to read the beginning of the file.", res == KSI_OK && readCount == sizeof(tmpBuf) && !memcmp(tmpBuf, testStr, readCount));
+
+	/* The rest of the file is returned in place. */
+	res = KSI_RDR_read_ptr(rdr, &ptr, sizeof(testStr), &readCount);
+	CuAssert(tc, "Unable to read the file in place.", res == KSI_OK && ptr != NULL);
+	CuAssert(tc, "Wrong data read in place.", readCount == strlen(testStr) - sizeof(tmpBuf) && !memcmp(ptr, testStr + sizeof(tmpBuf), readCount));
+	CuAssert(tc, "Reader is not at EOF", KSI_RDR_isEOF(rdr));
+	CuAssert(tc, "Reader should be at the end.", KSI_RDR_verifyEnd(rdr) == KSI_OK);
+
+	KSI_RDR_close(rdr);
+	rdr = NULL;
+
+	CuAssert(tc, "Unable to remove temporary file", remove(getFullResourcePath(TMP_FILE)) == 0);
+
+	res = KSI_RDR_fromFile(ctx, getFullResourcePath(TMP_FILE), &rdr);
+	CuAssert(tc, "Reading a missing file should fail.", res != KSI_OK && rdr == NULL);
+}
+
+#ifndef _WIN32
+static void TestRdrPipeFile(CuTest* tc) {
+	int res;
+	int fds[2];
+	char fileName[64];
+	KSI_RDR *rdr = NULL;
+	unsigned char *ptr = NULL;
+	size_t readCount;
+	static char testStr[] = "Randomness is too important to be left to chance";
+
+	res = pipe(fds);
+	CuAssert(tc, "Unable to create pipe.", res == 0);
+
+	CuAssert(tc, "Unable to write to pipe.", write(fds[1], testStr, strlen(testStr)) == (ssize_t)strlen(testStr));
+	close(fds[1]);
+
+	/* A pipe can not be mapped, it is read to the end instead. */
+	KSI_snprintf(fileName, sizeof(fileName), "/dev/fd/%d", fds[0]);
+
+	res = KSI_RDR_fromFile(ctx, fileName, &rdr);
+	CuAssert(tc, "Unable to create reader from pipe.", res == KSI_OK && rdr != NULL);
+
+	res = KSI_RDR_read_ptr(rdr, &ptr, sizeof(testStr), &readCount);
+	CuAssert(tc, "Unable to read the pipe in place.", res == KSI_OK && ptr != NULL);
+	CuAssert(tc, "Wrong data read from pipe.", readCount == strlen(testStr) && !memcmp(ptr, testStr, readCount));
+	CuAssert(tc, "Reader should be at the end.", KSI_RDR_verifyEnd(rdr) == KSI_OK);
+
+	KSI_RDR_close(rdr);
+	close(fds[0]);
+}
+
+static void TestRdrSocketReadAhead(CuTest* tc) {
+	int res;
+	int fds[2];
+	KSI_RDR *rdr = NULL;
+	/* Two TLVs and the beginning of a third one, sent as a single segment. */
+	static const unsigned char data[] = {0x01, 0x02, 0xaa, 0xbb, 0x82, 0x03, 0x00, 0x03, 0xcc, 0xdd, 0xee, 0x04, 0x02, 0x11};
+	unsigned char *raw = NULL;
+	unsigned char *ptr = NULL;
+	size_t len = 0;
+
+	res = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+	CuAssert(tc, "Unable to create socket pair.", res == 0);
+
+	res = KSI_RDR_fromSocket(ctx, fds[0], &rdr);
+	CuAssert(tc, "Unable to create socket reader.", res == KSI_OK && rdr != NULL);
+
+	CuAssert(tc, "Unable to write to socket.", write(fds[1], data, sizeof(data)) == sizeof(data));
+
+	res = KSI_TLV_readTlvAlloc(rdr, &raw, &len);
+	CuAssert(tc, "Unable to read first TLV.", res == KSI_OK && len == 4 && !memcmp(raw, data, 4));
+	KSI_free(raw);
+	raw = NULL;
+
+	/* The rest of the segment was received together with the first TLV. */
+	CuAssert(tc, "Remaining data should be buffered.", KSI_RDR_isBuffered(rdr));
+
+	res = KSI_RDR_read_ptr(rdr, &ptr, 7, &len);
+	CuAssert(tc, "Unable to read second TLV in place.", res == KSI_OK && len == 7 && !memcmp(ptr, data + 4, 7));
+
+	/* The last TLV is completed by a later segment. */
+	CuAssert(tc, "Unable to write to socket.", write(fds[1], "\x22", 1) == 1);
+	close(fds[1]);
+
+	res = KSI_TLV_readTlvAlloc(rdr, &raw, &len);
+	CuAssert(tc, "Unable to read TLV split between segments.", res == KSI_OK && len == 4 && raw[2] == 0x11 && raw[3] == 0x22);
+	KSI_free(raw);
+	raw = NULL;
+
+	CuAssert(tc, "Nothing should be buffered.", !KSI_RDR_isBuffered(rdr));
+
+	res = KSI_TLV_readTlvAlloc(rdr, &raw, &len);
+	CuAssert(tc, "End of stream should be reported.", res == KSI_OK && raw == NULL && KSI_RDR_isEOF(rdr));
+
+	KSI_RDR_close(rdr);
+	close(fds[0]);
+}
+#endif
+
 CuSuite* KSITest_RDR_getSuite(void)
 {
 	CuSuite* suite = CuSuiteNew();
@@ -183,6 +313,11 @@ CuSuite* KSITest_RDR_getSuite(void)
 	SUITE_ADD_TEST(suite, TestRdrFileReadingChuncks);
 
 	SUITE_ADD_TEST(suite, TestRdrMemInitExtStorage);
+	SUITE_ADD_TEST(suite, TestRdrMappedFile);
+#ifndef _WIN32
+	SUITE_ADD_TEST(suite, TestRdrPipeFile);
+	SUITE_ADD_TEST(suite, TestRdrSocketReadAhead);
+#endif
 
 	return suite;
 }
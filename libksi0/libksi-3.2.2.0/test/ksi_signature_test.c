@@ -20,9 +20,15 @@
 #include <string.h>
 #include "all_tests.h"
 #include <ksi/signature.h>
+#include <ksi/verification_pool.h>
+#include <ksi/signature_archive.h>
 #include "../src/ksi/ctx_impl.h"
 
 #include "../src/ksi/ctx_impl.h"
+#include "../src/ksi/internal.h"
+#include "../src/ksi/net_impl.h"
+#include "../src/ksi/verification_impl.h"
+#include "../src/ksi/signature_impl.h"
 
 
 extern KSI_CTX *ctx;
@@ -110,6 +116,325 @@ static void testVerifySignatureWithUserPublication(CuTest *tc) {
 	KSI_Signature_free(sig);
 }
 
+static void testVerifySignatures(CuTest *tc) {
+	int res;
+	static const char *files[] = {
+		"resource/tlv/ok-sig-2014-04-30.1-extended.ksig",
+		"resource/tlv/ok-sig-2014-08-01.1.ksig",
+		"resource/tlv/ok-sig-2014-04-30.1-extended.ksig",
+		"resource/tlv/ok-sig-2014-07-01.1.ksig"
+	};
+	const char pubStr[] = "AAAAAA-CTOQBY-AAMJYH-XZPM6T-UO6U6V-2WJMHQ-EJMVXR-JEAGID-2OY7P5-XFFKYI-QIF2LG-YOV7SO";
+	const char pubStr_bad[] = "AAAAAA-CT5VGY-AAPUCF-L3EKCC-NRSX56-AXIDFL-VZJQK4-WDCPOE-3KIWGB-XGPPM3-O5BIMW-REOVR4";
+	KSI_Signature *sigs[4];
+	int results[4];
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	for (i = 0; i < 4; i++) {
+		res = KSI_Signature_fromFile(ctx, getFullResourcePath(files[i]), &sigs[i]);
+		CuAssert(tc, "Unable to read signature from file.", res == KSI_OK && sigs[i] != NULL);
+	}
+
+	res = KSI_verifySignatures(ctx, sigs, 4, results);
+	CuAssert(tc, "Unable to verify signatures.", res == KSI_OK);
+
+	/* The outcome must not differ from verifying the signatures one by one. */
+	for (i = 0; i < 4; i++) {
+		res = KSI_verifySignature(ctx, sigs[i]);
+		CuAssert(tc, "Batch verification result mismatch.", res == results[i]);
+	}
+	CuAssert(tc, "Unable to verify signature with publication.", results[0] == KSI_OK && results[2] == KSI_OK);
+
+	res = KSI_verifySignatures(ctx, sigs, 3, NULL);
+	CuAssert(tc, "Unable to verify signatures.", res == KSI_OK);
+
+	res = KSI_verifySignaturesWithPublicationString(ctx, sigs, 4, pubStr, results);
+	CuAssert(tc, "Unable to verify signatures with publication string.", res == KSI_OK);
+	CuAssert(tc, "Unable to verify signature with publication string.", results[0] == KSI_OK && results[2] == KSI_OK);
+
+	res = KSI_verifySignaturesWithPublicationString(ctx, sigs, 3, pubStr_bad, NULL);
+	CuAssert(tc, "Signatures should not verify with wrong publication string.", res != KSI_OK);
+
+	for (i = 0; i < 4; i++) {
+		KSI_Signature_free(sigs[i]);
+	}
+}
+
+static void testVerificationPool(CuTest *tc) {
+	int res;
+	static const char *files[] = {
+		"resource/tlv/ok-sig-2014-04-30.1-extended.ksig",
+		"resource/tlv/ok-sig-2014-08-01.1.ksig",
+		"resource/tlv/ok-sig-2014-04-30.1-extended.ksig",
+		"resource/tlv/ok-sig-2014-07-01.1.ksig"
+	};
+	const char pubStr[] = "AAAAAA-CTOQBY-AAMJYH-XZPM6T-UO6U6V-2WJMHQ-EJMVXR-JEAGID-2OY7P5-XFFKYI-QIF2LG-YOV7SO";
+	KSI_VerificationPool *pool = NULL;
+	KSI_PublicationData *pubData = NULL;
+	KSI_Signature *loaded[4];
+	KSI_Signature *sigs[16];
+	int results[16];
+	int expected[4];
+	unsigned stepsPerformed[4];
+	unsigned stepsFailed[4];
+	size_t threads = 0;
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	for (i = 0; i < 4; i++) {
+		res = KSI_Signature_fromFile(ctx, getFullResourcePath(files[i]), &loaded[i]);
+		CuAssert(tc, "Unable to read signature from file.", res == KSI_OK && loaded[i] != NULL);
+	}
+
+	/* Repeat the signatures to have the workers steal from each other. */
+	for (i = 0; i < 16; i++) {
+		sigs[i] = loaded[i % 4];
+	}
+
+	res = KSI_VerificationPool_new(ctx, 4, &pool);
+	CuAssert(tc, "Unable to create verification pool.", res == KSI_OK && pool != NULL);
+
+	res = KSI_VerificationPool_getThreadCount(pool, &threads);
+	CuAssert(tc, "Unexpected thread count.", res == KSI_OK && threads == 4);
+
+	res = KSI_VerificationPool_verify(pool, sigs, 16, NULL, results);
+	CuAssert(tc, "Unable to verify signatures.", res == KSI_OK);
+
+	for (i = 0; i < 4; i++) {
+		stepsPerformed[i] = loaded[i]->verificationResult.stepsPerformed;
+		stepsFailed[i] = loaded[i]->verificationResult.stepsFailed;
+	}
+
+	/* The outcome must not differ from verifying the signatures one by one. */
+	for (i = 0; i < 4; i++) {
+		res = KSI_verifySignature(ctx, loaded[i]);
+		CuAssert(tc, "Pool verification result mismatch.", res == results[i] && res == results[i + 4] && res == results[i + 12]);
+		CuAssert(tc, "Pool verification steps mismatch.", stepsPerformed[i] == loaded[i]->verificationResult.stepsPerformed &&
+				stepsFailed[i] == loaded[i]->verificationResult.stepsFailed);
+	}
+	CuAssert(tc, "Unable to verify signature.", results[0] == KSI_OK && results[2] == KSI_OK);
+
+	res = KSI_VerificationPool_verify(pool, sigs, 3, NULL, NULL);
+	CuAssert(tc, "Unable to verify signatures.", res == KSI_OK);
+
+	res = KSI_PublicationData_fromBase32(ctx, pubStr, &pubData);
+	CuAssert(tc, "Unable to decode publication string.", res == KSI_OK && pubData != NULL);
+
+	res = KSI_VerificationPool_verify(pool, sigs, 16, pubData, results);
+	CuAssert(tc, "Unable to verify signatures with publication.", res == KSI_OK);
+	CuAssert(tc, "Unable to verify signature with publication.", results[0] == KSI_OK && results[8] == KSI_OK);
+
+	res = KSI_Signature_verifyMany(loaded, 4, ctx, pubData, expected);
+	CuAssert(tc, "Unable to verify signatures with publication.", res == KSI_OK);
+
+	for (i = 0; i < 16; i++) {
+		CuAssert(tc, "Pool verification result mismatch.", results[i] == expected[i % 4]);
+	}
+
+	KSI_PublicationData_free(pubData);
+	KSI_VerificationPool_free(pool);
+	for (i = 0; i < 4; i++) {
+		KSI_Signature_free(loaded[i]);
+	}
+}
+
+static int failPublicationRequest(KSI_NetworkClient *client, KSI_RequestHandle **handle) {
+	return KSI_NETWORK_CONNECTION_TIMEOUT;
+}
+
+static void testVerificationPoolNoPublicationsFile(CuTest *tc) {
+	int res;
+	static const char *files[] = {
+		"resource/tlv/ok-sig-2014-04-30.1-extended.ksig",
+		"resource/tlv/ok-sig-2014-08-01.1.ksig",
+		"resource/tlv/ok-sig-2014-07-01.1.ksig"
+	};
+	KSI_CTX *lctx = NULL;
+	KSI_NetworkClient *pr = NULL;
+	KSI_VerificationPool *pool = NULL;
+	KSI_Signature *sigs[3];
+	int results[3];
+	size_t i;
+
+	res = KSI_CTX_new(&lctx);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+
+	res = KSI_NET_MOCK_new(lctx, &pr);
+	CuAssert(tc, "Unable to create mock network provider.", res == KSI_OK && pr != NULL);
+
+	res = KSI_CTX_setNetworkProvider(lctx, pr);
+	CuAssert(tc, "Unable to set network provider.", res == KSI_OK);
+
+	/* The publications file can not be received. */
+	pr->sendPublicationRequest = failPublicationRequest;
+
+	for (i = 0; i < 3; i++) {
+		res = KSI_Signature_fromFile(lctx, getFullResourcePath(files[i]), &sigs[i]);
+		CuAssert(tc, "Unable to read signature from file.", res == KSI_OK && sigs[i] != NULL);
+	}
+
+	res = KSI_VerificationPool_new(lctx, 2, &pool);
+	CuAssert(tc, "Unable to create verification pool.", res == KSI_OK && pool != NULL);
+
+	res = KSI_VerificationPool_verify(pool, sigs, 3, NULL, results);
+	CuAssert(tc, "Unable to verify signatures.", res == KSI_OK);
+
+	/* The workers must not fetch the publications file from anywhere else. */
+	for (i = 0; i < 3; i++) {
+		CuAssert(tc, "Signature should fail with the error of the publications file request.", results[i] == KSI_NETWORK_CONNECTION_TIMEOUT);
+	}
+
+	KSI_VerificationPool_free(pool);
+	for (i = 0; i < 3; i++) {
+		KSI_Signature_free(sigs[i]);
+	}
+	KSI_CTX_free(lctx);
+}
+
+static void testSignatureArchive(CuTest *tc) {
+	int res;
+	static const char *files[] = {
+		"resource/tlv/ok-sig-2014-04-30.1-extended.ksig",
+		"resource/tlv/ok-sig-2014-08-01.1.ksig",
+		"resource/tlv/ok-sig-2014-04-30.1-extended.ksig",
+		"resource/tlv/ok-sig-2014-07-01.1.ksig"
+	};
+	KSI_SignatureArchiveWriter *writer = NULL;
+	KSI_SignatureArchive *archive = NULL;
+	KSI_Signature *sig = NULL;
+	KSI_Signature *exported = NULL;
+	unsigned char *raw = NULL;
+	size_t raw_len = 0;
+	unsigned char *sigRaw = NULL;
+	unsigned sigRaw_len = 0;
+	unsigned char *expRaw = NULL;
+	size_t expRaw_len = 0;
+	size_t count = 0;
+	size_t index = 0;
+	size_t total = 0;
+	size_t i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_SignatureArchiveWriter_new(ctx, &writer);
+	CuAssert(tc, "Unable to create archive writer.", res == KSI_OK && writer != NULL);
+
+	for (i = 0; i < 4; i++) {
+		res = KSI_Signature_fromFile(ctx, getFullResourcePath(files[i]), &sig);
+		CuAssert(tc, "Unable to read signature from file.", res == KSI_OK && sig != NULL);
+
+		res = KSI_SignatureArchiveWriter_add(writer, sig, &index);
+		CuAssert(tc, "Unable to add signature to archive.", res == KSI_OK && index == i);
+
+		res = KSI_Signature_serialize(sig, &sigRaw, &sigRaw_len);
+		CuAssert(tc, "Unable to serialize signature.", res == KSI_OK && sigRaw != NULL);
+		total += sigRaw_len;
+
+		KSI_free(sigRaw);
+		sigRaw = NULL;
+		KSI_Signature_free(sig);
+		sig = NULL;
+	}
+
+	res = KSI_SignatureArchiveWriter_addRaw(writer, (const unsigned char *)"\x88\x00\x00\x05\x01", 5, NULL);
+	CuAssert(tc, "Truncated signature should not be accepted.", res == KSI_INVALID_FORMAT);
+
+	/* The repeated signature must be stored only as references. */
+	res = KSI_SignatureArchiveWriter_serialize(writer, &raw, &raw_len);
+	CuAssert(tc, "Unable to serialize archive.", res == KSI_OK && raw != NULL);
+	CuAssert(tc, "Components are not shared.", raw_len < total);
+
+	res = KSI_SignatureArchive_parse(ctx, raw, raw_len, &archive);
+	CuAssert(tc, "Unable to parse archive.", res == KSI_OK && archive != NULL);
+
+	res = KSI_SignatureArchive_getCount(archive, &count);
+	CuAssert(tc, "Unexpected signature count.", res == KSI_OK && count == 4);
+
+	res = KSI_SignatureArchive_getComponentCount(archive, &count);
+	CuAssert(tc, "Unexpected component count.", res == KSI_OK && count > 0);
+
+	for (i = 0; i < 4; i++) {
+		res = KSI_Signature_fromFile(ctx, getFullResourcePath(files[i]), &sig);
+		CuAssert(tc, "Unable to read signature from file.", res == KSI_OK && sig != NULL);
+
+		res = KSI_Signature_serialize(sig, &sigRaw, &sigRaw_len);
+		CuAssert(tc, "Unable to serialize signature.", res == KSI_OK && sigRaw != NULL);
+
+		res = KSI_SignatureArchive_export(archive, i, &expRaw, &expRaw_len);
+		CuAssert(tc, "Unable to export signature.", res == KSI_OK && expRaw != NULL);
+		CuAssert(tc, "Exported signature mismatch.", expRaw_len == sigRaw_len && !memcmp(expRaw, sigRaw, sigRaw_len));
+
+		res = KSI_SignatureArchive_getSignature(archive, i, &exported);
+		CuAssert(tc, "Unable to get signature from archive.", res == KSI_OK && exported != NULL);
+
+		res = KSI_verifySignature(ctx, exported);
+		CuAssert(tc, "Signature verification result mismatch.", res == KSI_verifySignature(ctx, sig));
+
+		KSI_Signature_free(exported);
+		exported = NULL;
+		KSI_free(expRaw);
+		expRaw = NULL;
+		KSI_free(sigRaw);
+		sigRaw = NULL;
+		KSI_Signature_free(sig);
+		sig = NULL;
+	}
+
+	res = KSI_SignatureArchive_export(archive, 4, &expRaw, &expRaw_len);
+	CuAssert(tc, "Index out of range should fail.", res == KSI_INVALID_ARGUMENT);
+
+	KSI_SignatureArchive_free(archive);
+	archive = NULL;
+
+	/* Corrupt a component reference. */
+	raw[raw_len - 1] = 0xff;
+	res = KSI_SignatureArchive_parse(ctx, raw, raw_len, &archive);
+	CuAssert(tc, "Corrupt archive should not be accepted.", res == KSI_INVALID_FORMAT && archive == NULL);
+
+	KSI_free(raw);
+	KSI_SignatureArchiveWriter_free(writer);
+}
+
+static void testCalendarRootInvalidation(CuTest *tc) {
+	int res;
+	KSI_Signature *sig = NULL;
+	KSI_Signature *other = NULL;
+	KSI_CalendarHashChain *chain = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_Signature_fromFile(ctx, getFullResourcePath("resource/tlv/ok-sig-2014-04-30.1-extended.ksig"), &sig);
+	CuAssert(tc, "Unable to read signature from file.", res == KSI_OK && sig != NULL);
+
+	res = KSI_Signature_fromFile(ctx, getFullResourcePath(TEST_SIGNATURE_FILE), &other);
+	CuAssert(tc, "Unable to read signature from file.", res == KSI_OK && other != NULL);
+
+	res = KSI_verifySignature(ctx, sig);
+	CuAssert(tc, "Unable to verify signature with publication.", res == KSI_OK);
+	CuAssert(tc, "Calendar root not remembered.", sig->calendarRoot != NULL && sig->aggregationRoot != NULL);
+
+	/* Verifying again must give the same outcome. */
+	res = KSI_verifySignature(ctx, sig);
+	CuAssert(tc, "Unable to verify signature with publication.", res == KSI_OK);
+
+	/* Take the unextended chain from the other copy of the signature. */
+	chain = other->calendarChain;
+	other->calendarChain = NULL;
+
+	res = KSI_Signature_replaceCalendarChain(sig, chain);
+	CuAssert(tc, "Unable to replace calendar chain.", res == KSI_OK);
+	CuAssert(tc, "Calendar root not forgotten.", sig->calendarRoot == NULL);
+
+	res = KSI_verifySignature(ctx, sig);
+	CuAssert(tc, "Signature should not verify with a chain not matching the publication.", res != KSI_OK);
+
+	KSI_Signature_free(other);
+	KSI_Signature_free(sig);
+}
+
 static void testVerifySignatureExtendedToHead(CuTest *tc) {
 	int res;
 	KSI_Signature *sig = NULL;
@@ -353,6 +678,11 @@ CuSuite* KSITest_Signature_getSuite(void) {
 	SUITE_ADD_TEST(suite, testVerifySignatureNew);
 	SUITE_ADD_TEST(suite, testVerifySignatureWithPublication);
 	SUITE_ADD_TEST(suite, testVerifySignatureWithUserPublication);
+	SUITE_ADD_TEST(suite, testVerifySignatures);
+	SUITE_ADD_TEST(suite, testVerificationPool);
+	SUITE_ADD_TEST(suite, testVerificationPoolNoPublicationsFile);
+	SUITE_ADD_TEST(suite, testSignatureArchive);
+	SUITE_ADD_TEST(suite, testCalendarRootInvalidation);
 	SUITE_ADD_TEST(suite, testVerifySignatureExtendedToHead);
 	SUITE_ADD_TEST(suite, testSignerIdentity);
 	SUITE_ADD_TEST(suite, testSignatureWith2Anchors);
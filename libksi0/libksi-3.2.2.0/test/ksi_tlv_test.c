@@ -197,6 +197,37 @@ static void testTlv16FromReader(CuTest* tc) {
 	KSI_RDR_close(rdr);
 }
 
+static void testTlvReadTlvAlloc(CuTest* tc) {
+	int res;
+	/* TLV16 type = 0x2aa, length = 21 followed by TLV8 type = 0x07, length = 6 and a truncated TLV8 */
+	unsigned char raw[] = "\x82\xaa\x00\x15THIS IS A TLV CONTENT\x07\x06QWERTY\x07\x06QW";
+	unsigned char *buf = NULL;
+	size_t buf_len = 0;
+
+	KSI_RDR *rdr = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	res = KSI_RDR_fromSharedMem(ctx, raw, sizeof(raw) - 1, &rdr);
+	CuAssert(tc, "Failed to create reader.", res == KSI_OK && rdr != NULL);
+
+	res = KSI_TLV_readTlvAlloc(rdr, &buf, &buf_len);
+	CuAssert(tc, "Failed to read TLV16.", res == KSI_OK && buf != NULL);
+	CuAssert(tc, "TLV16 length mismatch.", buf_len == 25 && !memcmp(buf, raw, buf_len));
+	KSI_free(buf);
+	buf = NULL;
+
+	res = KSI_TLV_readTlvAlloc(rdr, &buf, &buf_len);
+	CuAssert(tc, "Failed to read TLV8.", res == KSI_OK && buf != NULL);
+	CuAssert(tc, "TLV8 length mismatch.", buf_len == 8 && !memcmp(buf, raw + 25, buf_len));
+	KSI_free(buf);
+	buf = NULL;
+
+	res = KSI_TLV_readTlvAlloc(rdr, &buf, &buf_len);
+	CuAssert(tc, "Truncated TLV was read.", res != KSI_OK && buf == NULL);
+
+	KSI_RDR_close(rdr);
+}
+
 static void testTlvGetUint64(CuTest* tc) {
 	int res;
 	/* TLV type = 1a, length = 8 */
@@ -538,6 +569,7 @@ CuSuite* KSITest_TLV_getSuite(void)
 	SUITE_ADD_TEST(suite, testTlv8FromReader);
 	SUITE_ADD_TEST(suite, testTlv8getRawValueSharedMem);
 	SUITE_ADD_TEST(suite, testTlv16FromReader);
+	SUITE_ADD_TEST(suite, testTlvReadTlvAlloc);
 	SUITE_ADD_TEST(suite, testTlvGetUint64);
 	SUITE_ADD_TEST(suite, testTlvGetUint64Overflow);
 	SUITE_ADD_TEST(suite, testTlvGetStringValue);
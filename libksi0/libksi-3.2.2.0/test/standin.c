@@ -0,0 +1,128 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ksi/ksi.h>
+
+#include "ksi_net_standin.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+
+static void usage(const char *name) {
+	fprintf(stderr,
+			"Usage: %s [options]\n"
+			"Serves the aggregator and extender protocols on 127.0.0.1 over TCP and HTTP.\n"
+			"  -p port     Port to listen on (default: ephemeral).\n"
+			"  -U path     Listen on a Unix domain socket instead of a port.\n"
+			"  -u login    Login id expected from the clients (default: anon).\n"
+			"  -k key      HMAC key (default: anon).\n"
+			"  -r ms       Aggregation round length.\n"
+			"  -l ms       Latency added to every response.\n"
+			"  -j ms       Maximum random jitter added to the latency.\n"
+			"  -f percent  Percentage of requests answered with an error status.\n"
+			"  -s status   Status code of the injected errors (default: 0x0200).\n"
+			"  -d percent  Percentage of requests answered by closing the connection.\n"
+			"  -S seed     Seed for the jitter and the injected faults.\n"
+			"  -a count    Number of connections accepted, further ones are closed.\n"
+			"  -K          Keep the HTTP connections open after the responses.\n"
+			"  -C          Send the HTTP responses with the chunked transfer coding.\n"
+			"  -i ms       Close the HTTP connections idle for longer without notice.\n", name);
+}
+
+int main(int argc, char **argv) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CTX *ksi = NULL;
+	KSITest_StandIn *srv = NULL;
+	KSITest_StandInConfig conf;
+	unsigned long port = 0;
+	int c;
+
+	KSITest_StandInConfig_init(&conf);
+
+	while ((c = getopt(argc, argv, "p:U:u:k:r:l:j:f:s:d:S:a:KCi:h")) != -1) {
+		switch (c) {
+			case 'p': port = strtoul(optarg, NULL, 0); break;
+			case 'U': conf.socketPath = optarg; break;
+			case 'u': conf.loginId = optarg; break;
+			case 'k': conf.key = optarg; break;
+			case 'r': conf.roundMs = (unsigned)strtoul(optarg, NULL, 0); break;
+			case 'l': conf.latencyMs = (unsigned)strtoul(optarg, NULL, 0); break;
+			case 'j': conf.jitterMs = (unsigned)strtoul(optarg, NULL, 0); break;
+			case 'f': conf.failPercent = (unsigned)strtoul(optarg, NULL, 0); break;
+			case 's': conf.failStatus = (unsigned)strtoul(optarg, NULL, 0); break;
+			case 'd': conf.dropPercent = (unsigned)strtoul(optarg, NULL, 0); break;
+			case 'S': conf.seed = (unsigned)strtoul(optarg, NULL, 0); break;
+			case 'a': conf.acceptLimit = (unsigned)strtoul(optarg, NULL, 0); break;
+			case 'K': conf.httpKeepAlive = 1; break;
+			case 'C': conf.httpChunked = 1; break;
+			case 'i': conf.httpIdleMs = (unsigned)strtoul(optarg, NULL, 0); break;
+			default:
+				usage(argv[0]);
+				return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (port > 0xffff) {
+		fprintf(stderr, "Invalid port: %lu\n", port);
+		goto cleanup;
+	}
+
+	res = KSI_CTX_new(&ksi);
+	if (res != KSI_OK) {
+		fprintf(stderr, "Unable to create KSI context.\n");
+		goto cleanup;
+	}
+
+	res = KSITest_StandIn_new(ksi, &conf, (unsigned short)port, &srv);
+	if (res != KSI_OK) {
+		fprintf(stderr, "Unable to start the server: %s\n", KSI_getErrorString(res));
+		goto cleanup;
+	}
+
+	if (conf.socketPath != NULL) {
+		printf("Listening on %s\n", conf.socketPath);
+	} else {
+		printf("Listening on 127.0.0.1:%u\n", (unsigned)KSITest_StandIn_getPort(srv));
+	}
+	fflush(stdout);
+
+	do {
+		res = KSITest_StandIn_serve(srv, 1000);
+	} while (res == KSI_OK);
+
+	KSI_ERR_statusDump(ksi, stderr);
+
+cleanup:
+
+	KSITest_StandIn_free(srv);
+	KSI_CTX_free(ksi);
+
+	return res == KSI_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#else
+
+int main(void) {
+	fprintf(stderr, "The stand-in server is not supported on this platform.\n");
+	return EXIT_FAILURE;
+}
+
+#endif
@@ -20,11 +20,28 @@
 #include <stdio.h>
 #include <string.h>
 #include <ksi/net_uri.h>
+#include <ksi/net_fault.h>
+#include <ksi/net_replay.h>
+#include <ksi/spool.h>
 #include <ksi/compatibility.h>
 
+#include "../src/ksi/internal.h"
+#include "../src/ksi/ctx_impl.h"
 #include "../src/ksi/net_uri_impl.h"
 #include "cutest/CuTest.h"
 #include "all_tests.h"
+#include "ksi_net_standin.h"
+
+#ifndef _WIN32
+#  include <unistd.h>
+#  include <signal.h>
+#  include <sys/socket.h>
+#  include <sys/wait.h>
+#  include <sys/resource.h>
+#  include <poll.h>
+#  include <netinet/in.h>
+#  include <arpa/inet.h>
+#endif
 
 extern KSI_CTX *ctx;
 
@@ -52,12 +69,15 @@ static 	const char *validHttpUri[] = {
 static const char *validTcpUri[] = {
 		"ksi+tcp://localhost:1234",
 		"ksi+tcp://127.0.0.1:1234",
+		"unix:///run/ksi/gateway.sock",
+		"unix://localhost/run/ksi/gateway.sock",
 		NULL
 };
 
 static const char *invalidUri[] = {
 		"ksi+tcp://localhost",
 		"ksi+tcp://127.0.0.1",
+		"unix:///",
 		NULL
 };
 
@@ -238,6 +258,1799 @@ static void testInvalidAggregatorUri(CuTest* tc) {
 	KSI_UriClient_free(uri);
 }
 
+static void sendPoolRequest(CuTest* tc, KSI_UriClient *uri, KSI_RequestHandle **handle, const KSI_UriEndpoint **endpoint) {
+	int res;
+	KSI_DataHash *hsh = NULL;
+	KSI_Integer *reqId = NULL;
+	KSI_AggregationReq *req = NULL;
+
+	res = KSI_DataHash_create(ctx, "pool", 4, KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	res = KSI_AggregationReq_new(ctx, &req);
+	CuAssert(tc, "Unable to create aggregation request.", res == KSI_OK && req != NULL);
+
+	res = KSI_AggregationReq_setRequestHash(req, hsh);
+	CuAssert(tc, "Unable to set request data hash.", res == KSI_OK);
+
+	res = KSI_Integer_new(ctx, 17, &reqId);
+	CuAssert(tc, "Unable to create request id.", res == KSI_OK && reqId != NULL);
+
+	res = KSI_AggregationReq_setRequestId(req, reqId);
+	CuAssert(tc, "Unable to set request id.", res == KSI_OK);
+
+	res = KSI_NetworkClient_sendSignRequest((KSI_NetworkClient *)uri, req, handle);
+	CuAssert(tc, "Unable to send request.", res == KSI_OK && *handle != NULL);
+
+	res = KSI_RequestHandle_getEndpoint(*handle, endpoint);
+	CuAssert(tc, "Request should be routed to an endpoint.", res == KSI_OK && *endpoint != NULL);
+
+	KSI_AggregationReq_free(req);
+}
+
+static void testAggregatorPool(CuTest* tc) {
+	static const char *pool[] = {
+			"ksi+tcp://127.0.0.1:1",
+			"ksi+tcp://127.0.0.1:2",
+			"ksi+tcp://127.0.0.1:3"
+	};
+	int res;
+	KSI_UriClient *uri = NULL;
+	KSI_RequestHandle *handle[4] = {NULL, NULL, NULL, NULL};
+	const KSI_UriEndpoint *ep[4];
+	const KSI_UriEndpoint *tmp = NULL;
+	const unsigned char *raw = NULL;
+	unsigned raw_len;
+	const char *epUri = NULL;
+	size_t count;
+	size_t i;
+	int healthy;
+
+	res = KSI_UriClient_new(ctx, &uri);
+	CuAssert(tc, "Unable to create URI client.", res == KSI_OK && uri != NULL);
+
+	for (i = 0; i < 3; i++) {
+		res = KSI_UriClient_addAggregator(uri, pool[i], "anon", "anon");
+		CuAssert(tc, "Unable to add aggregator.", res == KSI_OK);
+	}
+
+	res = KSI_UriClient_getAggregatorCount(uri, &count);
+	CuAssert(tc, "Aggregator pool should contain all the endpoints.", res == KSI_OK && count == 3);
+	CuAssert(tc, "First endpoint should be served by the shared TCP client.", uri->pAggregationClient == (KSI_NetworkClient *)uri->tcpClient);
+
+	/* Round-robin. */
+	for (i = 0; i < 3; i++) {
+		sendPoolRequest(tc, uri, &handle[i], &ep[i]);
+
+		res = KSI_UriClient_getAggregator(uri, i, &tmp);
+		CuAssert(tc, "Unable to get aggregator.", res == KSI_OK && tmp == ep[i]);
+
+		res = KSI_UriEndpoint_getUri(ep[i], &epUri);
+		CuAssert(tc, "Endpoint URI mismatch.", res == KSI_OK && strcmp(epUri, pool[i]) == 0);
+	}
+
+	/* Least outstanding: only the second endpoint has no pending requests. */
+	res = KSI_UriClient_setLoadBalancing(uri, KSI_URI_BALANCE_LEAST_OUTSTANDING);
+	CuAssert(tc, "Unable to set load balancing.", res == KSI_OK);
+
+	KSI_RequestHandle_free(handle[1]);
+	handle[1] = NULL;
+
+	res = KSI_UriEndpoint_getOutstanding(ep[1], &count);
+	CuAssert(tc, "Abandoned request should not be outstanding.", res == KSI_OK && count == 0);
+
+	sendPoolRequest(tc, uri, &handle[3], &ep[3]);
+	CuAssert(tc, "Request should be routed to the least loaded endpoint.", ep[3] == ep[1]);
+
+	/* Passive health check: a failed request takes the endpoint out of rotation. */
+	res = KSI_UriClient_setHealthCheck(uri, 1, 60);
+	CuAssert(tc, "Unable to configure health check.", res == KSI_OK);
+
+	res = KSI_RequestHandle_getResponse(handle[3], &raw, &raw_len);
+	CuAssert(tc, "Nothing should be listening on the endpoint.", res != KSI_OK);
+
+	res = KSI_UriEndpoint_isHealthy(ep[3], &healthy);
+	CuAssert(tc, "Endpoint should be down.", res == KSI_OK && !healthy);
+
+	res = KSI_UriEndpoint_getRequestCount(ep[3], &count, NULL);
+	CuAssert(tc, "Endpoint request count mismatch.", res == KSI_OK && count == 2);
+
+	KSI_RequestHandle_free(handle[3]);
+	sendPoolRequest(tc, uri, &handle[3], &tmp);
+	CuAssert(tc, "Request should not be routed to an unhealthy endpoint.", tmp != ep[1]);
+
+	/* Routed requests outlive the client. */
+	KSI_UriClient_free(uri);
+
+	res = KSI_UriEndpoint_getUri(tmp, &epUri);
+	CuAssert(tc, "Endpoint should be accessible after the client is freed.", res == KSI_OK && epUri != NULL);
+
+	for (i = 0; i < 4; i++) {
+		KSI_RequestHandle_free(handle[i]);
+	}
+}
+
+#ifndef _WIN32
+static int recvAll(int fd, unsigned char *buf, size_t len) {
+	size_t count = 0;
+	while (count < len) {
+		ssize_t c = recv(fd, buf + count, len - count, 0);
+		if (c <= 0) return -1;
+		count += (size_t)c;
+	}
+	return 0;
+}
+
+/* Accepts a single connection and reads a TLV16 aggregation request, answering it if \c answer is set. */
+static void mockAggregator(int lsock, int answer) {
+	unsigned char buf[0xffff + 4];
+	size_t len;
+	size_t i;
+	int fd;
+
+	/* Do not outlive a failed test. */
+	alarm(10);
+
+	fd = accept(lsock, NULL, NULL);
+	if (fd < 0) _exit(1);
+
+	if (recvAll(fd, buf, 4) != 0) _exit(1);
+	len = (buf[2] << 8) | buf[3];
+	if (recvAll(fd, buf + 4, len) != 0) _exit(1);
+	len += 4;
+
+	if (!answer) {
+		pause();
+		_exit(0);
+	}
+
+	/* Turn the nested request into a response by fixing the tag. */
+	for (i = 4; i + 1 < len;) {
+		if (buf[i] & 0x80) {
+			if (((buf[i] & 0x1f) << 8 | buf[i + 1]) == 0x201) buf[i + 1] = 0x02;
+			i += 4 + ((buf[i + 2] << 8) | buf[i + 3]);
+		} else {
+			i += 2 + buf[i + 1];
+		}
+	}
+
+	if (send(fd, buf, len, 0) != (ssize_t)len) _exit(1);
+
+	close(fd);
+	_exit(0);
+}
+
+static void testHedgedRequest(CuTest* tc) {
+	int res;
+	int lsock[2];
+	pid_t pid[2];
+	char uriBuf[2][64];
+	KSI_UriClient *uri = NULL;
+	KSI_RequestHandle *handle = NULL;
+	const KSI_UriEndpoint *ep = NULL;
+	const KSI_UriEndpoint *slow = NULL;
+	const KSI_UriEndpoint *fast = NULL;
+	const unsigned char *raw = NULL;
+	unsigned raw_len = 0;
+	size_t count;
+	size_t i;
+
+	for (i = 0; i < 2; i++) {
+		struct sockaddr_in addr;
+		socklen_t addr_len = sizeof(addr);
+
+		lsock[i] = (int)socket(AF_INET, SOCK_STREAM, 0);
+		CuAssert(tc, "Unable to open socket.", lsock[i] >= 0);
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = 0;
+
+		CuAssert(tc, "Unable to bind socket.", bind(lsock[i], (struct sockaddr *)&addr, sizeof(addr)) == 0);
+		CuAssert(tc, "Unable to listen.", listen(lsock[i], 1) == 0);
+		CuAssert(tc, "Unable to get port.", getsockname(lsock[i], (struct sockaddr *)&addr, &addr_len) == 0);
+
+		KSI_snprintf(uriBuf[i], sizeof(uriBuf[i]), "ksi+tcp://127.0.0.1:%u", (unsigned)ntohs(addr.sin_port));
+
+		/* The first aggregator never answers. */
+		pid[i] = fork();
+		CuAssert(tc, "Unable to fork.", pid[i] >= 0);
+		if (pid[i] == 0) mockAggregator(lsock[i], i == 1);
+		close(lsock[i]);
+	}
+
+	res = KSI_UriClient_new(ctx, &uri);
+	CuAssert(tc, "Unable to create URI client.", res == KSI_OK && uri != NULL);
+
+	for (i = 0; i < 2; i++) {
+		res = KSI_UriClient_addAggregator(uri, uriBuf[i], "anon", "anon");
+		CuAssert(tc, "Unable to add aggregator.", res == KSI_OK);
+	}
+
+	res = KSI_UriClient_setHedging(uri, 95, 0);
+	CuAssert(tc, "Unable to enable hedging.", res == KSI_OK);
+
+	KSI_UriClient_getAggregator(uri, 0, &slow);
+	KSI_UriClient_getAggregator(uri, 1, &fast);
+
+	/* The request is sent to the slow aggregator first. */
+	sendPoolRequest(tc, uri, &handle, &ep);
+	CuAssert(tc, "Request should be routed to the first aggregator.", ep == slow);
+
+	res = KSI_RequestHandle_getResponse(handle, &raw, &raw_len);
+	CuAssert(tc, "Hedged request should be answered.", res == KSI_OK && raw != NULL && raw_len > 0);
+
+	res = KSI_RequestHandle_getEndpoint(handle, &ep);
+	CuAssert(tc, "Response should come from the second aggregator.", res == KSI_OK && ep == fast);
+
+	res = KSI_UriEndpoint_getOutstanding(slow, &count);
+	CuAssert(tc, "Abandoned request should not be outstanding.", res == KSI_OK && count == 0);
+
+	res = KSI_UriEndpoint_getRequestCount(fast, &count, NULL);
+	CuAssert(tc, "Hedged request should be counted.", res == KSI_OK && count == 1);
+
+	KSI_RequestHandle_free(handle);
+	KSI_UriClient_free(uri);
+
+	kill(pid[0], SIGKILL);
+	for (i = 0; i < 2; i++) {
+		waitpid(pid[i], NULL, 0);
+	}
+}
+
+static void testStandInSignAndExtend(CuTest* tc) {
+	int res;
+	KSI_CTX *lctx = NULL;
+	unsigned short port = 0;
+	pid_t pid = -1;
+	char tcpUri[64];
+	char httpUri[64];
+	KSI_DataHash *hsh = NULL;
+	KSI_DataHash *docHash = NULL;
+	KSI_Signature *sig[2] = {NULL, NULL};
+	KSI_Signature *ext = NULL;
+	KSI_Integer *signTime[2] = {NULL, NULL};
+	KSI_Integer *extTime = NULL;
+	KSI_Integer *future = NULL;
+	size_t i;
+
+	res = KSITest_StandIn_spawn(ctx, NULL, &port, &pid);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	KSI_snprintf(tcpUri, sizeof(tcpUri), "ksi+tcp://127.0.0.1:%u", (unsigned)port);
+	KSI_snprintf(httpUri, sizeof(httpUri), "http://127.0.0.1:%u/", (unsigned)port);
+
+	res = KSI_CTX_new(&lctx);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+
+	res = KSI_CTX_setExtender(lctx, httpUri, "anon", "anon");
+	CuAssert(tc, "Unable to set extender.", res == KSI_OK);
+
+	res = KSI_DataHash_create(lctx, "Stand-in", 8, KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	/* Sign over both transports, each signature gets its own round. */
+	for (i = 0; i < 2; i++) {
+		res = KSI_CTX_setAggregator(lctx, i == 0 ? tcpUri : httpUri, "anon", "anon");
+		CuAssert(tc, "Unable to set aggregator.", res == KSI_OK);
+
+		res = KSI_createSignature(lctx, hsh, &sig[i]);
+		CuAssert(tc, "Unable to sign with the stand-in aggregator.", res == KSI_OK && sig[i] != NULL);
+
+		res = KSI_Signature_getDocumentHash(sig[i], &docHash);
+		CuAssert(tc, "Signature should be for the signed hash.", res == KSI_OK && KSI_DataHash_equals(hsh, docHash));
+
+		res = KSI_Signature_getSigningTime(sig[i], &signTime[i]);
+		CuAssert(tc, "Unable to get signing time.", res == KSI_OK && signTime[i] != NULL);
+	}
+
+	CuAssert(tc, "Rounds should be in ascending order.", KSI_Integer_compare(signTime[0], signTime[1]) < 0);
+
+	res = KSI_Signature_verifyOnline(sig[0], lctx);
+	CuAssert(tc, "Signature should verify against the stand-in extender.", res == KSI_OK);
+
+	/* Extend the first signature to the round of the second one. */
+	res = KSI_Signature_extendTo(sig[0], lctx, signTime[1], &ext);
+	CuAssert(tc, "Unable to extend the signature.", res == KSI_OK && ext != NULL);
+
+	res = KSI_Signature_getSigningTime(ext, &extTime);
+	CuAssert(tc, "Extending should not change the signing time.", res == KSI_OK && KSI_Integer_equals(extTime, signTime[0]));
+
+	res = KSI_Signature_verifyOnline(ext, lctx);
+	CuAssert(tc, "Extended signature should verify online.", res == KSI_OK);
+
+	KSI_Signature_free(ext);
+	ext = NULL;
+
+	/* The calendar can not be extended past its head. */
+	res = KSI_Integer_new(lctx, KSI_Integer_getUInt64(signTime[1]) + 3600, &future);
+	CuAssert(tc, "Unable to create publication time.", res == KSI_OK && future != NULL);
+
+	res = KSI_Signature_extendTo(sig[1], lctx, future, &ext);
+	CuAssert(tc, "Extending past the calendar head should fail.", res == KSI_SERVICE_EXTENDER_REQUEST_TIME_TOO_NEW && ext == NULL);
+
+	KSI_Integer_free(future);
+
+	for (i = 0; i < 2; i++) {
+		KSI_Signature_free(sig[i]);
+	}
+	KSI_DataHash_free(hsh);
+	KSI_CTX_free(lctx);
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+}
+
+static void testStandInFaultInjection(CuTest* tc) {
+	int res;
+	KSI_CTX *lctx = NULL;
+	KSITest_StandInConfig conf;
+	unsigned short port[2];
+	pid_t pid[2] = {-1, -1};
+	char uriBuf[64];
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig = NULL;
+	size_t i;
+
+	/* The first server fails every request, the second one drops them. */
+	KSITest_StandInConfig_init(&conf);
+	conf.failPercent = 100;
+	conf.failStatus = 0x0105;
+
+	res = KSITest_StandIn_spawn(ctx, &conf, &port[0], &pid[0]);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	KSITest_StandInConfig_init(&conf);
+	conf.dropPercent = 100;
+	conf.latencyMs = 50;
+
+	res = KSITest_StandIn_spawn(ctx, &conf, &port[1], &pid[1]);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	res = KSI_CTX_new(&lctx);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+
+	res = KSI_DataHash_create(lctx, "Stand-in", 8, KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	KSI_snprintf(uriBuf, sizeof(uriBuf), "ksi+tcp://127.0.0.1:%u", (unsigned)port[0]);
+	res = KSI_CTX_setAggregator(lctx, uriBuf, "anon", "anon");
+	CuAssert(tc, "Unable to set aggregator.", res == KSI_OK);
+
+	res = KSI_createSignature(lctx, hsh, &sig);
+	CuAssert(tc, "Injected status should be reported.", res == KSI_SERVICE_AGGR_REQUEST_OVER_QUOTA && sig == NULL);
+
+	KSI_snprintf(uriBuf, sizeof(uriBuf), "ksi+tcp://127.0.0.1:%u", (unsigned)port[1]);
+	res = KSI_CTX_setAggregator(lctx, uriBuf, "anon", "anon");
+	CuAssert(tc, "Unable to set aggregator.", res == KSI_OK);
+
+	res = KSI_createSignature(lctx, hsh, &sig);
+	CuAssert(tc, "Dropped connection should fail the request.", res != KSI_OK && sig == NULL);
+
+	/* Wrong credentials are rejected. */
+	KSI_snprintf(uriBuf, sizeof(uriBuf), "ksi+tcp://127.0.0.1:%u", (unsigned)port[0]);
+	res = KSI_CTX_setAggregator(lctx, uriBuf, "anon", "wrong");
+	CuAssert(tc, "Unable to set aggregator.", res == KSI_OK);
+
+	res = KSI_createSignature(lctx, hsh, &sig);
+	CuAssert(tc, "Response should not authenticate with a wrong key.", res == KSI_HMAC_MISMATCH && sig == NULL);
+
+	KSI_DataHash_free(hsh);
+	KSI_CTX_free(lctx);
+
+	for (i = 0; i < 2; i++) {
+		kill(pid[i], SIGKILL);
+		waitpid(pid[i], NULL, 0);
+	}
+}
+
+static void testUnixSocketTransport(CuTest* tc) {
+	int res;
+	KSI_CTX *lctx = NULL;
+	KSI_TcpClient *tcp = NULL;
+	KSITest_StandInConfig conf;
+	unsigned short port = 0;
+	pid_t pid = -1;
+	char path[64];
+	char uriBuf[128];
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig[3] = {NULL, NULL, NULL};
+	size_t i;
+
+	KSI_snprintf(path, sizeof(path), "/tmp/ksi_standin_%ld.sock", (long)getpid());
+
+	KSITest_StandInConfig_init(&conf);
+	conf.socketPath = path;
+
+	res = KSITest_StandIn_spawn(ctx, &conf, &port, &pid);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK && port == 0);
+
+	res = KSI_CTX_new(&lctx);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+
+	KSI_snprintf(uriBuf, sizeof(uriBuf), "unix://%s", path);
+
+	res = KSI_CTX_setAggregator(lctx, uriBuf, "anon", "anon");
+	CuAssert(tc, "Unable to set aggregator.", res == KSI_OK);
+
+	res = KSI_CTX_setExtender(lctx, uriBuf, "anon", "anon");
+	CuAssert(tc, "Unable to set extender.", res == KSI_OK);
+
+	res = KSI_DataHash_create(lctx, "Gateway", 7, KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	/* Consecutive requests share the connection to the gateway. */
+	for (i = 0; i < 3; i++) {
+		res = KSI_createSignature(lctx, hsh, &sig[i]);
+		CuAssert(tc, "Unable to sign over the Unix domain socket.", res == KSI_OK && sig[i] != NULL);
+	}
+
+	res = KSI_Signature_verifyOnline(sig[0], lctx);
+	CuAssert(tc, "Signature should verify against the extender on the Unix domain socket.", res == KSI_OK);
+
+	for (i = 0; i < 3; i++) {
+		KSI_Signature_free(sig[i]);
+		sig[i] = NULL;
+	}
+
+	/* The socket path is set to the TCP client explicitly, port 0 is not a valid port. */
+	res = KSI_TcpClient_new(lctx, &tcp);
+	CuAssert(tc, "Unable to create TCP client.", res == KSI_OK && tcp != NULL);
+
+	res = KSI_TcpClient_setAggregator(tcp, path, 0, "anon", "anon");
+	CuAssert(tc, "Port 0 should be rejected.", res == KSI_INVALID_ARGUMENT);
+
+	res = KSI_TcpClient_setAggregatorUnix(tcp, path, "anon", "anon");
+	CuAssert(tc, "Unable to set aggregator socket path.", res == KSI_OK);
+
+	res = KSI_CTX_setNetworkProvider(lctx, (KSI_NetworkClient *)tcp);
+	CuAssert(tc, "Unable to set network provider.", res == KSI_OK);
+
+	res = KSI_createSignature(lctx, hsh, &sig[0]);
+	CuAssert(tc, "Unable to sign over the Unix domain socket.", res == KSI_OK && sig[0] != NULL);
+
+	KSI_Signature_free(sig[0]);
+	KSI_DataHash_free(hsh);
+	KSI_CTX_free(lctx);
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	unlink(path);
+}
+
+/* Creates a context signing and extending over HTTP with the stand-in server on the given port. */
+static int createHttpContext(unsigned short port, KSI_CTX **lctx) {
+	int res;
+	KSI_CTX *tmp = NULL;
+	char uriBuf[64];
+
+	res = KSI_CTX_new(&tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	KSI_snprintf(uriBuf, sizeof(uriBuf), "http://127.0.0.1:%u/", (unsigned)port);
+
+	res = KSI_CTX_setAggregator(tmp, uriBuf, "anon", "anon");
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_CTX_setExtender(tmp, uriBuf, "anon", "anon");
+	if (res != KSI_OK) goto cleanup;
+
+	*lctx = tmp;
+	tmp = NULL;
+
+cleanup:
+
+	KSI_CTX_free(tmp);
+
+	return res;
+}
+
+static void testHttpConnectionRefused(CuTest* tc) {
+	int res;
+	KSI_CTX *lctx = NULL;
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	int sock;
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig = NULL;
+	size_t i;
+
+	/* A port just released by a socket that never listened refuses the connections. */
+	sock = (int)socket(AF_INET, SOCK_STREAM, 0);
+	CuAssert(tc, "Unable to open socket.", sock >= 0);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	CuAssert(tc, "Unable to bind socket.", bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+	CuAssert(tc, "Unable to get port.", getsockname(sock, (struct sockaddr *)&addr, &addr_len) == 0);
+	close(sock);
+
+	res = createHttpContext(ntohs(addr.sin_port), &lctx);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+
+	res = KSI_DataHash_create(lctx, "Refused", 7, KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	/* The second request must not be stuck behind the first one. */
+	for (i = 0; i < 2; i++) {
+		res = KSI_createSignature(lctx, hsh, &sig);
+		CuAssert(tc, "Refused connection should fail the request.", res == KSI_NETWORK_ERROR && sig == NULL);
+	}
+
+	KSI_DataHash_free(hsh);
+	KSI_CTX_free(lctx);
+}
+
+#if KSI_NET_HTTP_IMPL==KSI_IMPL_NATIVE
+static void testNativeHttpChunkedResponse(CuTest* tc) {
+	int res;
+	KSI_CTX *lctx = NULL;
+	KSITest_StandInConfig conf;
+	unsigned short port = 0;
+	pid_t pid = -1;
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig[2] = {NULL, NULL};
+	size_t i;
+
+	KSITest_StandInConfig_init(&conf);
+	conf.httpChunked = 1;
+	conf.httpKeepAlive = 1;
+
+	res = KSITest_StandIn_spawn(ctx, &conf, &port, &pid);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	res = createHttpContext(port, &lctx);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+
+	res = KSI_DataHash_create(lctx, "Chunked", 7, KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	/* The end of a chunked body tells the responses apart on the persistent connection. */
+	for (i = 0; i < 2; i++) {
+		res = KSI_createSignature(lctx, hsh, &sig[i]);
+		CuAssert(tc, "Unable to sign with a chunked response.", res == KSI_OK && sig[i] != NULL);
+	}
+
+	res = KSI_Signature_verifyOnline(sig[0], lctx);
+	CuAssert(tc, "Signature should verify with a chunked extend response.", res == KSI_OK);
+
+	for (i = 0; i < 2; i++) {
+		KSI_Signature_free(sig[i]);
+	}
+	KSI_DataHash_free(hsh);
+	KSI_CTX_free(lctx);
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+}
+
+static void testNativeHttpKeepAlive(CuTest* tc) {
+	int res;
+	KSITest_StandInConfig conf;
+	unsigned short port = 0;
+	pid_t pid = -1;
+	char uriBuf[64];
+	KSI_HttpClient *http = NULL;
+	KSI_RequestHandle *handle[3] = {NULL, NULL, NULL};
+	KSI_AggregationResp *resp = NULL;
+	KSI_Integer *respId = NULL;
+	size_t i;
+
+	/* Every request has to be served over the only connection accepted. */
+	KSITest_StandInConfig_init(&conf);
+	conf.httpKeepAlive = 1;
+	conf.acceptLimit = 1;
+
+	res = KSITest_StandIn_spawn(ctx, &conf, &port, &pid);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	res = KSI_HttpClient_new(ctx, &http);
+	CuAssert(tc, "Unable to create HTTP client.", res == KSI_OK && http != NULL);
+
+	KSI_snprintf(uriBuf, sizeof(uriBuf), "http://127.0.0.1:%u/", (unsigned)port);
+	res = KSI_HttpClient_setAggregator(http, uriBuf, "anon", "anon");
+	CuAssert(tc, "Unable to set aggregator.", res == KSI_OK);
+
+	for (i = 0; i < 3; i++) {
+		KSI_AggregationReq *req = NULL;
+		KSI_DataHash *hsh = NULL;
+		KSI_Integer *reqId = NULL;
+
+		res = KSI_DataHash_create(ctx, &i, sizeof(i), KSI_HASHALG_SHA2_256, &hsh);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+		res = KSI_AggregationReq_new(ctx, &req);
+		CuAssert(tc, "Unable to create request.", res == KSI_OK && req != NULL);
+
+		res = KSI_AggregationReq_setRequestHash(req, hsh);
+		CuAssert(tc, "Unable to set request hash.", res == KSI_OK);
+
+		res = KSI_Integer_new(ctx, 100 + i, &reqId);
+		CuAssert(tc, "Unable to create request id.", res == KSI_OK && reqId != NULL);
+
+		res = KSI_AggregationReq_setRequestId(req, reqId);
+		CuAssert(tc, "Unable to set request id.", res == KSI_OK);
+
+		res = KSI_NetworkClient_sendSignRequest((KSI_NetworkClient *)http, req, &handle[i]);
+		CuAssert(tc, "Unable to send request.", res == KSI_OK && handle[i] != NULL);
+
+		KSI_AggregationReq_free(req);
+	}
+
+	/* Reading the last response pipelines the rest of the requests after the first one and
+	 * routes the responses to their handles by the order of the requests. */
+	for (i = 3; i-- > 0;) {
+		res = KSI_RequestHandle_getAggregationResponse(handle[i], &resp);
+		CuAssert(tc, "Unable to read the response over the persistent connection.", res == KSI_OK && resp != NULL);
+
+		res = KSI_AggregationResp_getRequestId(resp, &respId);
+		CuAssert(tc, "Response routed to the wrong request handle.", res == KSI_OK && KSI_Integer_getUInt64(respId) == 100 + i);
+
+		KSI_AggregationResp_free(resp);
+		resp = NULL;
+	}
+
+	for (i = 0; i < 3; i++) {
+		KSI_RequestHandle_free(handle[i]);
+	}
+	KSI_HttpClient_free(http);
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+}
+
+static void testNativeHttpIdleClose(CuTest* tc) {
+	int res;
+	KSI_CTX *lctx = NULL;
+	KSITest_StandInConfig conf;
+	unsigned short port = 0;
+	pid_t pid = -1;
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig = NULL;
+	size_t i;
+
+	/* The server closes the persistent connection behind the back of the client. */
+	KSITest_StandInConfig_init(&conf);
+	conf.httpKeepAlive = 1;
+	conf.httpIdleMs = 20;
+
+	res = KSITest_StandIn_spawn(ctx, &conf, &port, &pid);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	res = createHttpContext(port, &lctx);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+
+	res = KSI_DataHash_create(lctx, "Idle", 4, KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	for (i = 0; i < 3; i++) {
+		/* A request written to the closed connection is resent over a new one. */
+		if (i > 0) usleep(100 * 1000);
+
+		res = KSI_createSignature(lctx, hsh, &sig);
+		CuAssert(tc, "Request should be resent after the idle connection was closed.", res == KSI_OK && sig != NULL);
+
+		KSI_Signature_free(sig);
+		sig = NULL;
+	}
+
+	KSI_DataHash_free(hsh);
+	KSI_CTX_free(lctx);
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+}
+
+static void testNativeHttpMalformedResponse(CuTest* tc) {
+	static const char *heads[] = {
+		/* Malformed status line. */
+		"HTTP/1.1 2OO OK\r\nContent-Length: 0\r\n\r\n",
+		/* Header field without a colon. */
+		"HTTP/1.1 200 OK\r\nContent-Type application/ksi-response\r\n\r\n",
+		/* Content-Length not a number. */
+		"HTTP/1.1 200 OK\r\nContent-Length: 1x\r\n\r\n",
+		NULL
+	};
+	int res;
+	KSI_CTX *lctx = NULL;
+	KSITest_StandInConfig conf;
+	unsigned short port = 0;
+	pid_t pid = -1;
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig = NULL;
+	size_t i;
+
+	for (i = 0; heads[i] != NULL; i++) {
+		KSITest_StandInConfig_init(&conf);
+		conf.httpHead = heads[i];
+
+		res = KSITest_StandIn_spawn(ctx, &conf, &port, &pid);
+		CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+		res = createHttpContext(port, &lctx);
+		CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+
+		res = KSI_DataHash_create(lctx, "Malformed", 9, KSI_HASHALG_SHA2_256, &hsh);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+		res = KSI_createSignature(lctx, hsh, &sig);
+		CuAssert(tc, "Malformed response should fail the request.", res == KSI_NETWORK_ERROR && sig == NULL);
+
+		KSI_DataHash_free(hsh);
+		hsh = NULL;
+		KSI_CTX_free(lctx);
+		lctx = NULL;
+
+		kill(pid, SIGKILL);
+		waitpid(pid, NULL, 0);
+	}
+}
+#endif
+
+typedef struct {
+	KSI_uint64_t time[KSI_NET_NOF_PHASES];
+	size_t count;
+} PhaseRecorder;
+
+static void recordPhase(void *phaseCtx, const KSI_RequestHandle *handle, int phase, KSI_uint64_t timeUs) {
+	PhaseRecorder *rec = phaseCtx;
+	(void)handle;
+	rec->time[phase] = timeUs;
+	rec->count++;
+}
+
+static void testRequestPhaseTiming(CuTest* tc) {
+	int res;
+	KSI_CTX *lctx = NULL;
+	KSITest_StandInConfig conf;
+	unsigned short port = 0;
+	pid_t pid = -1;
+	char uriBuf[64];
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig = NULL;
+	PhaseRecorder rec;
+	int phase;
+	size_t i;
+
+	/* The latency of the server should show up between sending and receiving. */
+	KSITest_StandInConfig_init(&conf);
+	conf.latencyMs = 50;
+
+	res = KSITest_StandIn_spawn(ctx, &conf, &port, &pid);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	res = KSI_CTX_new(&lctx);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+
+	res = KSI_CTX_setRequestPhaseCallback(lctx, recordPhase, &rec);
+	CuAssert(tc, "Unable to set request phase callback.", res == KSI_OK);
+
+	res = KSI_DataHash_create(lctx, "Timing", 6, KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	for (i = 0; i < 2; i++) {
+		memset(&rec, 0, sizeof(rec));
+
+		if (i == 0) {
+			KSI_snprintf(uriBuf, sizeof(uriBuf), "ksi+tcp://127.0.0.1:%u", (unsigned)port);
+		} else {
+			KSI_snprintf(uriBuf, sizeof(uriBuf), "http://127.0.0.1:%u/", (unsigned)port);
+		}
+		res = KSI_CTX_setAggregator(lctx, uriBuf, "anon", "anon");
+		CuAssert(tc, "Unable to set aggregator.", res == KSI_OK);
+
+		res = KSI_createSignature(lctx, hsh, &sig);
+		CuAssert(tc, "Unable to sign with the stand-in aggregator.", res == KSI_OK && sig != NULL);
+
+		KSI_Signature_free(sig);
+		sig = NULL;
+
+		/* A new connection is timed from the name resolution, but there is no TLS. */
+		CuAssert(tc, "TLS handshake should not be reported.", rec.time[KSI_NET_PHASE_TLS_DONE] == 0);
+		for (phase = KSI_NET_PHASE_START; phase < KSI_NET_NOF_PHASES; phase++) {
+			if (phase == KSI_NET_PHASE_TLS_DONE) continue;
+			CuAssert(tc, "Phase should be reported.", rec.time[phase] != 0);
+			CuAssert(tc, "Phases should be in order.", phase == KSI_NET_PHASE_START || rec.time[phase] >= rec.time[phase == KSI_NET_PHASE_REQUEST_SENT ? KSI_NET_PHASE_CONNECTED : phase - 1]);
+		}
+		CuAssert(tc, "Every phase should be reported once.", rec.count == KSI_NET_NOF_PHASES - 1);
+		CuAssert(tc, "Server latency should be measured as waiting for the first byte.", rec.time[KSI_NET_PHASE_FIRST_BYTE] - rec.time[KSI_NET_PHASE_REQUEST_SENT] >= 40000);
+	}
+
+	KSI_DataHash_free(hsh);
+	KSI_CTX_free(lctx);
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+}
+
+/* A minimal host event loop, as run by an application driving the network client itself. */
+typedef struct {
+	struct pollfd fds[8];
+	size_t fds_len;
+	int hasTimer;
+	KSI_uint64_t timerAt;
+	size_t done;
+} EventLoop;
+
+static int eventLoopWatch(void *userCtx, int fd, int events) {
+	EventLoop *loop = userCtx;
+	size_t i;
+
+	for (i = 0; i < loop->fds_len && loop->fds[i].fd != fd; i++);
+
+	if (events == KSI_NET_EVENT_REMOVE) {
+		if (i < loop->fds_len) loop->fds[i] = loop->fds[--loop->fds_len];
+		return KSI_OK;
+	}
+
+	if (i == loop->fds_len) {
+		if (loop->fds_len == sizeof(loop->fds) / sizeof(loop->fds[0])) return KSI_BUFFER_OVERFLOW;
+		loop->fds[loop->fds_len++].fd = fd;
+	}
+
+	loop->fds[i].events = ((events & KSI_NET_EVENT_READ) ? POLLIN : 0) | ((events & KSI_NET_EVENT_WRITE) ? POLLOUT : 0);
+
+	return KSI_OK;
+}
+
+static int eventLoopTimer(void *userCtx, long timeoutMs) {
+	EventLoop *loop = userCtx;
+
+	loop->hasTimer = timeoutMs >= 0;
+	loop->timerAt = KSI_NET_getTimeMs() + (timeoutMs > 0 ? timeoutMs : 0);
+
+	return KSI_OK;
+}
+
+static void eventLoopDone(void *userCtx, KSI_RequestHandle *handle) {
+	EventLoop *loop = userCtx;
+	(void)handle;
+	loop->done++;
+}
+
+/* Runs the loop until the expected number of requests has completed. */
+static int EventLoop_run(EventLoop *loop, KSI_NetworkClient *client, size_t expected, unsigned limitMs) {
+	int res = KSI_OK;
+	KSI_uint64_t limit = KSI_NET_getTimeMs() + limitMs;
+
+	while (loop->done < expected && KSI_NET_getTimeMs() < limit) {
+		struct pollfd ready[8];
+		size_t ready_len = loop->fds_len;
+		KSI_uint64_t now = KSI_NET_getTimeMs();
+		int wait = 100;
+		size_t i;
+
+		if (loop->hasTimer) wait = loop->timerAt > now ? (int)(loop->timerAt - now) : 0;
+
+		/* The callbacks may change the watched sockets. */
+		memcpy(ready, loop->fds, sizeof(ready[0]) * ready_len);
+		if (poll(ready, ready_len, wait) < 0) return KSI_IO_ERROR;
+
+		for (i = 0; i < ready_len && res == KSI_OK; i++) {
+			if (ready[i].revents & (POLLIN | POLLERR | POLLHUP)) res = KSI_NetworkClient_onReadable(client, ready[i].fd);
+			if (res == KSI_OK && (ready[i].revents & (POLLOUT | POLLERR | POLLHUP))) res = KSI_NetworkClient_onWritable(client, ready[i].fd);
+		}
+
+		if (res == KSI_OK && loop->hasTimer && KSI_NET_getTimeMs() >= loop->timerAt) {
+			loop->hasTimer = 0;
+			res = KSI_NetworkClient_onTimeout(client);
+		}
+
+		if (res != KSI_OK) break;
+	}
+
+	return res;
+}
+
+static void testEventLoopIntegration(CuTest* tc) {
+	int res;
+	KSITest_StandInConfig conf;
+	unsigned short port = 0;
+	pid_t pid = -1;
+	KSI_TcpClient *tcp = NULL;
+#if KSI_NET_HTTP_IMPL==KSI_IMPL_CURL
+	char uriBuf[64];
+	KSI_HttpClient *http = NULL;
+#endif
+	KSI_NetworkClient *client[2] = {NULL, NULL};
+	KSI_RequestHandle *handle[4] = {NULL, NULL, NULL, NULL};
+	KSI_AggregationResp *resp = NULL;
+	EventLoop loop;
+	size_t n;
+	size_t i;
+
+	KSITest_StandInConfig_init(&conf);
+	conf.latencyMs = 50;
+
+	res = KSITest_StandIn_spawn(ctx, &conf, &port, &pid);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	res = KSI_TcpClient_new(ctx, &tcp);
+	CuAssert(tc, "Unable to create TCP client.", res == KSI_OK && tcp != NULL);
+
+	res = KSI_TcpClient_setAggregator(tcp, "127.0.0.1", port, "anon", "anon");
+	CuAssert(tc, "Unable to set aggregator.", res == KSI_OK);
+	client[0] = (KSI_NetworkClient *)tcp;
+
+#if KSI_NET_HTTP_IMPL==KSI_IMPL_CURL
+	res = KSI_HttpClient_new(ctx, &http);
+	CuAssert(tc, "Unable to create HTTP client.", res == KSI_OK && http != NULL);
+
+	KSI_snprintf(uriBuf, sizeof(uriBuf), "http://127.0.0.1:%u/", (unsigned)port);
+	res = KSI_HttpClient_setAggregator(http, uriBuf, "anon", "anon");
+	CuAssert(tc, "Unable to set aggregator.", res == KSI_OK);
+	client[1] = (KSI_NetworkClient *)http;
+#endif
+
+	for (n = 0; n < 2 && client[n] != NULL; n++) {
+		memset(&loop, 0, sizeof(loop));
+
+		res = KSI_NetworkClient_setEventCallbacks(client[n], eventLoopWatch, eventLoopTimer, eventLoopDone, &loop);
+		CuAssert(tc, "Unable to set event callbacks.", res == KSI_OK);
+
+		for (i = 0; i < 4; i++) {
+			KSI_AggregationReq *req = NULL;
+			KSI_DataHash *hsh = NULL;
+			KSI_Integer *reqId = NULL;
+
+			res = KSI_DataHash_create(ctx, &i, sizeof(i), KSI_HASHALG_SHA2_256, &hsh);
+			CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+			res = KSI_AggregationReq_new(ctx, &req);
+			CuAssert(tc, "Unable to create request.", res == KSI_OK && req != NULL);
+
+			res = KSI_AggregationReq_setRequestHash(req, hsh);
+			CuAssert(tc, "Unable to set request hash.", res == KSI_OK);
+
+			res = KSI_Integer_new(ctx, 100 + i, &reqId);
+			CuAssert(tc, "Unable to create request id.", res == KSI_OK && reqId != NULL);
+
+			res = KSI_AggregationReq_setRequestId(req, reqId);
+			CuAssert(tc, "Unable to set request id.", res == KSI_OK);
+
+			res = KSI_NetworkClient_sendSignRequest(client[n], req, &handle[i]);
+			CuAssert(tc, "Unable to send request.", res == KSI_OK && handle[i] != NULL);
+
+			KSI_AggregationReq_free(req);
+		}
+
+		/* Nothing is waited for outside of the event loop. */
+		res = KSI_RequestHandle_getAggregationResponse(handle[0], &resp);
+		CuAssert(tc, "Response should not be available yet.", res == KSI_ASYNC_NOT_FINISHED && resp == NULL);
+		CuAssert(tc, "Client should be waiting for a socket.", loop.fds_len > 0 || loop.hasTimer);
+
+		res = EventLoop_run(&loop, client[n], 4, 10000);
+		CuAssert(tc, "Event loop failed.", res == KSI_OK);
+		CuAssert(tc, "All requests should complete.", loop.done == 4);
+
+		for (i = 0; i < 4; i++) {
+			res = KSI_RequestHandle_getAggregationResponse(handle[i], &resp);
+			CuAssert(tc, "Unable to read the response.", res == KSI_OK && resp != NULL);
+
+			KSI_AggregationResp_free(resp);
+			resp = NULL;
+
+			KSI_RequestHandle_free(handle[i]);
+			handle[i] = NULL;
+		}
+
+		KSI_NetworkClient_free(client[n]);
+		CuAssert(tc, "Sockets should be released with the client.", loop.fds_len == 0);
+	}
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+}
+static void testEventLoopDefaultProvider(CuTest* tc) {
+	int res;
+	unsigned short port = 0;
+	pid_t pid = -1;
+	char uriBuf[64];
+	KSI_CTX *lctx = NULL;
+	KSI_NetworkClient *client = NULL;
+	KSI_RequestHandle *handle[4] = {NULL, NULL, NULL, NULL};
+	KSI_AggregationResp *resp = NULL;
+	const KSI_UriEndpoint *ep = NULL;
+	size_t requests = 0;
+	size_t failures = 0;
+	EventLoop loop;
+	size_t i;
+
+	memset(&loop, 0, sizeof(loop));
+
+	res = KSITest_StandIn_spawn(ctx, NULL, &port, &pid);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	res = KSI_CTX_new(&lctx);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+	client = lctx->netProvider;
+
+	res = KSI_NetworkClient_setEventCallbacks(client, eventLoopWatch, eventLoopTimer, eventLoopDone, &loop);
+	CuAssert(tc, "Unable to set event callbacks on the default provider.", res == KSI_OK);
+
+	/* The transports created afterwards are event driven as well. */
+	KSI_snprintf(uriBuf, sizeof(uriBuf), "ksi+tcp://127.0.0.1:%u", (unsigned)port);
+	res = KSI_CTX_setAggregator(lctx, uriBuf, "anon", "anon");
+	CuAssert(tc, "Unable to set aggregator.", res == KSI_OK);
+
+	res = KSI_UriClient_addAggregator((KSI_UriClient *)client, uriBuf, "anon", "anon");
+	CuAssert(tc, "Unable to add aggregator.", res == KSI_OK);
+
+	for (i = 0; i < 4; i++) {
+		KSI_AggregationReq *req = NULL;
+		KSI_DataHash *hsh = NULL;
+		KSI_Integer *reqId = NULL;
+
+		res = KSI_DataHash_create(lctx, &i, sizeof(i), KSI_HASHALG_SHA2_256, &hsh);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+		res = KSI_AggregationReq_new(lctx, &req);
+		CuAssert(tc, "Unable to create request.", res == KSI_OK && req != NULL);
+
+		res = KSI_AggregationReq_setRequestHash(req, hsh);
+		CuAssert(tc, "Unable to set request hash.", res == KSI_OK);
+
+		res = KSI_Integer_new(lctx, 100 + i, &reqId);
+		CuAssert(tc, "Unable to create request id.", res == KSI_OK && reqId != NULL);
+
+		res = KSI_AggregationReq_setRequestId(req, reqId);
+		CuAssert(tc, "Unable to set request id.", res == KSI_OK);
+
+		res = KSI_NetworkClient_sendSignRequest(client, req, &handle[i]);
+		CuAssert(tc, "Unable to send request.", res == KSI_OK && handle[i] != NULL);
+
+		KSI_AggregationReq_free(req);
+	}
+
+	res = KSI_RequestHandle_getAggregationResponse(handle[0], &resp);
+	CuAssert(tc, "Response should not be available yet.", res == KSI_ASYNC_NOT_FINISHED && resp == NULL);
+
+	res = EventLoop_run(&loop, client, 4, 10000);
+	CuAssert(tc, "Event loop failed.", res == KSI_OK);
+	CuAssert(tc, "All requests should complete.", loop.done == 4);
+
+	for (i = 0; i < 4; i++) {
+		res = KSI_RequestHandle_getAggregationResponse(handle[i], &resp);
+		CuAssert(tc, "Unable to read the response.", res == KSI_OK && resp != NULL);
+
+		KSI_AggregationResp_free(resp);
+		resp = NULL;
+
+		KSI_RequestHandle_free(handle[i]);
+		handle[i] = NULL;
+	}
+
+	/* Both endpoints were driven by the loop. */
+	for (i = 0; i < 2; i++) {
+		res = KSI_UriClient_getAggregator((KSI_UriClient *)client, i, &ep);
+		CuAssert(tc, "Unable to get endpoint.", res == KSI_OK && ep != NULL);
+
+		res = KSI_UriEndpoint_getRequestCount(ep, &requests, &failures);
+		CuAssert(tc, "Endpoint should have served requests.", res == KSI_OK && requests == 2 && failures == 0);
+	}
+
+	KSI_CTX_free(lctx);
+	CuAssert(tc, "Sockets should be released with the context.", loop.fds_len == 0);
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+}
+
+/* Creates a context signing through a fault injecting client in front of a TCP client. */
+static int createFaultContext(unsigned short port, KSI_CTX **lctx, KSI_FaultClient **fault) {
+	int res;
+	KSI_CTX *tmp = NULL;
+	KSI_TcpClient *tcp = NULL;
+
+	res = KSI_CTX_new(&tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TcpClient_new(tmp, &tcp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_TcpClient_setAggregator(tcp, "127.0.0.1", port, "anon", "anon");
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_FaultClient_new(tmp, (KSI_NetworkClient *)tcp, fault);
+	if (res != KSI_OK) goto cleanup;
+	tcp = NULL;
+
+	res = KSI_CTX_setNetworkProvider(tmp, (KSI_NetworkClient *)*fault);
+	if (res != KSI_OK) goto cleanup;
+
+	*lctx = tmp;
+	tmp = NULL;
+
+cleanup:
+
+	KSI_TcpClient_free(tcp);
+	KSI_CTX_free(tmp);
+
+	return res;
+}
+
+static void testFaultClient(CuTest* tc) {
+	int res;
+	KSI_CTX *lctx = NULL;
+	KSI_FaultClient *fault = NULL;
+	unsigned short port = 0;
+	pid_t pid = -1;
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig = NULL;
+	KSI_uint64_t start;
+	int outcome[2][8];
+	size_t n;
+	size_t i;
+
+	res = KSITest_StandIn_spawn(ctx, NULL, &port, &pid);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	res = createFaultContext(port, &lctx, &fault);
+	CuAssert(tc, "Unable to create fault injecting context.", res == KSI_OK && lctx != NULL);
+
+	res = KSI_DataHash_create(lctx, "Fault", 5, KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	/* Without faults the requests pass through, delayed by the latency. */
+	res = KSI_FaultClient_setLatency(fault, KSI_FAULT_LATENCY_FIXED, 100, 0);
+	CuAssert(tc, "Unable to set latency.", res == KSI_OK);
+
+	start = KSI_NET_getTimeMs();
+	res = KSI_createSignature(lctx, hsh, &sig);
+	CuAssert(tc, "Unable to sign through the fault injecting client.", res == KSI_OK && sig != NULL);
+	CuAssert(tc, "Response should be delayed.", KSI_NET_getTimeMs() - start >= 100);
+
+	KSI_Signature_free(sig);
+	sig = NULL;
+
+	res = KSI_FaultClient_setLatency(fault, KSI_FAULT_LATENCY_FIXED, 0, 0);
+	CuAssert(tc, "Unable to set latency.", res == KSI_OK);
+
+	res = KSI_FaultClient_setErrorPdu(fault, 100, 0x0200);
+	CuAssert(tc, "Unable to set error PDU rate.", res == KSI_OK);
+
+	res = KSI_createSignature(lctx, hsh, &sig);
+	CuAssert(tc, "Injected error PDU should be reported.", res == KSI_SERVICE_INTERNAL_ERROR && sig == NULL);
+
+	res = KSI_FaultClient_setTruncation(fault, 100);
+	CuAssert(tc, "Fault rates over 100 percent should be rejected.", res == KSI_INVALID_ARGUMENT);
+
+	res = KSI_FaultClient_setErrorPdu(fault, 0, 0);
+	CuAssert(tc, "Unable to set error PDU rate.", res == KSI_OK);
+
+	res = KSI_FaultClient_setTruncation(fault, 100);
+	CuAssert(tc, "Unable to set truncation rate.", res == KSI_OK);
+
+	res = KSI_createSignature(lctx, hsh, &sig);
+	CuAssert(tc, "Truncated response should not parse.", res != KSI_OK && sig == NULL);
+
+	res = KSI_FaultClient_setTruncation(fault, 0);
+	CuAssert(tc, "Unable to set truncation rate.", res == KSI_OK);
+
+	res = KSI_FaultClient_setTimeouts(fault, 100, 50);
+	CuAssert(tc, "Unable to set timeout rate.", res == KSI_OK);
+
+	start = KSI_NET_getTimeMs();
+	res = KSI_createSignature(lctx, hsh, &sig);
+	CuAssert(tc, "Injected timeout should be reported.", res == KSI_NETWORK_RECIEVE_TIMEOUT && sig == NULL);
+	CuAssert(tc, "Timeout should be reported after the delay.", KSI_NET_getTimeMs() - start >= 50);
+
+	KSI_DataHash_free(hsh);
+	hsh = NULL;
+	KSI_CTX_free(lctx);
+	lctx = NULL;
+
+	/* The same seed gives the same faults. */
+	for (n = 0; n < 2; n++) {
+		res = createFaultContext(port, &lctx, &fault);
+		CuAssert(tc, "Unable to create fault injecting context.", res == KSI_OK && lctx != NULL);
+
+		res = KSI_DataHash_create(lctx, "Fault", 5, KSI_HASHALG_SHA2_256, &hsh);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+		res = KSI_FaultClient_setSeed(fault, 4242);
+		CuAssert(tc, "Unable to set seed.", res == KSI_OK);
+
+		res = KSI_FaultClient_setErrorPdu(fault, 50, 0x0200);
+		CuAssert(tc, "Unable to set error PDU rate.", res == KSI_OK);
+
+		for (i = 0; i < 8; i++) {
+			outcome[n][i] = KSI_createSignature(lctx, hsh, &sig);
+			KSI_Signature_free(sig);
+			sig = NULL;
+		}
+
+		KSI_DataHash_free(hsh);
+		hsh = NULL;
+		KSI_CTX_free(lctx);
+		lctx = NULL;
+	}
+
+	CuAssert(tc, "Faults should be reproducible.", memcmp(outcome[0], outcome[1], sizeof(outcome[0])) == 0);
+	for (i = 1; i < 8 && outcome[0][i] == outcome[0][0]; i++);
+	CuAssert(tc, "Both outcomes should occur.", i < 8);
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+}
+
+static void testFaultClientEndpoints(CuTest* tc) {
+	int res;
+	KSI_CTX *lctx = NULL;
+	KSI_UriClient *uri = NULL;
+	KSI_FaultClient *fault = NULL;
+	const KSI_UriEndpoint *ep[2];
+	unsigned short port = 0;
+	pid_t pid = -1;
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig = NULL;
+	char uriBuf[64];
+	double latency;
+	size_t requests;
+	size_t failures;
+	size_t i;
+
+	res = KSITest_StandIn_spawn(ctx, NULL, &port, &pid);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	res = KSI_CTX_new(&lctx);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+
+	res = KSI_UriClient_new(lctx, &uri);
+	CuAssert(tc, "Unable to create URI client.", res == KSI_OK && uri != NULL);
+
+	/* Two endpoints of the same server, so the retry has somewhere to go. */
+	KSI_snprintf(uriBuf, sizeof(uriBuf), "ksi+tcp://127.0.0.1:%u", (unsigned)port);
+	for (i = 0; i < 2; i++) {
+		res = KSI_UriClient_addAggregator(uri, uriBuf, "anon", "anon");
+		CuAssert(tc, "Unable to add aggregator.", res == KSI_OK);
+	}
+
+	res = KSI_UriClient_setRetry(uri, 1, 0, 100);
+	CuAssert(tc, "Unable to enable retries.", res == KSI_OK);
+
+	res = KSI_FaultClient_newForUriClient(lctx, uri, &fault);
+	CuAssert(tc, "Unable to create fault injecting client.", res == KSI_OK && fault != NULL);
+
+	res = KSI_CTX_setNetworkProvider(lctx, (KSI_NetworkClient *)fault);
+	CuAssert(tc, "Unable to set network provider.", res == KSI_OK);
+
+	KSI_UriClient_getAggregator(uri, 0, &ep[0]);
+	KSI_UriClient_getAggregator(uri, 1, &ep[1]);
+
+	res = KSI_DataHash_create(lctx, "Fault", 5, KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	/* The injected latency is seen by the endpoint. */
+	res = KSI_FaultClient_setLatency(fault, KSI_FAULT_LATENCY_FIXED, 50, 0);
+	CuAssert(tc, "Unable to set latency.", res == KSI_OK);
+
+	res = KSI_createSignature(lctx, hsh, &sig);
+	CuAssert(tc, "Unable to sign through the fault injecting client.", res == KSI_OK && sig != NULL);
+
+	KSI_Signature_free(sig);
+	sig = NULL;
+
+	latency = 0;
+	for (i = 0; i < 2; i++) {
+		double tmp = 0;
+		KSI_UriEndpoint_getLatency(ep[i], &tmp);
+		if (tmp > latency) latency = tmp;
+	}
+	CuAssert(tc, "Endpoint latency should include the injected delay.", latency >= 50);
+
+	res = KSI_FaultClient_setLatency(fault, KSI_FAULT_LATENCY_FIXED, 0, 0);
+	CuAssert(tc, "Unable to set latency.", res == KSI_OK);
+
+	/* The retry meets the fault as well. */
+	res = KSI_FaultClient_setTimeouts(fault, 100, 20);
+	CuAssert(tc, "Unable to set timeout rate.", res == KSI_OK);
+
+	res = KSI_createSignature(lctx, hsh, &sig);
+	CuAssert(tc, "Injected timeout should be reported.", res == KSI_NETWORK_RECIEVE_TIMEOUT && sig == NULL);
+
+	for (i = 0; i < 2; i++) {
+		res = KSI_UriEndpoint_getRequestCount(ep[i], &requests, &failures);
+		CuAssert(tc, "Both attempts should have failed at their endpoints.", res == KSI_OK && requests >= 1 && failures == 1);
+	}
+
+	KSI_DataHash_free(hsh);
+	KSI_CTX_free(lctx);
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+}
+static void testRetrySingleEndpoint(CuTest* tc) {
+	int res;
+	KSI_CTX *lctx = NULL;
+	KSI_UriClient *uri = NULL;
+	KSI_FaultClient *fault = NULL;
+	const KSI_UriEndpoint *ep = NULL;
+	unsigned short port = 0;
+	pid_t pid = -1;
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig = NULL;
+	char uriBuf[64];
+	size_t requests;
+	size_t failures;
+	size_t i;
+
+	res = KSITest_StandIn_spawn(ctx, NULL, &port, &pid);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	res = KSI_CTX_new(&lctx);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+
+	res = KSI_UriClient_new(lctx, &uri);
+	CuAssert(tc, "Unable to create URI client.", res == KSI_OK && uri != NULL);
+
+	KSI_snprintf(uriBuf, sizeof(uriBuf), "ksi+tcp://127.0.0.1:%u", (unsigned)port);
+	res = KSI_UriClient_addAggregator(uri, uriBuf, "anon", "anon");
+	CuAssert(tc, "Unable to add aggregator.", res == KSI_OK);
+
+	res = KSI_UriClient_setRetry(uri, 2, 10, 100);
+	CuAssert(tc, "Unable to enable retries.", res == KSI_OK);
+
+	res = KSI_FaultClient_newForUriClient(lctx, uri, &fault);
+	CuAssert(tc, "Unable to create fault injecting client.", res == KSI_OK && fault != NULL);
+
+	res = KSI_CTX_setNetworkProvider(lctx, (KSI_NetworkClient *)fault);
+	CuAssert(tc, "Unable to set network provider.", res == KSI_OK);
+
+	KSI_UriClient_getAggregator(uri, 0, &ep);
+
+	res = KSI_DataHash_create(lctx, "Retry", 5, KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	/* Every attempt times out, the only endpoint is tried again until the retries run out. */
+	res = KSI_FaultClient_setTimeouts(fault, 100, 20);
+	CuAssert(tc, "Unable to set timeout rate.", res == KSI_OK);
+
+	res = KSI_createSignature(lctx, hsh, &sig);
+	CuAssert(tc, "Injected timeout should be reported.", res == KSI_NETWORK_RECIEVE_TIMEOUT && sig == NULL);
+
+	res = KSI_UriEndpoint_getRequestCount(ep, &requests, &failures);
+	CuAssert(tc, "The endpoint should have been retried.", res == KSI_OK && requests == 3 && failures == 3);
+
+	/* Some of the attempts time out, the retries get the requests through. */
+	res = KSI_FaultClient_setSeed(fault, 4242);
+	CuAssert(tc, "Unable to set seed.", res == KSI_OK);
+
+	res = KSI_FaultClient_setTimeouts(fault, 30, 20);
+	CuAssert(tc, "Unable to set timeout rate.", res == KSI_OK);
+
+	for (i = 0; i < 4; i++) {
+		res = KSI_createSignature(lctx, hsh, &sig);
+		CuAssert(tc, "Retried request should be answered.", res == KSI_OK && sig != NULL);
+
+		KSI_Signature_free(sig);
+		sig = NULL;
+	}
+
+	res = KSI_UriEndpoint_getRequestCount(ep, &requests, &failures);
+	CuAssert(tc, "Some of the requests should have been retried.", res == KSI_OK && failures > 3 && requests == 4 + failures);
+
+	KSI_DataHash_free(hsh);
+	KSI_CTX_free(lctx);
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+}
+
+static void testHedgeAfterErrorStatus(CuTest* tc) {
+	int res;
+	KSI_CTX *lctx = NULL;
+	KSI_UriClient *uri = NULL;
+	KSITest_StandInConfig conf;
+	const KSI_UriEndpoint *ep[2];
+	unsigned short port[2];
+	pid_t pid[2] = {-1, -1};
+	char uriBuf[64];
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig = NULL;
+	KSI_uint64_t start;
+	size_t requests;
+	size_t i;
+
+	/* The first server answers every request with an error status. */
+	KSITest_StandInConfig_init(&conf);
+	conf.failPercent = 100;
+	conf.failStatus = 0x0200;
+
+	res = KSITest_StandIn_spawn(ctx, &conf, &port[0], &pid[0]);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	res = KSITest_StandIn_spawn(ctx, NULL, &port[1], &pid[1]);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	res = KSI_CTX_new(&lctx);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+
+	res = KSI_UriClient_new(lctx, &uri);
+	CuAssert(tc, "Unable to create URI client.", res == KSI_OK && uri != NULL);
+
+	for (i = 0; i < 2; i++) {
+		KSI_snprintf(uriBuf, sizeof(uriBuf), "ksi+tcp://127.0.0.1:%u", (unsigned)port[i]);
+		res = KSI_UriClient_addAggregator(uri, uriBuf, "anon", "anon");
+		CuAssert(tc, "Unable to add aggregator.", res == KSI_OK);
+	}
+
+	res = KSI_UriClient_setHedging(uri, 95, 0);
+	CuAssert(tc, "Unable to enable hedging.", res == KSI_OK);
+
+	res = KSI_CTX_setNetworkProvider(lctx, (KSI_NetworkClient *)uri);
+	CuAssert(tc, "Unable to set network provider.", res == KSI_OK);
+
+	KSI_UriClient_getAggregator(uri, 0, &ep[0]);
+	KSI_UriClient_getAggregator(uri, 1, &ep[1]);
+
+	res = KSI_DataHash_create(lctx, "Hedge", 5, KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	/* The request goes to the failing server first, its answer sends the hedged request at once. */
+	start = KSI_NET_getTimeMs();
+	res = KSI_createSignature(lctx, hsh, &sig);
+	CuAssert(tc, "Hedged request should be answered.", res == KSI_OK && sig != NULL);
+	CuAssert(tc, "Hedged request should not wait for the delay.", KSI_NET_getTimeMs() - start < 500);
+
+	for (i = 0; i < 2; i++) {
+		res = KSI_UriEndpoint_getRequestCount(ep[i], &requests, NULL);
+		CuAssert(tc, "Both servers should have been asked.", res == KSI_OK && requests == 1);
+	}
+
+	KSI_Signature_free(sig);
+	KSI_DataHash_free(hsh);
+	KSI_CTX_free(lctx);
+
+	for (i = 0; i < 2; i++) {
+		kill(pid[i], SIGKILL);
+		waitpid(pid[i], NULL, 0);
+	}
+}
+
+/* Signs the hashes "Replay 0" .. "Replay n-1" in the given order and serializes the signatures. */
+static int signReplayHashes(KSI_CTX *lctx, size_t n, int reverse, unsigned char **raw, unsigned *raw_len) {
+	int res = KSI_OK;
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig = NULL;
+	char buf[16];
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		size_t k = reverse ? n - 1 - i : i;
+
+		KSI_snprintf(buf, sizeof(buf), "Replay %u", (unsigned)k);
+
+		res = KSI_DataHash_create(lctx, buf, strlen(buf), KSI_HASHALG_SHA2_256, &hsh);
+		if (res != KSI_OK) break;
+
+		res = KSI_createSignature(lctx, hsh, &sig);
+		if (res != KSI_OK) break;
+
+		res = KSI_Signature_serialize(sig, &raw[k], &raw_len[k]);
+		if (res != KSI_OK) break;
+
+		KSI_Signature_free(sig);
+		sig = NULL;
+		KSI_DataHash_free(hsh);
+		hsh = NULL;
+	}
+
+	KSI_Signature_free(sig);
+	KSI_DataHash_free(hsh);
+
+	return res;
+}
+
+static void testRecordAndReplay(CuTest* tc) {
+	int res;
+	KSI_CTX *lctx = NULL;
+	KSITest_StandInConfig conf;
+	unsigned short port = 0;
+	pid_t pid = -1;
+	char path[64];
+	KSI_TcpClient *tcp = NULL;
+	KSI_RecordingClient *rec = NULL;
+	KSI_ReplayClient *replay = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig = NULL;
+	unsigned char *raw[2][3];
+	unsigned raw_len[2][3];
+	KSI_uint64_t start;
+	size_t i;
+	size_t j;
+
+	memset(raw, 0, sizeof(raw));
+	KSI_snprintf(path, sizeof(path), "/tmp/ksi_capture_%ld.bin", (long)getpid());
+
+	KSITest_StandInConfig_init(&conf);
+	conf.latencyMs = 50;
+
+	res = KSITest_StandIn_spawn(ctx, &conf, &port, &pid);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	/* Record a run against the stand-in server. */
+	res = KSI_CTX_new(&lctx);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+
+	res = KSI_TcpClient_new(lctx, &tcp);
+	CuAssert(tc, "Unable to create TCP client.", res == KSI_OK && tcp != NULL);
+
+	res = KSI_TcpClient_setAggregator(tcp, "127.0.0.1", port, "anon", "anon");
+	CuAssert(tc, "Unable to set aggregator.", res == KSI_OK);
+
+	res = KSI_RecordingClient_new(lctx, (KSI_NetworkClient *)tcp, path, &rec);
+	CuAssert(tc, "Unable to create recording client.", res == KSI_OK && rec != NULL);
+
+	res = KSI_CTX_setNetworkProvider(lctx, (KSI_NetworkClient *)rec);
+	CuAssert(tc, "Unable to set network provider.", res == KSI_OK);
+
+	res = signReplayHashes(lctx, 3, 0, raw[0], raw_len[0]);
+	CuAssert(tc, "Unable to sign through the recording client.", res == KSI_OK);
+
+	KSI_CTX_free(lctx);
+	lctx = NULL;
+
+	/* The server is not needed for replaying. */
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+
+	for (i = 0; i < 3; i++) {
+		res = KSI_CTX_new(&lctx);
+		CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+
+		res = KSI_ReplayClient_new(lctx, path, &replay);
+		CuAssert(tc, "Unable to load the capture.", res == KSI_OK && replay != NULL);
+
+		/* The last run authenticates the responses with other credentials. */
+		res = KSI_NetworkClient_setAggregatorUser((KSI_NetworkClient *)replay, i < 2 ? "anon" : "replay");
+		CuAssert(tc, "Unable to set aggregator user.", res == KSI_OK);
+
+		res = KSI_NetworkClient_setAggregatorPass((KSI_NetworkClient *)replay, i < 2 ? "anon" : "secret");
+		CuAssert(tc, "Unable to set aggregator pass.", res == KSI_OK);
+
+		/* The first run keeps the recorded timing, the others respond immediately. */
+		if (i > 0) {
+			res = KSI_ReplayClient_setTimeScale(replay, 0);
+			CuAssert(tc, "Unable to set time scale.", res == KSI_OK);
+		}
+
+		res = KSI_CTX_setNetworkProvider(lctx, (KSI_NetworkClient *)replay);
+		CuAssert(tc, "Unable to set network provider.", res == KSI_OK);
+
+		/* The last run asks in another order, so the request ids differ from the recorded ones. */
+		start = KSI_NET_getTimeMs();
+		res = signReplayHashes(lctx, 3, i == 2, raw[1], raw_len[1]);
+		CuAssert(tc, "Unable to sign with the replayed responses.", res == KSI_OK);
+		CuAssert(tc, "Replay should follow the time scale.", i == 0 ? KSI_NET_getTimeMs() - start >= 150 : KSI_NET_getTimeMs() - start < 150);
+
+		for (j = 0; j < 3; j++) {
+			CuAssert(tc, "Replayed signature should match the recorded one.", raw_len[0][j] == raw_len[1][j] && memcmp(raw[0][j], raw[1][j], raw_len[0][j]) == 0);
+			KSI_free(raw[1][j]);
+			raw[1][j] = NULL;
+		}
+
+		/* A request that was not recorded can not be answered. */
+		res = KSI_DataHash_create(lctx, "Unknown", 7, KSI_HASHALG_SHA2_256, &hsh);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+		res = KSI_createSignature(lctx, hsh, &sig);
+		CuAssert(tc, "Unrecorded request should fail.", res == KSI_NETWORK_ERROR && sig == NULL);
+
+		KSI_DataHash_free(hsh);
+		hsh = NULL;
+		KSI_CTX_free(lctx);
+		lctx = NULL;
+	}
+
+	for (i = 0; i < 3; i++) {
+		KSI_free(raw[0][i]);
+	}
+
+	remove(path);
+}
+typedef struct {
+	size_t count;
+	int status[4];
+	char meta[4];
+	int hashMatches[4];
+} SpoolDelivery;
+
+static void collectSpooled(void *cbCtx, const KSI_DataHash *hsh, const unsigned char *meta, size_t meta_len, int status, KSI_Signature *sig) {
+	SpoolDelivery *d = cbCtx;
+	KSI_DataHash *docHash = NULL;
+
+	if (d->count < 4) {
+		d->status[d->count] = status;
+		d->meta[d->count] = meta_len == 1 ? (char)meta[0] : '?';
+		d->hashMatches[d->count] = sig != NULL && KSI_Signature_getDocumentHash(sig, &docHash) == KSI_OK && KSI_DataHash_equals(hsh, docHash);
+	}
+	d->count++;
+
+	KSI_Signature_free(sig);
+}
+
+static void testSigningSpool(CuTest* tc) {
+	int res;
+	KSI_CTX *lctx = NULL;
+	unsigned short port = 0;
+	pid_t pid = -1;
+	char path[64];
+	char uriBuf[64];
+	KSI_SigningSpool *spool = NULL;
+	KSI_DataHash *hsh[3] = {NULL, NULL, NULL};
+	KSI_Signature *sig = NULL;
+	SpoolDelivery delivered;
+	size_t count = 0;
+	size_t i;
+
+	memset(&delivered, 0, sizeof(delivered));
+	KSI_snprintf(path, sizeof(path), "/tmp/ksi_spool_%ld.log", (long)getpid());
+	remove(path);
+
+	res = KSITest_StandIn_spawn(ctx, NULL, &port, &pid);
+	CuAssert(tc, "Unable to start the stand-in server.", res == KSI_OK);
+
+	res = KSI_CTX_new(&lctx);
+	CuAssert(tc, "Unable to create context.", res == KSI_OK && lctx != NULL);
+
+	/* Nothing listens on the port. */
+	res = KSI_CTX_setAggregator(lctx, "ksi+tcp://127.0.0.1:1", "anon", "anon");
+	CuAssert(tc, "Unable to set aggregator.", res == KSI_OK);
+
+	for (i = 0; i < 3; i++) {
+		res = KSI_DataHash_create(lctx, &i, sizeof(i), KSI_HASHALG_SHA2_256, &hsh[i]);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh[i] != NULL);
+	}
+
+	res = KSI_SigningSpool_open(lctx, path, &spool);
+	CuAssert(tc, "Unable to open the signing spool.", res == KSI_OK && spool != NULL);
+
+	for (i = 0; i < 3; i++) {
+		unsigned char meta = (unsigned char)('a' + i);
+
+		res = KSI_SigningSpool_sign(spool, hsh[i], 0, &meta, 1, &sig);
+		CuAssert(tc, "Hash should be spooled during the outage.", res == KSI_ASYNC_NOT_FINISHED && sig == NULL);
+	}
+
+	/* The pending hashes survive a restart. */
+	KSI_SigningSpool_close(spool);
+	spool = NULL;
+
+	res = KSI_SigningSpool_open(lctx, path, &spool);
+	CuAssert(tc, "Unable to reopen the signing spool.", res == KSI_OK && spool != NULL);
+
+	res = KSI_SigningSpool_getPendingCount(spool, &count);
+	CuAssert(tc, "Spooled hashes should be pending.", res == KSI_OK && count == 3);
+
+	res = KSI_SigningSpool_setCallback(spool, collectSpooled, &delivered);
+	CuAssert(tc, "Unable to set callback.", res == KSI_OK);
+
+	res = KSI_SigningSpool_drain(spool, 0, &count);
+	CuAssert(tc, "Draining should fail during the outage.", res == KSI_NETWORK_ERROR && count == 0 && delivered.count == 0);
+
+	/* The aggregator comes back. */
+	KSI_snprintf(uriBuf, sizeof(uriBuf), "ksi+tcp://127.0.0.1:%u", (unsigned)port);
+	res = KSI_CTX_setAggregator(lctx, uriBuf, "anon", "anon");
+	CuAssert(tc, "Unable to set aggregator.", res == KSI_OK);
+
+	res = KSI_SigningSpool_setDrainBatch(spool, 2);
+	CuAssert(tc, "Unable to set drain batch.", res == KSI_OK);
+
+	res = KSI_SigningSpool_drain(spool, 0, &count);
+	CuAssert(tc, "Unable to drain the spool.", res == KSI_OK && count == 3);
+	CuAssert(tc, "All hashes should be delivered.", delivered.count == 3);
+
+	for (i = 0; i < 3; i++) {
+		CuAssert(tc, "Hash should be signed.", delivered.status[i] == KSI_OK && delivered.hashMatches[i]);
+		CuAssert(tc, "Hashes should be delivered in order with their metadata.", delivered.meta[i] == 'a' + (char)i);
+	}
+
+	res = KSI_SigningSpool_getPendingCount(spool, &count);
+	CuAssert(tc, "Spool should be empty.", res == KSI_OK && count == 0);
+
+	res = KSI_SigningSpool_sign(spool, hsh[0], 0, NULL, 0, &sig);
+	CuAssert(tc, "Hash should be signed directly.", res == KSI_OK && sig != NULL);
+
+	KSI_Signature_free(sig);
+	KSI_SigningSpool_close(spool);
+	spool = NULL;
+
+	res = KSI_SigningSpool_open(lctx, path, &spool);
+	CuAssert(tc, "Unable to reopen the signing spool.", res == KSI_OK && spool != NULL);
+
+	res = KSI_SigningSpool_getPendingCount(spool, &count);
+	CuAssert(tc, "Signed hashes should not be pending after a restart.", res == KSI_OK && count == 0);
+
+	KSI_SigningSpool_close(spool);
+	for (i = 0; i < 3; i++) {
+		KSI_DataHash_free(hsh[i]);
+	}
+	KSI_CTX_free(lctx);
+	remove(path);
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+}
+
+static void testSigningSpoolWriteError(CuTest* tc) {
+	int res;
+	char path[64];
+	KSI_SigningSpool *spool = NULL;
+	KSI_DataHash *hsh = NULL;
+	unsigned char meta[8192];
+	struct rlimit orig;
+	struct rlimit lim;
+	void (*origHandler)(int);
+	FILE *f = NULL;
+	long size;
+	size_t count = 0;
+	size_t i;
+
+	memset(meta, 'm', sizeof(meta));
+	KSI_snprintf(path, sizeof(path), "/tmp/ksi_spool_err_%ld.log", (long)getpid());
+	remove(path);
+
+	res = KSI_DataHash_create(ctx, "spool", 5, KSI_HASHALG_SHA2_256, &hsh);
+	CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+	res = KSI_SigningSpool_open(ctx, path, &spool);
+	CuAssert(tc, "Unable to open the signing spool.", res == KSI_OK && spool != NULL);
+
+	for (i = 0; i < 2; i++) {
+		res = KSI_SigningSpool_add(spool, hsh, 0, meta, 1);
+		CuAssert(tc, "Unable to spool the hash.", res == KSI_OK);
+	}
+
+	res = KSI_SigningSpool_sync(spool);
+	CuAssert(tc, "Unable to sync the signing spool.", res == KSI_OK);
+
+	f = fopen(path, "rb");
+	CuAssert(tc, "Unable to open the log.", f != NULL);
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fclose(f);
+
+	/* Let the write of a large record fail partway. */
+	origHandler = signal(SIGXFSZ, SIG_IGN);
+	getrlimit(RLIMIT_FSIZE, &orig);
+	lim = orig;
+	lim.rlim_cur = (rlim_t)size + 64;
+	setrlimit(RLIMIT_FSIZE, &lim);
+
+	res = KSI_SigningSpool_add(spool, hsh, 0, meta, sizeof(meta));
+
+	setrlimit(RLIMIT_FSIZE, &orig);
+	signal(SIGXFSZ, origHandler);
+
+	CuAssert(tc, "Writing the record should fail.", res == KSI_IO_ERROR);
+
+	res = KSI_SigningSpool_getPendingCount(spool, &count);
+	CuAssert(tc, "The failed hash should not be pending.", res == KSI_OK && count == 2);
+
+	/* The next record must not end up behind a torn one. */
+	res = KSI_SigningSpool_add(spool, hsh, 0, meta, 1);
+	CuAssert(tc, "Unable to spool the hash after the error.", res == KSI_OK);
+
+	KSI_SigningSpool_close(spool);
+	spool = NULL;
+
+	res = KSI_SigningSpool_open(ctx, path, &spool);
+	CuAssert(tc, "Unable to reopen the signing spool.", res == KSI_OK && spool != NULL);
+
+	res = KSI_SigningSpool_getPendingCount(spool, &count);
+	CuAssert(tc, "All written hashes should be pending after a restart.", res == KSI_OK && count == 3);
+
+	KSI_SigningSpool_close(spool);
+	KSI_DataHash_free(hsh);
+	remove(path);
+}
+#endif
+
 CuSuite* KSITest_uriClient_getSuite(void) {
 	CuSuite* suite = CuSuiteNew();
 
@@ -248,6 +2061,30 @@ CuSuite* KSITest_uriClient_getSuite(void) {
 	SUITE_ADD_TEST(suite, testValidExtenderTcpUri);
 	SUITE_ADD_TEST(suite, testInvalidExtenderUri);
 	SUITE_ADD_TEST(suite, testInvalidAggregatorUri);
+	SUITE_ADD_TEST(suite, testAggregatorPool);
+#ifndef _WIN32
+	SUITE_ADD_TEST(suite, testHedgedRequest);
+	SUITE_ADD_TEST(suite, testStandInSignAndExtend);
+	SUITE_ADD_TEST(suite, testStandInFaultInjection);
+	SUITE_ADD_TEST(suite, testRequestPhaseTiming);
+	SUITE_ADD_TEST(suite, testUnixSocketTransport);
+	SUITE_ADD_TEST(suite, testHttpConnectionRefused);
+#if KSI_NET_HTTP_IMPL==KSI_IMPL_NATIVE
+	SUITE_ADD_TEST(suite, testNativeHttpChunkedResponse);
+	SUITE_ADD_TEST(suite, testNativeHttpKeepAlive);
+	SUITE_ADD_TEST(suite, testNativeHttpIdleClose);
+	SUITE_ADD_TEST(suite, testNativeHttpMalformedResponse);
+#endif
+	SUITE_ADD_TEST(suite, testEventLoopIntegration);
+	SUITE_ADD_TEST(suite, testEventLoopDefaultProvider);
+	SUITE_ADD_TEST(suite, testFaultClient);
+	SUITE_ADD_TEST(suite, testFaultClientEndpoints);
+	SUITE_ADD_TEST(suite, testRetrySingleEndpoint);
+	SUITE_ADD_TEST(suite, testHedgeAfterErrorStatus);
+	SUITE_ADD_TEST(suite, testRecordAndReplay);
+	SUITE_ADD_TEST(suite, testSigningSpool);
+	SUITE_ADD_TEST(suite, testSigningSpoolWriteError);
+#endif
 
 	return suite;
 }